@@ -52,7 +52,9 @@ mark_as_advanced(GTSAM_SINGLE_TEST_EXE)
 
 # Enable make check (http://www.cmake.org/Wiki/CMakeEmulateMakeCheck)
 if(GTSAM_BUILD_TESTS)
-    add_custom_target(check COMMAND ${CMAKE_CTEST_COMMAND} -C $<CONFIGURATION> --output-on-failure)
+    add_custom_target(check COMMAND ${CMAKE_CTEST_COMMAND} -C $<CONFIGURATION> --output-on-failure -LE perf)
+    # Performance regression tests (tests labelled 'perf'), not part of check
+    add_custom_target(perf COMMAND ${CMAKE_CTEST_COMMAND} -C $<CONFIGURATION> --output-on-failure -L perf)
 endif()
 
 # Add examples target
@@ -70,7 +72,7 @@ macro(gtsamAddTestsGlob_impl groupName globPatterns excludedFiles linkLibraries
 	if(GTSAM_BUILD_TESTS)
 		# Add group target if it doesn't already exist
 	    if(NOT TARGET check.${groupName})
-			add_custom_target(check.${groupName} COMMAND ${CMAKE_CTEST_COMMAND} -C $<CONFIGURATION> --output-on-failure)
+			add_custom_target(check.${groupName} COMMAND ${CMAKE_CTEST_COMMAND} -C $<CONFIGURATION> --output-on-failure -LE perf)
 		endif()
 
 	    # Get all script files
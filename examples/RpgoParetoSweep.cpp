@@ -0,0 +1,472 @@
+/*
+Sweep a grid of PcmParams and GncParams over g2o datasets with ground truth,
+one process per run, and print the Pareto table of runtime versus trajectory
+error and loop closure precision / recall
+author: Yun Chang
+*/
+
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtsam/geometry/Pose2.h>
+#include <gtsam/geometry/Pose3.h>
+#include <gtsam/slam/dataset.h>
+
+#include "KimeraRPGO/Logger.h"
+#include "KimeraRPGO/RobustSolver.h"
+#include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/utils/GeometryUtils.h"
+#include "KimeraRPGO/utils/TypeUtils.h"
+
+using namespace KimeraRPGO;
+
+/* Usage: ./RpgoParetoSweep <2d or 3d> <sweep-file> <output-csv>
+   <opt: number of processes>
+   The sweep file lists the datasets and the values of every swept parameter
+   (parameters left out keep the value below), for example:
+     dataset /data/city10k.g2o /data/city10k_gt.g2o
+     inlier_tolerance 0.5 0.1   # loop closure vs ground truth [m] [rad]
+     odom_threshold 1 3 10
+     lc_threshold 1 3 10
+     incremental 0 1
+     gnc_probability 0 0.9      # 0: no GNC
+     mu_step 1.4 2
+     max_iterations 100
+     fix_prev_inliers 0 1
+     bias_odom 0 1
+     online 0 1                 # 1: one update per loop closure
+*/
+
+namespace {
+
+enum Param {
+  ODOM_THRESHOLD = 0,
+  LC_THRESHOLD,
+  INCREMENTAL,
+  GNC_PROBABILITY,
+  MU_STEP,
+  MAX_ITERATIONS,
+  FIX_PREV_INLIERS,
+  BIAS_ODOM,
+  ONLINE,
+  NUM_PARAMS
+};
+
+const char* kParamNames[NUM_PARAMS] = {"odom_threshold",
+                                       "lc_threshold",
+                                       "incremental",
+                                       "gnc_probability",
+                                       "mu_step",
+                                       "max_iterations",
+                                       "fix_prev_inliers",
+                                       "bias_odom",
+                                       "online"};
+const double kParamDefaults[NUM_PARAMS] = {3, 3, 0, 0, 1.4, 100, 0, 0, 0};
+
+typedef std::vector<double> Config;  // one value per Param
+
+struct Dataset {
+  std::string g2o_file;
+  std::string gt_file;
+  gtsam::GraphAndValues graph;
+  gtsam::Values ground_truth;
+  // loop closure keys -> agrees with the ground truth
+  std::map<std::pair<gtsam::Key, gtsam::Key>, bool> labels;
+  size_t num_true_inliers = 0;
+};
+
+// sent from the child process through a pipe
+struct RunResult {
+  bool ok = false;
+  double runtime_s = 0;
+  double sq_error_sum = 0;  // position errors w.r.t. ground truth
+  size_t num_poses = 0;
+  size_t num_accepted = 0;  // labeled loop closures kept by the solver
+  size_t true_positives = 0;
+};
+
+struct Summary {
+  Config config;
+  bool ok = true;
+  double runtime_s = 0;
+  double ate = 0;
+  double precision = 1;
+  double recall = 1;
+  bool pareto = false;
+};
+
+template <class T>
+gtsam::GraphAndValues load(const std::string& file);
+
+template <>
+gtsam::GraphAndValues load<gtsam::Pose2>(const std::string& file) {
+  return gtsam::load2D(file,
+                       gtsam::SharedNoiseModel(),
+                       0,
+                       false,
+                       true,
+                       gtsam::NoiseFormatG2O);
+}
+
+template <>
+gtsam::GraphAndValues load<gtsam::Pose3>(const std::string& file) {
+  return gtsam::load3D(file);
+}
+
+// same split as RpgoReadG2oIncremental
+template <class T>
+bool isLoopClosure(const gtsam::NonlinearFactor::shared_ptr& factor) {
+  return boost::dynamic_pointer_cast<gtsam::BetweenFactor<T>>(factor) &&
+         factor->front() + 1 != factor->back();
+}
+
+template <class T>
+bool loadDataset(Dataset* data, double trans_tol, double rot_tol) {
+  data->graph = load<T>(data->g2o_file);
+  data->ground_truth = *load<T>(data->gt_file).second;
+  if (data->graph.first->size() == 0) {
+    log<WARNING>("No factors in %1%") % data->g2o_file;
+    return false;
+  }
+  for (const auto& factor : *data->graph.first) {
+    if (!isLoopClosure<T>(factor)) continue;
+    const gtsam::Key from = factor->front();
+    const gtsam::Key to = factor->back();
+    if (!data->ground_truth.exists(from) || !data->ground_truth.exists(to)) {
+      continue;  // unlabeled: left out of precision and recall
+    }
+    const T measured =
+        boost::dynamic_pointer_cast<gtsam::BetweenFactor<T>>(factor)
+            ->measured();
+    const T error = measured.between(data->ground_truth.at<T>(from).between(
+        data->ground_truth.at<T>(to)));
+    const bool inlier =
+        error.translation().norm() < trans_tol &&
+        T::Rotation::Logmap(error.rotation()).norm() < rot_tol;
+    data->labels[std::make_pair(from, to)] = inlier;
+    if (inlier) data->num_true_inliers++;
+  }
+  return true;
+}
+
+template <class T>
+RunResult run(const Dataset& data, const Config& config, bool is_3d) {
+  RobustSolverParams params;
+  if (is_3d) {
+    params.setPcm3DParams(
+        config[ODOM_THRESHOLD], config[LC_THRESHOLD], Verbosity::QUIET);
+  } else {
+    params.setPcm2DParams(
+        config[ODOM_THRESHOLD], config[LC_THRESHOLD], Verbosity::QUIET);
+  }
+  if (config[INCREMENTAL] > 0) params.setIncremental();
+  if (config[GNC_PROBABILITY] > 0) {
+    params.setGncInlierCostThresholdsAtProbability(
+        config[GNC_PROBABILITY],
+        static_cast<size_t>(config[MAX_ITERATIONS]),
+        config[MU_STEP],
+        1e-5,
+        1e-4,
+        config[FIX_PREV_INLIERS] > 0,
+        config[BIAS_ODOM] > 0);
+  }
+
+  // prior on the first key, as in RpgoReadG2o
+  const gtsam::NonlinearFactorGraph& nfg = *data.graph.first;
+  const gtsam::Values& values = *data.graph.second;
+  const gtsam::Key first_key = nfg[0]->front();
+  static const gtsam::SharedNoiseModel& init_noise =
+      gtsam::noiseModel::Diagonal::Sigmas(
+          Eigen::VectorXd::Zero(getDim<T>()));
+  gtsam::NonlinearFactorGraph non_lc_factors, lc_factors;
+  non_lc_factors.add(gtsam::PriorFactor<T>(
+      first_key, values.at<T>(first_key), init_noise));
+  for (const auto& factor : nfg) {
+    if (isLoopClosure<T>(factor)) {
+      lc_factors.add(factor);
+    } else {
+      non_lc_factors.add(factor);
+    }
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<RobustSolver> pgo =
+      KimeraRPGO::make_unique<RobustSolver>(params);
+  if (config[ONLINE] > 0) {
+    pgo->update(non_lc_factors, values);
+    for (const auto& loop_closure : lc_factors) {
+      gtsam::NonlinearFactorGraph new_factors;
+      new_factors.add(loop_closure);
+      pgo->update(new_factors, gtsam::Values());
+    }
+  } else {
+    non_lc_factors.push_back(lc_factors);
+    pgo->update(non_lc_factors, values);
+  }
+  RunResult result;
+  result.runtime_s = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+  // trajectory error, aligned at the first key
+  const gtsam::Values estimate = pgo->calculateEstimate();
+  const T align = data.ground_truth.at<T>(first_key) *
+                  estimate.at<T>(first_key).inverse();
+  for (const auto& key_value : data.ground_truth) {
+    if (!estimate.exists(key_value.key)) continue;
+    const T error = data.ground_truth.at<T>(key_value.key)
+                        .between(align * estimate.at<T>(key_value.key));
+    result.sq_error_sum += std::pow(error.translation().norm(), 2);
+    result.num_poses++;
+  }
+
+  // loop closures kept by PCM (and not rejected by GNC)
+  const gtsam::NonlinearFactorGraph factors = pgo->getFactorsUnsafe();
+  const gtsam::Vector weights = pgo->getGncWeights();
+  const bool use_weights =
+      static_cast<size_t>(weights.size()) == factors.size();
+  for (size_t i = 0; i < factors.size(); i++) {
+    if (!factors[i] || !isLoopClosure<T>(factors[i])) continue;
+    if (use_weights && weights(i) < 0.5) continue;
+    const auto label = data.labels.find(
+        std::make_pair(factors[i]->front(), factors[i]->back()));
+    if (label == data.labels.end()) continue;
+    result.num_accepted++;
+    if (label->second) result.true_positives++;
+  }
+  result.ok = true;
+  return result;
+}
+
+std::vector<Config> makeGrid(const std::vector<std::vector<double>>& values) {
+  std::vector<Config> grid(1);
+  for (size_t p = 0; p < NUM_PARAMS; p++) {
+    std::vector<Config> next;
+    for (const Config& config : grid) {
+      for (const double value : values[p]) {
+        next.push_back(config);
+        next.back().push_back(value);
+      }
+    }
+    grid.swap(next);
+  }
+  return grid;
+}
+
+bool dominates(const Summary& a, const Summary& b) {
+  const bool no_worse = a.runtime_s <= b.runtime_s && a.ate <= b.ate &&
+                        a.precision >= b.precision && a.recall >= b.recall;
+  const bool better = a.runtime_s < b.runtime_s || a.ate < b.ate ||
+                      a.precision > b.precision || a.recall > b.recall;
+  return no_worse && better;
+}
+
+template <class T>
+int sweep(const std::string& sweep_file,
+          const std::string& output_csv,
+          size_t num_processes,
+          bool is_3d) {
+  std::ifstream infile(sweep_file);
+  if (!infile.is_open()) {
+    log<WARNING>("Cannot open sweep file %1%") % sweep_file;
+    return 1;
+  }
+  std::vector<Dataset> datasets;
+  std::vector<std::vector<double>> values(NUM_PARAMS);
+  double trans_tol = 0.5, rot_tol = 0.1;
+  std::string line;
+  while (std::getline(infile, line)) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream stream(line);
+    std::string name;
+    if (!(stream >> name)) continue;
+    if (name == "dataset") {
+      datasets.emplace_back();
+      stream >> datasets.back().g2o_file >> datasets.back().gt_file;
+      continue;
+    }
+    if (name == "inlier_tolerance") {
+      stream >> trans_tol >> rot_tol;
+      continue;
+    }
+    const size_t p = std::find(kParamNames, kParamNames + NUM_PARAMS, name) -
+                     kParamNames;
+    if (p == NUM_PARAMS) {
+      log<WARNING>("Unknown sweep parameter %1%") % name;
+      return 1;
+    }
+    double value;
+    while (stream >> value) values[p].push_back(value);
+  }
+  for (size_t p = 0; p < NUM_PARAMS; p++) {
+    if (values[p].empty()) values[p].push_back(kParamDefaults[p]);
+  }
+  if (datasets.empty()) {
+    log<WARNING>("No dataset in the sweep file");
+    return 1;
+  }
+  // loaded once, shared with the children (copy on write)
+  for (Dataset& data : datasets) {
+    if (!loadDataset<T>(&data, trans_tol, rot_tol)) return 1;
+  }
+
+  const std::vector<Config> grid = makeGrid(values);
+  const size_t num_runs = grid.size() * datasets.size();
+  std::vector<RunResult> results(num_runs);
+  std::map<pid_t, std::pair<size_t, int>> running;  // pid -> run, pipe
+  size_t next_run = 0, num_done = 0;
+  std::cout << "Running " << grid.size() << " configurations on "
+            << datasets.size() << " datasets in " << num_processes
+            << " processes" << std::endl;
+  while (num_done < num_runs) {
+    while (next_run < num_runs && running.size() < num_processes) {
+      int fds[2];
+      if (pipe(fds) != 0) {
+        log<WARNING>("Cannot create pipe");
+        return 1;
+      }
+      const pid_t pid = fork();
+      if (pid == 0) {
+        close(fds[0]);
+        RunResult result;
+        try {
+          result = run<T>(datasets[next_run % datasets.size()],
+                          grid[next_run / datasets.size()],
+                          is_3d);
+        } catch (const std::exception& e) {
+          log<WARNING>("Run failed: %1%") % e.what();
+        }
+        const ssize_t written = write(fds[1], &result, sizeof(result));
+        _exit(written == sizeof(result) ? 0 : 1);
+      }
+      close(fds[1]);
+      if (pid < 0) {
+        close(fds[0]);
+        log<WARNING>("Cannot fork");
+        return 1;
+      }
+      running[pid] = std::make_pair(next_run++, fds[0]);
+    }
+
+    int status;
+    const pid_t pid = waitpid(-1, &status, 0);
+    const auto child = running.find(pid);
+    if (child == running.end()) continue;
+    RunResult& result = results[child->second.first];
+    if (read(child->second.second, &result, sizeof(result)) !=
+            sizeof(result) ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      result.ok = false;  // crashed
+    }
+    close(child->second.second);
+    running.erase(child);
+    num_done++;
+    std::cout << "\r" << num_done << "/" << num_runs << " runs" << std::flush;
+  }
+  std::cout << std::endl;
+
+  // per configuration, over the datasets
+  std::vector<Summary> summaries(grid.size());
+  for (size_t c = 0; c < grid.size(); c++) {
+    Summary& summary = summaries[c];
+    summary.config = grid[c];
+    double sq_error_sum = 0;
+    size_t num_poses = 0, num_accepted = 0, true_positives = 0,
+           num_true_inliers = 0;
+    for (size_t d = 0; d < datasets.size(); d++) {
+      const RunResult& result = results[c * datasets.size() + d];
+      summary.ok = summary.ok && result.ok;
+      summary.runtime_s += result.runtime_s;
+      sq_error_sum += result.sq_error_sum;
+      num_poses += result.num_poses;
+      num_accepted += result.num_accepted;
+      true_positives += result.true_positives;
+      num_true_inliers += datasets[d].num_true_inliers;
+    }
+    summary.ate = num_poses > 0 ? std::sqrt(sq_error_sum / num_poses) : 0;
+    if (num_accepted > 0) {
+      summary.precision = static_cast<double>(true_positives) / num_accepted;
+    }
+    if (num_true_inliers > 0) {
+      summary.recall = static_cast<double>(true_positives) / num_true_inliers;
+    }
+  }
+  for (Summary& summary : summaries) {
+    summary.pareto =
+        summary.ok &&
+        std::none_of(summaries.begin(),
+                     summaries.end(),
+                     [&](const Summary& other) {
+                       return other.ok && dominates(other, summary);
+                     });
+  }
+  std::sort(summaries.begin(),
+            summaries.end(),
+            [](const Summary& a, const Summary& b) {
+              return a.runtime_s < b.runtime_s;
+            });
+
+  std::ofstream csv(output_csv);
+  for (size_t p = 0; p < NUM_PARAMS; p++) csv << kParamNames[p] << ",";
+  csv << "ok,runtime_s,ate_m,precision,recall,pareto\n";
+  std::cout << std::endl << "Pareto front (total runtime over datasets)"
+            << std::endl;
+  for (size_t p = 0; p < NUM_PARAMS; p++) {
+    std::cout << std::setw(17) << kParamNames[p];
+  }
+  std::cout << std::setw(12) << "runtime_s" << std::setw(12) << "ate_m"
+            << std::setw(12) << "precision" << std::setw(12) << "recall"
+            << std::endl;
+  for (const Summary& summary : summaries) {
+    for (const double value : summary.config) csv << value << ",";
+    csv << summary.ok << "," << summary.runtime_s << "," << summary.ate << ","
+        << summary.precision << "," << summary.recall << "," << summary.pareto
+        << "\n";
+    if (!summary.pareto) continue;
+    for (const double value : summary.config) {
+      std::cout << std::setw(17) << value;
+    }
+    std::cout << std::setw(12) << summary.runtime_s << std::setw(12)
+              << summary.ate << std::setw(12) << summary.precision
+              << std::setw(12) << summary.recall << std::endl;
+  }
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    log<WARNING>(
+        "Should be ./RpgoParetoSweep <2d or 3d> <sweep file> <output csv> "
+        "<opt: number of processes>");
+    return 1;
+  }
+  const std::string dim = argv[1];
+  size_t num_processes = std::max(1u, std::thread::hardware_concurrency());
+  if (argc > 4) num_processes = std::max(1, std::atoi(argv[4]));
+
+  if (dim == "2d") {
+    return sweep<gtsam::Pose2>(argv[2], argv[3], num_processes, false);
+  } else if (dim == "3d") {
+    return sweep<gtsam::Pose3>(argv[2], argv[3], num_processes, true);
+  }
+  log<WARNING>("Unsupported input format: %1%") % dim;
+  return 1;
+}
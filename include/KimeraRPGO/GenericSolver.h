@@ -5,16 +5,20 @@ author: Yun Chang, Luca Carlone
 
 #pragma once
 
+#include <algorithm>
+#include <limits>
+#include <memory>
 #include <string>
 #include <vector>
 
-// enables correct operations of GTSAM (correct Jacobians)
-#define SLOW_BUT_CORRECT_BETWEENFACTOR
 #include <gtsam/nonlinear/NonlinearFactorGraph.h>
 #include <gtsam/nonlinear/Values.h>
 
 #include "KimeraRPGO/Logger.h"
 #include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/utils/FastBetweenFactor.h"
+#include "KimeraRPGO/utils/NoiseModelCache.h"
+#include "KimeraRPGO/utils/OptimizerContext.h"
 #include "KimeraRPGO/utils/TypeUtils.h"
 
 namespace KimeraRPGO {
@@ -28,16 +32,44 @@ class GenericSolver {
 
   virtual ~GenericSolver() = default;
 
-  void update(
+  /*! \brief Add factors and values, remove factors and optimize
+   * Returns the ids of the factors of nfg, in order. factorsToRemove are slots
+   * of getFactorsUnsafe(): deprecated with compactFactors() (the slots move),
+   * use the FactorIds overload.
+   */
+  FactorIds update(
       const gtsam::NonlinearFactorGraph& nfg = gtsam::NonlinearFactorGraph(),
       const gtsam::Values& values = gtsam::Values(),
       const gtsam::FactorIndices& factorsToRemove = gtsam::FactorIndices());
 
+  FactorIds update(const gtsam::NonlinearFactorGraph& nfg,
+                   const gtsam::Values& values,
+                   const FactorIds& factors_to_remove);
+
   void removeFactorsNoUpdate(
       gtsam::FactorIndices factorsToRemove = gtsam::FactorIndices());
 
+  void removeFactorsNoUpdate(const FactorIds& factors_to_remove);
+
+  // slots of getFactorsUnsafe(), removed factors included until compaction
   size_t size() { return nfg_.size(); }
 
+  /*! \brief Drop the removed slots once half of the graph is empty (amortized
+   * O(1) per removal). The factors then move to other slots: remove them by
+   * FactorId only, the positional overloads warn. Off by default
+   */
+  void compactFactors() { compact_factors_ = true; }
+
+  /*! \brief Slot of the factor in getFactorsUnsafe() (size() if the factor
+   * was removed), valid until the next removal
+   */
+  size_t getFactorSlot(const FactorId& id);
+
+  /*! \brief Id of the factor in a slot of getFactorsUnsafe() (invalid for
+   * removed factors)
+   */
+  FactorId getFactorId(size_t slot);
+
   inline gtsam::Values calculateEstimate() const { return values_; }
   inline gtsam::Values calculateBestEstimate() const { return values_; }
   inline gtsam::Values getLinearizationPoint() const { return values_; }
@@ -50,13 +82,13 @@ class GenericSolver {
   inline void updateTempFactorsValues(
       const gtsam::NonlinearFactorGraph& temp_nfg,
       const gtsam::Values& temp_values) {
-    temp_nfg_.add(temp_nfg);
+    temp_nfg_.add(toFastBetweenFactors(temp_nfg, noise_models_.get()));
     temp_values_.insert(temp_values);
   }
   inline void replaceTempFactorsValues(
       const gtsam::NonlinearFactorGraph& temp_nfg,
       const gtsam::Values& temp_values) {
-    temp_nfg_ = temp_nfg;
+    temp_nfg_ = toFastBetweenFactors(temp_nfg, noise_models_.get());
     temp_values_ = temp_values;
   }
   inline void clearTempFactorsValues() {
@@ -68,7 +100,23 @@ class GenericSolver {
 
   void setQuiet() { debug_ = false; }
 
-  EdgePtr removeLastFactor();  // remove last added factor
+  /*! \brief keep ordering and LM damping between optimize calls
+   */
+  void reuseOptimizerContext(double reorder_growth = 0.2) {
+    optimizer_context_ = make_unique<OptimizerContext>(reorder_growth);
+  }
+
+  /*! \brief share one noise model between the incoming relative pose factors
+   * with the same covariance (see utils/NoiseModelCache.h)
+   */
+  void internNoiseModels() {
+    noise_models_ = make_unique<NoiseModelCache>();
+  }
+  inline size_t getNumNoiseModels() const {
+    return noise_models_ ? noise_models_->size() : 0;
+  }
+
+  EdgePtr removeLastFactor();  // remove last added factor (still present)
 
   void removePriorsWithPrefix(const char& prefix);
 
@@ -77,7 +125,36 @@ class GenericSolver {
  protected:
   bool addAndCheckIfOptimize(
       const gtsam::NonlinearFactorGraph& nfg = gtsam::NonlinearFactorGraph(),
-      const gtsam::Values& values = gtsam::Values());
+      const gtsam::Values& values = gtsam::Values(),
+      FactorIds* ids = nullptr);
+
+  /*! \brief To call after nfg_ was rebuilt outside of GenericSolver (by the
+   * outlier rejection): the slots are remapped on the next request, the
+   * factors still in nfg_ keep their ids. kept_slots: leading slots left in
+   * place (only appended after them), their ids are not remapped
+   */
+  inline void invalidateFactorIds(size_t kept_slots = 0) {
+    factor_ids_stale_ = true;
+    factor_slots_kept_ = std::min(factor_slots_kept_, kept_slots);
+  }
+
+  /*! \brief Ids of factors, in order, found in the slots of nfg_ from
+   * first_slot on (invalid for the factors not in nfg_)
+   */
+  FactorIds findFactorIds(const gtsam::NonlinearFactorGraph& factors,
+                          size_t first_slot = 0);
+
+  /*! \brief Undo log of values_ (see RobustSolver::beginSpeculative)
+   * saveValue records the value of a key before its first change (or that the
+   * key is new), undoValues restores them. Null values_undo_: not recorded
+   */
+  struct ValuesUndoLog {
+    gtsam::Values previous;
+    gtsam::KeySet added;
+  };
+  void saveValue(gtsam::Key key);
+  void undoValues();
+  std::unique_ptr<ValuesUndoLog> values_undo_;
 
  protected:
   bool isSpecialSymbol(char symb) const;
@@ -92,6 +169,43 @@ class GenericSolver {
   bool debug_;
   bool log_;
   std::string log_folder_;
+  // state kept between optimize calls (null: fresh optimizer every call)
+  std::unique_ptr<OptimizerContext> optimizer_context_;
+  // interned noise models (null: the factors keep their own)
+  std::unique_ptr<NoiseModelCache> noise_models_;
+
+ private:
+  FactorIds updateAndRemoveSlots(const gtsam::NonlinearFactorGraph& nfg,
+                                 const gtsam::Values& values,
+                                 const gtsam::FactorIndices& factorsToRemove);
+
+  /* reset the slots, then compact the graph (if enabled) once half the slots
+   * are empty
+   */
+  void removeSlots(const gtsam::FactorIndices& slots);
+  void removeSlot(size_t slot);
+  void compactIfSparse();
+  // ids for the slots of nfg_ from first_slot on (new factors)
+  void indexNewSlots(size_t first_slot, FactorIds* ids = nullptr);
+  gtsam::FactorIndices toSlots(const FactorIds& ids);
+  void warnIfPositional(const gtsam::FactorIndices& slots) const;
+
+  /* ids for every factor of nfg_ if it was rebuilt elsewhere: the factors
+   * indexed before keep their ids, the others get new ones
+   */
+  void reissueFactorIds();
+
+  // factor ids, parallel to nfg_ (0: removed) and back to the slots
+  std::vector<uint64_t> slot_ids_;
+  FlatHashMap<uint64_t, size_t> id_slots_;
+  // the factors of slot_ids_, to find them again in a rebuilt nfg_
+  std::vector<gtsam::NonlinearFactor::shared_ptr> slot_factors_;
+  uint64_t next_factor_id_;
+  size_t num_empty_slots_;
+  bool factor_ids_stale_;
+  size_t factor_slots_kept_;  // slots of slot_ids_ still current if stale
+  bool compact_factors_;
+  static constexpr size_t kMinSlotsToCompact = 64;
 };
 
 }  // namespace KimeraRPGO
\ No newline at end of file
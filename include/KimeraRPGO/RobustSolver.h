@@ -15,10 +15,15 @@ author: Yun Chang, Luca Carlone
 #include <gtsam/slam/PriorFactor.h>
 #include <gtsam/nonlinear/GaussNewtonOptimizer.h>
 #include <gtsam/nonlinear/GncOptimizer.h>
+#include <gtsam/nonlinear/ISAM2.h>
 
 #include "KimeraRPGO/GenericSolver.h"
 #include "KimeraRPGO/SolverParams.h"
 #include "KimeraRPGO/outlier/OutlierRemoval.h"
+#include "KimeraRPGO/utils/GncSolver.h"
+#include "KimeraRPGO/utils/PoseArchive.h"
+#include "KimeraRPGO/utils/ThreadPool.h"
+#include "KimeraRPGO/utils/TrajectoryExport.h"
 
 namespace KimeraRPGO {
 
@@ -33,7 +38,9 @@ class RobustSolver : public GenericSolver {
 
   explicit RobustSolver(const RobustSolverParams& params);
 
-  virtual ~RobustSolver() = default;
+  // writes the trace if params.trace_file is set (once the last solver
+  // recording it is destroyed)
+  virtual ~RobustSolver();
 
   // TODO(yun) this seg faults we disable outlier removal
   size_t getNumLC() { return outlier_removal_->getNumLC(); }
@@ -46,6 +53,16 @@ class RobustSolver : public GenericSolver {
     }
   }
 
+  /*! \brief Operation counts of the outlier rejection (see OutlierRemoval)
+   */
+  size_t getNumConsistencyChecks() const {
+    return outlier_removal_ ? outlier_removal_->getNumConsistencyChecks() : 0;
+  }
+  size_t getNumCliqueNodesExpanded() const {
+    return outlier_removal_ ? outlier_removal_->getNumCliqueNodesExpanded()
+                            : 0;
+  }
+
   /*! \brief Update call that bypasses outlier rejection.
    *  add new factors and values and optimize, without rejecting outliers.
    *  - nfg: new factors
@@ -55,16 +72,32 @@ class RobustSolver : public GenericSolver {
       const gtsam::NonlinearFactorGraph& nfg = gtsam::NonlinearFactorGraph(),
       const gtsam::Values& values = gtsam::Values());
 
+  /*! \brief Re-solve after a change of the temporary factors only.
+   *  The permanent graph keeps its last outlier rejection: PCM and GNC are not
+   * run again and the factors rejected by GNC stay out. The temporary factors
+   * and values are added as an increment to an ISAM2 instance seeded with the
+   * last solution, so only the cliques touched by the temporary keys are
+   * refactored. Use this instead of forceUpdate() when only the temporary
+   * factors changed (e.g. after replaceTempFactorsValues).
+   */
+  void updateTempFactors();
+
   /*! \brief Update function. Sorts through the factors, separate out the
    * odometry, the landmark measurements, and loop closures, then
    * addAndCheckIfOptimize with outlier rejection. Note that we assume the
    * odometry is ordered by key in an increasing manner
    *  - factors: the factors of the graph to be added
    *  - values: linearization point of graph to be connected
+   * Returns the ids of factors, in order (see GenericSolver::update). The id
+   * of a factor the outlier rejection holds back or rejects is invalid. It
+   * hides the GenericSolver overloads, which would bypass the outlier
+   * rejection. Do not call compactFactors() on a RobustSolver unless GNC is
+   * off: the GNC weights (getGncWeights) and the known inliers are indexed
+   * by slot, compaction would move the factors under them.
    */
-  void update(const gtsam::NonlinearFactorGraph& factors,
-              const gtsam::Values& values = gtsam::Values(),
-              bool optimize_graph = true);
+  FactorIds update(const gtsam::NonlinearFactorGraph& factors,
+                   const gtsam::Values& values = gtsam::Values(),
+                   bool optimize_graph = true);
 
   /*! \brief Remove last added loop closure based on the prefixes of the robots
    * For example, to remove the last measure loop closure between robots a and c
@@ -102,7 +135,50 @@ class RobustSolver : public GenericSolver {
    */
   inline gtsam::Vector getGncWeights() const { return gnc_weights_; }
 
+  /*! \brief Speculative (what-if) updates
+   *  After beginSpeculative, update, forceUpdate, the loop closure and prior
+   * removals and ignorePrefix / revivePrefix work as usual (read the result
+   * with calculateEstimate), then commit keeps the changes and rollback brings
+   * the solver back to its state at beginSpeculative. The state is recorded
+   * before its first change (undo log), so the rollback costs time in the
+   * size of the changes, not of the map. Not nested: returns false if already
+   * speculative or if the outlier rejection cannot undo its changes.
+   * The factor ids are reissued after a rollback.
+   */
+  bool beginSpeculative();
+  void commit();
+  void rollback();
+  inline bool isSpeculative() const { return speculative_ != nullptr; }
+
+  /*! \brief Time sliced optimization (RobustSolverParams::setOptimizationSlice)
+   *  The calls that optimize only set up the problem, resumeOptimization runs
+   * it for one slice (LM / GN iterations, with GNC the inner LM iterations)
+   * and publishes the estimate of the last iteration to calculateEstimate.
+   * A new optimization (new factors, removals) supersedes the running one
+   * and starts from the published estimate. With GNC the slices run
+   * KimeraRPGO::GncSolver (gtsam::GncOptimizer cannot be resumed); GN with
+   * GNC is not sliced. Returns true once converged (or nothing to run).
+   */
+  bool resumeOptimization();
+  inline bool isOptimizing() const { return sliced_ != nullptr; }
+
+  /*! \brief Archive the settled poses of a robot (see utils/PoseArchive.h)
+   *  The Pose2 / Pose3 values with the prefix and an index below end_index
+   * move to a packed archive with the odometry between them, except the
+   * poses still connected to the rest of the graph (loop closures, newer
+   * odometry). Those stay live and are held at their estimate by a tight
+   * prior while the archive is out of the optimization. A measurement on an
+   * archived pose rehydrates its segment (and the later segments of the
+   * robot) before the outlier rejection. Needs PCM, no multirobot alignment
+   * and no speculative update. Returns false if nothing was archived.
+   */
+  bool archive(char prefix, size_t end_index);
+  void rehydrateAll();
+  inline size_t getNumArchivedPoses() const { return archive_.numPoses(); }
+
  private:
+  // shared by the parallel stages (declared first: destroyed after its users)
+  std::unique_ptr<ThreadPool> thread_pool_;
   std::unique_ptr<OutlierRemoval> outlier_removal_;  // outlier removal
                                                      // method;
 
@@ -116,12 +192,101 @@ class RobustSolver : public GenericSolver {
    */
   void optimize();
 
+  /*! \brief Seed the temporary factor solver with the permanent inliers
+   * linearized at the last solution
+   */
+  void resetTempSolver();
+
+  /*! \brief Drop the temporary factor solver (permanent graph changed)
+   */
+  void invalidateTempSolver();
+
+  /*! \brief Speculative updates: save nfg_ before it changes (the factors are
+   * shared, only the pointers are copied), the values before the outlier
+   * rejection adds new_values (and realigns the robot frames), and the GNC
+   * weights before GNC replaces them
+   */
+  void saveFactors();
+  void saveValuesBeforeOutlierRemoval(const gtsam::Values& new_values);
+  void saveGncWeights();
+
+  /*! \brief Keep the GNC weights of the slots of nfg_ (the temporary factors
+   * and archive anchors follow them) and the factors GNC rejected
+   */
+  void setGncWeights(const gtsam::Vector& all_weights);
+
+  // state at beginSpeculative that is not in an undo log (null: the changes
+  // are final)
+  struct SpeculativeState {
+    bool factors_saved;
+    gtsam::NonlinearFactorGraph nfg;
+    bool gnc_weights_saved;
+    gtsam::Vector gnc_weights;
+    gtsam::NonlinearFactorGraph gnc_rejected;
+    size_t gnc_num_inliers;
+    size_t latest_num_lc;
+    // the temporary factors and values are small: copied
+    gtsam::NonlinearFactorGraph temp_nfg;
+    gtsam::Values temp_values;
+    // archived segments were rehydrated (kept by the rollback)
+    bool rehydrated;
+  };
+  std::unique_ptr<SpeculativeState> speculative_;
+
+  inline bool slicing() const {
+    return params_.slice_time_ms > 0 || params_.slice_iterations > 0;
+  }
+
+  /*! \brief Store the result of the sliced optimization (and the GNC
+   * weights) as optimize does
+   */
+  void finishSlicedOptimization();
+
+  // running sliced optimization: LM / GN optimizer or GNC (null: none)
+  struct SlicedOptimization {
+    std::unique_ptr<gtsam::NonlinearOptimizer> optimizer;
+    gtsam::NonlinearOptimizerParams params;  // stopping rule of optimizer
+    const char* iteration_name;
+    std::unique_ptr<GncSolver> gnc;
+    size_t num_known_inliers;
+  };
+  std::unique_ptr<SlicedOptimization> sliced_;
+
+  /*! \brief Archive helpers
+   *  - rehydrate: unpack the segments reached by the keys of factors
+   *  - restoreArchived: put unpacked poses and odometry back in the graph
+   *  - updateArchiveAnchors: priors on the live poses with archived factors
+   *  - applyArchive: drop the factors on archived poses from a graph to
+   *    optimize and append the anchors
+   */
+  void rehydrate(const gtsam::NonlinearFactorGraph& factors);
+  void restoreArchived(const gtsam::Values& poses,
+                       const SlottedFactors& released);
+  void updateArchiveAnchors();
+  void applyArchive(gtsam::NonlinearFactorGraph* full_nfg) const;
+  bool isArchived(gtsam::Key key) const {
+    return !values_.exists(key) && archive_.contains(key);
+  }
+
+  PoseArchive archive_;
+  gtsam::NonlinearFactorGraph archive_priors_;
+
   // GNC variables
   gtsam::Vector gnc_weights_;
+  // rejected by the last GNC solve: kept out of the temporary factor solver
+  // even once their slot moved or factors were appended
+  gtsam::NonlinearFactorGraph gnc_rejected_;
   size_t gnc_num_inliers_;
   size_t latest_num_lc_;
 
+  // Incremental solver for the temporary factors
+  std::unique_ptr<gtsam::ISAM2> temp_solver_;
+  gtsam::FactorIndices temp_solver_factors_;  // slots of the temp factors
+  gtsam::KeySet temp_solver_keys_;            // temp keys in the solver
+  size_t temp_solver_num_factors_;            // nfg_ size when seeded
+
   RobustSolverParams params_;
+  bool trace_started_;  // joined the trace of params_.trace_file
 
  public:
   /*! \brief Save results from Solver
@@ -130,6 +295,16 @@ class RobustSolver : public GenericSolver {
    *  - folder_path: the directory to save the results.
    */
   void saveData(std::string folder_path) const;
+
+  /*! \brief Write the trajectory of each robot in the current estimate
+   * (archived poses included) to folder_path/robot_<prefix>.csv or .bin,
+   * sorted by index, straight from the values (see utils/TrajectoryExport.h).
+   * The robots are written in parallel on the solver threads. Returns the
+   * number of files written
+   */
+  size_t exportTrajectories(
+      const std::string& folder_path,
+      TrajectoryFormat format = TrajectoryFormat::CSV) const;
 };
 
 }  // namespace KimeraRPGO
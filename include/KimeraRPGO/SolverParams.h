@@ -5,9 +5,20 @@ author: Yun Chang
 
 #pragma once
 
+#include <functional>
 #include <string>
 #include <vector>
 
+#include <gtsam/config.h>
+
+#ifdef GTSAM_USE_TBB
+#include <tbb/task_arena.h>
+#endif
+
+namespace gtsam {
+class NonlinearFactor;
+}
+
 namespace KimeraRPGO {
 
 enum class Solver { LM, GN };
@@ -30,6 +41,73 @@ enum class MultiRobotAlignMethod {
   GNC    // Use robust pose averaging with GNC
 };
 
+// Bound on the number of measurements per Pcm group (robot pair or landmark)
+// that take part in the consistency graph. Measurements leaving the window
+// keep the inlier / outlier status of the last max clique.
+enum class PcmWindowPolicy {
+  NONE,      // unbounded
+  SLIDING,   // keep the most recent measurements
+  RESERVOIR  // keep a uniform random sample of all measurements
+};
+
+// Cheap loop closure filters run in front of the pairwise consistency check
+// (in the order of PcmPrefilterParams::stages). Landmark observations are not
+// prefiltered.
+enum class PcmPrefilter {
+  ODOMETRY,       // loose check of intra robot closures against the odometry
+  NODE_DISTANCE,  // drop intra robot closures between nearby poses
+  DUPLICATE       // drop closures repeating an earlier one
+};
+
+struct PcmPrefilterParams {
+ public:
+  PcmPrefilterParams()
+      : stages(),
+        odom_trans_threshold(1.0),
+        odom_trans_drift(0.1),
+        odom_rot_threshold(0.2),
+        odom_rot_drift(0.01),
+        min_node_distance(10),
+        duplicate_trans_threshold(0.01),
+        duplicate_rot_threshold(0.001) {}
+  std::vector<PcmPrefilter> stages;  // empty: no prefilter
+
+  // ODOMETRY: allowed error = threshold + drift * number of odometry edges
+  double odom_trans_threshold;  // [m]
+  double odom_trans_drift;      // [m / edge]
+  double odom_rot_threshold;    // [rad]
+  double odom_rot_drift;        // [rad / edge]
+
+  // NODE_DISTANCE: minimum difference of the pose indices
+  size_t min_node_distance;
+
+  // DUPLICATE: max difference to an earlier closure between the same poses
+  double duplicate_trans_threshold;  // [m]
+  double duplicate_rot_threshold;    // [rad]
+};
+
+// Order in which queued loop closures are admitted to Pcm when the spin has
+// a check budget (PcmAdmissionParams). Ties keep the arrival order.
+enum class PcmAdmissionPolicy {
+  FIFO,               // arrival order
+  INTER_ROBOT_FIRST,  // inter robot closures before intra robot / landmarks
+  ODOMETRY_GAP,       // larger index gap first (inter robot: first)
+  SCORE               // higher PcmAdmissionParams::score first
+};
+
+struct PcmAdmissionParams {
+ public:
+  PcmAdmissionParams()
+      : policy(PcmAdmissionPolicy::FIFO), check_budget(0), score() {}
+  PcmAdmissionPolicy policy;
+  // estimated pairwise checks per spin (one per active measurement of the
+  // group a closure joins), at least one closure is admitted per spin
+  // (0: no admission stage, every closure is processed when it arrives)
+  size_t check_budget;
+  // for PcmAdmissionPolicy::SCORE, evaluated once when the closure is queued
+  std::function<double(const gtsam::NonlinearFactor&)> score;
+};
+
 struct PcmParams {
  public:
   PcmParams()
@@ -39,7 +117,15 @@ struct PcmParams {
         odom_rot_threshold(0.005),
         dist_trans_threshold(0.01),
         dist_rot_threshold(0.001),
-        incremental(false) {}
+        incremental(false),
+        window_policy(PcmWindowPolicy::NONE),
+        window_size(0),
+        lazy_consistency(false),
+        prefilter(),
+        admission(),
+        transform_voting(false),
+        voting_trans_resolution(1.0),
+        voting_rot_resolution(0.2) {}
   // if threshold is < 0, check disabled
   // for Pcm
   double odom_threshold;
@@ -53,6 +139,27 @@ struct PcmParams {
 
   // incremental max clique
   bool incremental;
+
+  // bound on the active measurements per group (window_size 0: unbounded)
+  PcmWindowPolicy window_policy;
+  size_t window_size;
+
+  // pairwise consistency checked on demand by the max clique search
+  // (takes precedence over incremental)
+  bool lazy_consistency;
+
+  // filters applied to the loop closures before the consistency check
+  PcmPrefilterParams prefilter;
+
+  // queue in front of the consistency check for loop closure bursts
+  PcmAdmissionParams admission;
+
+  // inter robot groups: vote the frame transform implied by each closure in a
+  // grid, only the closures around the dominant cell enter the max clique and
+  // only closures in neighboring cells are checked against each other
+  bool transform_voting;
+  double voting_trans_resolution;  // [m] cell size of the translation
+  double voting_rot_resolution;    // [rad] cell size of the rotation
 };
 
 struct GncParams {
@@ -65,7 +172,8 @@ struct GncParams {
         relative_cost_tol_(1e-5),
         weights_tol_(1e-4),
         fix_prev_inliers_(false),
-        bias_odom_(false) {}
+        bias_odom_(false),
+        native_(false) {}
   enum class GncThresholdMode { COST = 0u, PROBABILITY = 1u };
   GncThresholdMode gnc_threshold_mode_;
   double gnc_inlier_threshold_;
@@ -75,6 +183,7 @@ struct GncParams {
   double weights_tol_;
   bool fix_prev_inliers_;
   bool bias_odom_;  // Bias odometry in initialization
+  bool native_;     // Use KimeraRPGO::GncSolver instead of gtsam's GNC
 };
 
 struct RobustSolverParams {
@@ -86,9 +195,17 @@ struct RobustSolverParams {
         specialSymbols(),
         verbosity(Verbosity::UPDATE),
         log_output(false),
+        trace_file(),
+        num_threads(1),
+        cpu_affinity(),
         pcm_params(),
         gnc_params(),
         lm_diagonal_damping(true),
+        reuse_optimizer_context(false),
+        reorder_growth(0.2),
+        intern_noise_models(true),
+        slice_time_ms(0),
+        slice_iterations(0),
         multirobot_align_method(MultiRobotAlignMethod::NONE),
         use_gnc_(false) {}
   /*! \brief For RobustSolver to not do outlier rejection at all
@@ -102,6 +219,58 @@ struct RobustSolverParams {
    */
   void setIncremental() { pcm_params.incremental = true; }
 
+  /*! \brief bound the number of active measurements per robot pair / landmark
+   * policy: which measurements stay in the consistency graph
+   * window_size: max number of active measurements per group
+   */
+  void setPcmWindow(PcmWindowPolicy policy, size_t window_size) {
+    pcm_params.window_policy = policy;
+    pcm_params.window_size = window_size;
+  }
+
+  /*! \brief only check the pairs of measurements the max clique search needs
+   * (results are memoized in the adjacency matrices)
+   */
+  void setLazyConsistency(bool lazy = true) {
+    pcm_params.lazy_consistency = lazy;
+  }
+
+  /*! \brief cheap filters in front of the pairwise consistency check
+   * (only survivors of every stage enter the max clique problem)
+   */
+  void setPcmPrefilter(const PcmPrefilterParams& prefilter) {
+    pcm_params.prefilter = prefilter;
+  }
+
+  /*! \brief queue the loop closures and admit the most valuable ones first,
+   * within a budget of pairwise checks per spin (the others are carried over
+   * to the next spins)
+   * policy: priority of the queued loop closures
+   * check_budget: estimated pairwise checks per spin (0: no queue)
+   * score: priority for PcmAdmissionPolicy::SCORE (higher first)
+   */
+  void setPcmAdmission(
+      PcmAdmissionPolicy policy,
+      size_t check_budget,
+      const std::function<double(const gtsam::NonlinearFactor&)>& score =
+          nullptr) {
+    pcm_params.admission.policy = policy;
+    pcm_params.admission.check_budget = check_budget;
+    pcm_params.admission.score = score;
+  }
+
+  /*! \brief consensus on the robot to robot frame transform before the
+   * pairwise consistency check of inter robot loop closures
+   * trans_resolution: cell size of the voting grid in translation [m]
+   * rot_resolution: cell size of the voting grid in rotation [rad]
+   */
+  void setTransformVoting(double trans_resolution = 1.0,
+                          double rot_resolution = 0.2) {
+    pcm_params.transform_voting = true;
+    pcm_params.voting_trans_resolution = trans_resolution;
+    pcm_params.voting_rot_resolution = rot_resolution;
+  }
+
   /*! \brief toggle diagonal damping
    * diagonal_damping: use diagonal damping (bool)
    */
@@ -109,6 +278,25 @@ struct RobustSolverParams {
     lm_diagonal_damping = diagonal_damping;
   }
 
+  /*! \brief keep the elimination ordering and the LM damping between
+   * optimize calls (see utils/OptimizerContext.h)
+   * reorder_growth: run COLAMD again once the keys appended to the ordering
+   * exceed this fraction of the keys of the last full ordering
+   */
+  void setReuseOptimizerContext(bool reuse = true, double growth = 0.2) {
+    reuse_optimizer_context = reuse;
+    reorder_growth = growth;
+  }
+
+  /*! \brief share one noise model between the relative pose factors with the
+   * same covariance, and decode each one once for the consistency checks
+   * (see utils/NoiseModelCache.h). On by default; graphs where every factor
+   * has its own covariance gain nothing from it
+   */
+  void setNoiseModelInterning(bool intern = true) {
+    intern_noise_models = intern;
+  }
+
   /*! \brief 2D version of Pcm
    * This one looks at Mahalanobis distance
    * odomThreshold: max allowable M distance deviation from odometry
@@ -258,6 +446,23 @@ struct RobustSolverParams {
    */
   void gncBiasOdom() { gnc_params.bias_odom_ = true; }
 
+  /*! \brief run GNC with the in-library solver (LM only, see
+   * utils/GncSolver.h) instead of gtsam::GncOptimizer. The residuals are
+   * evaluated on the pool of setThreads
+   */
+  void gncNative() { gnc_params.native_ = true; }
+
+  /*! \brief resumable optimization: update (and the other calls that
+   * optimize) only start the optimization, RobustSolver::resumeOptimization
+   * runs it a slice at a time (see RobustSolver.h). A slice stops after
+   * max_time_ms or max_iterations iterations, whichever comes first (0: no
+   * bound, both 0: optimize to convergence in update)
+   */
+  void setOptimizationSlice(double max_time_ms, size_t max_iterations = 0) {
+    slice_time_ms = max_time_ms;
+    slice_iterations = max_iterations;
+  }
+
   /*! \brief use multirobot frame alignment for initialization
    */
   void setMultiRobotAlignMethod(MultiRobotAlignMethod method) {
@@ -271,6 +476,28 @@ struct RobustSolverParams {
     log_folder = output_folder;
   }
 
+  /*! \brief record a Chrome trace of the solver internals (see
+   * utils/Trace.h), written to trace_file when the solver is destroyed
+   */
+  void traceOutput(const std::string& filename) { trace_file = filename; }
+
+  /*! \brief thread pool shared by the parallel stages (pairwise checks, max
+   * clique searches per group, GNC residuals), see utils/ThreadPool.h
+   * - threads: 0 all cores, 1 serial (default)
+   * - affinity: cores the workers are pinned to (empty: no pinning)
+   */
+  void setThreads(size_t threads, const std::vector<int>& affinity = {}) {
+    num_threads = threads;
+    cpu_affinity = affinity;
+  }
+
+#ifdef GTSAM_USE_TBB
+  /*! \brief run the parallel stages in an existing arena (e.g. the one of
+   * gtsam) instead of our own threads; the arena must outlive the solver
+   */
+  void useTbbArena(tbb::task_arena* arena) { tbb_arena = arena; }
+#endif
+
   // General
   Solver solver;
   OutlierRemovalMethod outlierRemovalMethod;
@@ -278,12 +505,27 @@ struct RobustSolverParams {
   Verbosity verbosity;
   bool log_output;
   std::string log_folder;
+  std::string trace_file;  // empty: no trace
+
+  // shared thread pool
+  size_t num_threads;
+  std::vector<int> cpu_affinity;
+#ifdef GTSAM_USE_TBB
+  tbb::task_arena* tbb_arena = nullptr;
+#endif
 
   PcmParams pcm_params;
   GncParams gnc_params;
 
   // Additional params
   bool lm_diagonal_damping;
+  bool reuse_optimizer_context;
+  double reorder_growth;
+  bool intern_noise_models;
+
+  // resumable optimization (both 0: blocking)
+  double slice_time_ms;
+  size_t slice_iterations;
 
   // multirobot frame alignment
   MultiRobotAlignMethod multirobot_align_method;
@@ -22,18 +22,16 @@
 #include <vector>
 
 namespace FMC {
-int pruned1;
-int pruned2;
-int pruned3;
-int pruned5;
 
 /* Algorithm 2: CLIQUE: Recursive Subroutine of algorithm 1. */
 void maxCliqueHelper(CGraphIO* gio,
                      vector<int>* U,
                      size_t sizeOfClique,
                      size_t* maxClq,
-                     vector<int>* max_clique_data_inter) {
-  int iPos, index = 0, maxClq_prev;
+                     vector<int>* max_clique_data_inter,
+                     SearchCounters* counters) {
+  counters->nodes_expanded++;
+  int index = 0, maxClq_prev;
   vector<int>* ptrVertex = gio->GetVerticesPtr();
   vector<int>* ptrEdge = gio->GetEdgesPtr();
   vector<int> U_new;
@@ -63,12 +61,12 @@ void maxCliqueHelper(CGraphIO* gio,
           if ((*ptrEdge)[j] == (*U)[i]) U_new.push_back((*ptrEdge)[j]);
         }
       } else
-        pruned3++;
+        counters->pruned5++;
 
     maxClq_prev = *maxClq;
 
     maxCliqueHelper(
-        gio, &U_new, sizeOfClique + 1, maxClq, max_clique_data_inter);
+        gio, &U_new, sizeOfClique + 1, maxClq, max_clique_data_inter, counters);
 
     if (*maxClq > maxClq_prev) max_clique_data_inter->push_back(index);
 
@@ -77,7 +75,14 @@ void maxCliqueHelper(CGraphIO* gio,
 }
 
 /* Algorithm 1: MAXCLIQUE: Finds maximum clique of the given graph */
-int maxClique(CGraphIO* gio, size_t l_bound, vector<int>* max_clique_data) {
+int maxClique(CGraphIO* gio,
+              size_t l_bound,
+              vector<int>* max_clique_data,
+              SearchCounters* counters) {
+  SearchCounters local_counters;
+  if (counters == NULL) counters = &local_counters;
+  *counters = SearchCounters();
+
   vector<int>* ptrVertex = gio->GetVerticesPtr();
   vector<int>* ptrEdge = gio->GetEdgesPtr();
   vector<int> U;
@@ -89,10 +94,6 @@ int maxClique(CGraphIO* gio, size_t l_bound, vector<int>* max_clique_data) {
   int prev_maxClq;
 
   // cout << "Computing Max Clique... with lower bound " << maxClq << endl;
-  pruned1 = 0;
-  pruned2 = 0;
-  pruned3 = 0;
-  pruned5 = 0;
 
   // Bit Vector to track if vertex has been considered previously.
   int* bitVec = new int[gio->GetVertexCount()];
@@ -105,7 +106,7 @@ int maxClique(CGraphIO* gio, size_t l_bound, vector<int>* max_clique_data) {
     U.clear();
     // Pruning 1
     if (getDegree(ptrVertex, i) < maxClq) {
-      pruned1++;
+      counters->pruned1++;
       continue;
     }
 
@@ -116,13 +117,13 @@ int maxClique(CGraphIO* gio, size_t l_bound, vector<int>* max_clique_data) {
         if (getDegree(ptrVertex, (*ptrEdge)[j]) >= maxClq)
           U.push_back((*ptrEdge)[j]);
         else
-          pruned3++;
+          counters->pruned3++;
       } else {
-        pruned2++;
+        counters->pruned2++;
       }
     }
 
-    maxCliqueHelper(gio, &U, 1, &maxClq, &max_clique_data_inter);
+    maxCliqueHelper(gio, &U, 1, &maxClq, &max_clique_data_inter, counters);
 
     if (maxClq > prev_maxClq) {
       max_clique_data_inter.push_back(i);
@@ -135,10 +136,10 @@ int maxClique(CGraphIO* gio, size_t l_bound, vector<int>* max_clique_data) {
   max_clique_data_inter.clear();
 
 #ifdef _DEBUG
-  cout << "Pruning 1 = " << pruned1 << endl;
-  cout << "Pruning 2 = " << pruned2 << endl;
-  cout << "Pruning 3 = " << pruned3 << endl;
-  cout << "Pruning 5 = " << pruned5 << endl;
+  cout << "Pruning 1 = " << counters->pruned1 << endl;
+  cout << "Pruning 2 = " << counters->pruned2 << endl;
+  cout << "Pruning 3 = " << counters->pruned3 << endl;
+  cout << "Pruning 5 = " << counters->pruned5 << endl;
 #endif
 
   return maxClq;
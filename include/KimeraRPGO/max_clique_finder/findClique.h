@@ -37,6 +37,16 @@ int DEBUG = 1;
 
 namespace FMC {
 
+// Work counters of a single search (see the pruning steps in the paper)
+struct SearchCounters {
+  size_t pruned1 = 0;  // candidate vertex degree below the current bound
+  size_t pruned2 = 0;  // neighbor already processed
+  size_t pruned3 = 0;  // neighbor degree below the current bound
+  size_t pruned5 = 0;  // neighbor degree below the bound within a branch
+  size_t not_computed = 0;    // candidate vertices skipped by the heuristic
+  size_t nodes_expanded = 0;  // recursive calls / greedy steps
+};
+
 // Function Definitions
 bool fexists(const char* filename);
 double wtime();
@@ -44,23 +54,25 @@ void usage(char* argv0);
 int getDegree(vector<int>* ptrVtx, int idx);
 void print_max_clique(vector<int>& max_clique_data);
 
-int maxClique(CGraphIO* gio, size_t l_bound, vector<int>* max_clique_data);
+int maxClique(CGraphIO* gio,
+              size_t l_bound,
+              vector<int>* max_clique_data,
+              SearchCounters* counters = NULL);
 void maxCliqueHelper(CGraphIO* gio,
                      vector<int>* U,
                      size_t sizeOfClique,
                      size_t* maxClq,
-                     vector<int>* max_clique_data_inter);
+                     vector<int>* max_clique_data_inter,
+                     SearchCounters* counters);
 
-int maxCliqueHeu(CGraphIO* gio, vector<int>* max_clique_data);
-void maxCliqueHelperHeu(CGraphIO* gio,
-                        vector<int>* U,
-                        size_t sizeOfClique,
-                        size_t* maxClq,
-                        vector<int>* max_clique_data_inter);
+int maxCliqueHeu(CGraphIO* gio,
+                 vector<int>* max_clique_data,
+                 SearchCounters* counters = NULL);
 
 int maxCliqueHeuIncremental(CGraphIO* gio,
                             size_t num_new_lc,
                             size_t prev_maxclique_size,
-                            vector<int>* max_clique_data);
+                            vector<int>* max_clique_data,
+                            SearchCounters* counters = NULL);
 
 }  // namespace FMC
\ No newline at end of file
@@ -26,15 +26,19 @@
 #include "findClique.h"
 
 namespace FMC {
-int maxDegree, maxClq;
 
 /* Algorithm 2: MaxCliqueHeu: A heuristic to find maximum clique */
-int maxCliqueHeu(CGraphIO* gio, vector<int>* max_clique_data) {
+int maxCliqueHeu(CGraphIO* gio,
+                 vector<int>* max_clique_data,
+                 SearchCounters* counters) {
+  SearchCounters local_counters;
+  if (counters == NULL) counters = &local_counters;
+  *counters = SearchCounters();
   vector<int>* p_v_i_Vertices = gio->GetVerticesPtr();
   vector<int>* p_v_i_Edges = gio->GetEdgesPtr();
   // srand(time(NULL));
 
-  maxDegree = gio->GetMaximumVertexDegree();
+  int maxDegree = gio->GetMaximumVertexDegree();
   int maxClq = -1, u, icc;
   vector<int> v_i_S;
   vector<int> v_i_S1;
@@ -43,8 +47,6 @@ int maxCliqueHeu(CGraphIO* gio, vector<int>* max_clique_data) {
 
   int iPos, iPos1, iCount, iCount1;
 
-  int notComputed = 0;
-
   // compute the max clique for each vertex
   for (size_t iCandidateVertex = 0;
        iCandidateVertex < p_v_i_Vertices->size() - 1;
@@ -52,7 +54,8 @@ int maxCliqueHeu(CGraphIO* gio, vector<int>* max_clique_data) {
     // Pruning 1
     if (maxClq > ((*p_v_i_Vertices)[iCandidateVertex + 1] -
                   (*p_v_i_Vertices)[iCandidateVertex])) {
-      notComputed++;
+      counters->not_computed++;
+      counters->pruned1++;
       continue;
     }
 
@@ -68,6 +71,8 @@ int maxCliqueHeu(CGraphIO* gio, vector<int>* max_clique_data) {
       if (maxClq <= ((*p_v_i_Vertices)[(*p_v_i_Edges)[j] + 1] -
                      (*p_v_i_Vertices)[(*p_v_i_Edges)[j]]))
         v_i_S[iPos++] = (*p_v_i_Edges)[j];
+      else
+        counters->pruned3++;
     }
 
     icc = 0;
@@ -76,6 +81,7 @@ int maxCliqueHeu(CGraphIO* gio, vector<int>* max_clique_data) {
       int imdv1 = -1, imd1 = -1;
 
       icc++;
+      counters->nodes_expanded++;
 
       // generate a random number x from 0 to iPos -1
       // aasign that imdv = x and imd = d(x)
@@ -119,12 +125,16 @@ int maxCliqueHeu(CGraphIO* gio, vector<int>* max_clique_data) {
 int maxCliqueHeuIncremental(CGraphIO* gio,
                             size_t num_new_lc,
                             size_t prev_maxclique_size,
-                            vector<int>* max_clique_data) {
+                            vector<int>* max_clique_data,
+                            SearchCounters* counters) {
+  SearchCounters local_counters;
+  if (counters == NULL) counters = &local_counters;
+  *counters = SearchCounters();
   vector<int>* p_v_i_Vertices = gio->GetVerticesPtr();
   vector<int>* p_v_i_Edges = gio->GetEdgesPtr();
   // srand(time(NULL));
 
-  maxDegree = gio->GetMaximumVertexDegree();
+  int maxDegree = gio->GetMaximumVertexDegree();
   // TODO initialize maxClq with the best so far from prev steps
   int maxClq = prev_maxclique_size, u, icc;
   vector<int> v_i_S;
@@ -134,8 +144,6 @@ int maxCliqueHeuIncremental(CGraphIO* gio,
 
   int iPos, iPos1, iCount, iCount1;
 
-  int notComputed = 0;
-
   // compute the max clique for each vertex
   // TODO tricky indexing ...
   for (size_t iCandidateVertex = p_v_i_Vertices->size() - num_new_lc - 1;
@@ -144,7 +152,8 @@ int maxCliqueHeuIncremental(CGraphIO* gio,
     // Pruning 1
     if (maxClq > ((*p_v_i_Vertices)[iCandidateVertex + 1] -
                   (*p_v_i_Vertices)[iCandidateVertex])) {
-      notComputed++;
+      counters->not_computed++;
+      counters->pruned1++;
       continue;
     }
 
@@ -160,6 +169,8 @@ int maxCliqueHeuIncremental(CGraphIO* gio,
       if (maxClq <= ((*p_v_i_Vertices)[(*p_v_i_Edges)[j] + 1] -
                      (*p_v_i_Vertices)[(*p_v_i_Edges)[j]]))
         v_i_S[iPos++] = (*p_v_i_Edges)[j];
+      else
+        counters->pruned3++;
     }
 
     icc = 0;
@@ -168,6 +179,7 @@ int maxCliqueHeuIncremental(CGraphIO* gio,
       int imdv1 = -1, imd1 = -1;
 
       icc++;
+      counters->nodes_expanded++;
 
       // generate a random number x from 0 to iPos -1
       // aasign that imdv = x and imd = d(x)
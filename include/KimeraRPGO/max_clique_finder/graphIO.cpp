@@ -185,7 +185,7 @@ bool CGraphIO::ReadMatrixMarketAdjacencyGraph(string s_InputFile,
   return true;
 }
 
-bool CGraphIO::ReadEigenAdjacencyMatrix(Eigen::MatrixXd adjMatrix) {
+bool CGraphIO::ReadEigenAdjacencyMatrix(const Eigen::MatrixXd& adjMatrix) {
   map<int, vector<int>> nodeList;
   size_t col = 0, row = 0;
 
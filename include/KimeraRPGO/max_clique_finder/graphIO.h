@@ -46,7 +46,7 @@ class CGraphIO {
   string getFileExtension(string fileName);
   bool ReadMatrixMarketAdjacencyGraph(string s_InputFile,
                                       float connStrength = -DBL_MAX);
-  bool ReadEigenAdjacencyMatrix(Eigen::MatrixXd adjMatrix);
+  bool ReadEigenAdjacencyMatrix(const Eigen::MatrixXd& adjMatrix);
   bool ReadMeTiSAdjacencyGraph(string s_InputFile);
   void CalculateVertexDegrees();
 
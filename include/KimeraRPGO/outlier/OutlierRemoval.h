@@ -16,6 +16,9 @@ author: Yun Chang
 
 namespace KimeraRPGO {
 
+class NoiseModelCache;
+class ThreadPool;
+
 class OutlierRemoval {
  public:
   OutlierRemoval() = default;
@@ -26,11 +29,29 @@ class OutlierRemoval {
   virtual size_t getNumOdomFactors() = 0;
   virtual size_t getNumSpecialFactors() = 0;
 
+  /*! \brief Operation counts of the outlier rejection (0 if not tracked)
+   *  - getNumConsistencyChecks: pairwise consistency checks run so far
+   *  - getNumCliqueNodesExpanded: nodes expanded by the max clique searches
+   */
+  virtual size_t getNumConsistencyChecks() const { return 0; }
+  virtual size_t getNumCliqueNodesExpanded() const { return 0; }
+
+  /*! \brief Thread pool of the solver for the parallel stages (not owned,
+   *  nullptr: run serially)
+   */
+  virtual void setThreadPool(ThreadPool* thread_pool) {}
+
+  /*! \brief Noise models interned by the solver, with their decoded
+   *  covariances (not owned, nullptr: decode per factor)
+   */
+  virtual void setNoiseModelCache(const NoiseModelCache* noise_models) {}
+
   /*! \brief Process new measurements and reject outliers
    *  process the new measurements and update the "good set" of measurements
    *  - new_factors: factors from the new measurements
    *  - new_values: linearization point of the new measurements
    *	- nfg: the factors after processing new measurements and outlier removal
+   *    (the same graph on every call: it may be updated in place)
    * 	- values: the values after processing new measurements and outlier
    *removal
    *  - returns: boolean of if optimization should be called or not
@@ -40,6 +61,40 @@ class OutlierRemoval {
                               gtsam::NonlinearFactorGraph* nfg,
                               gtsam::Values* values) = 0;
 
+  /*! \brief Bring the graph written by removeOutliers back to the layout
+   *  expected by GNC (odometry, special factors, then loop closures) if
+   *  odometry only updates appended to it
+   */
+  virtual void restoreOutputLayout(gtsam::NonlinearFactorGraph* nfg) {}
+
+  /*! \brief Leading slots of nfg that the last removeOutliers left in place
+   *  (it only appended after them), 0 if it rebuilt nfg
+   */
+  virtual size_t getNumKeptOutputSlots() const { return 0; }
+
+  /*! \brief Archiving (see RobustSolver::archive)
+   *  - releaseOdometry: hand over the odometry factors between the given keys
+   *    that PoseArchive can pack, with their slot. Returns false if the method
+   *    does not support it
+   *  - restoreOdometry: put released factors back in their slot
+   *  Both rebuild nfg (the graph written by removeOutliers)
+   */
+  virtual bool releaseOdometry(const gtsam::KeySet& keys,
+                               SlottedFactors* released,
+                               gtsam::NonlinearFactorGraph* nfg) {
+    return false;
+  }
+  virtual void restoreOdometry(const SlottedFactors& released,
+                               gtsam::NonlinearFactorGraph* nfg) {}
+
+  /*! \brief Speculative updates (see RobustSolver::beginSpeculative): the
+   *  changes after beginSpeculative are kept by commitSpeculative or undone by
+   *  rollbackSpeculative. Returns false if the method cannot undo its changes
+   */
+  virtual bool beginSpeculative() { return false; }
+  virtual void commitSpeculative() {}
+  virtual void rollbackSpeculative() {}
+
   /*! \brief Save any data in the outlier removal process
    *  - folder_path: path to directory to save results in
    */
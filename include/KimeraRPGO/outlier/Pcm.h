@@ -6,18 +6,20 @@ author: Yun Chang, Luca Carlone
 
 #pragma once
 
-// enables correct operations of GTSAM (correct Jacobians)
-#define SLOW_BUT_CORRECT_BETWEENFACTOR
-
 #include <math.h>
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <fstream>
 #include <iomanip>
 #include <memory>
+#include <numeric>
+#include <queue>
+#include <random>
 #include <sstream>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <gtsam/geometry/Pose2.h>
@@ -33,8 +35,14 @@ author: Yun Chang, Luca Carlone
 #include "KimeraRPGO/Logger.h"
 #include "KimeraRPGO/SolverParams.h"
 #include "KimeraRPGO/outlier/OutlierRemoval.h"
+#include "KimeraRPGO/utils/Arena.h"
+#include "KimeraRPGO/utils/FlatHashMap.h"
 #include "KimeraRPGO/utils/GeometryUtils.h"
 #include "KimeraRPGO/utils/GraphUtils.h"
+#include "KimeraRPGO/utils/NoiseModelCache.h"
+#include "KimeraRPGO/utils/PoseArchive.h"
+#include "KimeraRPGO/utils/ThreadPool.h"
+#include "KimeraRPGO/utils/Trace.h"
 
 namespace KimeraRPGO {
 
@@ -49,6 +57,35 @@ enum class FactorType {
   NONBETWEEN_FACTORS = 4,  // not handled by PCM (may be more than 1)
 };
 
+/** \struct PrefilterStats
+ *  \brief Loop closures checked and rejected by a prefilter stage
+ */
+struct PrefilterStats {
+  PcmPrefilter stage;
+  size_t num_checked = 0;
+  size_t num_rejected = 0;
+  double time_ms = 0;
+
+  explicit PrefilterStats(PcmPrefilter prefilter) : stage(prefilter) {}
+
+  double rejectionRate() const {
+    return num_checked > 0 ? static_cast<double>(num_rejected) / num_checked
+                           : 0.0;
+  }
+};
+
+inline std::string prefilterName(PcmPrefilter stage) {
+  switch (stage) {
+    case PcmPrefilter::ODOMETRY:
+      return "odometry";
+    case PcmPrefilter::NODE_DISTANCE:
+      return "node_distance";
+    case PcmPrefilter::DUPLICATE:
+      return "duplicate";
+  }
+  return "unknown";
+}
+
 // poseT can be gtsam::Pose2 or Pose3 for 3D vs 3D
 // T can be PoseWithCovariance or PoseWithDistance based on
 // If using Pcm or PcmDistance
@@ -65,7 +102,14 @@ class Pcm : public OutlierRemoval {
         total_good_lc_(0),
         multirobot_align_method_(align_method),
         odom_check_(true),
-        loop_consistency_check_(true) {
+        loop_consistency_check_(true),
+        num_consistency_checks_(0),
+        thread_pool_(nullptr),
+        noise_models_(nullptr),
+        output_size_(0),
+        output_kept_(0),
+        output_layout_dirty_(false),
+        next_admission_seq_(0) {
     // check if templated value valid
     BOOST_CONCEPT_ASSERT((gtsam::IsLieGroup<poseT>));
 
@@ -78,6 +122,10 @@ class Pcm : public OutlierRemoval {
         params_.dist_trans_threshold < 0) {
       loop_consistency_check_ = false;
     }
+
+    for (const PcmPrefilter& stage : params_.prefilter.stages) {
+      prefilter_stats_.push_back(PrefilterStats(stage));
+    }
   }
   ~Pcm() = default;
   // initialize with odometry detect threshold and pairwise consistency
@@ -95,7 +143,7 @@ class Pcm : public OutlierRemoval {
   gtsam::NonlinearFactorGraph nfg_special_;
 
   // storing loop closures and its adjacency matrix
-  std::unordered_map<ObservationId, Measurements> loop_closures_;
+  FlatHashMap<ObservationId, Measurements> loop_closures_;
 
   // trajectory maping robot prefix to its keys and poses
   std::unordered_map<char, Trajectory<poseT, T>> odom_trajectories_;
@@ -104,7 +152,7 @@ class Pcm : public OutlierRemoval {
   std::vector<char> special_symbols_;
 
   // storing landmark measurements and its adjacency matrix
-  std::unordered_map<gtsam::Key, Measurements> landmarks_;
+  FlatHashMap<gtsam::Key, Measurements> landmarks_;
 
   // store the vector of observations (loop closures)
   std::vector<ObservationId> loop_closures_in_order_;
@@ -123,16 +171,230 @@ class Pcm : public OutlierRemoval {
   MultiRobotAlignMethod multirobot_align_method_;
   // Keep track of the order of robots when applying world transforms
   std::vector<char> robot_order_;
+  // frame of each aligned robot in the frame of robot_order_[0] (last
+  // multirobotValueInitialization), applied to the new odometry poses
+  std::unordered_map<char, poseT> frame_transforms_;
+
+  // odometry only spins append to the output graph instead of rebuilding it:
+  // size of the graph written last, and whether appended odometry follows
+  // special factors or loop closures (layout of buildGraphToOptimize broken)
+  size_t output_size_;
+  size_t output_kept_;  // slots the last spin left in place
+  bool output_layout_dirty_;
 
   // Toggle odom and loop consistency check
   bool odom_check_;
   bool loop_consistency_check_;
 
+  // scratch memory for a single call of removeOutliers (reset at the end)
+  MonotonicArena spin_arena_;
+
+  // random source of the reservoir window policy (fixed seed: repeatable)
+  std::mt19937 window_rng_;
+
+  // max clique search statistics per robot pair and over all landmarks
+  FlatHashMap<ObservationId, CliqueStatsSummary> lc_clique_stats_;
+  CliqueStatsSummary landmark_clique_stats_;
+
+  // pairwise consistency checks run so far (loop closures and landmarks),
+  // counted from the threads of the pool
+  std::atomic<size_t> num_consistency_checks_;
+
+  // shared with the solver (not owned), nullptr: everything runs serially
+  ThreadPool* thread_pool_;
+  // below this many calls per task a loop is not worth splitting
+  static constexpr size_t kMinChecksPerTask = 32;
+  static constexpr size_t kMinLandmarksPerTask = 8;
+
+  // interned by the solver (not owned), nullptr: covariances decoded per
+  // factor. Only read here, also from the threads of the pool
+  const NoiseModelCache* noise_models_;
+
+  // one entry per stage of params_.prefilter
+  std::vector<PrefilterStats> prefilter_stats_;
+
+  // measurements of the closures seen by the duplicate filter, per key pair
+  // (stored with the smaller key first)
+  struct KeyPairHash {
+    size_t operator()(const std::pair<gtsam::Key, gtsam::Key>& keys) const {
+      return keys.first * 0x9e3779b97f4a7c15ull + keys.second;
+    }
+  };
+  FlatHashMap<std::pair<gtsam::Key, gtsam::Key>,
+              std::vector<poseT>,
+              KeyPairHash>
+      seen_closures_;
+
+  // loop closures waiting for admission (see PcmAdmissionParams), highest
+  // priority on top, arrival order among equal priorities
+  struct QueuedLoopClosure {
+    double priority;
+    size_t seq;
+    gtsam::NonlinearFactor::shared_ptr factor;
+    bool operator<(const QueuedLoopClosure& other) const {
+      if (priority != other.priority) return priority < other.priority;
+      return seq > other.seq;
+    }
+  };
+  std::priority_queue<QueuedLoopClosure> admission_queue_;
+  size_t next_admission_seq_;
+
+  // state before the speculative updates (see beginSpeculative), null: the
+  // changes are final. The groups are saved before their first change, the
+  // append only state as a size, the small state as a copy. The operation
+  // counts and the statistics keep the work of the rolled back updates.
+  struct SavedGroup {
+    bool existed;
+    bool full;  // false: only the inliers changed (consistent_factors)
+    Measurements measurements;
+  };
+  struct UndoLog {
+    FlatHashMap<ObservationId, SavedGroup> loop_closures;
+    FlatHashMap<gtsam::Key, SavedGroup> landmarks;
+    size_t num_odom_factors;
+    size_t num_special_factors;
+    bool special_factors_saved;
+    gtsam::NonlinearFactorGraph special_factors;
+    // trajectory poses added, and the previous ones of overwritten poses
+    gtsam::KeySet added_poses;
+    std::map<gtsam::Key, T<poseT>> previous_poses;
+    // entries of loop_closures_in_order_ left from before, and the ones of
+    // them removed since (last removed at the back)
+    size_t num_in_order;
+    std::vector<ObservationId> removed_in_order;
+    std::vector<std::pair<gtsam::Key, gtsam::Key>> seen_closures;
+    size_t total_lc, total_good_lc;
+    std::vector<char> ignored_prefixes;
+    std::vector<char> robot_order;
+    std::unordered_map<char, poseT> frame_transforms;
+    size_t output_size;
+    bool output_layout_dirty;
+    std::mt19937 window_rng;
+    std::priority_queue<QueuedLoopClosure> admission_queue;
+    size_t next_admission_seq;
+  };
+  std::unique_ptr<UndoLog> undo_;
+
  public:
   size_t getNumLC() { return total_lc_; }
   size_t getNumLCInliers() { return total_good_lc_; }
   size_t getNumOdomFactors() { return nfg_odom_.size(); }
   size_t getNumSpecialFactors() { return nfg_special_.size(); }
+  size_t getNumQueuedLoopClosures() const { return admission_queue_.size(); }
+
+  /*! \brief Speculative updates: record the state before each change until
+   * commitSpeculative (drop the records) or rollbackSpeculative (restore)
+   */
+  bool beginSpeculative() override {
+    if (undo_) return false;
+    undo_ = make_unique<UndoLog>();
+    undo_->num_odom_factors = nfg_odom_.size();
+    undo_->num_special_factors = nfg_special_.size();
+    undo_->special_factors_saved = false;
+    undo_->num_in_order = loop_closures_in_order_.size();
+    undo_->total_lc = total_lc_;
+    undo_->total_good_lc = total_good_lc_;
+    undo_->ignored_prefixes = ignored_prefixes_;
+    undo_->robot_order = robot_order_;
+    undo_->frame_transforms = frame_transforms_;
+    undo_->output_size = output_size_;
+    undo_->output_layout_dirty = output_layout_dirty_;
+    undo_->window_rng = window_rng_;
+    undo_->admission_queue = admission_queue_;
+    undo_->next_admission_seq = next_admission_seq_;
+    return true;
+  }
+
+  void commitSpeculative() override { undo_.reset(); }
+
+  void rollbackSpeculative() override {
+    if (!undo_) return;
+    RPGO_TRACE_SCOPE("Pcm::rollbackSpeculative");
+    restoreGroups(&undo_->loop_closures, &loop_closures_);
+    restoreGroups(&undo_->landmarks, &landmarks_);
+
+    nfg_odom_.resize(undo_->num_odom_factors);
+    if (undo_->special_factors_saved) {
+      nfg_special_ = undo_->special_factors;
+    } else {
+      nfg_special_.resize(undo_->num_special_factors);
+    }
+
+    for (auto& previous : undo_->previous_poses) {
+      const char prefix = gtsam::Symbol(previous.first).chr();
+      odom_trajectories_.at(prefix).poses.at(previous.first) = previous.second;
+    }
+    for (const gtsam::Key& key : undo_->added_poses) {
+      const char prefix = gtsam::Symbol(key).chr();
+      auto trajectory = odom_trajectories_.find(prefix);
+      if (trajectory == odom_trajectories_.end()) continue;
+      trajectory->second.poses.erase(key);
+      if (trajectory->second.poses.empty()) {
+        odom_trajectories_.erase(trajectory);
+      }
+    }
+
+    loop_closures_in_order_.resize(undo_->num_in_order);
+    loop_closures_in_order_.insert(loop_closures_in_order_.end(),
+                                   undo_->removed_in_order.rbegin(),
+                                   undo_->removed_in_order.rend());
+    for (auto it = undo_->seen_closures.rbegin();
+         it != undo_->seen_closures.rend();
+         it++) {
+      std::vector<poseT>& seen = seen_closures_.at(*it);
+      seen.pop_back();
+      if (seen.empty()) seen_closures_.erase(*it);
+    }
+
+    total_lc_ = undo_->total_lc;
+    total_good_lc_ = undo_->total_good_lc;
+    ignored_prefixes_.swap(undo_->ignored_prefixes);
+    robot_order_.swap(undo_->robot_order);
+    frame_transforms_.swap(undo_->frame_transforms);
+    output_size_ = undo_->output_size;
+    output_layout_dirty_ = undo_->output_layout_dirty;
+    window_rng_ = undo_->window_rng;
+    admission_queue_.swap(undo_->admission_queue);
+    next_admission_seq_ = undo_->next_admission_seq;
+    undo_.reset();
+  }
+  void setThreadPool(ThreadPool* thread_pool) override {
+    thread_pool_ = thread_pool;
+  }
+  void setNoiseModelCache(const NoiseModelCache* noise_models) override {
+    noise_models_ = noise_models;
+  }
+
+  size_t getNumConsistencyChecks() const override {
+    return num_consistency_checks_;
+  }
+  size_t getNumCliqueNodesExpanded() const override {
+    size_t nodes = landmark_clique_stats_.total_nodes_expanded;
+    for (const auto& entry : lc_clique_stats_) {
+      nodes += entry.second.total_nodes_expanded;
+    }
+    return nodes;
+  }
+
+  /*! \brief Statistics of the prefilter stages (in the configured order)
+   */
+  const std::vector<PrefilterStats>& getPrefilterStats() const {
+    return prefilter_stats_;
+  }
+
+  /*! \brief Max clique statistics accumulated per robot pair (intra robot
+   * loop closures use ObservationId(r, r))
+   */
+  const FlatHashMap<ObservationId, CliqueStatsSummary>& getCliqueStats()
+      const {
+    return lc_clique_stats_;
+  }
+
+  /*! \brief Max clique statistics accumulated over all landmarks
+   */
+  const CliqueStatsSummary& getLandmarkCliqueStats() const {
+    return landmark_clique_stats_;
+  }
 
   /*! \brief Process new measurements and reject outliers
    *  process the new measurements and update the "good set" of measurements
@@ -146,18 +408,28 @@ class Pcm : public OutlierRemoval {
                       const gtsam::Values& new_values,
                       gtsam::NonlinearFactorGraph* output_nfg,
                       gtsam::Values* output_values) override {
+    RPGO_TRACE_SCOPE("Pcm::removeOutliers");
     // Start timer
     auto start = std::chrono::high_resolution_clock::now();
+    // release the scratch memory of this spin on exit
+    ScopedArenaReset arena_reset(&spin_arena_);
     // store new values:
     output_values->insert(new_values);
-    if (new_factors.size() == 0) {
+    output_kept_ = output_nfg->size();  // until rebuilt
+    if (new_factors.size() == 0 && admission_queue_.empty()) {
       // Done and nothing to optimize
       return false;
     }
 
     bool do_optimize = false;
+    // odometry only spins take the append path (see appendOdometry)
+    bool only_odometry = true;
+    const size_t num_robots = robot_order_.size();
     // ==============================================================================
-    gtsam::NonlinearFactorGraph loop_closure_factors;
+    ArenaVector<gtsam::NonlinearFactor::shared_ptr> loop_closure_factors{
+        ArenaAllocator<gtsam::NonlinearFactor::shared_ptr>(&spin_arena_)};
+    ArenaVector<gtsam::NonlinearFactor::shared_ptr> odometry_factors{
+        ArenaAllocator<gtsam::NonlinearFactor::shared_ptr>(&spin_arena_)};
     for (size_t i = 0; i < new_factors.size(); i++) {
       if (NULL == new_factors[i]) continue;
       // we first classify the current factors into the following categories:
@@ -167,8 +439,9 @@ class Pcm : public OutlierRemoval {
       // closures, and landmark observations
 
       // check if factor is a between factor
-      if (boost::dynamic_pointer_cast<gtsam::BetweenFactor<poseT>>(
-              new_factors[i])) {
+      // (raw pointer cast: no reference count traffic per factor)
+      if (dynamic_cast<const gtsam::BetweenFactor<poseT>*>(
+              new_factors[i].get())) {
         // specifically what outlier rejection handles
         gtsam::Key from_key = new_factors[i]->front();
         gtsam::Key to_key = new_factors[i]->back();
@@ -199,26 +472,29 @@ class Pcm : public OutlierRemoval {
       switch (type) {
         case FactorType::ODOMETRY:  // odometry, do not optimize
         {
-          updateOdom(new_factors[i], *output_values);
+          // the trajectories are updated per run below
+          odometry_factors.push_back(new_factors[i]);
         } break;
         case FactorType::FIRST_LANDMARK_OBSERVATION:  // landmark measurement,
                                                       // initialize
         {
           if (debug_) log<INFO>("New landmark observed");
-          Measurements newMeasurement;
-          newMeasurement.factors.add(new_factors[i]);
-          newMeasurement.consistent_factors.add(new_factors[i]);
           gtsam::Symbol symbfrnt(new_factors[i]->front());
           gtsam::Key landmark_key =
               (isSpecialSymbol(symbfrnt.chr()) ? new_factors[i]->front()
                                                : new_factors[i]->back());
-          landmarks_[landmark_key] = newMeasurement;
+          saveLandmarkGroup(landmark_key);
+          Measurements& measurements = landmarks_[landmark_key];
+          measurements = Measurements();
+          measurements.factors.add(new_factors[i]);
+          measurements.consistent_factors.add(new_factors[i]);
           total_lc_++;
+          only_odometry = false;
         } break;
         case FactorType::LOOP_CLOSURE: {
           if (new_factors[i]->front() != new_factors[i]->back()) {
             // add the the loop closure factors and process them together
-            loop_closure_factors.add(new_factors[i]);
+            loop_closure_factors.push_back(new_factors[i]);
           } else {
             log<WARNING>("Attempting to close loop against self");
           }
@@ -226,23 +502,31 @@ class Pcm : public OutlierRemoval {
         case FactorType::NONBETWEEN_FACTORS: {
           nfg_special_.add(new_factors[i]);
           do_optimize = true;
+          only_odometry = false;
         } break;
         default:  // the remainders are specical loop closure cases, includes
                   // the "UNCLASSIFIED" case
         {
           nfg_special_.add(new_factors[i]);
           do_optimize = true;
+          only_odometry = false;
         }
       }  // end switch
     }
+    updateOdometry(odometry_factors, *output_values);
+    if (params_.admission.check_budget > 0) {
+      admitLoopClosures(&loop_closure_factors);
+    }
     auto max_clique_duration = std::chrono::milliseconds::zero();
     if (loop_closure_factors.size() > 0) {
+      only_odometry = false;
       // update inliers
-      std::unordered_map<ObservationId, size_t> num_new_loopclosures;
+      FlatHashMap<ObservationId, size_t> num_new_loopclosures;
       parseAndIncrementAdjMatrix(
           loop_closure_factors, *output_values, &num_new_loopclosures);
       auto max_clique_start = std::chrono::high_resolution_clock::now();
-      if (params_.incremental) {
+      if (params_.incremental && !params_.lazy_consistency &&
+          !params_.transform_voting) {
         findInliersIncremental(num_new_loopclosures);
       } else {
         findInliers();
@@ -251,13 +535,20 @@ class Pcm : public OutlierRemoval {
       max_clique_duration =
           std::chrono::duration_cast<std::chrono::milliseconds>(
               max_clique_end - max_clique_start);
+      // freeze the measurements that leave the window of their group
+      enforceGroupWindows();
       // Find inliers with Pairwise consistent measurement set maximization
       do_optimize = true;
     }
-    *output_nfg = buildGraphToOptimize();
-    if (multirobot_align_method_ != MultiRobotAlignMethod::NONE &&
-        robot_order_.size() > 1) {
-      *output_values = multirobotValueInitialization(*output_values);
+    if (only_odometry && robot_order_.size() == num_robots &&
+        output_nfg->size() == output_size_) {
+      appendOdometry(odometry_factors, output_nfg, output_values);
+    } else {
+      *output_nfg = buildGraphToOptimize();
+      if (multirobot_align_method_ != MultiRobotAlignMethod::NONE &&
+          robot_order_.size() > 1) {
+        *output_values = multirobotValueInitialization(*output_values);
+      }
     }
 
     // End clock
@@ -270,6 +561,7 @@ class Pcm : public OutlierRemoval {
           "with %3% inliers. ") %
           spin_duration.count() % total_lc_ % total_good_lc_;
     if (log_output_) {
+      RPGO_TRACE_SCOPE("Pcm::log");
       saveAdjacencyMatrix(log_folder_);
       logSpinStatus(
           spin_duration.count(), max_clique_duration.count(), log_folder_);
@@ -282,16 +574,55 @@ class Pcm : public OutlierRemoval {
    *  - folder_path: path to directory to save results in
    */
   void saveData(std::string folder_path) override {
-    // TODO(Yun) save max clique results
-    // TODO(Yun) Maybe just use log?
-    // saveAdjacencyMatrix(folder_path);
-    // saveCliqueSizeData(folder_path);
+    RPGO_TRACE_SCOPE("Pcm::saveData");
+    // adjacency matrices are saved every spin when logging is enabled
+    saveCliqueStats(folder_path);
+    if (!prefilter_stats_.empty()) savePrefilterStats(folder_path);
+  }
+
+  /*! \brief rebuild the output graph if odometry was appended after the
+   * special factors or loop closures
+   */
+  void restoreOutputLayout(gtsam::NonlinearFactorGraph* output_nfg) override {
+    if (output_layout_dirty_) *output_nfg = buildGraphToOptimize();
+  }
+
+  size_t getNumKeptOutputSlots() const override { return output_kept_; }
+
+  /*! \brief release the odometry factors between archived poses: their slot
+   * in nfg_odom_ is left empty (null) so that the layout does not change
+   */
+  bool releaseOdometry(const gtsam::KeySet& keys,
+                       SlottedFactors* released,
+                       gtsam::NonlinearFactorGraph* output_nfg) override {
+    for (size_t i = 0; i < nfg_odom_.size(); i++) {
+      const gtsam::NonlinearFactor::shared_ptr& factor = nfg_odom_[i];
+      if (!factor || !PoseArchive::packable(*factor)) continue;
+      if (!keys.count(factor->front()) || !keys.count(factor->back())) {
+        continue;
+      }
+      released->emplace_back(i, factor);
+      nfg_odom_.remove(i);
+    }
+    *output_nfg = buildGraphToOptimize();
+    return true;
+  }
+
+  void restoreOdometry(const SlottedFactors& released,
+                       gtsam::NonlinearFactorGraph* output_nfg) override {
+    for (const auto& slotted : released) {
+      if (slotted.first < nfg_odom_.size()) {
+        nfg_odom_.replace(slotted.first, slotted.second);
+      }
+    }
+    *output_nfg = buildGraphToOptimize();
   }
 
   /*! \brief remove the last loop closure based on observation ID
    * and update the factors.
    * For example if Observation id is Obsid('a','c'), method
    * removes the last loop closure between robots a and c
+   * (with a window policy, only the active measurements can be removed)
    */
   EdgePtr removeLastLoopClosure(ObservationId id,
                                 gtsam::NonlinearFactorGraph* updated_factors) {
@@ -303,12 +634,16 @@ class Pcm : public OutlierRemoval {
     if (numLC <= 0) {
       return NULL;  // No more loop closures
     }
+    saveLoopClosureGroup(id);
     size_t num_lc = loop_closures_[id].factors.size();
     Edge removed_edge = Edge(loop_closures_[id].factors[num_lc - 1]->front(),
                              loop_closures_[id].factors[num_lc - 1]->back());
 
     loop_closures_[id].factors.erase(
         std::prev(loop_closures_[id].factors.end()));
+    if (!loop_closures_[id].voting_cells.empty()) {
+      loop_closures_[id].voting_cells.pop_back();
+    }
     if (loop_closures_[id].factors.size() < 2) {
       loop_closures_[id].consistent_factors = loop_closures_[id].factors;
     } else {
@@ -320,8 +655,10 @@ class Pcm : public OutlierRemoval {
 
       // Update the inliers
       std::vector<int> inliers_idx;
-      size_t num_inliers =
-          findMaxCliqueHeu(loop_closures_[id].adj_matrix, &inliers_idx);
+      MaxCliqueStats stats;
+      size_t num_inliers = findLoopClosureInliers(
+          id, &loop_closures_[id], &inliers_idx, &stats);
+      lc_clique_stats_[id].add(stats);
       loop_closures_[id].consistent_factors =
           gtsam::NonlinearFactorGraph();  // reset
       // update inliers, or consistent factors, according to max clique result
@@ -343,6 +680,10 @@ class Pcm : public OutlierRemoval {
     if (loop_closures_in_order_.size() == 0) return NULL;
 
     ObservationId last_obs = loop_closures_in_order_.back();
+    if (undo_ && loop_closures_in_order_.size() <= undo_->num_in_order) {
+      undo_->removed_in_order.push_back(last_obs);
+      undo_->num_in_order--;
+    }
     loop_closures_in_order_.pop_back();
     return removeLastLoopClosure(last_obs, updated_factors);
   }
@@ -382,17 +723,24 @@ class Pcm : public OutlierRemoval {
       gtsam::NonlinearFactorGraph* updated_factors) {
     // First make copy of nfg_special_ where prior factors stored
     const gtsam::NonlinearFactorGraph nfg_special_copy = nfg_special_;
+    if (undo_ && !undo_->special_factors_saved) {
+      undo_->special_factors =
+          gtsam::NonlinearFactorGraph(nfg_special_copy.begin(),
+                                      nfg_special_copy.begin() +
+                                          undo_->num_special_factors);
+      undo_->special_factors_saved = true;
+    }
     // Clear nfg_special_
     nfg_special_ = gtsam::NonlinearFactorGraph();
     // Iterate and pick out non prior factors and prior factors without key with
     // prefix
-    for (auto factor : nfg_special_copy) {
-      if (!boost::dynamic_pointer_cast<gtsam::PriorFactor<poseT>>(factor)) {
+    for (const auto& factor : nfg_special_copy) {
+      const gtsam::PriorFactor<poseT>* prior_factor =
+          dynamic_cast<const gtsam::PriorFactor<poseT>*>(factor.get());
+      if (!prior_factor) {
         nfg_special_.add(factor);
       } else {
-        gtsam::PriorFactor<poseT> prior_factor =
-            *boost::dynamic_pointer_cast<gtsam::PriorFactor<poseT>>(factor);
-        gtsam::Symbol node(prior_factor.key());
+        gtsam::Symbol node(prior_factor->key());
         if (node.chr() != prefix) nfg_special_.add(factor);
       }
     }
@@ -405,23 +753,24 @@ class Pcm : public OutlierRemoval {
    * adjacency matrices, in preparation for max clique
    */
   void parseAndIncrementAdjMatrix(
-      const gtsam::NonlinearFactorGraph& new_factors,
+      const ArenaVector<gtsam::NonlinearFactor::shared_ptr>& new_factors,
       const gtsam::Values& output_values,
-      std::unordered_map<ObservationId, size_t>* num_new_loopclosures) {
+      FlatHashMap<ObservationId, size_t>* num_new_loopclosures) {
+    RPGO_TRACE_SCOPE("Pcm classify loop closures");
     for (size_t i = 0; i < new_factors.size(); i++) {
       // iterate through the factors
       // double check again that these are between factors
-      if (boost::dynamic_pointer_cast<gtsam::BetweenFactor<poseT>>(
-              new_factors[i])) {
+      const gtsam::BetweenFactor<poseT>* between =
+          dynamic_cast<const gtsam::BetweenFactor<poseT>*>(
+              new_factors[i].get());
+      if (between) {
         // regular loop closure.
         // in this case we should run consistency check to see if loop closure
         // is good
         // * odometric consistency check (will only compare against odometry
         // - if loop fails this, we can just drop it)
-        // extract between factor
-        gtsam::BetweenFactor<poseT> nfg_factor =
-            *boost::dynamic_pointer_cast<gtsam::BetweenFactor<poseT>>(
-                new_factors[i]);
+        // extract between factor (the stored factor is shared, not copied)
+        const gtsam::BetweenFactor<poseT>& nfg_factor = *between;
 
         if (!output_values.exists(nfg_factor.keys().front()) ||
             !output_values.exists(nfg_factor.keys().back())) {
@@ -443,12 +792,17 @@ class Pcm : public OutlierRemoval {
             log<INFO>("loop closing with landmark %1%") %
                 gtsam::DefaultKeyFormatter(landmark_key);
 
-          landmarks_[landmark_key].factors.add(nfg_factor);
+          saveLandmarkGroup(landmark_key);
+          landmarks_[landmark_key].factors.add(new_factors[i]);
           total_lc_++;
           // grow adj matrix
           incrementLandmarkAdjMatrix(landmark_key);
         } else {
           // It is a proper loop closures
+          if (!passesPrefilters(nfg_factor)) {
+            if (debug_) log<WARNING>("Discarded loop closure (prefilter)");
+            continue;
+          }
           double odom_dist;
           bool odom_consistent = false;
           if (symbfrnt.chr() == symbback.chr()) {
@@ -464,14 +818,9 @@ class Pcm : public OutlierRemoval {
                   gtsam::DefaultKeyFormatter(nfg_factor.back());
             ObservationId obs_id(symbfrnt.chr(), symbback.chr());
             // detect which inter or intra robot loop closure this belongs to
-            if (num_new_loopclosures->find(obs_id) ==
-                num_new_loopclosures->end()) {
-              num_new_loopclosures->insert(
-                  std::pair<ObservationId, size_t>(obs_id, 1));
-            } else {
-              num_new_loopclosures->at(obs_id)++;
-            }
-            loop_closures_[obs_id].factors.add(nfg_factor);
+            (*num_new_loopclosures)[obs_id]++;
+            saveLoopClosureGroup(obs_id);
+            loop_closures_[obs_id].factors.add(new_factors[i]);
             loop_closures_in_order_.push_back(obs_id);
             total_lc_++;
             incrementAdjMatrix(obs_id, nfg_factor);
@@ -492,6 +841,272 @@ class Pcm : public OutlierRemoval {
     }
   }
 
+  /*
+   * speculative updates: save a group before its first change (inliers_only:
+   * the change only replaces its inliers)
+   */
+  template <class Id>
+  static void saveGroup(const Id& id,
+                        const FlatHashMap<Id, Measurements>& groups,
+                        FlatHashMap<Id, SavedGroup>* saved_groups,
+                        bool inliers_only) {
+    const auto group = groups.find(id);
+    const auto saved = saved_groups->find(id);
+    if (saved == saved_groups->end()) {
+      SavedGroup& entry = (*saved_groups)[id];
+      entry.existed = group != groups.end();
+      entry.full = !inliers_only;
+      if (!entry.existed) return;
+      if (inliers_only) {
+        entry.measurements.consistent_factors =
+            group->second.consistent_factors;
+      } else {
+        entry.measurements = group->second;
+      }
+      return;
+    }
+    if (inliers_only || saved->second.full || !saved->second.existed) return;
+    // the inliers saved before are the ones to restore
+    gtsam::NonlinearFactorGraph inliers =
+        saved->second.measurements.consistent_factors;
+    saved->second.measurements = group->second;
+    saved->second.measurements.consistent_factors = inliers;
+    saved->second.full = true;
+  }
+
+  void saveLoopClosureGroup(const ObservationId& id,
+                            bool inliers_only = false) {
+    if (undo_) {
+      saveGroup(id, loop_closures_, &undo_->loop_closures, inliers_only);
+    }
+  }
+
+  void saveLandmarkGroup(const gtsam::Key& key, bool inliers_only = false) {
+    if (undo_) saveGroup(key, landmarks_, &undo_->landmarks, inliers_only);
+  }
+
+  /*
+   * undo the changes of the saved groups. The groups created since are at the
+   * end of groups in the order they were saved: erasing them last to first
+   * keeps the order of the others (and of the output graph)
+   */
+  template <class Id>
+  static void restoreGroups(FlatHashMap<Id, SavedGroup>* saved_groups,
+                            FlatHashMap<Id, Measurements>* groups) {
+    for (auto it = saved_groups->end(); it != saved_groups->begin();) {
+      it--;
+      if (!it->second.existed) {
+        groups->erase(it->first);
+      } else if (it->second.full) {
+        groups->at(it->first) = std::move(it->second.measurements);
+      } else {
+        groups->at(it->first).consistent_factors =
+            it->second.measurements.consistent_factors;
+      }
+    }
+  }
+
+  /*
+   * speculative updates: save a trajectory pose before it is written
+   */
+  void savePose(const std::map<gtsam::Key, T<poseT>>& poses,
+                const gtsam::Key& key) {
+    if (!undo_ || undo_->added_poses.count(key)) return;
+    const auto pose = poses.find(key);
+    if (pose == poses.end()) {
+      undo_->added_poses.insert(key);
+    } else {
+      undo_->previous_poses.emplace(key, pose->second);
+    }
+  }
+
+  /*
+   * priority of a loop closure under the admission policy (higher first)
+   */
+  double admissionPriority(const gtsam::NonlinearFactor& factor) const {
+    const gtsam::Symbol symb_i(factor.front());
+    const gtsam::Symbol symb_j(factor.back());
+    const bool landmark =
+        isSpecialSymbol(symb_i.chr()) || isSpecialSymbol(symb_j.chr());
+    const bool inter_robot = !landmark && symb_i.chr() != symb_j.chr();
+    switch (params_.admission.policy) {
+      case PcmAdmissionPolicy::INTER_ROBOT_FIRST:
+        return inter_robot ? 1.0 : 0.0;
+      case PcmAdmissionPolicy::ODOMETRY_GAP:
+        if (landmark) return 0.0;
+        if (inter_robot) return std::numeric_limits<double>::infinity();
+        return std::fabs(static_cast<double>(symb_j.index()) -
+                         static_cast<double>(symb_i.index()));
+      case PcmAdmissionPolicy::SCORE:
+        return params_.admission.score ? params_.admission.score(factor)
+                                       : 0.0;
+      case PcmAdmissionPolicy::FIFO:
+      default:
+        return 0.0;
+    }
+  }
+
+  /*
+   * queue the new loop closures and take back the ones admitted this spin:
+   * each closure costs about one pairwise check per active measurement of
+   * its group, the first one is always admitted so the queue drains
+   */
+  void admitLoopClosures(
+      ArenaVector<gtsam::NonlinearFactor::shared_ptr>* loop_closure_factors) {
+    RPGO_TRACE_SCOPE("Pcm admission");
+    for (const auto& factor : *loop_closure_factors) {
+      admission_queue_.push(QueuedLoopClosure{
+          admissionPriority(*factor), next_admission_seq_++, factor});
+    }
+    loop_closure_factors->clear();
+
+    // closures admitted this spin per group (they grow the group as well)
+    FlatHashMap<ObservationId, size_t> admitted_lc;
+    FlatHashMap<gtsam::Key, size_t> admitted_landmark;
+    size_t checks = 0;
+    while (!admission_queue_.empty()) {
+      const gtsam::NonlinearFactor::shared_ptr& factor =
+          admission_queue_.top().factor;
+      const gtsam::Symbol symb_i(factor->front());
+      const gtsam::Symbol symb_j(factor->back());
+      size_t cost = 0;
+      if (isSpecialSymbol(symb_i.chr()) || isSpecialSymbol(symb_j.chr())) {
+        const gtsam::Key landmark_key =
+            isSpecialSymbol(symb_i.chr()) ? factor->front() : factor->back();
+        const auto landmark = landmarks_.find(landmark_key);
+        if (landmark != landmarks_.end()) {
+          cost += landmark->second.adj_matrix.rows();
+        }
+        cost += admitted_landmark[landmark_key]++;
+      } else {
+        const ObservationId obs_id(symb_i.chr(), symb_j.chr());
+        const auto group = loop_closures_.find(obs_id);
+        if (group != loop_closures_.end()) {
+          cost += group->second.adj_matrix.rows();
+        }
+        cost += admitted_lc[obs_id]++;
+      }
+      if (!loop_closure_factors->empty() &&
+          checks + cost > params_.admission.check_budget) {
+        break;
+      }
+      checks += cost;
+      loop_closure_factors->push_back(factor);
+      admission_queue_.pop();
+    }
+    if (debug_ && !admission_queue_.empty()) {
+      log<INFO>("Admitted %1% loop closures, %2% deferred") %
+          loop_closure_factors->size() % admission_queue_.size();
+    }
+  }
+
+  /*
+   * run the prefilter stages in order, stop at the first rejection
+   */
+  bool passesPrefilters(const gtsam::BetweenFactor<poseT>& lc_factor) {
+    for (PrefilterStats& stats : prefilter_stats_) {
+      auto start = std::chrono::high_resolution_clock::now();
+      bool applies = true;
+      bool passed = true;
+      switch (stats.stage) {
+        case PcmPrefilter::ODOMETRY:
+          passed = passesLooseOdomCheck(lc_factor, &applies);
+          break;
+        case PcmPrefilter::NODE_DISTANCE:
+          passed = passesNodeDistance(lc_factor, &applies);
+          break;
+        case PcmPrefilter::DUPLICATE:
+          passed = !isDuplicate(lc_factor);
+          break;
+      }
+      stats.time_ms += std::chrono::duration<double, std::milli>(
+                           std::chrono::high_resolution_clock::now() - start)
+                           .count();
+      if (!applies) continue;
+      stats.num_checked++;
+      if (!passed) {
+        stats.num_rejected++;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /*
+   * compare the closure to the odometry poses only (no covariance), with a
+   * tolerance growing with the number of odometry edges in between
+   */
+  bool passesLooseOdomCheck(const gtsam::BetweenFactor<poseT>& lc_factor,
+                            bool* applies) {
+    const gtsam::Symbol symb_i(lc_factor.keys().front());
+    const gtsam::Symbol symb_j(lc_factor.keys().back());
+    *applies = false;
+    if (symb_i.chr() != symb_j.chr()) return true;
+    const auto trajectory = odom_trajectories_.find(symb_i.chr());
+    if (trajectory == odom_trajectories_.end()) return true;
+    const auto pose_i = trajectory->second.poses.find(symb_i);
+    const auto pose_j = trajectory->second.poses.find(symb_j);
+    if (pose_i == trajectory->second.poses.end() ||
+        pose_j == trajectory->second.poses.end()) {
+      return true;
+    }
+    *applies = true;
+
+    const poseT error = pose_i->second.pose.between(pose_j->second.pose)
+                            .between(lc_factor.measured());
+    const double num_edges = std::fabs(static_cast<double>(symb_j.index()) -
+                                       static_cast<double>(symb_i.index()));
+    const PcmPrefilterParams& prefilter = params_.prefilter;
+    return error.translation().norm() <
+               prefilter.odom_trans_threshold +
+                   prefilter.odom_trans_drift * num_edges &&
+           poseT::Rotation::Logmap(error.rotation()).norm() <
+               prefilter.odom_rot_threshold +
+                   prefilter.odom_rot_drift * num_edges;
+  }
+
+  /*
+   * intra robot closures between poses closer than min_node_distance
+   */
+  bool passesNodeDistance(const gtsam::BetweenFactor<poseT>& lc_factor,
+                          bool* applies) {
+    const gtsam::Symbol symb_i(lc_factor.keys().front());
+    const gtsam::Symbol symb_j(lc_factor.keys().back());
+    *applies = symb_i.chr() == symb_j.chr();
+    if (!*applies) return true;
+    const size_t distance = symb_i.index() > symb_j.index()
+                                ? symb_i.index() - symb_j.index()
+                                : symb_j.index() - symb_i.index();
+    return distance >= params_.prefilter.min_node_distance;
+  }
+
+  /*
+   * same poses and (nearly) the same measurement as a closure seen before
+   * (closures that are not duplicates are remembered)
+   */
+  bool isDuplicate(const gtsam::BetweenFactor<poseT>& lc_factor) {
+    gtsam::Key key_i = lc_factor.keys().front();
+    gtsam::Key key_j = lc_factor.keys().back();
+    poseT measured = lc_factor.measured();
+    if (key_j < key_i) {
+      std::swap(key_i, key_j);
+      measured = measured.inverse();
+    }
+    std::vector<poseT>& seen = seen_closures_[std::make_pair(key_i, key_j)];
+    for (const poseT& previous : seen) {
+      const poseT difference = previous.between(measured);
+      if (difference.translation().norm() <
+              params_.prefilter.duplicate_trans_threshold &&
+          poseT::Rotation::Logmap(difference.rotation()).norm() <
+              params_.prefilter.duplicate_rot_threshold) {
+        return true;
+      }
+    }
+    seen.push_back(measured);
+    if (undo_) undo_->seen_closures.push_back(std::make_pair(key_i, key_j));
+    return false;
+  }
+
   // check if a character is a special symbol as defined in constructor
   // (typically these are the landmarks)
   bool isSpecialSymbol(const char& symb) const {
@@ -501,49 +1116,143 @@ class Pcm : public OutlierRemoval {
     return false;
   }
 
+  /*
+   * odometry of a robot (empty if none received yet); read only so that the
+   * consistency checks can run on several threads
+   */
+  const Trajectory<poseT, T>& trajectory(char prefix) const {
+    static const Trajectory<poseT, T> empty;
+    const auto it = odom_trajectories_.find(prefix);
+    return it == odom_trajectories_.end() ? empty : it->second;
+  }
+
+  /*
+   * fn(k) for k in [0, n), split over the thread pool (if any) in tasks of at
+   * least min_per_task calls
+   */
+  void forEach(size_t n,
+               const std::function<void(size_t)>& fn,
+               size_t min_per_task) {
+    if (thread_pool_ && n >= 2 * min_per_task) {
+      thread_pool_->parallelFor(n, fn, n / min_per_task);
+    } else {
+      for (size_t k = 0; k < n; k++) fn(k);
+    }
+  }
+
   /* *******************************************************************************
    */
   // update the odometry: add new measurements to odometry trajectory tree
-  void updateOdom(const gtsam::NonlinearFactor::shared_ptr& new_factor,
-                  const gtsam::Values& output_values) {
-    // here we have values for reference checking and initialization if needed
-    gtsam::BetweenFactor<poseT> odom_factor =
-        *boost::dynamic_pointer_cast<gtsam::BetweenFactor<poseT>>(new_factor);
-    nfg_odom_.add(odom_factor);  // - store factor in nfg_odom_
-    // update trajectory(compose last value with new odom value)
-    gtsam::Key new_key = odom_factor.keys().back();
-    gtsam::Key prev_key = odom_factor.keys().front();
-
-    // extract prefix
-    gtsam::Symbol sym = gtsam::Symbol(new_key);
-    char prefix = sym.chr();
+  // The odometry of a spin arrives in order: each run of chained factors
+  // (one robot, consecutive keys) is composed in one loop, then appended to
+  // the trajectory
+  template <class Factors>
+  void updateOdometry(const Factors& odometry_factors,
+                      const gtsam::Values& output_values) {
+    if (odometry_factors.empty()) return;
+    RPGO_TRACE_SCOPE("Pcm update odometry");
+    nfg_odom_.reserve(nfg_odom_.size() + odometry_factors.size());
+    size_t begin = 0;
+    for (size_t i = 1; i <= odometry_factors.size(); i++) {
+      if (i < odometry_factors.size() &&
+          odometry_factors[i]->front() == odometry_factors[i - 1]->back()) {
+        continue;
+      }
+      updateOdomRun(odometry_factors, begin, i, output_values);
+      begin = i;
+    }
+  }
 
-    // construct pose with covariance for odometry measurement
-    T<poseT> odom_delta(odom_factor);
+  template <class Factors>
+  void updateOdomRun(const Factors& odometry_factors,
+                     size_t begin,
+                     size_t end,
+                     const gtsam::Values& output_values) {
+    // here we have values for reference checking and initialization if needed
+    // (classified as BetweenFactor<poseT> in removeOutliers)
+    const gtsam::Key prev_key = odometry_factors[begin]->front();
+    const char prefix = gtsam::Symbol(prev_key).chr();
 
-    if (odom_trajectories_.find(prefix) == odom_trajectories_.end()) {
+    std::map<gtsam::Key, T<poseT>>& poses = odom_trajectories_[prefix].poses;
+    if (poses.empty()) {
       // prefix has not been seen before, add
       T<poseT> initial_pose;
       initial_pose.pose = output_values.at<poseT>(prev_key);
       // populate trajectories
-      odom_trajectories_[prefix].poses[prev_key] = initial_pose;
+      savePose(poses, prev_key);
+      poses[prev_key] = initial_pose;
       // add to robot order since seen for the first time
       robot_order_.push_back(prefix);
     }
 
-    // Now get the latest pose in trajectory and compose
-    T<poseT> prev_pose;
-    try {
-      prev_pose = odom_trajectories_[prefix].poses[prev_key];
-    } catch (...) {
+    // Now get the latest pose in trajectory and compose (odometry arrives in
+    // order: the previous pose is the last one, no search)
+    T<poseT> pose;
+    auto prev = std::prev(poses.end());
+    if (prev->first != prev_key) prev = poses.find(prev_key);
+    if (prev != poses.end()) {
+      pose = prev->second;
+    } else {
       log<WARNING>("Attempted to add odom to non-existing key. ");
     }
 
-    // compose latest pose to odometry for new pose
-    T<poseT> new_pose = prev_pose.compose(odom_delta);
+    // compose along the run, the covariance decoded once per noise model
+    ArenaVector<std::pair<gtsam::Key, T<poseT>>> run{
+        ArenaAllocator<std::pair<gtsam::Key, T<poseT>>>(&spin_arena_)};
+    run.reserve(end - begin);
+    const gtsam::noiseModel::Base* model = nullptr;
+    const gtsam::Matrix* covariance = nullptr;
+    gtsam::Matrix decoded;  // covariance of a model not interned
+    for (size_t i = begin; i < end; i++) {
+      const gtsam::BetweenFactor<poseT>& odom_factor =
+          static_cast<const gtsam::BetweenFactor<poseT>&>(
+              *odometry_factors[i]);
+      nfg_odom_.add(odometry_factors[i]);  // - store factor in nfg_odom_
+      if (odom_factor.noiseModel().get() != model) {
+        model = odom_factor.noiseModel().get();
+        covariance = &decodeCovariance(odom_factor, &decoded);
+      }
+      pose.composeInPlace(T<poseT>(odom_factor, *covariance));
+      run.emplace_back(odom_factor.back(), pose);
+    }
 
-    // add to trajectory
-    odom_trajectories_[prefix].poses[new_key] = new_pose;
+    // add to trajectory (amortized constant at the end)
+    for (const auto& new_pose : run) {
+      savePose(poses, new_pose.first);
+      poses.emplace_hint(poses.end(), new_pose)->second = new_pose.second;
+    }
+  }
+
+  /* *******************************************************************************
+   */
+  /*
+   * odometry only spin: append the odometry to the output graph and express
+   * the new poses in the aligned frame of their robot, instead of rebuilding
+   * the graph and realigning every pose (the earlier poses keep their
+   * estimates). No pass over the graph or the trajectories. GNC expects the
+   * odometry first: the layout is restored by restoreOutputLayout
+   */
+  template <class Factors>
+  void appendOdometry(const Factors& odometry_factors,
+                      gtsam::NonlinearFactorGraph* output_nfg,
+                      gtsam::Values* output_values) {
+    for (const auto& factor : odometry_factors) output_nfg->add(factor);
+    output_size_ = output_nfg->size();
+    if (output_size_ != nfg_odom_.size()) output_layout_dirty_ = true;
+    if (multirobot_align_method_ == MultiRobotAlignMethod::NONE ||
+        robot_order_.size() < 2) {
+      return;
+    }
+    for (const auto& factor : odometry_factors) {
+      const gtsam::Key key = factor->back();
+      const char prefix = gtsam::Symbol(key).chr();
+      const auto transform = frame_transforms_.find(prefix);
+      if (transform == frame_transforms_.end()) continue;  // not aligned
+      output_values->update(
+          key,
+          transform->second.compose(
+              odom_trajectories_.at(prefix).poses.at(key).pose));
+    }
   }
 
   /* *******************************************************************************
@@ -582,6 +1291,30 @@ class Pcm : public OutlierRemoval {
     return false;
   }
 
+  /* *******************************************************************************
+   */
+  /*
+   * measurement of a relative pose factor, with the covariance decoded once
+   * per interned noise model (per call if the model is not interned). The
+   * covariance of an interned model is returned without a copy, that of
+   * another model is decoded into scratch (owned by the caller, so that
+   * parallel checks do not share it)
+   */
+  const gtsam::Matrix& decodeCovariance(
+      const gtsam::BetweenFactor<poseT>& factor,
+      gtsam::Matrix* scratch) const {
+    const NoiseModelCache::Entry* entry =
+        noise_models_ ? noise_models_->find(factor.noiseModel()) : nullptr;
+    if (entry) return entry->covariance;
+    *scratch = factorCovariance(factor);
+    return *scratch;
+  }
+
+  T<poseT> decodeMeasurement(const gtsam::BetweenFactor<poseT>& factor) const {
+    gtsam::Matrix scratch;  // not allocated for interned models
+    return T<poseT>(factor, decodeCovariance(factor, &scratch));
+  }
+
   /* *******************************************************************************
    */
   /*
@@ -603,10 +1336,10 @@ class Pcm : public OutlierRemoval {
       log<WARNING>(
           "Only check for odmetry consistency for intrarobot loop closures");
     }
-    pij_odom = odom_trajectories_[symb_i.chr()].getBetween(key_i, key_j);
+    pij_odom = trajectory(symb_i.chr()).getBetween(key_i, key_j);
 
     // get pij_lc = (Tij_lc, Covij_lc) from factor
-    pji_lc = T<poseT>(lc_factor).inverse();
+    pji_lc = decodeMeasurement(lc_factor).inverse();
 
     // check consistency (Tij_odom,Cov_ij_odom, Tij_lc, Cov_ij_lc)
     result = pij_odom.compose(pji_lc);
@@ -658,6 +1391,7 @@ class Pcm : public OutlierRemoval {
                           const gtsam::BetweenFactor<poseT>& c_lcBetween_d,
                           double* dist) {
     if (!loop_consistency_check_) return true;
+    num_consistency_checks_++;
     // check if two loop closures are consistent
     // say: loop closure 1 is (a,b)
     gtsam::Key key_a = a_lcBetween_b.keys().front();
@@ -667,8 +1401,8 @@ class Pcm : public OutlierRemoval {
     gtsam::Key key_d = c_lcBetween_d.keys().back();
 
     T<poseT> a_lc_b, c_lc_d;
-    a_lc_b = T<poseT>(a_lcBetween_b);
-    c_lc_d = T<poseT>(c_lcBetween_d);
+    a_lc_b = decodeMeasurement(a_lcBetween_b);
+    c_lc_d = decodeMeasurement(c_lcBetween_d);
     gtsam::Symbol symb_a = gtsam::Symbol(key_a);
     gtsam::Symbol symb_b = gtsam::Symbol(key_b);
     gtsam::Symbol symb_c = gtsam::Symbol(key_c);
@@ -687,14 +1421,12 @@ class Pcm : public OutlierRemoval {
     if (symb_a.chr() != symb_c.chr()) {
       log<WARNING>("Attempting to get odometry between different trajectories");
     }
-    T<poseT> a_odom_c =
-        odom_trajectories_[symb_a.chr()].getBetween(key_a, key_c);
+    T<poseT> a_odom_c = trajectory(symb_a.chr()).getBetween(key_a, key_c);
     // find odometry from d to b
     if (symb_b.chr() != symb_d.chr()) {
       log<WARNING>("Attempting to get odometry between different trajectories");
     }
-    T<poseT> b_odom_d =
-        odom_trajectories_[symb_b.chr()].getBetween(key_b, key_d);
+    T<poseT> b_odom_d = trajectory(symb_b.chr()).getBetween(key_b, key_d);
 
     // check that d to b pose is consistent with pose from b to d
     T<poseT> a_path_d, d_path_b, loop;
@@ -711,6 +1443,7 @@ class Pcm : public OutlierRemoval {
    */
   void incrementAdjMatrix(const ObservationId& id,
                           const gtsam::BetweenFactor<poseT>& factor) {
+    RPGO_TRACE_SCOPE_DETAIL("Pcm adjacency row", traceDetail(id));
     // * pairwise consistency check (will also compare other loops - if loop
     // fails we still store it, but not include in the optimization)
     // -- add 1 row and 1 column to lc_adjacency_matrix_;
@@ -720,43 +1453,56 @@ class Pcm : public OutlierRemoval {
     // -- add loops in max clique to a local variable nfg_good_lc (done in the
     // updateOutputGraph function) Using correspondence rowId (size_t, in
     // adjacency matrix) to slot id (size_t, id of that lc in nfg_lc)
-    if (loop_closures_.find(id) == loop_closures_.end()) {
-      // does not exist yet, add
-      Measurements new_measurements;
-      loop_closures_[id] = new_measurements;
-    }
+    // does not exist yet: default constructed
+    Measurements& measurements = loop_closures_[id];
     size_t num_lc =
-        loop_closures_[id].factors.size();  // number of loop closures so far,
-                                            // including the one we just added
+        measurements.factors.size();  // number of loop closures so far,
+                                      // including the one we just added
+    const bool voting = votesFrameTransform(id);
+    if (voting) measurements.voting_cells.push_back(votingCell(factor));
     Eigen::MatrixXd new_adj_matrix = Eigen::MatrixXd::Zero(num_lc, num_lc);
     Eigen::MatrixXd new_dst_matrix = Eigen::MatrixXd::Zero(num_lc, num_lc);
     if (num_lc > 1) {
       // if = 1 then just initialized
       new_adj_matrix.topLeftCorner(num_lc - 1, num_lc - 1) =
-          loop_closures_[id].adj_matrix;
+          measurements.adj_matrix;
       new_dst_matrix.topLeftCorner(num_lc - 1, num_lc - 1) =
-          loop_closures_[id].dist_matrix;
+          measurements.dist_matrix;
 
-      // now iterate through the previous loop closures and fill in last row +
-      // col of adjacency
-      for (size_t i = 0; i < num_lc - 1;
-           i++) {  // compare it against all others
-        gtsam::BetweenFactor<poseT> factor_i =
-            *boost::dynamic_pointer_cast<gtsam::BetweenFactor<poseT>>(
-                loop_closures_[id].factors[i]);
-        // check consistency
-        double mah_distance = 0.0;
-        bool consistent = areLoopsConsistent(factor_i, factor, &mah_distance);
-        new_dst_matrix(num_lc - 1, i) = mah_distance;
-        new_dst_matrix(i, num_lc - 1) = mah_distance;
-        if (consistent) {
-          new_adj_matrix(num_lc - 1, i) = 1;
-          new_adj_matrix(i, num_lc - 1) = 1;
-        }
+      if (params_.lazy_consistency) {
+        // checked by the max clique search if needed (see findGroupInliers)
+        markLastUnknown(&new_adj_matrix, &new_dst_matrix);
+      } else {
+        // now iterate through the previous loop closures and fill in last
+        // row + col of adjacency (every entry is written by one call)
+        auto check = [&](size_t i) {  // compare it against all others
+          // only BetweenFactor<poseT> are stored in the loop closure groups
+          const gtsam::BetweenFactor<poseT>& factor_i =
+              static_cast<const gtsam::BetweenFactor<poseT>&>(
+                  *measurements.factors[i]);
+          // closures implying distant frame transforms are not compared
+          if (voting && !neighborCells(measurements.voting_cells.back(),
+                                       measurements.voting_cells[i])) {
+            new_dst_matrix(num_lc - 1, i) = -1;
+            new_dst_matrix(i, num_lc - 1) = -1;
+            return;
+          }
+          // check consistency
+          double mah_distance = 0.0;
+          bool consistent =
+              areLoopsConsistent(factor_i, factor, &mah_distance);
+          new_dst_matrix(num_lc - 1, i) = mah_distance;
+          new_dst_matrix(i, num_lc - 1) = mah_distance;
+          if (consistent) {
+            new_adj_matrix(num_lc - 1, i) = 1;
+            new_adj_matrix(i, num_lc - 1) = 1;
+          }
+        };
+        forEach(num_lc - 1, check, kMinChecksPerTask);
       }
     }
-    loop_closures_[id].adj_matrix = new_adj_matrix;
-    loop_closures_[id].dist_matrix = new_dst_matrix;
+    measurements.adj_matrix.swap(new_adj_matrix);
+    measurements.dist_matrix.swap(new_dst_matrix);
   }
 
   /* *******************************************************************************
@@ -766,63 +1512,53 @@ class Pcm : public OutlierRemoval {
    */
   void incrementLandmarkAdjMatrix(const gtsam::Key& ldmk_key) {
     // pairwise consistency check for landmarks
-    size_t num_lc = landmarks_[ldmk_key].factors.size();  // number measurements
+    RPGO_TRACE_SCOPE_DETAIL("Pcm landmark adjacency row",
+                            std::string(gtsam::Symbol(ldmk_key)));
+    Measurements& measurements = landmarks_[ldmk_key];
+    size_t num_lc = measurements.factors.size();  // number measurements
     Eigen::MatrixXd new_adj_matrix = Eigen::MatrixXd::Zero(num_lc, num_lc);
     Eigen::MatrixXd new_dst_matrix = Eigen::MatrixXd::Zero(num_lc, num_lc);
     if (num_lc > 1) {
       // if = 1 then just initialized
       new_adj_matrix.topLeftCorner(num_lc - 1, num_lc - 1) =
-          landmarks_[ldmk_key].adj_matrix;
+          measurements.adj_matrix;
       new_dst_matrix.topLeftCorner(num_lc - 1, num_lc - 1) =
-          landmarks_[ldmk_key].dist_matrix;
+          measurements.dist_matrix;
+
+      if (params_.lazy_consistency) {
+        // checked by the max clique search if needed (see findGroupInliers)
+        markLastUnknown(&new_adj_matrix, &new_dst_matrix);
+        measurements.adj_matrix.swap(new_adj_matrix);
+        measurements.dist_matrix.swap(new_dst_matrix);
+        return;
+      }
 
       // now iterate through the previous loop closures and fill in last row +
       // col of adjacency
-      gtsam::BetweenFactor<poseT>
+      // (only BetweenFactor<poseT> are stored in the landmark groups)
+      const gtsam::BetweenFactor<poseT>&
           factor_jl =  // latest landmark loop closure: to be checked
-          *boost::dynamic_pointer_cast<gtsam::BetweenFactor<poseT>>(
-              landmarks_[ldmk_key].factors[num_lc - 1]);
+          static_cast<const gtsam::BetweenFactor<poseT>&>(
+              *measurements.factors[num_lc - 1]);
 
       // check it against all others
       for (size_t i = 0; i < num_lc - 1; i++) {
-        gtsam::BetweenFactor<poseT> factor_il =
-            *boost::dynamic_pointer_cast<gtsam::BetweenFactor<poseT>>(
-                landmarks_[ldmk_key].factors[i]);
+        const gtsam::BetweenFactor<poseT>& factor_il =
+            static_cast<const gtsam::BetweenFactor<poseT>&>(
+                *measurements.factors[i]);
 
-        // check consistency
-        gtsam::Key keyi = factor_il.keys().front();
-        gtsam::Key keyj = factor_jl.keys().front();
-
-        if (keyi == ldmk_key || keyj == ldmk_key) {
+        if (factor_il.keys().front() == ldmk_key ||
+            factor_jl.keys().front() == ldmk_key) {
           log<WARNING>(
               "Landmark observations should be connected pose -> "
               "landmark, discarding");
           return;
         }
 
-        // factors are (i,l) and (j,l) and connect poses i,j to a landmark l
-        T<poseT> i_pose_l, j_pose_l;
-        i_pose_l = T<poseT>(factor_il);
-        j_pose_l = T<poseT>(factor_jl);
-
-        gtsam::Symbol symb_i = gtsam::Symbol(keyi);
-        gtsam::Symbol symb_j = gtsam::Symbol(keyj);
-
-        // find odometry from 1a to 2a
-        if (symb_i.chr() != symb_j.chr()) {
-          log<WARNING>(
-              "Attempting to get odometry between different trajectories");
-        }
-        T<poseT> i_odom_j =
-            odom_trajectories_[symb_i.chr()].getBetween(keyi, keyj);
-
-        // check that lc_1 pose is consistent with pose from 1a to 1b
-        T<poseT> i_path_l, loop;
-        i_path_l = i_odom_j.compose(j_pose_l);
-        loop = i_path_l.inverse().compose(i_pose_l);
-
+        // check consistency
         double dist;
-        bool consistent = checkLoopConsistent(loop, &dist);
+        bool consistent =
+            areLandmarkObservationsConsistent(factor_il, factor_jl, &dist);
 
         new_dst_matrix(num_lc - 1, i) = dist;
         new_dst_matrix(i, num_lc - 1) = dist;
@@ -832,8 +1568,289 @@ class Pcm : public OutlierRemoval {
         }
       }
     }
-    landmarks_[ldmk_key].adj_matrix = new_adj_matrix;
-    landmarks_[ldmk_key].dist_matrix = new_dst_matrix;
+    measurements.adj_matrix.swap(new_adj_matrix);
+    measurements.dist_matrix.swap(new_dst_matrix);
+  }
+
+  /* *******************************************************************************
+   */
+  /*
+   * consistency of two observations (i,l) and (j,l) of the same landmark l
+   */
+  bool areLandmarkObservationsConsistent(
+      const gtsam::BetweenFactor<poseT>& factor_il,
+      const gtsam::BetweenFactor<poseT>& factor_jl,
+      double* dist) {
+    num_consistency_checks_++;
+    gtsam::Key keyi = factor_il.keys().front();
+    gtsam::Key keyj = factor_jl.keys().front();
+
+    // factors are (i,l) and (j,l) and connect poses i,j to a landmark l
+    T<poseT> i_pose_l, j_pose_l;
+    i_pose_l = decodeMeasurement(factor_il);
+    j_pose_l = decodeMeasurement(factor_jl);
+
+    gtsam::Symbol symb_i = gtsam::Symbol(keyi);
+    gtsam::Symbol symb_j = gtsam::Symbol(keyj);
+
+    // find odometry from 1a to 2a
+    if (symb_i.chr() != symb_j.chr()) {
+      log<WARNING>("Attempting to get odometry between different trajectories");
+    }
+    T<poseT> i_odom_j = trajectory(symb_i.chr()).getBetween(keyi, keyj);
+
+    // check that lc_1 pose is consistent with pose from 1a to 1b
+    T<poseT> i_path_l, loop;
+    i_path_l = i_odom_j.compose(j_pose_l);
+    loop = i_path_l.inverse().compose(i_pose_l);
+    return checkLoopConsistent(loop, dist);
+  }
+
+  /*
+   * robot pair of a group, shown in the trace events
+   */
+  static std::string traceDetail(const ObservationId& id) {
+    return std::string{id.id1, id.id2};
+  }
+
+  /*
+   * lazy mode: the last row and column (new measurement) are unknown (-1)
+   */
+  static void markLastUnknown(Eigen::MatrixXd* adj_matrix,
+                              Eigen::MatrixXd* dist_matrix) {
+    const size_t last = adj_matrix->rows() - 1;
+    adj_matrix->row(last).head(last).setConstant(-1);
+    adj_matrix->col(last).head(last).setConstant(-1);
+    dist_matrix->row(last).head(last).setConstant(-1);
+    dist_matrix->col(last).head(last).setConstant(-1);
+  }
+
+  /*
+   * consistency of the loop closures i < j of a group, for the lazy search
+   */
+  EdgeOracle loopClosureOracle(const ObservationId& id,
+                               Measurements* measurements) {
+    const bool voting = votesFrameTransform(id);
+    return [this, voting, measurements](size_t i, size_t j) {
+      const gtsam::BetweenFactor<poseT>& factor_i =
+          static_cast<const gtsam::BetweenFactor<poseT>&>(
+              *measurements->factors[i]);
+      const gtsam::BetweenFactor<poseT>& factor_j =
+          static_cast<const gtsam::BetweenFactor<poseT>&>(
+              *measurements->factors[j]);
+      if (voting && !neighborCells(measurements->voting_cells[i],
+                                   measurements->voting_cells[j])) {
+        return false;
+      }
+      double dist = 0.0;
+      const bool consistent = areLoopsConsistent(factor_i, factor_j, &dist);
+      measurements->dist_matrix(i, j) = dist;
+      measurements->dist_matrix(j, i) = dist;
+      return consistent;
+    };
+  }
+
+  /*
+   * consistency of the observations i < j of a landmark, for the lazy search
+   */
+  EdgeOracle landmarkOracle(const gtsam::Key& ldmk_key,
+                            Measurements* measurements) {
+    return [this, ldmk_key, measurements](size_t i, size_t j) {
+      const gtsam::BetweenFactor<poseT>& factor_il =
+          static_cast<const gtsam::BetweenFactor<poseT>&>(
+              *measurements->factors[i]);
+      const gtsam::BetweenFactor<poseT>& factor_jl =
+          static_cast<const gtsam::BetweenFactor<poseT>&>(
+              *measurements->factors[j]);
+      if (factor_il.keys().front() == ldmk_key ||
+          factor_jl.keys().front() == ldmk_key) {
+        log<WARNING>(
+            "Landmark observations should be connected pose -> landmark, "
+            "discarding");
+        return false;
+      }
+      double dist = 0.0;
+      const bool consistent =
+          areLandmarkObservationsConsistent(factor_il, factor_jl, &dist);
+      measurements->dist_matrix(i, j) = dist;
+      measurements->dist_matrix(j, i) = dist;
+      return consistent;
+    };
+  }
+
+  /*
+   * max clique of a group, in lazy mode the unknown entries of the adjacency
+   * are resolved with check when the search needs them
+   */
+  size_t findGroupInliers(Eigen::MatrixXd* adj_matrix,
+                          const EdgeOracle& check,
+                          std::vector<int>* inliers_idx,
+                          MaxCliqueStats* stats) {
+    if (params_.lazy_consistency) {
+      return findMaxCliqueHeuLazy(adj_matrix, check, inliers_idx, stats);
+    }
+    return findMaxCliqueHeu(*adj_matrix, inliers_idx, stats);
+  }
+
+  /*
+   * max clique of a loop closure group. With transform voting, only the
+   * closures around the dominant cell of an inter robot group take part.
+   */
+  size_t findLoopClosureInliers(const ObservationId& id,
+                                Measurements* measurements,
+                                std::vector<int>* inliers_idx,
+                                MaxCliqueStats* stats) {
+    RPGO_TRACE_SCOPE_DETAIL("Pcm max clique", traceDetail(id));
+    const EdgeOracle check = loopClosureOracle(id, measurements);
+    if (!votesFrameTransform(id)) {
+      return findGroupInliers(
+          &measurements->adj_matrix, check, inliers_idx, stats);
+    }
+
+    // one vote per closure: O(n), no pairwise check
+    const size_t num_lc = measurements->factors.size();
+    std::vector<const std::vector<int>*> cells(num_lc);
+    std::vector<std::vector<int>> late_cells;  // no odometry when added
+    late_cells.reserve(num_lc);
+    FlatHashMap<uint64_t, size_t> votes;
+    size_t dominant = num_lc, dominant_votes = 0;
+    for (size_t i = 0; i < num_lc; i++) {
+      cells[i] = &measurements->voting_cells[i];
+      if (cells[i]->empty()) {
+        late_cells.push_back(
+            votingCell(static_cast<const gtsam::BetweenFactor<poseT>&>(
+                *measurements->factors[i])));
+        cells[i] = &late_cells.back();
+      }
+      if (cells[i]->empty()) continue;
+      const size_t num_votes = ++votes[packCell(*cells[i])];
+      if (num_votes > dominant_votes) {
+        dominant = i;
+        dominant_votes = num_votes;
+      }
+    }
+    // closures without a vote (odometry missing) are kept
+    std::vector<size_t> members;
+    for (size_t i = 0; i < num_lc; i++) {
+      if (dominant == num_lc || neighborCells(*cells[i], *cells[dominant])) {
+        members.push_back(i);
+      }
+    }
+    if (members.size() == num_lc) {
+      return findGroupInliers(
+          &measurements->adj_matrix, check, inliers_idx, stats);
+    }
+
+    Eigen::MatrixXd& adj_matrix = measurements->adj_matrix;
+    Eigen::MatrixXd members_adj(members.size(), members.size());
+    for (size_t j = 0; j < members.size(); j++) {
+      for (size_t i = 0; i < members.size(); i++) {
+        members_adj(i, j) = adj_matrix(members[i], members[j]);
+      }
+    }
+    const EdgeOracle members_check = [&check, &members](size_t i, size_t j) {
+      return check(members[i], members[j]);
+    };
+    size_t num_inliers =
+        findGroupInliers(&members_adj, members_check, inliers_idx, stats);
+    if (params_.lazy_consistency) {
+      // keep the entries resolved by the search
+      for (size_t j = 0; j < members.size(); j++) {
+        for (size_t i = 0; i < members.size(); i++) {
+          adj_matrix(members[i], members[j]) = members_adj(i, j);
+        }
+      }
+    }
+    for (size_t k = 0; k < num_inliers; k++) {
+      (*inliers_idx)[k] = members[(*inliers_idx)[k]];
+    }
+    return num_inliers;
+  }
+
+  /*
+   * transform voting applies to inter robot groups
+   */
+  bool votesFrameTransform(const ObservationId& id) const {
+    return params_.transform_voting && id.id1 != id.id2;
+  }
+
+  /*
+   * transform from the frame of the robot with the smaller prefix to the frame
+   * of the other robot implied by an inter robot loop closure and the
+   * odometry of both robots (false if the odometry does not reach the poses)
+   */
+  bool impliedFrameTransform(const gtsam::BetweenFactor<poseT>& lc,
+                             poseT* T_w0_wi) {
+    gtsam::Symbol front = gtsam::Symbol(lc.key1());
+    gtsam::Symbol back = gtsam::Symbol(lc.key2());
+    poseT T_front_back = lc.measured();
+    // Check order and switch if needed
+    if (front.chr() > back.chr()) {
+      std::swap(front, back);
+      T_front_back = T_front_back.inverse();
+    }
+    const auto front_trajectory = odom_trajectories_.find(front.chr());
+    const auto back_trajectory = odom_trajectories_.find(back.chr());
+    if (front_trajectory == odom_trajectories_.end() ||
+        back_trajectory == odom_trajectories_.end()) {
+      return false;
+    }
+    const auto T_w0_front = front_trajectory->second.poses.find(front);
+    const auto T_wi_back = back_trajectory->second.poses.find(back);
+    if (T_w0_front == front_trajectory->second.poses.end() ||
+        T_wi_back == back_trajectory->second.poses.end()) {
+      return false;
+    }
+    *T_w0_wi = T_w0_front->second.pose.compose(T_front_back)
+                   .compose(T_wi_back->second.pose.inverse());
+    return true;
+  }
+
+  /*
+   * cell of the voting grid hit by the frame transform implied by a closure
+   * (rotation then translation, empty if there is no implied transform)
+   */
+  std::vector<int> votingCell(const gtsam::BetweenFactor<poseT>& lc) {
+    poseT T_w0_wi;
+    if (!impliedFrameTransform(lc, &T_w0_wi)) return std::vector<int>();
+    const gtsam::Vector rotation =
+        poseT::Rotation::Logmap(T_w0_wi.rotation());
+    const gtsam::Vector translation = T_w0_wi.translation();
+    std::vector<int> cell;
+    cell.reserve(rotation.size() + translation.size());
+    for (int k = 0; k < rotation.size(); k++) {
+      cell.push_back(static_cast<int>(
+          std::floor(rotation(k) / params_.voting_rot_resolution)));
+    }
+    for (int k = 0; k < translation.size(); k++) {
+      cell.push_back(static_cast<int>(
+          std::floor(translation(k) / params_.voting_trans_resolution)));
+    }
+    return cell;
+  }
+
+  /*
+   * cells touching each other (closures without a cell match everything)
+   */
+  static bool neighborCells(const std::vector<int>& a,
+                            const std::vector<int>& b) {
+    if (a.empty() || b.empty()) return true;
+    for (size_t k = 0; k < a.size(); k++) {
+      if (std::abs(a[k] - b[k]) > 1) return false;
+    }
+    return true;
+  }
+
+  /*
+   * hash key of a cell (10 bits per coordinate, far cells are clamped)
+   */
+  static uint64_t packCell(const std::vector<int>& cell) {
+    uint64_t key = 0;
+    for (const int& coordinate : cell) {
+      const int clamped = std::min(std::max(coordinate + 512, 0), 1023);
+      key = (key << 10) | static_cast<uint64_t>(clamped);
+    }
+    return key;
   }
 
   /* *******************************************************************************
@@ -844,47 +1861,91 @@ class Pcm : public OutlierRemoval {
   void findInliers() {
     if (debug_) log<INFO>("total loop closures registered: %1%") % total_lc_;
     total_good_lc_ = 0;
-    // iterate through loop closures and find inliers
-    std::unordered_map<ObservationId, Measurements>::iterator it =
-        loop_closures_.begin();
-    while (it != loop_closures_.end()) {
-      size_t num_inliers;
+    // the groups are independent: search them in parallel, then apply the
+    // results in order
+    std::vector<FlatHashMap<ObservationId, Measurements>::iterator> groups;
+    for (auto it = loop_closures_.begin(); it != loop_closures_.end(); it++) {
+      groups.push_back(it);
+    }
+    std::vector<std::vector<int>> inliers_idx(groups.size());
+    std::vector<MaxCliqueStats> stats(groups.size());
+    std::vector<size_t> num_inliers(groups.size(), 0);
+    if (loop_consistency_check_) {
+      forEach(
+          groups.size(),
+          [&](size_t k) {
+            // find max clique
+            num_inliers[k] = findLoopClosureInliers(groups[k]->first,
+                                                    &groups[k]->second,
+                                                    &inliers_idx[k],
+                                                    &stats[k]);
+          },
+          1);
+    }
+    for (size_t k = 0; k < groups.size(); k++) {
+      saveLoopClosureGroup(groups[k]->first, true);
+      Measurements& measurements = groups[k]->second;
       if (loop_consistency_check_) {
-        std::vector<int> inliers_idx;
-        it->second.consistent_factors = gtsam::NonlinearFactorGraph();  // reset
-        // find max clique
-        num_inliers = findMaxCliqueHeu(it->second.adj_matrix, &inliers_idx);
+        measurements.consistent_factors = gtsam::NonlinearFactorGraph();
+        lc_clique_stats_[groups[k]->first].add(stats[k]);
         // update inliers, or consistent factors, according to max clique result
-        for (size_t i = 0; i < num_inliers; i++) {
-          it->second.consistent_factors.add(it->second.factors[inliers_idx[i]]);
+        for (size_t i = 0; i < num_inliers[k]; i++) {
+          measurements.consistent_factors.add(
+              measurements.factors[inliers_idx[k][i]]);
         }
       } else {
-        it->second.consistent_factors = it->second.factors;
-        num_inliers = it->second.factors.size();
+        measurements.consistent_factors = measurements.factors;
+        num_inliers[k] = measurements.factors.size();
       }
-      it++;
-      total_good_lc_ = total_good_lc_ + num_inliers;
+      total_good_lc_ = total_good_lc_ + num_inliers[k] +
+                       measurements.frozen_inliers.size();
     }
 
-    // iterate through landmarks and find inliers
-    std::unordered_map<gtsam::Key, Measurements>::iterator it_ldmrk =
-        landmarks_.begin();
-    while (it_ldmrk != landmarks_.end()) {
-      std::vector<int> inliers_idx;
-      it_ldmrk->second.consistent_factors =
-          gtsam::NonlinearFactorGraph();  // reset
-      // find max clique
-      size_t num_inliers =
-          findMaxCliqueHeu(it_ldmrk->second.adj_matrix, &inliers_idx);
+    findLandmarkInliers();
+    if (debug_) log<INFO>("number of inliers: %1%") % total_good_lc_;
+  }
+
+  /* *******************************************************************************
+   */
+  /*
+   * max clique search of every landmark (in parallel), adds the inliers to
+   * total_good_lc_
+   */
+  void findLandmarkInliers() {
+    std::vector<FlatHashMap<gtsam::Key, Measurements>::iterator> landmarks;
+    for (auto it = landmarks_.begin(); it != landmarks_.end(); it++) {
+      landmarks.push_back(it);
+    }
+    std::vector<std::vector<int>> inliers_idx(landmarks.size());
+    std::vector<MaxCliqueStats> stats(landmarks.size());
+    std::vector<size_t> num_inliers(landmarks.size(), 0);
+    forEach(
+        landmarks.size(),
+        [&](size_t k) {
+          const gtsam::Key landmark_key = landmarks[k]->first;
+          RPGO_TRACE_SCOPE_DETAIL("Pcm landmark max clique",
+                                  std::string(gtsam::Symbol(landmark_key)));
+          // find max clique
+          num_inliers[k] = findGroupInliers(
+              &landmarks[k]->second.adj_matrix,
+              landmarkOracle(landmark_key, &landmarks[k]->second),
+              &inliers_idx[k],
+              &stats[k]);
+        },
+        kMinLandmarksPerTask);
+    for (size_t k = 0; k < landmarks.size(); k++) {
+      saveLandmarkGroup(landmarks[k]->first, true);
+      Measurements& measurements = landmarks[k]->second;
+      measurements.consistent_factors = gtsam::NonlinearFactorGraph();
+      landmark_clique_stats_.add(stats[k]);
       // update inliers, or consistent factors, according to max clique result
-      for (size_t i = 0; i < num_inliers; i++) {
-        it_ldmrk->second.consistent_factors.add(
-            it_ldmrk->second.factors[inliers_idx[i]]);
+      for (size_t i = 0; i < num_inliers[k]; i++) {
+        measurements.consistent_factors.add(
+            measurements.factors[inliers_idx[k][i]]);
       }
-      it_ldmrk++;
-      total_good_lc_ = total_good_lc_ + num_inliers;
+      total_good_lc_ = total_good_lc_ + num_inliers[k] +
+                       measurements.frozen_inliers.size();
     }
-    if (debug_) log<INFO>("number of inliers: %1%") % total_good_lc_;
   }
 
   /* *******************************************************************************
@@ -893,15 +1954,17 @@ class Pcm : public OutlierRemoval {
    * TODO Incremental maxclique
    */
   void findInliersIncremental(
-      const std::unordered_map<ObservationId, size_t>& num_new_loopclosures) {
+      const FlatHashMap<ObservationId, size_t>& num_new_loopclosures) {
     if (debug_) log<INFO>("total loop closures registered: %1%") % total_lc_;
     total_good_lc_ = 0;
     // iterate through loop closures and find inliers
-    std::unordered_map<ObservationId, size_t>::const_iterator new_lc_it =
+    FlatHashMap<ObservationId, size_t>::const_iterator new_lc_it =
         num_new_loopclosures.begin();
     while (new_lc_it != num_new_loopclosures.end()) {
       ObservationId robot_pair = new_lc_it->first;
+      RPGO_TRACE_SCOPE_DETAIL("Pcm max clique", traceDetail(robot_pair));
       std::vector<int> inliers_idx;
+      MaxCliqueStats stats;
       size_t prev_maxclique_size =
           loop_closures_[robot_pair].consistent_factors.size();
       // find max clique incrementally
@@ -909,11 +1972,14 @@ class Pcm : public OutlierRemoval {
           findMaxCliqueHeuIncremental(loop_closures_[robot_pair].adj_matrix,
                                       new_lc_it->second,
                                       prev_maxclique_size,
-                                      &inliers_idx);
+                                      &inliers_idx,
+                                      &stats);
+      lc_clique_stats_[robot_pair].add(stats);
       // update inliers, or consistent factors, according to max clique result
       // num_inliers will be zero if the previous inlier set should not be
       // changed
       if (num_inliers > 0) {
+        saveLoopClosureGroup(robot_pair, true);
         loop_closures_[robot_pair].consistent_factors =
             gtsam::NonlinearFactorGraph();  // reset
         for (size_t i = 0; i < num_inliers; i++) {
@@ -928,30 +1994,110 @@ class Pcm : public OutlierRemoval {
     }
 
     // update total_good_lc_
-    for (auto robot_pair_lc : loop_closures_) {
-      total_good_lc_ =
-          total_good_lc_ + robot_pair_lc.second.consistent_factors.size();
+    for (const auto& robot_pair_lc : loop_closures_) {
+      total_good_lc_ = total_good_lc_ +
+                       robot_pair_lc.second.consistent_factors.size() +
+                       robot_pair_lc.second.frozen_inliers.size();
     }
 
-    // iterate through landmarks and find inliers
-    std::unordered_map<gtsam::Key, Measurements>::iterator it_ldmrk =
-        landmarks_.begin();
-    while (it_ldmrk != landmarks_.end()) {
-      std::vector<int> inliers_idx;
-      it_ldmrk->second.consistent_factors =
-          gtsam::NonlinearFactorGraph();  // reset
-      // find max clique
-      size_t num_inliers =
-          findMaxCliqueHeu(it_ldmrk->second.adj_matrix, &inliers_idx);
-      // update inliers, or consistent factors, according to max clique result
-      for (size_t i = 0; i < num_inliers; i++) {
-        it_ldmrk->second.consistent_factors.add(
-            it_ldmrk->second.factors[inliers_idx[i]]);
+    findLandmarkInliers();
+    if (debug_) log<INFO>("number of inliers: %1%") % total_good_lc_;
+  }
+
+  /* *******************************************************************************
+   */
+  /*
+   * Bound the active measurements of every group (PcmParams::window_size).
+   * Run after the max clique so that evicted measurements keep the inlier
+   * status that was just decided.
+   */
+  void enforceGroupWindows() {
+    if (params_.window_policy == PcmWindowPolicy::NONE ||
+        params_.window_size == 0)
+      return;
+    for (auto& entry : loop_closures_) {
+      if (entry.second.factors.size() > params_.window_size) {
+        saveLoopClosureGroup(entry.first);
       }
-      it_ldmrk++;
-      total_good_lc_ = total_good_lc_ + num_inliers;
+      enforceGroupWindow(&entry.second);
+    }
+    for (auto& entry : landmarks_) {
+      if (entry.second.factors.size() > params_.window_size) {
+        saveLandmarkGroup(entry.first);
+      }
+      enforceGroupWindow(&entry.second);
     }
-    if (debug_) log<INFO>("number of inliers: %1%") % total_good_lc_;
+  }
+
+  void enforceGroupWindow(Measurements* measurements) {
+    const size_t window = params_.window_size;
+    const size_t num_active = measurements->factors.size();
+    if (num_active <= window) return;
+    if (static_cast<size_t>(measurements->adj_matrix.rows()) != num_active) {
+      log<WARNING>("Pcm group adjacency out of sync, not applying window");
+      return;
+    }
+
+    std::vector<bool> evict(num_active, false);
+    if (params_.window_policy == PcmWindowPolicy::SLIDING) {
+      for (size_t i = 0; i < num_active - window; i++) evict[i] = true;
+    } else {
+      // reservoir sampling (algorithm R): the active measurements stay a
+      // uniform sample of all the measurements seen in this group
+      std::vector<size_t> reservoir(window);
+      std::iota(reservoir.begin(), reservoir.end(), 0);
+      for (size_t i = window; i < num_active; i++) {
+        const size_t num_seen = measurements->num_evicted + i + 1;
+        std::uniform_int_distribution<size_t> pick(0, num_seen - 1);
+        const size_t r = pick(window_rng_);
+        if (r < window) {
+          evict[reservoir[r]] = true;
+          reservoir[r] = i;
+        } else {
+          evict[i] = true;
+        }
+      }
+    }
+
+    std::unordered_set<const gtsam::NonlinearFactor*> inliers;
+    for (const auto& factor : measurements->consistent_factors)
+      inliers.insert(factor.get());
+
+    std::vector<size_t> keep;
+    keep.reserve(window);
+    gtsam::NonlinearFactorGraph active, consistent;
+    for (size_t i = 0; i < num_active; i++) {
+      const gtsam::NonlinearFactor::shared_ptr& factor =
+          measurements->factors[i];
+      const bool inlier = inliers.count(factor.get()) > 0;
+      if (evict[i]) {
+        if (inlier) measurements->frozen_inliers.add(factor);
+        measurements->num_evicted++;
+      } else {
+        keep.push_back(i);
+        active.add(factor);
+        if (inlier) consistent.add(factor);
+      }
+    }
+
+    Eigen::MatrixXd adj_matrix(keep.size(), keep.size());
+    Eigen::MatrixXd dist_matrix(keep.size(), keep.size());
+    for (size_t j = 0; j < keep.size(); j++) {
+      for (size_t i = 0; i < keep.size(); i++) {
+        adj_matrix(i, j) = measurements->adj_matrix(keep[i], keep[j]);
+        dist_matrix(i, j) = measurements->dist_matrix(keep[i], keep[j]);
+      }
+    }
+    if (measurements->voting_cells.size() == num_active) {
+      for (size_t i = 0; i < keep.size(); i++) {
+        measurements->voting_cells[i].swap(measurements->voting_cells[keep[i]]);
+      }
+      measurements->voting_cells.resize(keep.size());
+    }
+    measurements->factors = active;
+    measurements->consistent_factors = consistent;
+    measurements->adj_matrix.swap(adj_matrix);
+    measurements->dist_matrix.swap(dist_matrix);
   }
 
   /* *******************************************************************************
@@ -966,7 +2112,7 @@ class Pcm : public OutlierRemoval {
     // important for gnc that we add the "special" non lc no odom factors second
     output_nfg.add(nfg_special_);
     // add the good loop closures
-    std::unordered_map<ObservationId, Measurements>::iterator it =
+    FlatHashMap<ObservationId, Measurements>::iterator it =
         loop_closures_.begin();
     while (it != loop_closures_.end()) {
       if (std::find(ignored_prefixes_.begin(),
@@ -974,18 +2120,24 @@ class Pcm : public OutlierRemoval {
                     it->first.id1) == ignored_prefixes_.end() &&
           std::find(ignored_prefixes_.begin(),
                     ignored_prefixes_.end(),
-                    it->first.id2) == ignored_prefixes_.end())
+                    it->first.id2) == ignored_prefixes_.end()) {
+        output_nfg.add(it->second.frozen_inliers);
         output_nfg.add(it->second.consistent_factors);
+      }
       it++;
     }
     // add the good loop closures associated with landmarks
-    std::unordered_map<gtsam::Key, Measurements>::iterator it_ldmrk =
+    FlatHashMap<gtsam::Key, Measurements>::iterator it_ldmrk =
         landmarks_.begin();
     while (it_ldmrk != landmarks_.end()) {
+      output_nfg.add(it_ldmrk->second.frozen_inliers);
       output_nfg.add(it_ldmrk->second.consistent_factors);
       it_ldmrk++;
     }
     // still need to update the class overall factorgraph
+    output_size_ = output_nfg.size();
+    output_kept_ = 0;
+    output_layout_dirty_ = false;
     return output_nfg;
   }
 
@@ -995,6 +2147,7 @@ class Pcm : public OutlierRemoval {
    */
   gtsam::Values multirobotValueInitialization(
       const gtsam::Values& input_values) {
+    RPGO_TRACE_SCOPE("Pcm multirobot alignment");
     gtsam::Values initialized_values = input_values;
     if (robot_order_.size() == 0) {
       log<INFO>("No robot poses received. ");
@@ -1004,6 +2157,8 @@ class Pcm : public OutlierRemoval {
     std::sort(robot_order_.begin(), robot_order_.end());
     // Do not transform first robot
     initialized_values.update(getRobotOdomValues(robot_order_[0]));
+    frame_transforms_.clear();
+    frame_transforms_[robot_order_[0]] = poseT();
 
     // Start estimating the frame-to-frame transforms between robots
     for (size_t i = 1; i < robot_order_.size(); i++) {
@@ -1013,42 +2168,30 @@ class Pcm : public OutlierRemoval {
       const char& ri = robot_order_[i];
       ObservationId obs_id(r0, ri);
       try {
-        gtsam::NonlinearFactorGraph lc_factors =
-            loop_closures_.at(obs_id).consistent_factors;
+        const Measurements& measurements = loop_closures_.at(obs_id);
+        gtsam::NonlinearFactorGraph lc_factors = measurements.frozen_inliers;
+        lc_factors.add(measurements.consistent_factors);
         // Create list of frame-to-fram transforms
         std::vector<poseT> T_w0_wi_measured;
-        for (auto factor : lc_factors) {
+        for (const auto& factor : lc_factors) {
           assert(factor != nullptr);
           assert(
               boost::dynamic_pointer_cast<gtsam::BetweenFactor<poseT>>(factor));
-          gtsam::BetweenFactor<poseT> lc =
-              *boost::dynamic_pointer_cast<gtsam::BetweenFactor<poseT>>(factor);
-
-          gtsam::Symbol front = gtsam::Symbol(lc.key1());
-          gtsam::Symbol back = gtsam::Symbol(lc.key2());
-          poseT T_front_back = lc.measured();
-
-          // Check order and switch if needed
-          if (front.chr() != r0) {
-            gtsam::Symbol front_temp = front;
-            front = back;
-            back = front_temp;
-            T_front_back = T_front_back.inverse();
-          }
+          const gtsam::BetweenFactor<poseT>& lc =
+              static_cast<const gtsam::BetweenFactor<poseT>&>(*factor);
 
-          poseT T_w0_front, T_wi_back, T_w0_wi;
-          // Get T_w1_fron and T_w2_back from stored trajectories
-          T_w0_front = odom_trajectories_[r0].poses.at(front).pose;
-          T_wi_back = odom_trajectories_[ri].poses.at(back).pose;
-
-          T_w0_wi =
-              T_w0_front.compose(T_front_back).compose(T_wi_back.inverse());
+          // r0 has the smallest prefix (robot_order_ is sorted)
+          poseT T_w0_wi;
+          if (!impliedFrameTransform(lc, &T_w0_wi)) {
+            throw std::out_of_range("loop closure pose not in the odometry");
+          }
           T_w0_wi_measured.push_back(T_w0_wi);
         }
         // Pose averaging to find transform
         poseT T_w0_wi_est = gncRobustPoseAveraging(T_w0_wi_measured);
         initialized_values.update(
             getRobotOdomValues(robot_order_[i], T_w0_wi_est));
+        frame_transforms_[robot_order_[i]] = T_w0_wi_est;
       } catch (std::out_of_range e) {
         log<WARNING>(
             "No inter-robot loop closures between robots with prefix %1% and "
@@ -1117,6 +2260,7 @@ class Pcm : public OutlierRemoval {
 
   /*
    * Save adjacency matrix to ObservationId_adj_matrix.txt
+   * (in lazy mode -1 marks the pairs that were never checked)
    */
   void saveAdjacencyMatrix(const std::string& folder_path) {
     for (auto measurement : loop_closures_) {
@@ -1133,6 +2277,58 @@ class Pcm : public OutlierRemoval {
     }
   }
 
+  /*
+   * Save max clique statistics per robot pair to clique_stats.csv
+   */
+  void saveCliqueStats(const std::string& folder_path) {
+    std::string filename = folder_path + "/clique_stats.csv";
+    std::ofstream outfile;
+    outfile.open(filename);
+    outfile << "pair,num_searches,total_time_ms,max_time_ms,"
+               "total_nodes_expanded,vertices,edges,density,pruned1,pruned2,"
+               "pruned3,pruned5,not_computed,nodes_expanded,clique_size,"
+               "time_ms,num_checks,total_checks"
+            << std::endl;
+    for (const auto& entry : lc_clique_stats_) {
+      outfile << entry.first.id1 << "-" << entry.first.id2 << ",";
+      writeCliqueStats(entry.second, &outfile);
+    }
+    if (landmark_clique_stats_.num_searches > 0) {
+      outfile << "landmarks,";
+      writeCliqueStats(landmark_clique_stats_, &outfile);
+    }
+    outfile.close();
+  }
+
+  /*
+   * Save prefilter statistics to prefilter_stats.csv
+   */
+  void savePrefilterStats(const std::string& folder_path) {
+    std::string filename = folder_path + "/prefilter_stats.csv";
+    std::ofstream outfile;
+    outfile.open(filename);
+    outfile << "stage,checked,rejected,rejection_rate,time_ms" << std::endl;
+    for (const PrefilterStats& stats : prefilter_stats_) {
+      outfile << prefilterName(stats.stage) << "," << stats.num_checked << ","
+              << stats.num_rejected << "," << stats.rejectionRate() << ","
+              << stats.time_ms << std::endl;
+    }
+    outfile.close();
+  }
+
+  void writeCliqueStats(const CliqueStatsSummary& summary,
+                        std::ofstream* outfile) {
+    const MaxCliqueStats& last = summary.last;
+    *outfile << summary.num_searches << "," << summary.total_time_ms << ","
+             << summary.max_time_ms << "," << summary.total_nodes_expanded
+             << "," << last.num_vertices << "," << last.num_edges << ","
+             << last.density << "," << last.pruned1 << "," << last.pruned2
+             << "," << last.pruned3 << "," << last.pruned5 << ","
+             << last.not_computed << "," << last.nodes_expanded << ","
+             << last.clique_size << "," << last.time_ms << ","
+             << last.num_checks << "," << summary.total_checks << std::endl;
+  }
+
   /*
    * Log spin status (timing, number of loop closures, number of inliers)
    */
@@ -0,0 +1,113 @@
+/*
+Monotonic arena for per-spin scratch memory
+Allocations are bump-pointer into large blocks and are never freed
+individually; the whole arena is released at once with reset(). After a few
+spins the arena settles on a single block large enough for a spin, so the
+outlier rejection loop stops hitting the general purpose allocator.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace KimeraRPGO {
+
+/*! \brief Bump allocator backed by a list of blocks
+ * - allocate: returns aligned memory from the current block, chaining a new
+ *   (larger) block when it does not fit
+ * - reset: invalidates every allocation; if more than one block was needed,
+ *   they are coalesced into one block of the combined size
+ */
+class MonotonicArena {
+ public:
+  explicit MonotonicArena(size_t initial_block_size = 64 * 1024);
+  MonotonicArena(const MonotonicArena&) = delete;
+  MonotonicArena& operator=(const MonotonicArena&) = delete;
+  ~MonotonicArena() = default;
+
+  void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+  void reset();
+
+  /*! \brief bytes handed out since the last reset (including padding)
+   */
+  inline size_t bytesUsed() const { return bytes_used_; }
+
+  /*! \brief total size of the blocks currently owned by the arena
+   */
+  inline size_t capacity() const { return capacity_; }
+
+  inline size_t numBlocks() const { return blocks_.size(); }
+
+ private:
+  struct Block {
+    std::unique_ptr<char[]> data;
+    size_t size;
+  };
+
+  void addBlock(size_t min_size);
+
+  std::vector<Block> blocks_;
+  size_t initial_block_size_;
+  size_t offset_;  // in the last block
+  size_t bytes_used_;
+  size_t capacity_;
+};
+
+/*! \brief Standard allocator drawing from a MonotonicArena
+ * deallocate is a no-op, memory comes back when the arena is reset.
+ */
+template <class T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(MonotonicArena* arena) : arena_(arena) {}
+
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U>& other)  // NOLINT
+      : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T*, size_t) {}
+
+  inline MonotonicArena* arena() const { return arena_; }
+
+ private:
+  MonotonicArena* arena_;
+};
+
+template <class T, class U>
+inline bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <class T, class U>
+inline bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+/*! \brief Resets the arena when going out of scope
+ * Declare it before any container using the arena, so that those are
+ * destroyed first.
+ */
+class ScopedArenaReset {
+ public:
+  explicit ScopedArenaReset(MonotonicArena* arena) : arena_(arena) {}
+  ScopedArenaReset(const ScopedArenaReset&) = delete;
+  ScopedArenaReset& operator=(const ScopedArenaReset&) = delete;
+  ~ScopedArenaReset() { arena_->reset(); }
+
+ private:
+  MonotonicArena* arena_;
+};
+
+}  // namespace KimeraRPGO
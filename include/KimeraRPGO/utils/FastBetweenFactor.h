@@ -0,0 +1,119 @@
+/*
+Relative pose factor with closed form Jacobians
+Replaces gtsam::BetweenFactor<Pose2/Pose3> (and the
+SLOW_BUT_CORRECT_BETWEENFACTOR macro) in the graphs handled by the solver
+author: Yun Chang
+*/
+
+#pragma once
+
+#include <gtsam/geometry/Pose2.h>
+#include <gtsam/geometry/Pose3.h>
+#include <gtsam/nonlinear/NonlinearFactorGraph.h>
+#include <gtsam/slam/BetweenFactor.h>
+
+#include "KimeraRPGO/utils/NoiseModelCache.h"
+
+namespace KimeraRPGO {
+
+/*! \brief Between factor on Pose2 / Pose3 with analytic Jacobians
+ * The error is e = Logmap(measured^-1 * p1^-1 * p2), the same error that
+ * BetweenFactor computes with SLOW_BUT_CORRECT_BETWEENFACTOR, but the
+ * Jacobians are evaluated in closed form with fixed size matrices:
+ *   H1 = -Jr^-1(e) * Ad(hx^-1), H2 = Jr^-1(e), with hx = p1^-1 * p2
+ * where Jr^-1 is the inverse right Jacobian (LogmapDerivative). It derives
+ * from gtsam::BetweenFactor so everything that casts to BetweenFactor (PCM,
+ * writeG2o, ...) handles it unchanged.
+ */
+template <class T>
+class FastBetweenFactor : public gtsam::BetweenFactor<T> {
+ public:
+  typedef gtsam::BetweenFactor<T> Base;
+  typedef FastBetweenFactor<T> This;
+  typedef boost::shared_ptr<This> shared_ptr;
+  typedef Eigen::Matrix<double, T::dimension, T::dimension> Jacobian;
+  typedef Eigen::Matrix<double, T::dimension, 1> TangentVector;
+
+  FastBetweenFactor() {}
+
+  FastBetweenFactor(gtsam::Key key1,
+                    gtsam::Key key2,
+                    const T& measured,
+                    const gtsam::SharedNoiseModel& model)
+      : Base(key1, key2, measured, model) {}
+
+  explicit FastBetweenFactor(const Base& factor) : Base(factor) {}
+
+  ~FastBetweenFactor() override {}
+
+  gtsam::NonlinearFactor::shared_ptr clone() const override {
+    return boost::static_pointer_cast<gtsam::NonlinearFactor>(
+        gtsam::NonlinearFactor::shared_ptr(new This(*this)));
+  }
+
+  gtsam::Vector evaluateError(
+      const T& p1,
+      const T& p2,
+      boost::optional<gtsam::Matrix&> H1 = boost::none,
+      boost::optional<gtsam::Matrix&> H2 = boost::none) const override {
+    const T hx = p1.between(p2);
+    const T error_pose = this->measured().between(hx);
+    const TangentVector error = T::Logmap(error_pose);
+    if (H1 || H2) {
+      const Jacobian Jr_inv = T::LogmapDerivative(error_pose);
+      if (H1) {
+        const Jacobian Ad_hx_inv = hx.inverse().AdjointMap();
+        *H1 = -Jr_inv * Ad_hx_inv;
+      }
+      if (H2) *H2 = Jr_inv;
+    }
+    return error;
+  }
+};
+
+typedef FastBetweenFactor<gtsam::Pose2> FastBetweenFactor2D;
+typedef FastBetweenFactor<gtsam::Pose3> FastBetweenFactor3D;
+
+/*! \brief Replace the gtsam BetweenFactor<T> in place by FastBetweenFactor<T>
+ * with the interned noise model if noise_models is given. Other factors (and
+ * factors already converted, with the interned model) are left as they are.
+ * Returns false if the factor is not a BetweenFactor<T>.
+ */
+template <class T>
+inline bool convertToFastBetweenFactor(
+    gtsam::NonlinearFactor::shared_ptr* factor,
+    NoiseModelCache* noise_models = nullptr) {
+  const gtsam::BetweenFactor<T>* between =
+      dynamic_cast<const gtsam::BetweenFactor<T>*>(factor->get());
+  if (!between) return false;
+  const gtsam::SharedNoiseModel model =
+      noise_models ? noise_models->intern(between->noiseModel())
+                   : between->noiseModel();
+  if (dynamic_cast<const FastBetweenFactor<T>*>(between) &&
+      model == between->noiseModel()) {
+    return true;
+  }
+  *factor = boost::make_shared<FastBetweenFactor<T>>(
+      between->key1(), between->key2(), between->measured(), model);
+  return true;
+}
+
+/*! \brief Copy of the graph with every Pose2 / Pose3 BetweenFactor replaced by
+ * the corresponding FastBetweenFactor (the other factors are shared). With
+ * noise_models, the between factors share the interned noise models.
+ */
+inline gtsam::NonlinearFactorGraph toFastBetweenFactors(
+    const gtsam::NonlinearFactorGraph& nfg,
+    NoiseModelCache* noise_models = nullptr) {
+  gtsam::NonlinearFactorGraph converted;
+  converted.reserve(nfg.size());
+  for (gtsam::NonlinearFactor::shared_ptr factor : nfg) {
+    if (!convertToFastBetweenFactor<gtsam::Pose3>(&factor, noise_models)) {
+      convertToFastBetweenFactor<gtsam::Pose2>(&factor, noise_models);
+    }
+    converted.push_back(factor);
+  }
+  return converted;
+}
+
+}  // namespace KimeraRPGO
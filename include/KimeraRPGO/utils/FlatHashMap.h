@@ -0,0 +1,205 @@
+/*
+Flat open-addressing hash map used for the Pcm registries
+Entries are stored contiguously (in insertion order) and looked up through a
+linear-probing table of indices, so iteration is a plain vector walk and
+lookups touch at most a couple of cache lines.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace KimeraRPGO {
+
+/*! \brief Finalizer of MurmurHash3 (64 bit).
+ * std::hash is the identity for integral types in libstdc++, which clusters
+ * badly with power-of-two tables (gtsam::Symbol keep the index in the low
+ * bits and the robot prefix in the top byte), so every hash goes through
+ * this mixer before it is masked.
+ */
+inline uint64_t mixHash(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+/*! \brief Open addressing hash map with contiguous storage.
+ * - Entries live in a std::vector<std::pair<Key, Value>> in insertion order
+ *   (erase swaps the last entry into the hole).
+ * - The probe table only stores 32 bit indices into the entry vector.
+ * Like std::vector, any insertion or erase invalidates iterators and
+ * references to values.
+ */
+template <class Key,
+          class Value,
+          class Hash = std::hash<Key>,
+          class KeyEqual = std::equal_to<Key>>
+class FlatHashMap {
+ public:
+  typedef std::pair<Key, Value> value_type;
+  typedef typename std::vector<value_type>::iterator iterator;
+  typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+  FlatHashMap() = default;
+
+  inline size_t size() const { return entries_.size(); }
+  inline bool empty() const { return entries_.empty(); }
+
+  inline iterator begin() { return entries_.begin(); }
+  inline iterator end() { return entries_.end(); }
+  inline const_iterator begin() const { return entries_.begin(); }
+  inline const_iterator end() const { return entries_.end(); }
+
+  void clear() {
+    entries_.clear();
+    slots_.clear();
+    mask_ = 0;
+  }
+
+  /*! \brief Make room for n entries without rehashing
+   */
+  void reserve(size_t n) {
+    entries_.reserve(n);
+    if (2 * n > slots_.size()) rehash(2 * n);
+  }
+
+  iterator find(const Key& key) {
+    size_t slot;
+    if (!findSlot(key, &slot)) return entries_.end();
+    return entries_.begin() + slots_[slot];
+  }
+
+  const_iterator find(const Key& key) const {
+    size_t slot;
+    if (!findSlot(key, &slot)) return entries_.end();
+    return entries_.begin() + slots_[slot];
+  }
+
+  inline size_t count(const Key& key) const {
+    size_t slot;
+    return findSlot(key, &slot) ? 1 : 0;
+  }
+
+  Value& at(const Key& key) {
+    size_t slot;
+    if (!findSlot(key, &slot)) throw std::out_of_range("FlatHashMap::at");
+    return entries_[slots_[slot]].second;
+  }
+
+  const Value& at(const Key& key) const {
+    size_t slot;
+    if (!findSlot(key, &slot)) throw std::out_of_range("FlatHashMap::at");
+    return entries_[slots_[slot]].second;
+  }
+
+  Value& operator[](const Key& key) {
+    size_t slot;
+    if (findSlot(key, &slot)) return entries_[slots_[slot]].second;
+    return insert(value_type(key, Value())).first->second;
+  }
+
+  std::pair<iterator, bool> insert(const value_type& entry) {
+    size_t slot;
+    if (findSlot(entry.first, &slot)) {
+      return std::make_pair(entries_.begin() + slots_[slot], false);
+    }
+    if (2 * (entries_.size() + 1) > slots_.size()) {
+      rehash(2 * (entries_.size() + 1));
+      findSlot(entry.first, &slot);
+    }
+    slots_[slot] = static_cast<uint32_t>(entries_.size());
+    entries_.push_back(entry);
+    return std::make_pair(std::prev(entries_.end()), true);
+  }
+
+  /*! \brief Remove key, returns number of removed entries (0 or 1)
+   * Uses backward shift deletion, so no tombstones accumulate.
+   */
+  size_t erase(const Key& key) {
+    size_t slot;
+    if (!findSlot(key, &slot)) return 0;
+    const uint32_t removed = slots_[slot];
+
+    // close the gap in the probe sequence
+    size_t hole = slot;
+    size_t next = (hole + 1) & mask_;
+    while (slots_[next] != kEmpty) {
+      size_t home = homeSlot(entries_[slots_[next]].first);
+      if (((next - home) & mask_) >= ((next - hole) & mask_)) {
+        slots_[hole] = slots_[next];
+        hole = next;
+      }
+      next = (next + 1) & mask_;
+    }
+    slots_[hole] = kEmpty;
+
+    // keep entries dense: move the last entry into the removed position
+    const uint32_t last = static_cast<uint32_t>(entries_.size() - 1);
+    if (removed != last) {
+      size_t last_slot;
+      findSlot(entries_[last].first, &last_slot);
+      slots_[last_slot] = removed;
+      entries_[removed] = std::move(entries_[last]);
+    }
+    entries_.pop_back();
+    return 1;
+  }
+
+ private:
+  static constexpr uint32_t kEmpty = 0xFFFFFFFF;
+
+  inline size_t homeSlot(const Key& key) const {
+    return static_cast<size_t>(mixHash(hasher_(key))) & mask_;
+  }
+
+  // Returns true if key found (slot is its position), otherwise slot is the
+  // empty position where key would be inserted
+  bool findSlot(const Key& key, size_t* slot) const {
+    if (slots_.empty()) {
+      *slot = 0;
+      return false;
+    }
+    size_t s = homeSlot(key);
+    while (slots_[s] != kEmpty) {
+      if (key_equal_(entries_[slots_[s]].first, key)) {
+        *slot = s;
+        return true;
+      }
+      s = (s + 1) & mask_;
+    }
+    *slot = s;
+    return false;
+  }
+
+  void rehash(size_t min_slots) {
+    size_t num_slots = 8;
+    while (num_slots < min_slots) num_slots <<= 1;
+    slots_.assign(num_slots, kEmpty);
+    mask_ = num_slots - 1;
+    for (size_t i = 0; i < entries_.size(); i++) {
+      size_t s = homeSlot(entries_[i].first);
+      while (slots_[s] != kEmpty) s = (s + 1) & mask_;
+      slots_[s] = static_cast<uint32_t>(i);
+    }
+  }
+
+  std::vector<value_type> entries_;
+  std::vector<uint32_t> slots_;
+  size_t mask_ = 0;
+  Hash hasher_;
+  KeyEqual key_equal_;
+};
+
+template <class Key, class Value, class Hash, class KeyEqual>
+constexpr uint32_t FlatHashMap<Key, Value, Hash, KeyEqual>::kEmpty;
+
+}  // namespace KimeraRPGO
@@ -2,9 +2,6 @@
 
 #pragma once
 
-// enables correct operations of GTSAM (correct Jacobians)
-#define SLOW_BUT_CORRECT_BETWEENFACTOR
-
 #include <gtsam/geometry/Pose3.h>
 #include <gtsam/geometry/Rot3.h>
 #include <gtsam/linear/NoiseModel.h>
@@ -47,25 +44,36 @@ static const size_t getDim() {
   return sample_object.dimension;
 }
 
+/** \brief covariance of the (Gaussian) noise model of a factor */
+inline gtsam::Matrix factorCovariance(const gtsam::NoiseModelFactor& factor) {
+  return boost::dynamic_pointer_cast<gtsam::noiseModel::Gaussian>(
+             factor.noiseModel())
+      ->covariance();
+}
+
 /** \struct PoseWithCovariance
  *  \brief Structure to store a pose and its covariance data
  *  \currently supports gtsam::Pose2 and gtsam::Pose3
  */
 template <class T>
 struct PoseWithCovariance {
+  // Fixed size so that composing poses in the pairwise checks does not touch
+  // the heap. DontAlign: these live in std::map / std::vector nodes, which
+  // do not honour the alignment of vectorizable Eigen members before C++17.
+  typedef Eigen::Matrix<double, T::dimension, T::dimension, Eigen::DontAlign>
+      CovarianceMatrix;
+  typedef Eigen::Matrix<double, T::dimension, T::dimension> Jacobian;
+
   /* variables ------------------------------------------------ */
   /* ---------------------------------------------------------- */
   T pose;  // ex. gtsam::Pose3
-  gtsam::Matrix covariance_matrix;
+  CovarianceMatrix covariance_matrix;
   bool rotation_info = true;
 
   /* default constructor -------------------------------------- */
   PoseWithCovariance() {
     pose = T();
-    const size_t dim = getDim<T>();
-    gtsam::Matrix covar =
-        Eigen::MatrixXd::Zero(dim, dim);  // initialize as zero
-    covariance_matrix = covar;
+    covariance_matrix.setZero();  // initialize as zero
   }
 
   /* basic constructor ---------------------------------------- */
@@ -76,47 +84,41 @@ struct PoseWithCovariance {
 
   /* construct from gtsam prior factor ------------------------ */
   explicit PoseWithCovariance(const gtsam::PriorFactor<T>& prior_factor) {
-    T value = prior_factor.prior();
-    const size_t dim = getDim<T>();
-    gtsam::Matrix covar =
-        Eigen::MatrixXd::Zero(dim, dim);  // initialize as zero
-
-    pose = value;
-    covariance_matrix = covar;
+    pose = prior_factor.prior();
+    covariance_matrix.setZero();  // initialize as zero
   }
 
   /* construct from gtsam between factor  --------------------- */
-  explicit PoseWithCovariance(const gtsam::BetweenFactor<T>& between_factor) {
+  explicit PoseWithCovariance(const gtsam::BetweenFactor<T>& between_factor)
+      : PoseWithCovariance(between_factor, factorCovariance(between_factor)) {}
+
+  /* construct from gtsam between factor and its covariance ---- */
+  PoseWithCovariance(const gtsam::BetweenFactor<T>& between_factor,
+                     const gtsam::Matrix& covar) {
     pose = between_factor.measured();
-    gtsam::Matrix covar =
-        boost::dynamic_pointer_cast<gtsam::noiseModel::Gaussian>(
-            between_factor.noiseModel())
-            ->covariance();
 
     // prevent propagation of nan values in the edge case
-    const int dim = getDim<T>();
     const int r_dim = getRotationDim<T>();
     const int t_dim = getTranslationDim<T>();
     rotation_info = true;
     if (std::isnan(covar.block(0, 0, r_dim, r_dim).trace())) {
       rotation_info = false;
       // only keep translation part
-      Eigen::MatrixXd temp = Eigen::MatrixXd::Zero(
-          dim, dim);  // TODO(Yun): I wonder if this can cause issues: ...
-      // ... later you invert this matrix, which now contains a bunch of zero
-      // (it is not full rank)
-      temp.block(r_dim, r_dim, t_dim, t_dim) =
+      // TODO(Yun): I wonder if this can cause issues: later you invert this
+      // matrix, which now contains a bunch of zero (it is not full rank)
+      covariance_matrix.setZero();
+      covariance_matrix.block(r_dim, r_dim, t_dim, t_dim) =
           covar.block(r_dim, r_dim, t_dim, t_dim);
-      covar = temp;
+    } else {
+      covariance_matrix = covar;
     }
-    covariance_matrix = covar;
   }
 
   /* method to combine two poses (along with their covariances) */
   /* ---------------------------------------------------------- */
   PoseWithCovariance compose(const PoseWithCovariance& other) const {
     PoseWithCovariance<T> out;
-    gtsam::Matrix Ha, Hb;
+    Jacobian Ha, Hb;
 
     out.pose = pose.compose(other.pose, Ha, Hb);
     out.covariance_matrix = Ha * covariance_matrix * Ha.transpose() +
@@ -126,6 +128,16 @@ struct PoseWithCovariance {
     return out;
   }
 
+  /* compose in place, for odometry chains: the Jacobian of the composition
+   * with respect to other is the identity */
+  void composeInPlace(const PoseWithCovariance& other) {
+    Jacobian Ha;
+    pose = pose.compose(other.pose, Ha);
+    covariance_matrix =
+        Ha * covariance_matrix * Ha.transpose() + other.covariance_matrix;
+    if (!other.rotation_info) rotation_info = false;
+  }
+
   /* method to invert a pose along with its covariance -------- */
   /* ---------------------------------------------------------- */
   PoseWithCovariance inverse() const {
@@ -140,14 +152,14 @@ struct PoseWithCovariance {
   /* ----------------------------------------------------------- */
   PoseWithCovariance between(const PoseWithCovariance& other) const {
     PoseWithCovariance<T> out;
-    gtsam::Matrix Ha, Hb;
+    Jacobian Ha, Hb;
     out.pose = pose.between(other.pose, Ha, Hb);  // returns between in a frame
 
     out.covariance_matrix =
         other.covariance_matrix - Ha * covariance_matrix * Ha.transpose();
     bool pos_semi_def = true;
     // compute the Cholesky decomp
-    Eigen::LLT<Eigen::MatrixXd> lltCovar1(out.covariance_matrix);
+    Eigen::LLT<Jacobian> lltCovar1(out.covariance_matrix);
     if (lltCovar1.info() == Eigen::NumericalIssue) {
       pos_semi_def = false;
     }
@@ -158,7 +170,7 @@ struct PoseWithCovariance {
           covariance_matrix - Ha * other.covariance_matrix * Ha.transpose();
 
       // Check if positive semidef
-      Eigen::LLT<Eigen::MatrixXd> lltCovar2(out.covariance_matrix);
+      Eigen::LLT<Jacobian> lltCovar2(out.covariance_matrix);
       // if(lltCovar2.info() == Eigen::NumericalIssue){
       //   log<WARNING>("Warning: Covariance matrix between two poses not PSD");
       // }
@@ -169,7 +181,7 @@ struct PoseWithCovariance {
 
   double mahalanobis_norm() const {
     // calculate mahalanobis norm
-    gtsam::Vector log = T::Logmap(pose);
+    const typename gtsam::traits<T>::TangentVector log = T::Logmap(pose);
     if (!rotation_info) {
       // only use translation part
       int t_dim = getTranslationDim<T>();
@@ -216,12 +228,13 @@ struct PoseWithNode {
   }
 
   /* construct from gtsam between factor  --------------------- */
-  explicit PoseWithNode(const gtsam::BetweenFactor<T>& between_factor) {
+  explicit PoseWithNode(const gtsam::BetweenFactor<T>& between_factor)
+      : PoseWithNode(between_factor, factorCovariance(between_factor)) {}
+
+  /* construct from gtsam between factor and its covariance ---- */
+  PoseWithNode(const gtsam::BetweenFactor<T>& between_factor,
+               const gtsam::Matrix& covar) {
     pose = between_factor.measured();
-    gtsam::Matrix covar =
-        boost::dynamic_pointer_cast<gtsam::noiseModel::Gaussian>(
-            between_factor.noiseModel())
-            ->covariance();
 
     // prevent propagation of nan values in the edge case
     //const int dim = getDim<T>();
@@ -246,6 +259,13 @@ struct PoseWithNode {
     return out;
   }
 
+  /* compose in place, for odometry chains -------------------- */
+  void composeInPlace(const PoseWithNode& other) {
+    pose = pose.compose(other.pose);
+    node += other.node;
+    if (!other.rotation_info) rotation_info = false;
+  }
+
   /* method to invert a pose along with its covariance -------- */
   /* ---------------------------------------------------------- */
   PoseWithNode inverse() const {
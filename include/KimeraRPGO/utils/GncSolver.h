@@ -0,0 +1,160 @@
+/*
+Graduated non-convexity (GNC) with a truncated least squares loss
+Same schedule as gtsam::GncOptimizer (TLS), but the weighted graph is built
+once: every factor is wrapped in a WeightedFactor that reads its weight from
+a shared vector and rescales the rows of its linearization. The inner LM
+solves reuse one ordering and are warm started from the previous estimate
+and damping, and the residuals are evaluated in parallel.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gtsam/linear/GaussianFactor.h>
+#include <gtsam/nonlinear/LevenbergMarquardtOptimizer.h>
+#include <gtsam/nonlinear/NonlinearFactorGraph.h>
+#include <gtsam/nonlinear/Values.h>
+
+#include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/utils/ThreadPool.h"
+
+namespace KimeraRPGO {
+
+/*! \brief Factor scaled by an externally owned weight
+ * error = weight * error of the wrapped factor; the whitened Jacobian and
+ * right hand side are scaled by sqrt(weight)
+ */
+class WeightedFactor : public gtsam::NonlinearFactor {
+ public:
+  WeightedFactor(const gtsam::NonlinearFactor::shared_ptr& factor,
+                 const double* weight)
+      : gtsam::NonlinearFactor(factor->keys()),
+        factor_(factor),
+        weight_(weight) {}
+
+  double error(const gtsam::Values& values) const override {
+    return *weight_ * factor_->error(values);
+  }
+
+  size_t dim() const override { return factor_->dim(); }
+
+  boost::shared_ptr<gtsam::GaussianFactor> linearize(
+      const gtsam::Values& values) const override;
+
+  inline const gtsam::NonlinearFactor::shared_ptr& factor() const {
+    return factor_;
+  }
+
+ private:
+  gtsam::NonlinearFactor::shared_ptr factor_;
+  const double* weight_;
+};
+
+/*! \brief GNC-TLS solver on top of Levenberg-Marquardt
+ * - nfg: factors (only Gaussian noise models, as for gtsam::GncOptimizer)
+ * - initial: initial estimate
+ * - lm_params: parameters of the inner solves (the ordering is computed once
+ *   if not set)
+ * - gnc_params: thresholds, schedule and stopping conditions
+ * - known_inliers: indices of the factors with weight fixed to 1
+ * The residuals are evaluated on the pool of setThreadPool (serially if not
+ * set)
+ */
+class GncSolver {
+ public:
+  GncSolver(const gtsam::NonlinearFactorGraph& nfg,
+            const gtsam::Values& initial,
+            const gtsam::LevenbergMarquardtParams& lm_params,
+            const GncParams& gnc_params,
+            const std::vector<size_t>& known_inliers);
+  // the weighted factors point into weights_
+  GncSolver(const GncSolver&) = delete;
+  GncSolver& operator=(const GncSolver&) = delete;
+
+  /*! \brief initial weights (e.g. to bias the odometry)
+   */
+  void setWeights(const gtsam::Vector& weights);
+
+  /*! \brief evaluate the residuals on a shared pool (not owned), null:
+   * serially
+   */
+  inline void setThreadPool(ThreadPool* thread_pool) {
+    thread_pool_ = thread_pool ? thread_pool : own_thread_pool_.get();
+  }
+
+  gtsam::Values optimize();
+
+  /*! \brief one iteration of the current inner LM solve (and the GNC step
+   * after it if the solve converged), returns true once GNC stopped. For
+   * optimizations run a slice at a time: optimize() is iterate() until true
+   */
+  bool iterate();
+
+  /*! \brief estimate of the last iteration
+   */
+  inline const gtsam::Values& currentEstimate() const {
+    return inner_ ? inner_->values() : estimate_;
+  }
+
+  inline const gtsam::Vector& getWeights() const { return weights_; }
+  inline const gtsam::Vector& getInlierCostThresholds() const {
+    return barc_sq_;
+  }
+  inline size_t iterations() const { return iterations_; }
+  inline size_t innerIterations() const { return inner_iterations_; }
+
+ private:
+  /*! \brief residuals_[k] = error of factor k (unweighted)
+   */
+  void computeResiduals(const gtsam::Values& values);
+
+  double weightedCost() const;
+  /*! \brief first mu, from the residuals at the initial estimate (computed
+   * before the first inner solve)
+   */
+  double initializeMu() const;
+  void updateWeights(double mu);
+  bool weightsConverged() const;
+
+  /*! \brief inner LM from (and into) estimate_, warm started with lambda_
+   */
+  void startSolve();
+  void finishSolve();
+
+  /*! \brief GNC step after an inner solve: update mu and the weights,
+   * returns true if GNC stopped
+   */
+  bool nextMuStep();
+
+  gtsam::NonlinearFactorGraph nfg_;
+  gtsam::NonlinearFactorGraph weighted_nfg_;  // reads weights_
+  gtsam::Values estimate_;
+  gtsam::LevenbergMarquardtParams lm_params_;
+  GncParams gnc_params_;
+  std::vector<bool> known_inlier_;
+  size_t num_known_inliers_;
+  std::unique_ptr<ThreadPool> own_thread_pool_;  // one thread: inline
+  ThreadPool* thread_pool_;
+
+  gtsam::Vector weights_;
+  gtsam::Vector barc_sq_;  // inlier cost thresholds
+  gtsam::Vector residuals_;
+  double lambda_;
+  bool has_lambda_;
+  size_t iterations_;
+  size_t inner_iterations_;
+
+  // state between iterate() calls
+  std::unique_ptr<gtsam::LevenbergMarquardtOptimizer> inner_;
+  bool mu_initialized_;  // false: first solve (all weights 1)
+  double mu_;
+  double prev_cost_;
+  bool done_;
+  int64_t mu_step_begin_;  // trace, -1: not traced
+};
+
+}  // namespace KimeraRPGO
@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
 #include <unordered_map>
 #include <vector>
@@ -11,16 +12,88 @@
 
 namespace KimeraRPGO {
 
-int findMaxClique(const Eigen::MatrixXd adjMatrix,
-                  std::vector<int>* max_clique);
+/** \struct MaxCliqueStats
+ *  \brief Statistics of a single max clique search
+ */
+struct MaxCliqueStats {
+  size_t num_vertices = 0;
+  size_t num_edges = 0;
+  double density = 0;  // edges / (v * (v - 1) / 2)
+  // pruning counts (see findClique.h)
+  size_t pruned1 = 0;
+  size_t pruned2 = 0;
+  size_t pruned3 = 0;
+  size_t pruned5 = 0;
+  size_t not_computed = 0;  // candidate vertices skipped by the heuristic
+  size_t nodes_expanded = 0;
+  size_t clique_size = 0;
+  double time_ms = 0;     // graph construction and search
+  size_t num_checks = 0;  // consistency checks run by a lazy search
+};
 
-int findMaxCliqueHeu(const Eigen::MatrixXd adjMatrix,
-                     std::vector<int>* max_clique);
+/** \struct CliqueStatsSummary
+ *  \brief Max clique statistics accumulated over several searches
+ */
+struct CliqueStatsSummary {
+  size_t num_searches = 0;
+  size_t total_nodes_expanded = 0;
+  size_t total_checks = 0;
+  double total_time_ms = 0;
+  double max_time_ms = 0;
+  MaxCliqueStats last;  // most recent search
 
-int findMaxCliqueHeuIncremental(const Eigen::MatrixXd adjMatrix,
+  void add(const MaxCliqueStats& stats) {
+    num_searches++;
+    total_nodes_expanded += stats.nodes_expanded;
+    total_checks += stats.num_checks;
+    total_time_ms += stats.time_ms;
+    if (stats.time_ms > max_time_ms) max_time_ms = stats.time_ms;
+    last = stats;
+  }
+};
+
+int findMaxClique(const Eigen::MatrixXd& adjMatrix,
+                  std::vector<int>* max_clique,
+                  MaxCliqueStats* stats = NULL);
+
+int findMaxCliqueHeu(const Eigen::MatrixXd& adjMatrix,
+                     std::vector<int>* max_clique,
+                     MaxCliqueStats* stats = NULL);
+
+int findMaxCliqueHeuIncremental(const Eigen::MatrixXd& adjMatrix,
                                 size_t num_new_lc,
                                 size_t prev_maxclique_size,
-                                std::vector<int>* max_clique);
+                                std::vector<int>* max_clique,
+                                MaxCliqueStats* stats = NULL);
+
+/*! \brief Pairwise consistency of vertices i < j, evaluated on demand
+ */
+typedef std::function<bool(size_t, size_t)> EdgeOracle;
+
+/*! \brief Greedy heuristic on a partially known adjacency
+ * Entries of adjMatrix are 1 (edge), 0 (no edge) or -1 (not checked yet).
+ * Unknown entries are resolved with check only when the search needs them
+ * and are written back to adjMatrix. Vertices are visited by decreasing
+ * upper bound on their degree (known and unknown entries) and the bounds
+ * shrink as checks fail, so most pairs involving outliers are never checked.
+ * Not the same heuristic as findMaxCliqueHeu, which visits the vertices in
+ * index order with their true degrees: the cliques found can differ (and
+ * their sizes, rarely, see testLazyConsistency).
+ */
+int findMaxCliqueHeuLazy(Eigen::MatrixXd* adjMatrix,
+                         const EdgeOracle& check,
+                         std::vector<int>* max_clique,
+                         MaxCliqueStats* stats = NULL);
+
+class MappedAdjacency;
+
+/*! \brief Same greedy heuristic as findMaxCliqueHeu, run directly on an out
+ * of core adjacency (rows are read into RAM bitsets one at a time, only the
+ * degrees and two rows are kept in memory)
+ */
+int findMaxCliqueHeu(const MappedAdjacency& adjacency,
+                     std::vector<int>* max_clique,
+                     MaxCliqueStats* stats = NULL);
 
 /** \struct Trajectory
  *  \brief Structure defining a robot trajectory
@@ -33,22 +106,24 @@ struct Trajectory {
   /** \brief Get transform (along with node number and covariance)
    *  between two keys in trajectory
    *  from key_a to key_b
+   *  (const: safe to call from several threads)
    */
-  T<poseT> getBetween(const gtsam::Key& key_a, const gtsam::Key& key_b) {
+  T<poseT> getBetween(const gtsam::Key& key_a,
+                      const gtsam::Key& key_b) const {
     gtsam::Symbol symb_key_a(key_a);
     gtsam::Symbol symb_key_b(key_b);
     if (symb_key_a.chr() == symb_key_b.chr()) {
       // same prefix: on same robot trajectory
-      return poses[key_a].between(poses[key_b]);
+      return pose(key_a).between(pose(key_b));
     } else {
       char prefix_a = symb_key_a.chr();
       char prefix_b = symb_key_b.chr();
       // define root key
       gtsam::Key a0 = gtsam::Symbol(prefix_a, 0);
       gtsam::Key b0 = gtsam::Symbol(prefix_b, 0);
-      T<poseT> pose_a = poses[a0].between(poses[key_a]);
-      T<poseT> pose_b = poses[b0].between(poses[key_b]);
-      T<poseT> pose_a0b0 = poses[a0].between(poses[b0]);
+      T<poseT> pose_a = pose(a0).between(pose(key_a));
+      T<poseT> pose_b = pose(b0).between(pose(key_b));
+      T<poseT> pose_a0b0 = pose(a0).between(pose(b0));
 
       // so now want a to b
       T<poseT> result = pose_a.inverse().compose(pose_a0b0);
@@ -58,6 +133,13 @@ struct Trajectory {
   }
 
   inline gtsam::Key getStartKey() { return poses.begin()->first; }
+
+  /** \brief Pose of key (default constructed if not in the trajectory)
+   */
+  T<poseT> pose(const gtsam::Key& key) const {
+    const auto it = poses.find(key);
+    return it == poses.end() ? T<poseT>() : it->second;
+  }
 };
 
 }  // namespace KimeraRPGO
\ No newline at end of file
@@ -0,0 +1,79 @@
+/*
+Out-of-core adjacency matrix for very large consistency graphs
+The matrix is bit packed and split in square tiles stored in a memory mapped
+file, so a group with hundreds of thousands of measurements only needs the
+page cache instead of a dense Eigen matrix (8 bytes per entry) in RAM.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace KimeraRPGO {
+
+/*! \brief Symmetric bit adjacency matrix backed by a memory mapped file
+ * - The matrix is split in tile_size x tile_size bit tiles, one row of a tile
+ *   is tile_size / 64 contiguous words.
+ * - Tiles are laid out in "shells": shell k holds tiles (k, 0..k) followed by
+ *   (0..k-1, k). Growing the matrix only appends shells, so existing tiles
+ *   never move and the file stays sparse where nothing has been written.
+ * - Both (i, j) and (j, i) are stored so that a row is read with one
+ *   contiguous copy per tile. Consecutive rows share pages, so scanning rows
+ *   in order (as the clique heuristic does) reads the file almost
+ *   sequentially.
+ */
+class MappedAdjacency {
+ public:
+  /*! \brief path: backing file (created or truncated). If empty, an unlinked
+   * temporary file is used. tile_size must be a multiple of 64.
+   */
+  explicit MappedAdjacency(const std::string& path = "",
+                           size_t tile_size = 4096);
+  MappedAdjacency(const MappedAdjacency&) = delete;
+  MappedAdjacency& operator=(const MappedAdjacency&) = delete;
+  ~MappedAdjacency();
+
+  /*! \brief grow to num_vertices (never shrinks), new entries are zero
+   */
+  void resize(size_t num_vertices);
+
+  inline size_t size() const { return num_vertices_; }
+  inline size_t tileSize() const { return tile_size_; }
+
+  /*! \brief number of 64 bit words of a row as returned by getRow
+   */
+  inline size_t rowWords() const { return num_tiles_ * words_per_tile_row_; }
+
+  /*! \brief size of the backing file
+   */
+  inline size_t mappedBytes() const { return mapped_bytes_; }
+
+  void setEdge(size_t i, size_t j, bool value = true);
+  bool hasEdge(size_t i, size_t j) const;
+
+  /*! \brief copy row i to a RAM bitset of rowWords() words
+   */
+  void getRow(size_t i, std::vector<uint64_t>* row) const;
+
+  size_t degree(size_t i) const;
+
+ private:
+  uint64_t* tileRow(size_t i, size_t tile_col) const;
+  static size_t tileIndex(size_t tile_row, size_t tile_col);
+  void remap(size_t num_tiles);
+
+  std::string path_;
+  int fd_;
+  uint64_t* data_;
+  size_t mapped_bytes_;
+  size_t num_vertices_;
+  size_t num_tiles_;  // tiles per side
+  size_t tile_size_;
+  size_t words_per_tile_row_;
+  size_t words_per_tile_;
+};
+
+}  // namespace KimeraRPGO
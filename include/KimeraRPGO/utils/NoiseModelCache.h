@@ -0,0 +1,52 @@
+/*
+Interning of Gaussian noise models
+Odometry and loop closures usually come with a few distinct covariances, but
+each factor carries its own noise model. The solver replaces the noise models
+on ingestion by one shared instance per distinct model, and the consistency
+checks read the covariance decoded once per instance instead of inverting the
+information matrix of every factor they compose.
+author: Yun Chang
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+
+#include <gtsam/linear/NoiseModel.h>
+
+namespace KimeraRPGO {
+
+/*! \brief Shared instance and decoded matrices of each distinct Gaussian
+ * noise model (same type and same square root information, bit for bit)
+ * - intern: the shared instance equal to model (model itself the first time).
+ *   Non Gaussian (robust) models are returned as they are
+ * - find: decoded matrices of model (by instance, then by value), nullptr if
+ *   not interned. Safe from several threads while nothing is interned
+ * The interned models stay alive as long as the cache.
+ */
+class NoiseModelCache {
+ public:
+  struct Entry {
+    gtsam::SharedNoiseModel model;
+    gtsam::Matrix covariance;
+    gtsam::Matrix information;
+  };
+
+  gtsam::SharedNoiseModel intern(const gtsam::SharedNoiseModel& model);
+
+  const Entry* find(const gtsam::SharedNoiseModel& model) const;
+
+  inline size_t size() const { return entries_.size(); }
+
+ private:
+  static size_t hash(const gtsam::noiseModel::Gaussian& model);
+  const Entry* findEqual(const gtsam::noiseModel::Gaussian& model,
+                         size_t hash) const;
+
+  // by shared instance (node based: the entries do not move)
+  std::unordered_map<const gtsam::noiseModel::Base*, Entry> entries_;
+  std::unordered_multimap<size_t, const Entry*> by_hash_;
+};
+
+}  // namespace KimeraRPGO
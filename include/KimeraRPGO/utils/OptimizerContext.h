@@ -0,0 +1,66 @@
+/*
+Optimizer state carried over between optimize calls
+Between two spins the graph is mostly the same plus a few factors, so the
+elimination ordering is extended with the new keys instead of running COLAMD
+again, and LM restarts from the damping it ended with.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+#include <gtsam/inference/Ordering.h>
+#include <gtsam/nonlinear/GaussNewtonOptimizer.h>
+#include <gtsam/nonlinear/LevenbergMarquardtOptimizer.h>
+#include <gtsam/nonlinear/NonlinearFactorGraph.h>
+
+namespace KimeraRPGO {
+
+/*! \brief Ordering and LM damping persisted across solves
+ * - ordering: COLAMD ordering of the graph keys. New keys are appended at the
+ *   end (they are usually the newest poses, eliminated last anyway). COLAMD
+ *   runs again when keys disappear or when the appended keys exceed
+ *   reorder_growth times the number of keys of the last full ordering.
+ * - lambda: final LM lambda of the previous solve, used as lambdaInitial
+ */
+class OptimizerContext {
+ public:
+  explicit OptimizerContext(double reorder_growth = 0.2);
+
+  /*! \brief ordering covering exactly the keys of nfg
+   */
+  const gtsam::Ordering& ordering(const gtsam::NonlinearFactorGraph& nfg);
+
+  /*! \brief set ordering (and initial lambda if use_lambda) of the params
+   */
+  void setup(const gtsam::NonlinearFactorGraph& nfg,
+             gtsam::LevenbergMarquardtParams* params,
+             bool use_lambda = true);
+  void setup(const gtsam::NonlinearFactorGraph& nfg,
+             gtsam::GaussNewtonParams* params);
+
+  /*! \brief store the final lambda of a LM solve
+   */
+  void setLambda(double lambda);
+
+  /*! \brief forget everything (next solve starts from scratch)
+   */
+  void reset();
+
+  inline size_t numFullOrderings() const { return num_full_orderings_; }
+  inline size_t numExtensions() const { return num_extensions_; }
+  inline bool hasLambda() const { return has_lambda_; }
+  inline double lambda() const { return lambda_; }
+
+ private:
+  double reorder_growth_;
+  gtsam::Ordering ordering_;
+  gtsam::KeySet keys_;
+  size_t num_keys_at_colamd_;
+  size_t num_full_orderings_;
+  size_t num_extensions_;
+  double lambda_;
+  bool has_lambda_;
+};
+
+}  // namespace KimeraRPGO
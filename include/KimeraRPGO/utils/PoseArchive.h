@@ -0,0 +1,100 @@
+/*
+Packed store of settled poses and of the odometry between them
+Poses far behind the robot rarely move after optimization. The archive keeps
+them, and the relative pose factors between them, in flat arrays: per pose
+its key and a few doubles, per factor its endpoints, measurement and the index
+of its noise model in a table shared by all factors. RobustSolver::archive
+moves parts of the graph here, and they are unpacked again (rehydrated) when a
+new measurement reaches them.
+author: Yun Chang
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include <gtsam/nonlinear/NonlinearFactorGraph.h>
+#include <gtsam/nonlinear/Values.h>
+
+#include "KimeraRPGO/utils/TypeUtils.h"
+
+namespace KimeraRPGO {
+
+/*! \brief Segments of archived poses and relative pose factors
+ * - add: pack the Pose2 / Pose3 values and the factors (with the slot they
+ *   had in the odometry of the outlier rejection) into a new segment
+ * - find: segment of an archived pose
+ * - extract: unpack a segment (FastBetweenFactor) and drop it, the later
+ *   segments move down by one
+ * - unpack: copy of everything, for writeG2o
+ * - save / load: binary form (host byte order) for checkpoints, load
+ *   rejects (false) truncated or inconsistent archives
+ */
+class PoseArchive {
+ public:
+  /*! \brief BetweenFactor on Pose2 / Pose3 with a (non constrained) Gaussian
+   * noise model: the factors the archive can pack
+   */
+  static bool packable(const gtsam::NonlinearFactor& factor);
+
+  void add(const gtsam::Values& poses, const SlottedFactors& factors);
+
+  bool find(gtsam::Key key, size_t* segment) const;
+  inline bool contains(gtsam::Key key) const {
+    size_t segment;
+    return find(key, &segment);
+  }
+
+  void extract(size_t segment, gtsam::Values* poses, SlottedFactors* factors);
+
+  /*! \brief robot prefix of the poses of a segment
+   */
+  char prefix(size_t segment) const;
+
+  /*! \brief endpoints of the packed factors
+   */
+  gtsam::KeySet factorKeys() const;
+
+  void unpack(gtsam::NonlinearFactorGraph* nfg, gtsam::Values* poses) const;
+
+  void save(std::ostream& stream) const;
+  bool load(std::istream& stream);
+
+  inline size_t numSegments() const { return segments_.size(); }
+  inline bool empty() const { return segments_.empty(); }
+  size_t numPoses() const;
+  size_t numFactors() const;
+
+ private:
+  struct Segment {
+    bool pose3;
+    std::vector<gtsam::Key> keys;  // sorted
+    std::vector<double> poses;     // x y theta, or qw qx qy qz x y z
+    std::vector<gtsam::Key> factor_keys;  // from, to
+    std::vector<double> measurements;
+    std::vector<uint32_t> noise;  // index in noise_models_
+    std::vector<uint64_t> slots;
+  };
+
+  static size_t stride(bool pose3) { return pose3 ? 7 : 3; }
+  /*! \brief array lengths agree, keys sorted, noise models of the segment
+   * dimension (checked on load: unpack indexes the arrays unchecked)
+   */
+  static bool consistent(
+      const Segment& segment,
+      const std::vector<gtsam::SharedNoiseModel>& noise_models);
+  uint32_t noiseIndex(const gtsam::SharedNoiseModel& model);
+  gtsam::NonlinearFactor::shared_ptr unpackFactor(const Segment& segment,
+                                                  size_t i) const;
+  void unpackPoses(const Segment& segment, gtsam::Values* poses) const;
+
+  std::vector<Segment> segments_;
+  std::vector<gtsam::SharedNoiseModel> noise_models_;
+  std::unordered_map<const gtsam::noiseModel::Base*, uint32_t> noise_index_;
+};
+
+}  // namespace KimeraRPGO
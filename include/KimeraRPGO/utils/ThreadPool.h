@@ -0,0 +1,90 @@
+/*
+Thread pool shared by the parallel stages of the solver
+RobustSolver creates one pool from RobustSolverParams and hands it to the
+outlier rejection and to GncSolver, so the pairwise consistency checks, the
+per group max clique searches and the GNC residuals share the same workers
+instead of each spawning threads. With gtsam built with TBB the pool can run
+inside an existing tbb::task_arena instead, sharing the workers of gtsam.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtsam/config.h>
+
+#ifdef GTSAM_USE_TBB
+#include <tbb/task_arena.h>
+#endif
+
+namespace KimeraRPGO {
+
+/*! \brief Fixed set of workers running one parallel loop at a time
+ * - num_threads: threads working on a loop, the caller included (0: hardware
+ *   concurrency, 1: every loop runs inline on the caller)
+ * - cpu_affinity: cores the workers are pinned to, round robin (Linux only,
+ *   empty: no pinning)
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t num_threads = 1,
+                      const std::vector<int>& cpu_affinity = {});
+#ifdef GTSAM_USE_TBB
+  /*! \brief run the loops in the arena (which must outlive the pool)
+   */
+  explicit ThreadPool(tbb::task_arena* arena);
+#endif
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  inline size_t numThreads() const { return num_threads_; }
+
+  /*! \brief fn(k) for k in [0, n), blocks until every call returned
+   * The range is split in at most max_tasks contiguous chunks (0: one per
+   * thread), which bounds the concurrency of the loop. Loops started from
+   * inside a loop run inline. The first exception thrown by fn is rethrown.
+   */
+  void parallelFor(size_t n,
+                   const std::function<void(size_t)>& fn,
+                   size_t max_tasks = 0);
+
+ private:
+  void workerLoop(size_t index, const std::vector<int>& cpu_affinity);
+
+  /* run chunks of the current loop until none is left
+   */
+  void runChunks();
+
+  size_t num_threads_;
+  std::vector<std::thread> workers_;
+#ifdef GTSAM_USE_TBB
+  tbb::task_arena* arena_;
+#endif
+
+  std::mutex submit_mutex_;  // one loop at a time
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  bool stop_;
+  size_t generation_;  // incremented for every loop
+  size_t active_;      // workers inside runChunks
+
+  // current loop
+  const std::function<void(size_t)>* fn_;
+  size_t size_;
+  size_t chunk_size_;
+  size_t num_chunks_;
+  std::atomic<size_t> next_chunk_;
+  std::atomic<size_t> completed_chunks_;
+  std::exception_ptr error_;
+};
+
+}  // namespace KimeraRPGO
@@ -0,0 +1,112 @@
+/*
+Chrome trace of the solver internals
+Scoped events are collected while tracing is on and written by the last
+Trace::stop() as Chrome trace JSON (chrome://tracing, ui.perfetto.dev), one
+track per thread. When tracing is off a scope costs a relaxed atomic load;
+building with KIMERA_RPGO_NO_TRACE defined compiles the scopes out.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include <gtsam/nonlinear/NonlinearOptimizer.h>
+#include <gtsam/nonlinear/Values.h>
+
+namespace KimeraRPGO {
+
+/*! \brief Process wide trace recorder, shared by the solvers of the process
+ * - start: the first start clears the recorded events and records from now
+ *   on into filename; later starts with the same filename join the trace,
+ *   with another filename they are refused (false)
+ * - stop: one stop per successful start. The last one stops recording and
+ *   writes the events (false if the file cannot be written or the trace is
+ *   not started). Scopes still open on other threads are dropped.
+ */
+class Trace {
+ public:
+  static bool start(const std::string& filename);
+  static bool stop();
+
+  static inline bool enabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /*! \brief microseconds of a monotonic clock
+   */
+  static int64_t now();
+
+  /*! \brief complete event [begin_us, end_us] on the calling thread
+   * - detail: shown as the "detail" argument of the event (may be empty)
+   */
+  static void record(const char* name,
+                     const std::string& detail,
+                     int64_t begin_us,
+                     int64_t end_us);
+
+ private:
+  static std::atomic<bool> enabled_;
+};
+
+/*! \brief Event spanning the lifetime of the scope
+ * name must outlive the trace (string literals)
+ */
+class TraceScope {
+ public:
+  explicit TraceScope(const char* name)
+      : name_(name), begin_(Trace::enabled() ? Trace::now() : -1) {}
+  TraceScope(const char* name, std::string detail)
+      : name_(name),
+        detail_(std::move(detail)),
+        begin_(Trace::enabled() ? Trace::now() : -1) {}
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+  ~TraceScope() {
+    if (begin_ >= 0 && Trace::enabled()) {
+      Trace::record(name_, detail_, begin_, Trace::now());
+    }
+  }
+
+ private:
+  const char* name_;
+  std::string detail_;
+  int64_t begin_;
+};
+
+/*! \brief optimizer->optimize() with one trace event per iteration
+ * Same stopping rule as gtsam's defaultOptimize; without tracing this is
+ * just optimize().
+ */
+gtsam::Values tracedOptimize(gtsam::NonlinearOptimizer* optimizer,
+                             const gtsam::NonlinearOptimizerParams& params,
+                             const char* iteration_name);
+
+/*! \brief one iteration of tracedOptimize (traced as well), returns true
+ * once the stopping rule is met (no iteration if the initial error is
+ * already below errorTol), for optimizations run a slice at a time
+ */
+bool tracedIterate(gtsam::NonlinearOptimizer* optimizer,
+                   const gtsam::NonlinearOptimizerParams& params,
+                   const char* iteration_name);
+
+}  // namespace KimeraRPGO
+
+#define KIMERA_RPGO_TRACE_CAT_(a, b) a##b
+#define KIMERA_RPGO_TRACE_CAT(a, b) KIMERA_RPGO_TRACE_CAT_(a, b)
+
+#ifdef KIMERA_RPGO_NO_TRACE
+#define RPGO_TRACE_SCOPE(name)
+#define RPGO_TRACE_SCOPE_DETAIL(name, detail)
+#else
+#define RPGO_TRACE_SCOPE(name)  \
+  KimeraRPGO::TraceScope KIMERA_RPGO_TRACE_CAT(rpgo_trace_, __LINE__)(name)
+// detail is only evaluated when tracing is on
+#define RPGO_TRACE_SCOPE_DETAIL(name, detail)                              \
+  KimeraRPGO::TraceScope KIMERA_RPGO_TRACE_CAT(rpgo_trace_, __LINE__)(     \
+      name,                                                                \
+      KimeraRPGO::Trace::enabled() ? std::string(detail) : std::string())
+#endif
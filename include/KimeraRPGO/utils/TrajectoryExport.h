@@ -0,0 +1,56 @@
+/*
+Per robot trajectories of an estimate
+gtsam::Values is ordered by key and gtsam::Symbol keeps the robot prefix in
+the high bits of the key, so the poses of a robot form one run of the values,
+sorted by index. One pass splits the estimate into these runs (no copies, no
+key lookups) and each run is streamed to its own file.
+author: Yun Chang
+*/
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <gtsam/nonlinear/Values.h>
+
+namespace KimeraRPGO {
+
+class ThreadPool;
+
+enum class TrajectoryFormat {
+  CSV = 0,     // timestamp (0), x, y, z, qw, qx, qy, qz per line
+  BINARY = 1,  // pose count, then index, x, y, z, qw, qx, qy, qz per pose
+};
+
+/*! \brief Poses of one robot: values in [begin, end) with the prefix (other
+ * values of the run, e.g. landmarks, are skipped when writing)
+ */
+struct TrajectoryRange {
+  char prefix;
+  gtsam::Values::const_iterator begin;
+  gtsam::Values::const_iterator end;
+  size_t num_poses;
+};
+
+/*! \brief Runs of the robots with Pose2 / Pose3 values, by prefix
+ */
+std::vector<TrajectoryRange> splitTrajectories(const gtsam::Values& values);
+
+/*! \brief Write one trajectory (Pose2 as planar Pose3). Binary: host byte
+ * order, uint64 count and index, doubles for the pose
+ */
+void writeTrajectory(const TrajectoryRange& trajectory,
+                     TrajectoryFormat format,
+                     std::ostream* stream);
+
+/*! \brief Write folder/robot_<prefix>.csv (or .bin) for each robot, in
+ * parallel on the pool if given. Returns the number of files written
+ */
+size_t writeTrajectories(const gtsam::Values& values,
+                         const std::string& folder,
+                         TrajectoryFormat format = TrajectoryFormat::CSV,
+                         ThreadPool* thread_pool = nullptr);
+
+}  // namespace KimeraRPGO
@@ -1,15 +1,19 @@
 // Authors: Yun Chang
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include <gtsam/base/Vector.h>
 #include <gtsam/inference/Symbol.h>
 #include <gtsam/nonlinear/NonlinearFactorGraph.h>
 
 #include "KimeraRPGO/Logger.h"
+#include "KimeraRPGO/utils/FlatHashMap.h"
 
 namespace KimeraRPGO {
 
@@ -18,6 +22,11 @@ struct Measurements {
   gtsam::NonlinearFactorGraph consistent_factors;
   gtsam::Matrix adj_matrix;
   gtsam::Matrix dist_matrix;
+  // inliers that left the active window (see PcmWindowPolicy)
+  gtsam::NonlinearFactorGraph frozen_inliers;
+  size_t num_evicted = 0;  // inliers and outliers that left the window
+  // transform voting: cell of each factor, computed when it is added
+  std::vector<std::vector<int>> voting_cells;
 
   Measurements(
       gtsam::NonlinearFactorGraph new_factors = gtsam::NonlinearFactorGraph())
@@ -40,20 +49,48 @@ struct Edge {
 };
 typedef std::unique_ptr<const Edge> EdgePtr;
 
+// Handle of a factor of the GenericSolver graph, returned on insertion.
+// Unlike the slot of the factor in getFactorsUnsafe(), it stays valid when
+// other factors are removed and the graph is compacted. Default: invalid
+class FactorId {
+ public:
+  FactorId() : id_(0) {}
+
+  inline bool valid() const { return id_ != 0; }
+
+  bool operator==(const FactorId& other) const { return id_ == other.id_; }
+
+  bool operator!=(const FactorId& other) const { return id_ != other.id_; }
+
+ private:
+  friend class GenericSolver;
+  explicit FactorId(uint64_t id) : id_(id) {}
+  uint64_t id_;
+};
+typedef std::vector<FactorId> FactorIds;
+
+// Factors with the slot they had in a graph (see PoseArchive)
+typedef std::vector<std::pair<size_t, gtsam::NonlinearFactor::shared_ptr>>
+    SlottedFactors;
+
 // struct storing the involved parties (ex robot a and robot b)
+// The pair is unordered: it is stored canonically (id1 <= id2) so that
+// ObservationId('a', 'b') and ObservationId('b', 'a') compare and hash equal
 struct ObservationId {
   char id1;
   char id2;
 
   ObservationId(char first, char second) {
-    id1 = first;
-    id2 = second;
+    id1 = std::min(first, second);
+    id2 = std::max(first, second);
   }
 
   bool operator==(const ObservationId& other) const {
-    if (id1 == other.id1 && id2 == other.id2) return true;
-    if (id2 == other.id1 && id1 == other.id2) return true;
-    return false;
+    return id1 == other.id1 && id2 == other.id2;
+  }
+
+  bool operator!=(const ObservationId& other) const {
+    return !(*this == other);
   }
 };
 
@@ -70,9 +107,10 @@ namespace std {
 template <>
 struct hash<KimeraRPGO::ObservationId> {
   std::size_t operator()(const KimeraRPGO::ObservationId& id) const {
-    using std::hash;
-    return hash<char>()(id.id1) + hash<char>()(id.id2) +
-           hash<char>()(id.id1) * hash<char>()(id.id2);
+    // pack the (canonical) pair: distinct pairs never collide. The bits are
+    // spread by the containers (see mixHash in FlatHashMap.h)
+    return (static_cast<std::size_t>(static_cast<unsigned char>(id.id1)) << 8) |
+           static_cast<unsigned char>(id.id2);
   }
 };
 }  // namespace std
\ No newline at end of file
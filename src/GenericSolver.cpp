@@ -4,6 +4,8 @@ No outlier removal in this class
 author: Yun Chang, Luca Carlone
 */
 
+#include <limits>
+#include <utility>
 #include <vector>
 
 #include "KimeraRPGO/GenericSolver.h"
@@ -25,7 +27,12 @@ GenericSolver::GenericSolver(Solver solvertype,
       solver_type_(solvertype),
       special_symbols_(special_symbols),
       debug_(true),
-      log_(false) {}
+      log_(false),
+      next_factor_id_(1),
+      num_empty_slots_(0),
+      factor_ids_stale_(false),
+      factor_slots_kept_(std::numeric_limits<size_t>::max()),
+      compact_factors_(false) {}
 
 bool GenericSolver::isSpecialSymbol(char symb) const {
   for (size_t i = 0; i < special_symbols_.size(); i++) {
@@ -37,6 +44,7 @@ bool GenericSolver::isSpecialSymbol(char symb) const {
 void GenericSolver::updateValues(const gtsam::Values& values) {
   for (const auto& v : values) {
     if (values_.exists(v.key)) {
+      if (values_undo_) saveValue(v.key);
       values_.update(v.key, v.value);
     } else if (temp_values_.exists(v.key)) {
       temp_values_.update(v.key, v.value);
@@ -44,12 +52,39 @@ void GenericSolver::updateValues(const gtsam::Values& values) {
   }
 }
 
+void GenericSolver::saveValue(gtsam::Key key) {
+  if (values_undo_->added.count(key) || values_undo_->previous.exists(key)) {
+    return;
+  }
+  if (values_.exists(key)) {
+    values_undo_->previous.insert(key, values_.at(key));
+  } else {
+    values_undo_->added.insert(key);
+  }
+}
+
+void GenericSolver::undoValues() {
+  if (!values_undo_) return;
+  for (const auto& v : values_undo_->previous) values_.update(v.key, v.value);
+  for (const auto& key : values_undo_->added) {
+    if (values_.exists(key)) values_.erase(key);
+  }
+  values_undo_.reset();
+}
+
 bool GenericSolver::addAndCheckIfOptimize(
     const gtsam::NonlinearFactorGraph& nfg,
-    const gtsam::Values& values) {
+    const gtsam::Values& values,
+    FactorIds* ids) {
   // add new values and factors
+  reissueFactorIds();
+  const size_t first_slot = nfg_.size();
   nfg_.add(nfg);
+  if (values_undo_) {
+    for (const auto& v : values) saveValue(v.key);
+  }
   values_.insert(values);
+  indexNewSlots(first_slot, ids);
 
   // Do not optimize for just odometry (between) additions
   if (nfg.size() == 1 && nfg[0]->keys().size() == 2 && values.size() == 1) {
@@ -64,20 +99,35 @@ bool GenericSolver::addAndCheckIfOptimize(
   return true;
 }
 
-void GenericSolver::update(const gtsam::NonlinearFactorGraph& nfg,
-                           const gtsam::Values& values,
-                           const gtsam::FactorIndices& factorsToRemove) {
+FactorIds GenericSolver::update(const gtsam::NonlinearFactorGraph& nfg,
+                                const gtsam::Values& values,
+                                const gtsam::FactorIndices& factorsToRemove) {
+  warnIfPositional(factorsToRemove);
+  return updateAndRemoveSlots(nfg, values, factorsToRemove);
+}
+
+FactorIds GenericSolver::update(const gtsam::NonlinearFactorGraph& nfg,
+                                const gtsam::Values& values,
+                                const FactorIds& factors_to_remove) {
+  return updateAndRemoveSlots(nfg, values, toSlots(factors_to_remove));
+}
+
+FactorIds GenericSolver::updateAndRemoveSlots(
+    const gtsam::NonlinearFactorGraph& nfg,
+    const gtsam::Values& values,
+    const gtsam::FactorIndices& factorsToRemove) {
   // TODO(Yun) Do we have unittests for generic (no outlier-rejection) update?
   // remove factors
   bool remove_factors = false;
   if (factorsToRemove.size() > 0) {
     remove_factors = true;
   }
-  for (size_t index : factorsToRemove) {
-    nfg_[index].reset();
-  }
+  removeSlots(factorsToRemove);
 
-  bool process_lc = addAndCheckIfOptimize(nfg, values);
+  FactorIds ids;
+  bool process_lc =
+      addAndCheckIfOptimize(
+      toFastBetweenFactors(nfg, noise_models_.get()), values, &ids);
 
   if (process_lc || remove_factors) {
     // optimize
@@ -93,14 +143,18 @@ void GenericSolver::update(const gtsam::NonlinearFactorGraph& nfg,
         log<INFO>("Running LM");
       }
       params.diagonalDamping = true;
-      result = gtsam::LevenbergMarquardtOptimizer(full_nfg, full_values, params)
-                   .optimize();
+      if (optimizer_context_) optimizer_context_->setup(full_nfg, &params);
+      gtsam::LevenbergMarquardtOptimizer optimizer(
+          full_nfg, full_values, params);
+      result = optimizer.optimize();
+      if (optimizer_context_) optimizer_context_->setLambda(optimizer.lambda());
     } else if (solver_type_ == Solver::GN) {
       gtsam::GaussNewtonParams params;
       if (debug_) {
         params.setVerbosity("ERROR");
         log<INFO>("Running GN");
       }
+      if (optimizer_context_) optimizer_context_->setup(full_nfg, &params);
       result =
           gtsam::GaussNewtonOptimizer(full_nfg, full_values, params).optimize();
     } else {
@@ -109,46 +163,218 @@ void GenericSolver::update(const gtsam::NonlinearFactorGraph& nfg,
     }
     updateValues(result);
   }
+  return ids;
 }
 
 void GenericSolver::removeFactorsNoUpdate(
     gtsam::FactorIndices factorsToRemove) {
+  warnIfPositional(factorsToRemove);
+  removeSlots(factorsToRemove);
+}
+
+void GenericSolver::removeFactorsNoUpdate(const FactorIds& factors_to_remove) {
+  removeSlots(toSlots(factors_to_remove));
+}
+
+void GenericSolver::removeSlots(const gtsam::FactorIndices& slots) {
   // remove factors
-  for (size_t index : factorsToRemove) {
-    nfg_[index].reset();
+  reissueFactorIds();
+  for (size_t index : slots) {
+    removeSlot(index);
+  }
+  // only after all the removals: the slots are relative to the same graph
+  if (compact_factors_) compactIfSparse();
+}
+
+gtsam::FactorIndices GenericSolver::toSlots(const FactorIds& ids) {
+  gtsam::FactorIndices slots;
+  for (const FactorId& id : ids) {
+    const size_t slot = getFactorSlot(id);
+    if (slot < nfg_.size()) slots.push_back(slot);
   }
+  return slots;
+}
+
+void GenericSolver::warnIfPositional(const gtsam::FactorIndices& slots) const {
+  if (compact_factors_ && !slots.empty()) {
+    log<WARNING>(
+        "Removing factors by slot is deprecated with compaction enabled (the "
+        "slots move): use the FactorIds overload");
+  }
+}
+
+size_t GenericSolver::getFactorSlot(const FactorId& id) {
+  reissueFactorIds();
+  const auto slot = id_slots_.find(id.id_);
+  return slot == id_slots_.end() ? nfg_.size() : slot->second;
+}
+
+FactorId GenericSolver::getFactorId(size_t slot) {
+  reissueFactorIds();
+  return slot < slot_ids_.size() ? FactorId(slot_ids_[slot]) : FactorId();
+}
+
+void GenericSolver::removeSlot(size_t slot) {
+  if (slot >= nfg_.size() || !nfg_[slot]) return;
+  nfg_[slot].reset();
+  id_slots_.erase(slot_ids_[slot]);
+  slot_ids_[slot] = 0;
+  slot_factors_[slot].reset();
+  num_empty_slots_++;
+}
+
+void GenericSolver::compactIfSparse() {
+  // amortized: at least half of the slots were removed since the last pass
+  if (nfg_.size() < kMinSlotsToCompact || 2 * num_empty_slots_ < nfg_.size()) {
+    return;
+  }
+  size_t num_kept = 0;
+  for (size_t slot = 0; slot < nfg_.size(); slot++) {
+    if (!nfg_[slot]) continue;
+    nfg_[num_kept] = nfg_[slot];
+    slot_ids_[num_kept] = slot_ids_[slot];
+    slot_factors_[num_kept] = slot_factors_[slot];
+    id_slots_[slot_ids_[num_kept]] = num_kept;
+    num_kept++;
+  }
+  nfg_.resize(num_kept);
+  slot_ids_.resize(num_kept);
+  slot_factors_.resize(num_kept);
+  num_empty_slots_ = 0;
+}
+
+void GenericSolver::indexNewSlots(size_t first_slot, FactorIds* ids) {
+  for (size_t slot = first_slot; slot < nfg_.size(); slot++) {
+    uint64_t id = 0;
+    if (nfg_[slot]) {
+      id = next_factor_id_++;
+      id_slots_[id] = slot;
+    } else {
+      num_empty_slots_++;
+    }
+    slot_ids_.push_back(id);
+    slot_factors_.push_back(nfg_[slot]);
+    if (ids) ids->push_back(FactorId(id));
+  }
+}
+
+FactorIds GenericSolver::findFactorIds(
+    const gtsam::NonlinearFactorGraph& factors,
+    size_t first_slot) {
+  reissueFactorIds();
+  FactorIds ids(factors.size());
+  FlatHashMap<const gtsam::NonlinearFactor*, size_t> positions;
+  positions.reserve(factors.size());
+  for (size_t i = 0; i < factors.size(); i++) {
+    if (factors[i]) positions.insert(std::make_pair(factors[i].get(), i));
+  }
+  for (size_t slot = first_slot; slot < nfg_.size() && !positions.empty();
+       slot++) {
+    if (!nfg_[slot]) continue;
+    const auto position = positions.find(nfg_[slot].get());
+    if (position == positions.end()) continue;
+    ids[position->second] = FactorId(slot_ids_[slot]);
+    positions.erase(nfg_[slot].get());
+  }
+  return ids;
+}
+
+void GenericSolver::reissueFactorIds() {
+  if (!factor_ids_stale_ && slot_ids_.size() == nfg_.size()) return;
+  if (factor_ids_stale_ && factor_slots_kept_ >= slot_ids_.size() &&
+      nfg_.size() >= slot_ids_.size()) {
+    // only appended to: the slots indexed before are unchanged
+    indexNewSlots(slot_ids_.size());
+    factor_ids_stale_ = false;
+    factor_slots_kept_ = std::numeric_limits<size_t>::max();
+    return;
+  }
+  // the factors kept by the rebuild keep their ids (slot_factors_ holds the
+  // indexed factors, so their addresses were not reused)
+  FlatHashMap<const gtsam::NonlinearFactor*, uint64_t> factor_ids;
+  factor_ids.reserve(id_slots_.size());
+  for (size_t slot = 0; slot < slot_factors_.size(); slot++) {
+    if (slot_factors_[slot]) {
+      factor_ids[slot_factors_[slot].get()] = slot_ids_[slot];
+    }
+  }
+  slot_ids_.assign(nfg_.size(), 0);
+  slot_factors_.assign(nfg_.begin(), nfg_.end());
+  id_slots_.clear();
+  num_empty_slots_ = 0;
+  for (size_t slot = 0; slot < nfg_.size(); slot++) {
+    if (!nfg_[slot]) {
+      num_empty_slots_++;
+      continue;
+    }
+    const auto known = factor_ids.find(nfg_[slot].get());
+    uint64_t id;
+    if (known != factor_ids.end()) {
+      id = known->second;
+      factor_ids.erase(nfg_[slot].get());  // added twice: new id for the copy
+    } else {
+      id = next_factor_id_++;
+    }
+    slot_ids_[slot] = id;
+    id_slots_[id] = slot;
+  }
+  factor_ids_stale_ = false;
+  factor_slots_kept_ = std::numeric_limits<size_t>::max();
 }
 
 EdgePtr GenericSolver::removeLastFactor() {
-  size_t num_factors = nfg_.size();
-  Edge removed_edge =
-      Edge(nfg_[num_factors - 1]->front(), nfg_[num_factors - 1]->back());
-  nfg_.erase(std::prev(nfg_.end()));
+  reissueFactorIds();
+  // skip the removed slots at the end
+  while (!nfg_.empty() && !nfg_.back()) {
+    nfg_.resize(nfg_.size() - 1);
+    slot_ids_.pop_back();
+    slot_factors_.pop_back();
+    num_empty_slots_--;
+  }
+  if (nfg_.empty()) return nullptr;
+  Edge removed_edge = Edge(nfg_.back()->front(), nfg_.back()->back());
+  id_slots_.erase(slot_ids_.back());
+  nfg_.resize(nfg_.size() - 1);
+  slot_ids_.pop_back();
+  slot_factors_.pop_back();
   return make_unique<Edge>(removed_edge);
 }
 
 void GenericSolver::removePriorsWithPrefix(const char& prefix) {
-  // First make copy of nfg_
+  // First make copy of nfg_ and its factor ids
+  reissueFactorIds();
   const gtsam::NonlinearFactorGraph nfg_copy = nfg_;
-  // Clear nfg_
+  const std::vector<uint64_t> ids_copy = slot_ids_;
+  // Clear nfg_ (the removed slots are dropped too)
   nfg_ = gtsam::NonlinearFactorGraph();
+  slot_ids_.clear();
+  slot_factors_.clear();
+  id_slots_.clear();
+  num_empty_slots_ = 0;
   // Iterate and pick out non prior factors and prior factors without key with
   // prefix
-  for (auto factor : nfg_copy) {
+  for (size_t slot = 0; slot < nfg_copy.size(); slot++) {
+    const auto& factor = nfg_copy[slot];
+    if (!factor) continue;
+    bool keep = true;
     if (boost::dynamic_pointer_cast<gtsam::PriorFactor<gtsam::Pose3>>(factor)) {
       gtsam::PriorFactor<gtsam::Pose3> prior_factor =
           *boost::dynamic_pointer_cast<gtsam::PriorFactor<gtsam::Pose3>>(
               factor);
       gtsam::Symbol node(prior_factor.key());
-      if (node.chr() != prefix) nfg_.add(factor);
+      keep = node.chr() != prefix;
     } else if (boost::dynamic_pointer_cast<gtsam::PriorFactor<gtsam::Pose2>>(
                    factor)) {
       gtsam::PriorFactor<gtsam::Pose2> prior_factor =
           *boost::dynamic_pointer_cast<gtsam::PriorFactor<gtsam::Pose2>>(
               factor);
       gtsam::Symbol node(prior_factor.key());
-      if (node.chr() != prefix) nfg_.add(factor);
-    } else {
+      keep = node.chr() != prefix;
+    }
+    if (keep) {
+      id_slots_[ids_copy[slot]] = nfg_.size();
+      slot_ids_.push_back(ids_copy[slot]);
+      slot_factors_.push_back(factor);
       nfg_.add(factor);
     }
   }
@@ -5,33 +5,52 @@ author: Yun Chang, Luca Carlone
 
 #include "KimeraRPGO/RobustSolver.h"
 
+#include <algorithm>
 #include <chrono>
+#include <fstream>
+#include <map>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <gtsam/inference/inferenceExceptions.h>
+#include <gtsam/linear/JacobianFactor.h>
 #include <gtsam/nonlinear/DoglegOptimizer.h>
 #include <gtsam/nonlinear/GaussNewtonOptimizer.h>
 #include <gtsam/nonlinear/GncOptimizer.h>
 #include <gtsam/nonlinear/LevenbergMarquardtOptimizer.h>
+#include <gtsam/nonlinear/LinearContainerFactor.h>
 #include <gtsam/slam/dataset.h>
 
 #include "KimeraRPGO/Logger.h"
 #include "KimeraRPGO/outlier/Pcm.h"
+#include "KimeraRPGO/utils/FlatHashMap.h"
+#include "KimeraRPGO/utils/GncSolver.h"
+#include "KimeraRPGO/utils/Trace.h"
 #include "KimeraRPGO/utils/TypeUtils.h"
 
 namespace KimeraRPGO {
 
 typedef std::pair<gtsam::NonlinearFactorGraph, gtsam::Values> GraphAndValues;
 
+// Standard deviation of the weak priors that anchor the permanent variables at
+// the last solution in the temporary factor solver. They fix the gauge (as the
+// damping of LM does in the full solve) without moving the solution.
+static const double kTempAnchorSigma = 1e3;
+
+// Standard deviation of the priors that hold the live poses connected to
+// archived ones at their estimate while the archive is out of the problem.
+static const double kArchiveAnchorSigma = 1e-4;
+
 RobustSolver::RobustSolver(const RobustSolverParams& params)
     : GenericSolver(params.solver, params.specialSymbols),
       gnc_weights_(),
       gnc_num_inliers_(0),
       latest_num_lc_(0),
-      params_(params) {
+      temp_solver_num_factors_(0),
+      params_(params),
+      trace_started_(false) {
   switch (params.outlierRemovalMethod) {
     case OutlierRemovalMethod::NONE: {
       outlier_removal_ =
@@ -67,6 +86,27 @@ RobustSolver::RobustSolver(const RobustSolverParams& params)
     }
   }
 
+  // one pool for every parallel stage
+#ifdef GTSAM_USE_TBB
+  if (params.tbb_arena) {
+    thread_pool_ = KimeraRPGO::make_unique<ThreadPool>(params.tbb_arena);
+  }
+#endif
+  if (!thread_pool_) {
+    thread_pool_ = KimeraRPGO::make_unique<ThreadPool>(params.num_threads,
+                                                       params.cpu_affinity);
+  }
+  if (outlier_removal_ && thread_pool_->numThreads() > 1) {
+    outlier_removal_->setThreadPool(thread_pool_.get());
+  }
+
+  if (params.intern_noise_models) {
+    internNoiseModels();
+    if (outlier_removal_) {
+      outlier_removal_->setNoiseModelCache(noise_models_.get());
+    }
+  }
+
   // toggle verbosity
   switch (params.verbosity) {
     case Verbosity::UPDATE: {
@@ -85,6 +125,10 @@ RobustSolver::RobustSolver(const RobustSolverParams& params)
     }
   }
 
+  if (params.reuse_optimizer_context) {
+    reuseOptimizerContext(params.reorder_growth);
+  }
+
   // set log output
   if (params.log_output) {
     if (outlier_removal_) outlier_removal_->logOutput(params.log_folder);
@@ -96,6 +140,20 @@ RobustSolver::RobustSolver(const RobustSolverParams& params)
     outfile << "graph-size,spin-time(mu-s),num-lc,num-inliers\n";
     outfile.close();
   }
+
+  if (!params.trace_file.empty()) {
+    trace_started_ = Trace::start(params.trace_file);
+    if (!trace_started_) {
+      log<WARNING>("Trace recorded to another file, not tracing to %1%") %
+          params.trace_file;
+    }
+  }
+}
+
+RobustSolver::~RobustSolver() {
+  if (trace_started_ && !Trace::stop()) {
+    log<WARNING>("Failed to write trace to %1%") % params_.trace_file;
+  }
 }
 
 void RobustSolver::getGncKnownInliers(InlierVectorType* known_inliers) {
@@ -106,15 +164,30 @@ void RobustSolver::getGncKnownInliers(InlierVectorType* known_inliers) {
   std::iota(std::begin(*known_inliers),
             std::begin(*known_inliers) + num_odom_factors + num_special_factors,
             0);
+  // the archive anchors, appended after the temporary factors
+  const size_t first_anchor = nfg_.size() + temp_nfg_.size();
+  for (size_t i = 0; i < archive_priors_.size(); i++) {
+    known_inliers->push_back(first_anchor + i);
+  }
 }
 
 void RobustSolver::optimize() {
+  RPGO_TRACE_SCOPE("RobustSolver::optimize");
+  // a new problem: the running sliced optimization is superseded
+  sliced_.reset();
+  // GNC takes the odometry and special factors first as known inliers
+  if (params_.use_gnc_ && outlier_removal_) {
+    saveFactors();
+    outlier_removal_->restoreOutputLayout(&nfg_);
+    invalidateFactorIds();
+  }
   gtsam::Values result;
   gtsam::Values full_values = values_;
   gtsam::NonlinearFactorGraph full_nfg = nfg_;
   // Merge in temporary values and factors
   full_values.insert(temp_values_);
   full_nfg.add(temp_nfg_);
+  applyArchive(&full_nfg);
 
   if (solver_type_ == Solver::LM) {
     gtsam::LevenbergMarquardtParams lmParams;
@@ -126,42 +199,73 @@ void RobustSolver::optimize() {
     if (params_.use_gnc_ && outlier_removal_ &&
         !(params_.gnc_params.fix_prev_inliers_ &&
           outlier_removal_->getNumLC() == latest_num_lc_)) {
-      gtsam::GncParams<gtsam::LevenbergMarquardtParams> gncParams(lmParams);
+      // GNC runs one LM per iteration: share the ordering, not the damping
+      if (optimizer_context_) {
+        optimizer_context_->setup(full_nfg, &lmParams, false);
+      }
       InlierVectorType known_inlier_factor_indices;
       getGncKnownInliers(&known_inlier_factor_indices);
-      gncParams.setKnownInliers(known_inlier_factor_indices);
-      gncParams.setMaxIterations(params_.gnc_params.max_iterations_);
-      gncParams.setMuStep(params_.gnc_params.mu_step_);
-      gncParams.setRelativeCostTol(params_.gnc_params.relative_cost_tol_);
-      gncParams.setWeightsTol(params_.gnc_params.weights_tol_);
-      // Create GNC optimizer
-      gtsam::GncOptimizer<gtsam::GncParams<gtsam::LevenbergMarquardtParams> >
-          gnc_optimizer(full_nfg, full_values, gncParams);
+      gtsam::Vector init_weights;
       if (params_.gnc_params.bias_odom_) {
         // Set initial weights to bias odom
-        gtsam::Vector init_weights = Eigen::VectorXd::Zero(full_nfg.size());
+        init_weights = Eigen::VectorXd::Zero(full_nfg.size());
         for (const auto& ind : known_inlier_factor_indices) {
           init_weights(ind) = 1;
         }
-        gnc_optimizer.setWeights(init_weights);
-      }
-      switch (params_.gnc_params.gnc_threshold_mode_) {
-        case (GncParams::GncThresholdMode::COST):
-          gnc_optimizer.setInlierCostThresholds(
-              params_.gnc_params.gnc_inlier_threshold_);
-          break;
-        case (GncParams::GncThresholdMode::PROBABILITY):
-          gnc_optimizer.setInlierCostThresholdsAtProbability(
-              params_.gnc_params.gnc_inlier_threshold_);
-          break;
-        default:
-          log<WARNING>("Unsupported GNC threshold mode. ");
       }
-      // Optimize and get weights
       auto opt_start_t = std::chrono::high_resolution_clock::now();
-      result = gnc_optimizer.optimize();
-      gtsam::Vector gnc_all_weights = gnc_optimizer.getWeights();
-      gnc_weights_ = gnc_all_weights.head(nfg_.size());
+      gtsam::Vector gnc_all_weights;
+      // gtsam::GncOptimizer cannot be resumed: slices run the native solver
+      if (params_.gnc_params.native_ || slicing()) {
+        auto gnc_solver = KimeraRPGO::make_unique<GncSolver>(
+            full_nfg,
+            full_values,
+            lmParams,
+            params_.gnc_params,
+            std::vector<size_t>(known_inlier_factor_indices.begin(),
+                                known_inlier_factor_indices.end()));
+        if (params_.gnc_params.bias_odom_) gnc_solver->setWeights(init_weights);
+        gnc_solver->setThreadPool(thread_pool_.get());
+        if (slicing()) {
+          sliced_ = KimeraRPGO::make_unique<SlicedOptimization>();
+          sliced_->gnc = std::move(gnc_solver);
+          sliced_->num_known_inliers = known_inlier_factor_indices.size();
+          return;
+        }
+        // Optimize and get weights
+        result = gnc_solver->optimize();
+        gnc_all_weights = gnc_solver->getWeights();
+      } else {
+        gtsam::GncParams<gtsam::LevenbergMarquardtParams> gncParams(lmParams);
+        gncParams.setKnownInliers(known_inlier_factor_indices);
+        gncParams.setMaxIterations(params_.gnc_params.max_iterations_);
+        gncParams.setMuStep(params_.gnc_params.mu_step_);
+        gncParams.setRelativeCostTol(params_.gnc_params.relative_cost_tol_);
+        gncParams.setWeightsTol(params_.gnc_params.weights_tol_);
+        // Create GNC optimizer
+        gtsam::GncOptimizer<
+            gtsam::GncParams<gtsam::LevenbergMarquardtParams> >
+            gnc_optimizer(full_nfg, full_values, gncParams);
+        if (params_.gnc_params.bias_odom_) {
+          gnc_optimizer.setWeights(init_weights);
+        }
+        switch (params_.gnc_params.gnc_threshold_mode_) {
+          case (GncParams::GncThresholdMode::COST):
+            gnc_optimizer.setInlierCostThresholds(
+                params_.gnc_params.gnc_inlier_threshold_);
+            break;
+          case (GncParams::GncThresholdMode::PROBABILITY):
+            gnc_optimizer.setInlierCostThresholdsAtProbability(
+                params_.gnc_params.gnc_inlier_threshold_);
+            break;
+          default:
+            log<WARNING>("Unsupported GNC threshold mode. ");
+        }
+        // Optimize and get weights
+        result = gnc_optimizer.optimize();
+        gnc_all_weights = gnc_optimizer.getWeights();
+      }
+      setGncWeights(gnc_all_weights);
       gnc_num_inliers_ = static_cast<size_t>(gnc_all_weights.sum()) -
                          known_inlier_factor_indices.size() - temp_nfg_.size();
       auto opt_stop_t = std::chrono::high_resolution_clock::now();
@@ -189,10 +293,22 @@ void RobustSolver::optimize() {
           }
         }
         full_nfg.add(temp_nfg_);
+        applyArchive(&full_nfg);
       }
-      result =
-          gtsam::LevenbergMarquardtOptimizer(full_nfg, full_values, lmParams)
-              .optimize();
+      if (optimizer_context_) optimizer_context_->setup(full_nfg, &lmParams);
+      if (slicing()) {
+        sliced_ = KimeraRPGO::make_unique<SlicedOptimization>();
+        sliced_->optimizer =
+            KimeraRPGO::make_unique<gtsam::LevenbergMarquardtOptimizer>(
+                full_nfg, full_values, lmParams);
+        sliced_->params = lmParams;
+        sliced_->iteration_name = "LM iteration";
+        return;
+      }
+      gtsam::LevenbergMarquardtOptimizer optimizer(
+          full_nfg, full_values, lmParams);
+      result = tracedOptimize(&optimizer, lmParams, "LM iteration");
+      if (optimizer_context_) optimizer_context_->setLambda(optimizer.lambda());
       auto opt_stop_t = std::chrono::high_resolution_clock::now();
       auto opt_duration = std::chrono::duration_cast<std::chrono::milliseconds>(
           opt_stop_t - opt_start_t);
@@ -211,6 +327,7 @@ void RobustSolver::optimize() {
       log<INFO>("Running GN");
     }
     if (params_.use_gnc_ && outlier_removal_) {
+      if (optimizer_context_) optimizer_context_->setup(full_nfg, &gnParams);
       gtsam::GncParams<gtsam::GaussNewtonParams> gncParams(gnParams);
       InlierVectorType known_inlier_factor_indices;
       getGncKnownInliers(&known_inlier_factor_indices);
@@ -246,7 +363,7 @@ void RobustSolver::optimize() {
       auto opt_start_t = std::chrono::high_resolution_clock::now();
       result = gnc_optimizer.optimize();
       gtsam::Vector gnc_all_weights = gnc_optimizer.getWeights();
-      gnc_weights_ = gnc_all_weights.head(nfg_.size());
+      setGncWeights(gnc_all_weights);
       gnc_num_inliers_ = static_cast<size_t>(gnc_all_weights.sum()) -
                          known_inlier_factor_indices.size();
       auto opt_stop_t = std::chrono::high_resolution_clock::now();
@@ -260,8 +377,18 @@ void RobustSolver::optimize() {
             gnc_num_inliers_;
       }
     } else {
-      result = gtsam::GaussNewtonOptimizer(full_nfg, full_values, gnParams)
-                   .optimize();
+      if (optimizer_context_) optimizer_context_->setup(full_nfg, &gnParams);
+      if (slicing()) {
+        sliced_ = KimeraRPGO::make_unique<SlicedOptimization>();
+        sliced_->optimizer =
+            KimeraRPGO::make_unique<gtsam::GaussNewtonOptimizer>(
+                full_nfg, full_values, gnParams);
+        sliced_->params = gnParams;
+        sliced_->iteration_name = "GN iteration";
+        return;
+      }
+      gtsam::GaussNewtonOptimizer optimizer(full_nfg, full_values, gnParams);
+      result = tracedOptimize(&optimizer, gnParams, "GN iteration");
     }
 
   } else {
@@ -272,16 +399,155 @@ void RobustSolver::optimize() {
   if (outlier_removal_) {
     latest_num_lc_ = outlier_removal_->getNumLC();
   }
+  invalidateTempSolver();
+}
+
+bool RobustSolver::resumeOptimization() {
+  if (!sliced_) return true;
+  RPGO_TRACE_SCOPE("RobustSolver::resumeOptimization");
+  auto slice_start_t = std::chrono::high_resolution_clock::now();
+  bool converged = false;
+  // at least one iteration per slice, the time is checked in between
+  for (size_t i = 0; !converged; i++) {
+    if (params_.slice_iterations > 0 && i >= params_.slice_iterations) break;
+    if (params_.slice_time_ms > 0 && i > 0 &&
+        std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - slice_start_t)
+                .count() >= params_.slice_time_ms) {
+      break;
+    }
+    converged = sliced_->gnc ? sliced_->gnc->iterate()
+                             : tracedIterate(sliced_->optimizer.get(),
+                                             sliced_->params,
+                                             sliced_->iteration_name);
+  }
+  if (converged) {
+    finishSlicedOptimization();
+    return true;
+  }
+  // publish the estimate of the last iteration
+  updateValues(sliced_->gnc ? sliced_->gnc->currentEstimate()
+                            : sliced_->optimizer->values());
+  return false;
+}
+
+void RobustSolver::finishSlicedOptimization() {
+  if (sliced_->gnc) {
+    const gtsam::Vector& gnc_all_weights = sliced_->gnc->getWeights();
+    setGncWeights(gnc_all_weights);
+    gnc_num_inliers_ = static_cast<size_t>(gnc_all_weights.sum()) -
+                       sliced_->num_known_inliers - temp_nfg_.size();
+    updateValues(sliced_->gnc->currentEstimate());
+  } else {
+    if (optimizer_context_) {
+      auto lm = dynamic_cast<gtsam::LevenbergMarquardtOptimizer*>(
+          sliced_->optimizer.get());
+      if (lm) optimizer_context_->setLambda(lm->lambda());
+    }
+    updateValues(sliced_->optimizer->values());
+  }
+  sliced_.reset();
+  if (outlier_removal_) {
+    latest_num_lc_ = outlier_removal_->getNumLC();
+  }
+  invalidateTempSolver();
+}
+
+void RobustSolver::invalidateTempSolver() {
+  temp_solver_.reset();
+  temp_solver_factors_.clear();
+  temp_solver_keys_.clear();
+  temp_solver_num_factors_ = 0;
+}
+
+void RobustSolver::resetTempSolver() {
+  invalidateTempSolver();
+  gtsam::ISAM2Params isam_params;
+  isam_params.relinearizeSkip = 1;
+  temp_solver_ = KimeraRPGO::make_unique<gtsam::ISAM2>(isam_params);
+
+  // Permanent graph with the last GNC decision (rejected factors stay out,
+  // wherever their slot is now)
+  FlatHashMap<const gtsam::NonlinearFactor*, bool> rejected;
+  if (params_.use_gnc_ && outlier_removal_) {
+    rejected.reserve(gnc_rejected_.size());
+    for (const auto& factor : gnc_rejected_) rejected[factor.get()] = true;
+  }
+  gtsam::NonlinearFactorGraph permanent_nfg;
+  for (size_t i = 0; i < nfg_.size(); i++) {
+    if (!nfg_[i]) continue;
+    if (rejected.find(nfg_[i].get()) != rejected.end()) continue;
+    permanent_nfg.add(nfg_[i]);
+  }
+  applyArchive(&permanent_nfg);
+  for (const auto& v : values_) {
+    const size_t dim = v.value.dim();
+    gtsam::Values lin_point;
+    lin_point.insert(v.key, v.value);
+    permanent_nfg.add(gtsam::LinearContainerFactor(
+        gtsam::JacobianFactor(v.key,
+                              gtsam::Matrix::Identity(dim, dim) /
+                                  kTempAnchorSigma,
+                              gtsam::Vector::Zero(dim)),
+        lin_point));
+  }
+  temp_solver_->update(permanent_nfg, values_);
+  temp_solver_num_factors_ = nfg_.size();
+}
+
+void RobustSolver::updateTempFactors() {
+  auto start = std::chrono::high_resolution_clock::now();
+
+  // ISAM2 cannot drop variables, so start over if a temp value was removed
+  bool reset = !temp_solver_ || temp_solver_num_factors_ != nfg_.size();
+  for (const auto& key : temp_solver_keys_) {
+    if (!temp_values_.exists(key)) {
+      reset = true;
+      break;
+    }
+  }
+  if (reset) resetTempSolver();
+
+  gtsam::Values new_values;
+  for (const auto& v : temp_values_) {
+    if (temp_solver_keys_.count(v.key) == 0) {
+      new_values.insert(v.key, v.value);
+      temp_solver_keys_.insert(v.key);
+    }
+  }
+  gtsam::NonlinearFactorGraph new_factors;
+  for (const auto& factor : temp_nfg_) {
+    if (factor) new_factors.add(factor);
+  }
+  // swap the previous temp factors for the current ones
+  gtsam::ISAM2Result result =
+      temp_solver_->update(new_factors, new_values, temp_solver_factors_);
+  temp_solver_factors_ = result.newFactorsIndices;
+  updateValues(temp_solver_->calculateEstimate());
+
+  auto stop = std::chrono::high_resolution_clock::now();
+  auto duration =
+      std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+  if (debug_) {
+    log<INFO>("Temporary factor update took %1% microseconds (%2%). ") %
+        duration.count() % (reset ? "reseeded" : "incremental");
+  }
 }
 
 void RobustSolver::forceUpdate(const gtsam::NonlinearFactorGraph& nfg,
                                const gtsam::Values& values) {
   // Start timer
   auto start = std::chrono::high_resolution_clock::now();
+  const gtsam::NonlinearFactorGraph fast_nfg =
+      toFastBetweenFactors(nfg, noise_models_.get());
+  rehydrate(fast_nfg);
+  saveFactors();
   if (outlier_removal_) {
-    outlier_removal_->removeOutliers(nfg, values, &nfg_, &values_);
+    saveValuesBeforeOutlierRemoval(values);
+    outlier_removal_->removeOutliers(fast_nfg, values, &nfg_, &values_);
+    invalidateFactorIds();
   } else {
-    addAndCheckIfOptimize(nfg, values);
+    addAndCheckIfOptimize(fast_nfg, values);
   }
   // optimize
   optimize();
@@ -293,6 +559,7 @@ void RobustSolver::forceUpdate(const gtsam::NonlinearFactorGraph& nfg,
 
   // Log status
   if (log_) {
+    RPGO_TRACE_SCOPE("RobustSolver::log");
     std::string filename = log_folder_ + "/rpgo_status.csv";
     std::ofstream outfile;
     outfile.open(filename, std::ofstream::out | std::ofstream::app);
@@ -303,18 +570,31 @@ void RobustSolver::forceUpdate(const gtsam::NonlinearFactorGraph& nfg,
   }
 }
 
-void RobustSolver::update(const gtsam::NonlinearFactorGraph& factors,
-                          const gtsam::Values& values,
-                          bool optimize_graph) {
+FactorIds RobustSolver::update(const gtsam::NonlinearFactorGraph& factors,
+                               const gtsam::Values& values,
+                               bool optimize_graph) {
+  RPGO_TRACE_SCOPE("RobustSolver::update");
   // Start timer
   auto start = std::chrono::high_resolution_clock::now();
+  invalidateTempSolver();
 
+  // analytic Jacobians for the relative pose factors
+  const gtsam::NonlinearFactorGraph fast_factors =
+      toFastBetweenFactors(factors, noise_models_.get());
+  rehydrate(fast_factors);
   bool do_optimize;
+  FactorIds ids;
+  saveFactors();
   if (outlier_removal_) {
+    saveValuesBeforeOutlierRemoval(values);
     do_optimize =
-        outlier_removal_->removeOutliers(factors, values, &nfg_, &values_);
+        outlier_removal_->removeOutliers(fast_factors, values, &nfg_, &values_);
+    // the factors added are found by address (not copied by the rejection)
+    const size_t kept_slots = outlier_removal_->getNumKeptOutputSlots();
+    invalidateFactorIds(kept_slots);
+    ids = findFactorIds(fast_factors, kept_slots);
   } else {
-    do_optimize = addAndCheckIfOptimize(factors, values);
+    do_optimize = addAndCheckIfOptimize(fast_factors, values, &ids);
   }
 
   if (do_optimize & optimize_graph) optimize();  // optimize once after loading
@@ -326,6 +606,7 @@ void RobustSolver::update(const gtsam::NonlinearFactorGraph& factors,
 
   // Log status
   if (log_ && optimize_graph) {
+    RPGO_TRACE_SCOPE("RobustSolver::log");
     std::string filename = log_folder_ + "/rpgo_status.csv";
     std::ofstream outfile;
     outfile.open(filename, std::ofstream::out | std::ofstream::app);
@@ -334,17 +615,20 @@ void RobustSolver::update(const gtsam::NonlinearFactorGraph& factors,
     outfile.close();
     saveData(log_folder_);
   }
-  return;
+  return ids;
 }
 
 void RobustSolver::removePriorFactorsWithPrefix(const char& prefix,
                                                 bool optimize_graph) {
+  saveFactors();
   if (outlier_removal_) {
     // removing loop closure so values should not change
     outlier_removal_->removePriorFactorsWithPrefix(prefix, &nfg_);
+    invalidateFactorIds();
   } else {
     removePriorsWithPrefix(prefix);
   }
+  invalidateTempSolver();
   if (optimize_graph) optimize();
   return;
 }
@@ -352,9 +636,11 @@ void RobustSolver::removePriorFactorsWithPrefix(const char& prefix,
 EdgePtr RobustSolver::removeLastLoopClosure(char prefix_1, char prefix_2) {
   ObservationId id(prefix_1, prefix_2);
   EdgePtr removed_edge;
+  saveFactors();
   if (outlier_removal_) {
     // removing loop closure so values should not change
     removed_edge = outlier_removal_->removeLastLoopClosure(id, &nfg_);
+    invalidateFactorIds();
   } else {
     removed_edge = removeLastFactor();
   }
@@ -365,9 +651,11 @@ EdgePtr RobustSolver::removeLastLoopClosure(char prefix_1, char prefix_2) {
 
 EdgePtr RobustSolver::removeLastLoopClosure() {
   EdgePtr removed_edge;
+  saveFactors();
   if (outlier_removal_) {
     // removing loop closure so values should not change
     removed_edge = outlier_removal_->removeLastLoopClosure(&nfg_);
+    invalidateFactorIds();
   } else {
     removed_edge = removeLastFactor();
   }
@@ -377,8 +665,10 @@ EdgePtr RobustSolver::removeLastLoopClosure() {
 }
 
 void RobustSolver::ignorePrefix(char prefix) {
+  saveFactors();
   if (outlier_removal_) {
     outlier_removal_->ignoreLoopClosureWithPrefix(prefix, &nfg_);
+    invalidateFactorIds();
   } else {
     log<WARNING>(
         "'ignorePrefix' currently not implemented for no outlier rejection "
@@ -390,8 +680,10 @@ void RobustSolver::ignorePrefix(char prefix) {
 }
 
 void RobustSolver::revivePrefix(char prefix) {
+  saveFactors();
   if (outlier_removal_) {
     outlier_removal_->reviveLoopClosureWithPrefix(prefix, &nfg_);
+    invalidateFactorIds();
   } else {
     log<WARNING>(
         "'revivePrefix' and 'ignorePrefix' currently not implemented for no "
@@ -402,6 +694,267 @@ void RobustSolver::revivePrefix(char prefix) {
   return;
 }
 
+bool RobustSolver::beginSpeculative() {
+  if (speculative_) {
+    log<WARNING>("Already speculative (speculative updates are not nested)");
+    return false;
+  }
+  if (outlier_removal_ && !outlier_removal_->beginSpeculative()) {
+    log<WARNING>("Outlier rejection method cannot undo speculative updates");
+    return false;
+  }
+  speculative_ = KimeraRPGO::make_unique<SpeculativeState>();
+  speculative_->factors_saved = false;
+  speculative_->gnc_weights_saved = false;
+  speculative_->gnc_num_inliers = gnc_num_inliers_;
+  speculative_->latest_num_lc = latest_num_lc_;
+  speculative_->temp_nfg = temp_nfg_;
+  speculative_->temp_values = temp_values_;
+  speculative_->rehydrated = false;
+  values_undo_ = KimeraRPGO::make_unique<ValuesUndoLog>();
+  return true;
+}
+
+void RobustSolver::commit() {
+  if (!speculative_) {
+    log<WARNING>("commit called without beginSpeculative");
+    return;
+  }
+  if (outlier_removal_) outlier_removal_->commitSpeculative();
+  speculative_.reset();
+  values_undo_.reset();
+}
+
+void RobustSolver::rollback() {
+  if (!speculative_) {
+    log<WARNING>("rollback called without beginSpeculative");
+    return;
+  }
+  RPGO_TRACE_SCOPE("RobustSolver::rollback");
+  if (outlier_removal_) outlier_removal_->rollbackSpeculative();
+  if (speculative_->factors_saved) {
+    nfg_ = speculative_->nfg;
+    invalidateFactorIds();
+  }
+  undoValues();
+  if (speculative_->rehydrated) {
+    // the saved graph still has empty slots for the rehydrated odometry
+    outlier_removal_->restoreOdometry(SlottedFactors(), &nfg_);
+    invalidateFactorIds();
+    updateArchiveAnchors();
+  }
+  if (speculative_->gnc_weights_saved) {
+    gnc_weights_.swap(speculative_->gnc_weights);
+    std::swap(gnc_rejected_, speculative_->gnc_rejected);
+  }
+  gnc_num_inliers_ = speculative_->gnc_num_inliers;
+  latest_num_lc_ = speculative_->latest_num_lc;
+  temp_nfg_ = speculative_->temp_nfg;
+  temp_values_.swap(speculative_->temp_values);
+  invalidateTempSolver();
+  sliced_.reset();
+  speculative_.reset();
+}
+
+bool RobustSolver::archive(char prefix, size_t end_index) {
+  if (!outlier_removal_) {
+    log<WARNING>("Archiving needs an outlier rejection method (PCM)");
+    return false;
+  }
+  if (params_.multirobot_align_method != MultiRobotAlignMethod::NONE) {
+    log<WARNING>("Archiving not supported with multirobot alignment");
+    return false;
+  }
+  if (speculative_) {
+    log<WARNING>("Cannot archive during a speculative update");
+    return false;
+  }
+  RPGO_TRACE_SCOPE("RobustSolver::archive");
+  gtsam::KeySet region;
+  for (const auto& v : values_) {
+    const gtsam::Symbol symb(v.key);
+    if (symb.chr() != prefix || symb.index() >= end_index) continue;
+    if (dynamic_cast<const gtsam::GenericValue<gtsam::Pose3>*>(&v.value) ||
+        dynamic_cast<const gtsam::GenericValue<gtsam::Pose2>*>(&v.value)) {
+      region.insert(v.key);
+    }
+  }
+  if (region.empty()) return false;
+
+  // poses with a factor leaving the region stay live
+  gtsam::KeySet boundary;
+  for (const gtsam::NonlinearFactorGraph* graph : {&nfg_, &temp_nfg_}) {
+    for (const auto& factor : *graph) {
+      if (!factor) continue;
+      const bool leaves = std::any_of(
+          factor->begin(), factor->end(), [&region](gtsam::Key key) {
+            return region.count(key) == 0;
+          });
+      if (!leaves) continue;
+      for (const gtsam::Key& key : *factor) {
+        if (region.count(key)) boundary.insert(key);
+      }
+    }
+  }
+  gtsam::Values poses;
+  for (const gtsam::Key& key : region) {
+    if (!boundary.count(key)) poses.insert(key, values_.at(key));
+  }
+  if (poses.empty()) return false;
+
+  SlottedFactors released;
+  if (!outlier_removal_->releaseOdometry(region, &released, &nfg_)) {
+    log<WARNING>("Outlier rejection method cannot release its odometry");
+    return false;
+  }
+  invalidateFactorIds();
+  for (const auto& v : poses) values_.erase(v.key);
+  archive_.add(poses, released);
+  if (debug_) {
+    log<INFO>("Archived %1% poses and %2% factors of robot %3%") %
+        poses.size() % released.size() % prefix;
+  }
+  sliced_.reset();
+  invalidateTempSolver();
+  updateArchiveAnchors();
+  return true;
+}
+
+void RobustSolver::rehydrateAll() {
+  if (archive_.empty()) return;
+  gtsam::Values poses;
+  SlottedFactors released;
+  while (!archive_.empty()) {
+    archive_.extract(archive_.numSegments() - 1, &poses, &released);
+  }
+  restoreArchived(poses, released);
+}
+
+void RobustSolver::rehydrate(const gtsam::NonlinearFactorGraph& factors) {
+  if (archive_.empty()) return;
+  // first segment reached, per robot: the later segments of the robot may
+  // hold the poses of its factors
+  std::map<char, size_t> first_segment;
+  for (const auto& factor : factors) {
+    if (!factor) continue;
+    for (const gtsam::Key& key : *factor) {
+      size_t segment;
+      if (values_.exists(key) || !archive_.find(key, &segment)) continue;
+      const char prefix = archive_.prefix(segment);
+      auto first = first_segment.emplace(prefix, segment).first;
+      first->second = std::min(first->second, segment);
+    }
+  }
+  if (first_segment.empty()) return;
+  RPGO_TRACE_SCOPE("RobustSolver::rehydrate");
+  gtsam::Values poses;
+  SlottedFactors released;
+  for (size_t i = archive_.numSegments(); i-- > 0;) {
+    const auto first = first_segment.find(archive_.prefix(i));
+    if (first != first_segment.end() && i >= first->second) {
+      archive_.extract(i, &poses, &released);
+    }
+  }
+  restoreArchived(poses, released);
+}
+
+void RobustSolver::restoreArchived(const gtsam::Values& poses,
+                                   const SlottedFactors& released) {
+  // not in the undo log of the values: a rollback keeps them
+  values_.insert(poses);
+  outlier_removal_->restoreOdometry(released, &nfg_);
+  invalidateFactorIds();
+  if (speculative_) speculative_->rehydrated = true;
+  if (debug_) {
+    log<INFO>("Rehydrated %1% poses and %2% factors") % poses.size() %
+        released.size();
+  }
+  sliced_.reset();
+  invalidateTempSolver();
+  updateArchiveAnchors();
+}
+
+void RobustSolver::updateArchiveAnchors() {
+  gtsam::NonlinearFactorGraph anchors;
+  if (!archive_.empty()) {
+    gtsam::KeySet anchored;
+    const gtsam::KeySet archived_ends = archive_.factorKeys();
+    // the anchors that remain keep their pose
+    for (const auto& prior : archive_priors_) {
+      const gtsam::Key key = prior->front();
+      if (values_.exists(key) && archived_ends.count(key)) {
+        anchors.add(prior);
+        anchored.insert(key);
+      }
+    }
+    for (const gtsam::Key& key : archived_ends) {
+      if (anchored.count(key) || !values_.exists(key)) continue;
+      const gtsam::Value& value = values_.at(key);
+      if (dynamic_cast<const gtsam::GenericValue<gtsam::Pose3>*>(&value)) {
+        anchors.add(gtsam::PriorFactor<gtsam::Pose3>(
+            key,
+            values_.at<gtsam::Pose3>(key),
+            gtsam::noiseModel::Isotropic::Sigma(6, kArchiveAnchorSigma)));
+      } else {
+        anchors.add(gtsam::PriorFactor<gtsam::Pose2>(
+            key,
+            values_.at<gtsam::Pose2>(key),
+            gtsam::noiseModel::Isotropic::Sigma(3, kArchiveAnchorSigma)));
+      }
+    }
+  }
+  archive_priors_ = anchors;
+}
+
+void RobustSolver::applyArchive(gtsam::NonlinearFactorGraph* full_nfg) const {
+  if (archive_.empty()) return;
+  for (size_t i = 0; i < full_nfg->size(); i++) {
+    const auto& factor = full_nfg->at(i);
+    if (!factor) continue;
+    for (const gtsam::Key& key : *factor) {
+      if (isArchived(key)) {
+        // the slot stays: GNC weights and known inliers are by slot
+        full_nfg->remove(i);
+        break;
+      }
+    }
+  }
+  full_nfg->add(archive_priors_);
+}
+
+void RobustSolver::saveFactors() {
+  if (!speculative_ || speculative_->factors_saved) return;
+  speculative_->nfg = nfg_;
+  speculative_->factors_saved = true;
+}
+
+void RobustSolver::saveValuesBeforeOutlierRemoval(
+    const gtsam::Values& new_values) {
+  if (!values_undo_) return;
+  for (const auto& v : new_values) saveValue(v.key);
+  // the frame alignment can move every pose
+  if (params_.multirobot_align_method != MultiRobotAlignMethod::NONE) {
+    for (const auto& v : values_) saveValue(v.key);
+  }
+}
+
+void RobustSolver::saveGncWeights() {
+  if (!speculative_ || speculative_->gnc_weights_saved) return;
+  // replaced right after: no copy
+  speculative_->gnc_weights.swap(gnc_weights_);
+  std::swap(speculative_->gnc_rejected, gnc_rejected_);
+  speculative_->gnc_weights_saved = true;
+}
+
+void RobustSolver::setGncWeights(const gtsam::Vector& all_weights) {
+  saveGncWeights();
+  gnc_weights_ = all_weights.head(nfg_.size());
+  gnc_rejected_ = gtsam::NonlinearFactorGraph();
+  for (size_t i = 0; i < nfg_.size(); i++) {
+    if (nfg_[i] && gnc_weights_(i) < 0.5) gnc_rejected_.add(nfg_[i]);
+  }
+}
+
 std::vector<char> RobustSolver::getIgnoredPrefixes() {
   if (outlier_removal_) {
     return outlier_removal_->getIgnoredPrefixes();
@@ -416,7 +969,18 @@ std::vector<char> RobustSolver::getIgnoredPrefixes() {
 
 void RobustSolver::saveData(std::string folder_path) const {
   std::string g2o_file_path = folder_path + "/result.g2o";
-  KimeraRPGO::writeG2o(nfg_, values_, g2o_file_path);
+  if (archive_.empty()) {
+    KimeraRPGO::writeG2o(nfg_, values_, g2o_file_path);
+  } else {
+    // the full graph, and the packed archive to restore it from
+    gtsam::NonlinearFactorGraph nfg = nfg_;
+    gtsam::Values values = values_;
+    archive_.unpack(&nfg, &values);
+    KimeraRPGO::writeG2o(nfg, values, g2o_file_path);
+    std::ofstream archive_file(folder_path + "/archive.bin",
+                               std::ios::binary);
+    archive_.save(archive_file);
+  }
   if (outlier_removal_) {
     outlier_removal_->saveData(folder_path);
   }
@@ -433,4 +997,16 @@ void RobustSolver::saveData(std::string folder_path) const {
   }
 }
 
+size_t RobustSolver::exportTrajectories(const std::string& folder_path,
+                                        TrajectoryFormat format) const {
+  RPGO_TRACE_SCOPE("RobustSolver::exportTrajectories");
+  if (archive_.empty()) {
+    return writeTrajectories(values_, folder_path, format, thread_pool_.get());
+  }
+  gtsam::Values values = values_;
+  gtsam::NonlinearFactorGraph archived_factors;
+  archive_.unpack(&archived_factors, &values);
+  return writeTrajectories(values, folder_path, format, thread_pool_.get());
+}
+
 }  // namespace KimeraRPGO
@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <cstdint>
+
+#include "KimeraRPGO/utils/Arena.h"
+
+namespace KimeraRPGO {
+
+MonotonicArena::MonotonicArena(size_t initial_block_size)
+    : initial_block_size_(std::max<size_t>(initial_block_size, 64)),
+      offset_(0),
+      bytes_used_(0),
+      capacity_(0) {}
+
+void* MonotonicArena::allocate(size_t bytes, size_t alignment) {
+  if (bytes == 0) bytes = 1;
+  if (!blocks_.empty()) {
+    Block& block = blocks_.back();
+    const uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+    const uintptr_t aligned =
+        (base + offset_ + alignment - 1) & ~(uintptr_t(alignment) - 1);
+    const size_t start = aligned - base;
+    if (start + bytes <= block.size) {
+      bytes_used_ += start + bytes - offset_;
+      offset_ = start + bytes;
+      return block.data.get() + start;
+    }
+  }
+  // does not fit: chain a new block (padding for alignment included)
+  addBlock(bytes + alignment);
+  return allocate(bytes, alignment);
+}
+
+void MonotonicArena::reset() {
+  if (blocks_.size() > 1) {
+    // coalesce so that the next spin of the same size needs a single block
+    const size_t total = capacity_;
+    blocks_.clear();
+    capacity_ = 0;
+    addBlock(total);
+  }
+  offset_ = 0;
+  bytes_used_ = 0;
+}
+
+void MonotonicArena::addBlock(size_t min_size) {
+  size_t size = blocks_.empty() ? initial_block_size_ : 2 * blocks_.back().size;
+  size = std::max(size, min_size);
+  Block block;
+  block.data.reset(new char[size]);
+  block.size = size;
+  blocks_.push_back(std::move(block));
+  capacity_ += size;
+  offset_ = 0;
+}
+
+}  // namespace KimeraRPGO
@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <boost/math/distributions/chi_squared.hpp>
+
+#include <gtsam/linear/HessianFactor.h>
+#include <gtsam/linear/JacobianFactor.h>
+
+#include "KimeraRPGO/Logger.h"
+#include "KimeraRPGO/utils/GncSolver.h"
+#include "KimeraRPGO/utils/Trace.h"
+#include "KimeraRPGO/utils/TypeUtils.h"
+
+namespace KimeraRPGO {
+
+namespace {
+// below this many factors per thread the residuals are evaluated serially
+const size_t kMinFactorsPerThread = 512;
+// floor of the initial mu (gtsam::GncOptimizer::initializeMu)
+const double kMinInitialMu = 1e-6;
+}  // namespace
+
+boost::shared_ptr<gtsam::GaussianFactor> WeightedFactor::linearize(
+    const gtsam::Values& values) const {
+  boost::shared_ptr<gtsam::GaussianFactor> linear = factor_->linearize(values);
+  if (*weight_ == 1.0 || !linear) return linear;
+
+  boost::shared_ptr<gtsam::JacobianFactor> jacobian =
+      boost::dynamic_pointer_cast<gtsam::JacobianFactor>(linear);
+  if (!jacobian) {
+    const boost::shared_ptr<gtsam::HessianFactor> hessian =
+        boost::dynamic_pointer_cast<gtsam::HessianFactor>(linear);
+    if (!hessian) return linear;
+    jacobian = boost::make_shared<gtsam::JacobianFactor>(*hessian);
+  }
+  // rows of a noise model factor are whitened: scale [A b] in place
+  jacobian->matrixObject().full() *= std::sqrt(*weight_);
+  return jacobian;
+}
+
+GncSolver::GncSolver(const gtsam::NonlinearFactorGraph& nfg,
+                     const gtsam::Values& initial,
+                     const gtsam::LevenbergMarquardtParams& lm_params,
+                     const GncParams& gnc_params,
+                     const std::vector<size_t>& known_inliers)
+    : nfg_(nfg),
+      estimate_(initial),
+      lm_params_(lm_params),
+      gnc_params_(gnc_params),
+      known_inlier_(nfg.size(), false),
+      num_known_inliers_(0),
+      own_thread_pool_(KimeraRPGO::make_unique<ThreadPool>(1)),
+      thread_pool_(own_thread_pool_.get()),
+      weights_(gtsam::Vector::Ones(nfg.size())),
+      barc_sq_(gtsam::Vector::Ones(nfg.size())),
+      residuals_(gtsam::Vector::Zero(nfg.size())),
+      lambda_(lm_params.lambdaInitial),
+      has_lambda_(false),
+      iterations_(0),
+      inner_iterations_(0),
+      mu_initialized_(false),
+      mu_(-1),
+      prev_cost_(0),
+      done_(false),
+      mu_step_begin_(-1) {
+  for (const size_t& k : known_inliers) {
+    if (k < nfg_.size() && !known_inlier_[k]) {
+      known_inlier_[k] = true;
+      num_known_inliers_++;
+    }
+  }
+
+  // inlier thresholds (as gtsam::GncOptimizer)
+  for (size_t k = 0; k < nfg_.size(); k++) {
+    if (!nfg_[k]) continue;
+    if (gnc_params_.gnc_threshold_mode_ ==
+        GncParams::GncThresholdMode::PROBABILITY) {
+      boost::math::chi_squared_distribution<double> chi2(nfg_[k]->dim());
+      barc_sq_(k) =
+          0.5 * boost::math::quantile(chi2, gnc_params_.gnc_inlier_threshold_);
+    } else {
+      barc_sq_(k) = gnc_params_.gnc_inlier_threshold_;
+    }
+  }
+
+  // weighted view of the graph: built once, reads weights_ in place
+  weighted_nfg_.reserve(nfg_.size());
+  for (size_t k = 0; k < nfg_.size(); k++) {
+    if (nfg_[k]) {
+      weighted_nfg_.push_back(
+          boost::make_shared<WeightedFactor>(nfg_[k], weights_.data() + k));
+    } else {
+      weighted_nfg_.push_back(gtsam::NonlinearFactor::shared_ptr());
+    }
+  }
+
+  // one ordering for every inner solve
+  if (!lm_params_.ordering) {
+    lm_params_.setOrdering(gtsam::Ordering::Colamd(nfg_));
+  }
+}
+
+void GncSolver::setWeights(const gtsam::Vector& weights) {
+  if (static_cast<size_t>(weights.size()) != nfg_.size()) {
+    log<WARNING>("GncSolver: expected %1% weights, got %2%. ") % nfg_.size() %
+        weights.size();
+    return;
+  }
+  // assign in place: the weighted factors point into weights_
+  weights_ = weights;
+}
+
+void GncSolver::computeResiduals(const gtsam::Values& values) {
+  const size_t n = nfg_.size();
+  auto evaluate = [this, &values](size_t begin, size_t end) {
+    RPGO_TRACE_SCOPE("GncSolver::residuals");
+    for (size_t k = begin; k < end; k++) {
+      residuals_(k) = nfg_[k] ? nfg_[k]->error(values) : 0.0;
+    }
+  };
+  const size_t num_tasks =
+      std::min(thread_pool_->numThreads(), n / kMinFactorsPerThread);
+  if (num_tasks <= 1) {
+    evaluate(0, n);
+    return;
+  }
+  const size_t chunk = (n + num_tasks - 1) / num_tasks;
+  thread_pool_->parallelFor(
+      num_tasks,
+      [&](size_t t) {
+        evaluate(std::min(n, t * chunk), std::min(n, (t + 1) * chunk));
+      },
+      num_tasks);
+}
+
+double GncSolver::weightedCost() const { return weights_.dot(residuals_); }
+
+double GncSolver::initializeMu() const {
+  // Remark 5 of the GNC paper, -1 if every residual is already small
+  double mu = std::numeric_limits<double>::infinity();
+  for (size_t k = 0; k < nfg_.size(); k++) {
+    if (!nfg_[k]) continue;
+    const double denominator = 2 * residuals_(k) - barc_sq_(k);
+    if (denominator > 0) mu = std::min(mu, barc_sq_(k) / denominator);
+  }
+  // very large residuals: floored as gtsam::GncOptimizer to avoid mu = 0
+  if (mu >= 0 && mu < kMinInitialMu) mu = kMinInitialMu;
+  if (mu > 0 && mu < std::numeric_limits<double>::infinity()) return mu;
+  return -1;
+}
+
+void GncSolver::updateWeights(double mu) {
+  for (size_t k = 0; k < nfg_.size(); k++) {
+    if (!nfg_[k] || known_inlier_[k]) continue;
+    const double u2 = residuals_(k);
+    const double upper_bound = (mu + 1) / mu * barc_sq_(k);
+    const double lower_bound = mu / (mu + 1) * barc_sq_(k);
+    double weight = std::sqrt(barc_sq_(k) * mu * (mu + 1) / u2) - mu;
+    if (u2 >= upper_bound || weight < 0) {
+      weight = 0;
+    } else if (u2 <= lower_bound || weight > 1) {
+      weight = 1;
+    }
+    weights_(k) = weight;
+  }
+}
+
+bool GncSolver::weightsConverged() const {
+  for (int k = 0; k < weights_.size(); k++) {
+    if (std::fabs(weights_(k) - std::round(weights_(k))) >
+        gnc_params_.weights_tol_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void GncSolver::startSolve() {
+  if (!mu_initialized_) {
+    // mu from the residuals at the initial estimate (as gtsam::GncOptimizer)
+    computeResiduals(estimate_);
+    mu_ = initializeMu();
+  }
+  gtsam::LevenbergMarquardtParams params = lm_params_;
+  if (has_lambda_) {
+    params.lambdaInitial = std::min(
+        std::max(lambda_, params.lambdaLowerBound), params.lambdaUpperBound);
+  }
+  inner_ = KimeraRPGO::make_unique<gtsam::LevenbergMarquardtOptimizer>(
+      weighted_nfg_, estimate_, params);
+}
+
+void GncSolver::finishSolve() {
+  estimate_ = inner_->values();
+  lambda_ = inner_->lambda();
+  has_lambda_ = true;
+  inner_iterations_ += inner_->iterations();
+  inner_.reset();
+}
+
+bool GncSolver::nextMuStep() {
+  computeResiduals(estimate_);
+  const double cost = weightedCost();
+  if (!mu_initialized_) {
+    prev_cost_ = cost;
+    mu_initialized_ = true;
+    // all residuals small (or nothing to decide): keep the first solution
+    if (mu_ <= 0 || nfg_.size() == num_known_inliers_) return true;
+  } else {
+    if (mu_step_begin_ >= 0 && Trace::enabled()) {
+      Trace::record("GNC mu step",
+                    "mu " + std::to_string(mu_),
+                    mu_step_begin_,
+                    Trace::now());
+    }
+    const bool cost_converged =
+        std::fabs(cost - prev_cost_) / std::max(prev_cost_, 1e-7) <
+        gnc_params_.relative_cost_tol_;
+    if (cost_converged || weightsConverged()) return true;
+    mu_ *= gnc_params_.mu_step_;
+    prev_cost_ = cost;
+    iterations_++;
+  }
+  if (iterations_ >= gnc_params_.max_iterations_) return true;
+  mu_step_begin_ = Trace::enabled() ? Trace::now() : -1;
+  updateWeights(mu_);
+  return false;
+}
+
+bool GncSolver::iterate() {
+  if (done_) return true;
+  if (!inner_) startSolve();
+  if (!tracedIterate(inner_.get(), inner_->params(), "LM iteration")) {
+    return false;
+  }
+  finishSolve();
+  done_ = nextMuStep();
+  return done_;
+}
+
+gtsam::Values GncSolver::optimize() {
+  RPGO_TRACE_SCOPE("GncSolver::optimize");
+  while (!iterate()) {
+  }
+  return estimate_;
+}
+
+}  // namespace KimeraRPGO
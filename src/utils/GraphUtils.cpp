@@ -1,46 +1,307 @@
 // Authors: Yun Chang
+#include <algorithm>
+#include <chrono>
+#include <numeric>
 #include <vector>
 
 #include "KimeraRPGO/max_clique_finder/findClique.h"
 #include "KimeraRPGO/utils/GraphUtils.h"
+#include "KimeraRPGO/utils/MappedAdjacency.h"
 
 namespace KimeraRPGO {
 
-int findMaxClique(const Eigen::MatrixXd adjMatrix,
-                  std::vector<int>* max_clique) {
+namespace {
+
+void fillStats(size_t num_vertices,
+               size_t num_edges,
+               const FMC::SearchCounters& counters,
+               int clique_size,
+               const std::chrono::high_resolution_clock::time_point& start,
+               MaxCliqueStats* stats) {
+  stats->num_vertices = num_vertices;
+  stats->num_edges = num_edges;
+  stats->density =
+      num_vertices > 1
+          ? 2.0 * stats->num_edges / (num_vertices * (num_vertices - 1))
+          : 0.0;
+  stats->pruned1 = counters.pruned1;
+  stats->pruned2 = counters.pruned2;
+  stats->pruned3 = counters.pruned3;
+  stats->pruned5 = counters.pruned5;
+  stats->not_computed = counters.not_computed;
+  stats->nodes_expanded = counters.nodes_expanded;
+  stats->clique_size = clique_size > 0 ? clique_size : 0;
+  stats->time_ms = std::chrono::duration<double, std::milli>(
+                       std::chrono::high_resolution_clock::now() - start)
+                       .count();
+}
+
+}  // namespace
+
+int findMaxClique(const Eigen::MatrixXd& adjMatrix,
+                  std::vector<int>* max_clique,
+                  MaxCliqueStats* stats) {
   // Compute maximum clique
+  auto start = std::chrono::high_resolution_clock::now();
   FMC::CGraphIO gio;
   gio.ReadEigenAdjacencyMatrix(adjMatrix);
+  FMC::SearchCounters counters;
   size_t max_clique_size = 0;
-  max_clique_size = FMC::maxClique(&gio, max_clique_size, max_clique);
+  max_clique_size =
+      FMC::maxClique(&gio, max_clique_size, max_clique, &counters);
+  if (stats) {
+    fillStats(gio.GetVertexCount(),
+              gio.GetEdgeCount(),
+              counters,
+              max_clique_size,
+              start,
+              stats);
+  }
   return max_clique_size;
 }
 
-int findMaxCliqueHeu(const Eigen::MatrixXd adjMatrix,
-                     std::vector<int>* max_clique) {
+int findMaxCliqueHeu(const Eigen::MatrixXd& adjMatrix,
+                     std::vector<int>* max_clique,
+                     MaxCliqueStats* stats) {
   // Compute maximum clique (heuristic inexact version)
+  auto start = std::chrono::high_resolution_clock::now();
   FMC::CGraphIO gio;
   gio.ReadEigenAdjacencyMatrix(adjMatrix);
+  FMC::SearchCounters counters;
   int max_clique_size = 0;
-  max_clique_size = FMC::maxCliqueHeu(&gio, max_clique);
+  max_clique_size = FMC::maxCliqueHeu(&gio, max_clique, &counters);
+  if (stats) {
+    fillStats(gio.GetVertexCount(),
+              gio.GetEdgeCount(),
+              counters,
+              max_clique_size,
+              start,
+              stats);
+  }
   return max_clique_size;
 }
 
 // TODO
-int findMaxCliqueHeuIncremental(const Eigen::MatrixXd adjMatrix,
+int findMaxCliqueHeuIncremental(const Eigen::MatrixXd& adjMatrix,
                                 size_t num_new_lc,
                                 size_t prev_maxclique_size,
-                                std::vector<int>* max_clique) {
+                                std::vector<int>* max_clique,
+                                MaxCliqueStats* stats) {
   // Compute maximum clique (heuristic inexact version)
+  auto start = std::chrono::high_resolution_clock::now();
   FMC::CGraphIO gio;
   gio.ReadEigenAdjacencyMatrix(adjMatrix);
+  FMC::SearchCounters counters;
   int max_clique_size_new_lc = 0;
   max_clique_size_new_lc = FMC::maxCliqueHeuIncremental(
-      &gio, num_new_lc, prev_maxclique_size, max_clique);
+      &gio, num_new_lc, prev_maxclique_size, max_clique, &counters);
+  if (stats) {
+    fillStats(gio.GetVertexCount(),
+              gio.GetEdgeCount(),
+              counters,
+              max_clique_size_new_lc,
+              start,
+              stats);
+  }
   if (static_cast<size_t>(max_clique_size_new_lc) > prev_maxclique_size) {
     return max_clique_size_new_lc;
   }
   return 0;
 }
 
+int findMaxCliqueHeuLazy(Eigen::MatrixXd* adjMatrix,
+                         const EdgeOracle& check,
+                         std::vector<int>* max_clique,
+                         MaxCliqueStats* stats) {
+  auto start = std::chrono::high_resolution_clock::now();
+  Eigen::MatrixXd& adj = *adjMatrix;
+  const size_t num_vertices = adj.rows();
+  FMC::SearchCounters counters;
+  size_t num_checks = 0;
+
+  // upper bound on the degrees: known and unknown edges
+  std::vector<int> bounds(num_vertices, 0);
+  for (size_t j = 0; j < num_vertices; j++) {
+    for (size_t i = 0; i < num_vertices; i++) {
+      if (i != j && adj(i, j) != 0) bounds[j]++;
+    }
+  }
+
+  // resolve (and memoize) an entry, tightening the bounds on failure
+  auto edge = [&](size_t i, size_t j) {
+    if (adj(i, j) < 0) {
+      const bool consistent = check(std::min(i, j), std::max(i, j));
+      num_checks++;
+      adj(i, j) = adj(j, i) = consistent ? 1 : 0;
+      if (!consistent) {
+        bounds[i]--;
+        bounds[j]--;
+      }
+    }
+    return adj(i, j) != 0;
+  };
+
+  std::vector<size_t> order(num_vertices);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return bounds[a] > bounds[b];
+  });
+
+  int max_clique_size = -1;
+  std::vector<size_t> candidates;
+  std::vector<int> clique;
+  for (const size_t& v : order) {
+    // Pruning 1: v cannot be in a larger clique than the best one
+    if (bounds[v] + 1 <= max_clique_size) {
+      counters.not_computed++;
+      counters.pruned1++;
+      continue;
+    }
+    // possible neighbors of v (unknown entries included, nothing is checked)
+    candidates.clear();
+    for (size_t u = 0; u < num_vertices; u++) {
+      if (u == v || adj(v, u) == 0) continue;
+      // Pruning 3: only keep neighbors that can be in a larger clique
+      if (bounds[u] + 1 <= max_clique_size) {
+        counters.pruned3++;
+        continue;
+      }
+      candidates.push_back(u);
+    }
+
+    // greedily try the candidate with the largest bound
+    clique.assign(1, v);
+    counters.nodes_expanded++;
+    while (!candidates.empty()) {
+      // Pruning 5: this clique cannot beat the best one anymore
+      if (static_cast<int>(clique.size() + candidates.size()) <=
+          max_clique_size) {
+        counters.pruned5++;
+        break;
+      }
+      size_t best = 0;
+      for (size_t k = 1; k < candidates.size(); k++) {
+        if (bounds[candidates[k]] > bounds[candidates[best]]) best = k;
+      }
+      const size_t u = candidates[best];
+      candidates[best] = candidates.back();
+      candidates.pop_back();
+      if (bounds[u] + 1 <= max_clique_size) {
+        counters.pruned3++;
+        continue;
+      }
+      // u joins if it is consistent with every vertex of the clique
+      bool consistent = true;
+      for (const int& w : clique) {
+        if (!edge(w, u)) {
+          consistent = false;
+          break;
+        }
+      }
+      if (!consistent) continue;
+      clique.push_back(u);
+      counters.nodes_expanded++;
+      // drop the candidates already known to be inconsistent with u
+      candidates.erase(std::remove_if(candidates.begin(),
+                                      candidates.end(),
+                                      [&](size_t w) { return adj(u, w) == 0; }),
+                       candidates.end());
+    }
+
+    if (max_clique_size < static_cast<int>(clique.size())) {
+      max_clique_size = clique.size();
+      *max_clique = clique;
+    }
+  }
+
+  if (stats) {
+    size_t num_edges = 0;
+    for (size_t j = 0; j < num_vertices; j++) {
+      for (size_t i = 0; i < j; i++) {
+        if (adj(i, j) > 0) num_edges++;
+      }
+    }
+    fillStats(num_vertices,
+              num_edges,
+              counters,
+              max_clique_size,
+              start,
+              stats);
+    stats->num_checks = num_checks;
+  }
+  return max_clique_size;
+}
+
+int findMaxCliqueHeu(const MappedAdjacency& adjacency,
+                     std::vector<int>* max_clique,
+                     MaxCliqueStats* stats) {
+  auto start = std::chrono::high_resolution_clock::now();
+  const size_t num_vertices = adjacency.size();
+  FMC::SearchCounters counters;
+
+  // degrees in a single pass over the rows (in file order)
+  std::vector<int> degrees(num_vertices);
+  size_t sum_degrees = 0;
+  for (size_t i = 0; i < num_vertices; i++) {
+    degrees[i] = adjacency.degree(i);
+    sum_degrees += degrees[i];
+  }
+
+  int max_clique_size = -1;
+  std::vector<uint64_t> candidates, row;
+  std::vector<int> clique;
+  for (size_t v = 0; v < num_vertices; v++) {
+    // Pruning 1
+    if (max_clique_size > degrees[v]) {
+      counters.not_computed++;
+      counters.pruned1++;
+      continue;
+    }
+    adjacency.getRow(v, &candidates);
+    // Pruning 3: only keep neighbors that can be in a larger clique
+    for (size_t w = 0; w < candidates.size(); w++) {
+      uint64_t word = candidates[w];
+      while (word != 0) {
+        const int bit = __builtin_ctzll(word);
+        word &= word - 1;
+        if (degrees[w * 64 + bit] < max_clique_size) {
+          candidates[w] &= ~(uint64_t(1) << bit);
+          counters.pruned3++;
+        }
+      }
+    }
+
+    // greedily add the last candidate and intersect with its neighborhood
+    clique.assign(1, v);
+    counters.nodes_expanded++;
+    size_t last_word = candidates.size();
+    while (true) {
+      while (last_word > 0 && candidates[last_word - 1] == 0) last_word--;
+      if (last_word == 0) break;
+      const size_t w = last_word - 1;
+      const int bit = 63 - __builtin_clzll(candidates[w]);
+      const size_t u = w * 64 + bit;
+      clique.push_back(u);
+      counters.nodes_expanded++;
+      adjacency.getRow(u, &row);
+      for (size_t k = 0; k < last_word; k++) candidates[k] &= row[k];
+    }
+
+    if (max_clique_size < static_cast<int>(clique.size())) {
+      max_clique_size = clique.size();
+      *max_clique = clique;
+    }
+  }
+
+  if (stats) {
+    fillStats(num_vertices,
+              sum_degrees / 2,
+              counters,
+              max_clique_size,
+              start,
+              stats);
+  }
+  return max_clique_size;
+}
+
 }  // namespace KimeraRPGO
@@ -0,0 +1,128 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "KimeraRPGO/utils/MappedAdjacency.h"
+
+namespace KimeraRPGO {
+
+MappedAdjacency::MappedAdjacency(const std::string& path, size_t tile_size)
+    : path_(path),
+      fd_(-1),
+      data_(NULL),
+      mapped_bytes_(0),
+      num_vertices_(0),
+      num_tiles_(0),
+      tile_size_(tile_size),
+      words_per_tile_row_(tile_size / 64),
+      words_per_tile_(tile_size * tile_size / 64) {
+  if (tile_size_ == 0 || tile_size_ % 64 != 0) {
+    throw std::invalid_argument(
+        "MappedAdjacency: tile size must be a multiple of 64");
+  }
+  if (path_.empty()) {
+    char tmp_path[] = "/tmp/kimera_rpgo_adjXXXXXX";
+    fd_ = mkstemp(tmp_path);
+    if (fd_ >= 0) unlink(tmp_path);
+  } else {
+    fd_ = open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  }
+  if (fd_ < 0) {
+    throw std::runtime_error("MappedAdjacency: cannot open backing file");
+  }
+}
+
+MappedAdjacency::~MappedAdjacency() {
+  if (data_ != NULL) munmap(data_, mapped_bytes_);
+  if (fd_ >= 0) close(fd_);
+}
+
+void MappedAdjacency::resize(size_t num_vertices) {
+  if (num_vertices <= num_vertices_) return;
+  const size_t num_tiles = (num_vertices + tile_size_ - 1) / tile_size_;
+  if (num_tiles > num_tiles_) remap(num_tiles);
+  num_vertices_ = num_vertices;
+}
+
+void MappedAdjacency::remap(size_t num_tiles) {
+  const size_t bytes = num_tiles * num_tiles * words_per_tile_ * 8;
+  if (data_ != NULL) munmap(data_, mapped_bytes_);
+  data_ = NULL;
+  // new shells are zero (and sparse) after extending the file
+  if (ftruncate(fd_, bytes) != 0) {
+    throw std::runtime_error("MappedAdjacency: cannot grow backing file");
+  }
+  void* data =
+      mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("MappedAdjacency: mmap failed");
+  }
+  data_ = static_cast<uint64_t*>(data);
+  mapped_bytes_ = bytes;
+  num_tiles_ = num_tiles;
+}
+
+size_t MappedAdjacency::tileIndex(size_t tile_row, size_t tile_col) {
+  const size_t shell = std::max(tile_row, tile_col);
+  if (tile_row == shell) return shell * shell + tile_col;
+  return shell * shell + shell + 1 + tile_row;
+}
+
+uint64_t* MappedAdjacency::tileRow(size_t i, size_t tile_col) const {
+  const size_t tile_row = i / tile_size_;
+  return data_ + tileIndex(tile_row, tile_col) * words_per_tile_ +
+         (i % tile_size_) * words_per_tile_row_;
+}
+
+void MappedAdjacency::setEdge(size_t i, size_t j, bool value) {
+  if (i >= num_vertices_ || j >= num_vertices_) {
+    throw std::out_of_range("MappedAdjacency::setEdge");
+  }
+  if (i == j) return;  // no self loops (as in the dense adjacency)
+  const size_t local_j = j % tile_size_;
+  const size_t local_i = i % tile_size_;
+  uint64_t* word_ij = tileRow(i, j / tile_size_) + local_j / 64;
+  uint64_t* word_ji = tileRow(j, i / tile_size_) + local_i / 64;
+  const uint64_t bit_ij = uint64_t(1) << (local_j % 64);
+  const uint64_t bit_ji = uint64_t(1) << (local_i % 64);
+  if (value) {
+    *word_ij |= bit_ij;
+    *word_ji |= bit_ji;
+  } else {
+    *word_ij &= ~bit_ij;
+    *word_ji &= ~bit_ji;
+  }
+}
+
+bool MappedAdjacency::hasEdge(size_t i, size_t j) const {
+  if (i >= num_vertices_ || j >= num_vertices_) return false;
+  const size_t local_j = j % tile_size_;
+  const uint64_t word = tileRow(i, j / tile_size_)[local_j / 64];
+  return (word >> (local_j % 64)) & 1;
+}
+
+void MappedAdjacency::getRow(size_t i, std::vector<uint64_t>* row) const {
+  row->resize(rowWords());
+  for (size_t tile_col = 0; tile_col < num_tiles_; tile_col++) {
+    std::memcpy(row->data() + tile_col * words_per_tile_row_,
+                tileRow(i, tile_col),
+                words_per_tile_row_ * sizeof(uint64_t));
+  }
+}
+
+size_t MappedAdjacency::degree(size_t i) const {
+  size_t count = 0;
+  for (size_t tile_col = 0; tile_col < num_tiles_; tile_col++) {
+    const uint64_t* words = tileRow(i, tile_col);
+    for (size_t w = 0; w < words_per_tile_row_; w++) {
+      count += __builtin_popcountll(words[w]);
+    }
+  }
+  return count;
+}
+
+}  // namespace KimeraRPGO
@@ -0,0 +1,68 @@
+#include <typeinfo>
+
+#include <boost/functional/hash.hpp>
+
+#include "KimeraRPGO/utils/NoiseModelCache.h"
+
+namespace KimeraRPGO {
+
+gtsam::SharedNoiseModel NoiseModelCache::intern(
+    const gtsam::SharedNoiseModel& model) {
+  const auto known = entries_.find(model.get());
+  if (known != entries_.end()) return known->second.model;
+  const gtsam::noiseModel::Gaussian::shared_ptr gaussian =
+      boost::dynamic_pointer_cast<gtsam::noiseModel::Gaussian>(model);
+  if (!gaussian) return model;
+
+  const size_t model_hash = hash(*gaussian);
+  const Entry* equal = findEqual(*gaussian, model_hash);
+  if (equal) return equal->model;
+
+  Entry& entry = entries_[model.get()];
+  entry.model = model;
+  entry.covariance = gaussian->covariance();
+  entry.information = gaussian->information();
+  by_hash_.emplace(model_hash, &entry);
+  return model;
+}
+
+const NoiseModelCache::Entry* NoiseModelCache::find(
+    const gtsam::SharedNoiseModel& model) const {
+  const auto known = entries_.find(model.get());
+  if (known != entries_.end()) return &known->second;
+  const gtsam::noiseModel::Gaussian* gaussian =
+      dynamic_cast<const gtsam::noiseModel::Gaussian*>(model.get());
+  if (!gaussian) return nullptr;
+  return findEqual(*gaussian, hash(*gaussian));
+}
+
+size_t NoiseModelCache::hash(const gtsam::noiseModel::Gaussian& model) {
+  size_t seed = typeid(model).hash_code();
+  const gtsam::Matrix R = model.R();
+  boost::hash_combine(seed, R.rows());
+  for (Eigen::Index i = 0; i < R.size(); i++) {
+    boost::hash_combine(seed, R.data()[i]);
+  }
+  return seed;
+}
+
+const NoiseModelCache::Entry* NoiseModelCache::findEqual(
+    const gtsam::noiseModel::Gaussian& model,
+    size_t hash) const {
+  const auto candidates = by_hash_.equal_range(hash);
+  if (candidates.first == candidates.second) return nullptr;
+  const gtsam::Matrix R = model.R();
+  for (auto it = candidates.first; it != candidates.second; ++it) {
+    const gtsam::noiseModel::Base& other = *it->second->model;
+    if (typeid(other) != typeid(model) || other.dim() != model.dim()) {
+      continue;
+    }
+    // exact match (NaN entries never match)
+    if (static_cast<const gtsam::noiseModel::Gaussian&>(other).R() == R) {
+      return it->second;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace KimeraRPGO
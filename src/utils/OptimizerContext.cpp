@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include "KimeraRPGO/utils/OptimizerContext.h"
+
+namespace KimeraRPGO {
+
+OptimizerContext::OptimizerContext(double reorder_growth)
+    : reorder_growth_(reorder_growth),
+      num_keys_at_colamd_(0),
+      num_full_orderings_(0),
+      num_extensions_(0),
+      lambda_(0),
+      has_lambda_(false) {}
+
+const gtsam::Ordering& OptimizerContext::ordering(
+    const gtsam::NonlinearFactorGraph& nfg) {
+  const gtsam::KeySet keys = nfg.keys();
+
+  // both sets are sorted: one pass finds the removed and the new keys
+  bool removed_keys = false;
+  std::vector<gtsam::Key> new_keys;
+  std::set_difference(keys.begin(),
+                      keys.end(),
+                      keys_.begin(),
+                      keys_.end(),
+                      std::back_inserter(new_keys));
+  if (keys.size() < keys_.size() + new_keys.size()) removed_keys = true;
+
+  const bool reorder =
+      ordering_.empty() || removed_keys ||
+      keys.size() > (1.0 + reorder_growth_) * num_keys_at_colamd_;
+  if (reorder) {
+    ordering_ = gtsam::Ordering::Colamd(nfg);
+    num_keys_at_colamd_ = keys.size();
+    num_full_orderings_++;
+  } else if (!new_keys.empty()) {
+    for (const gtsam::Key& key : new_keys) ordering_.push_back(key);
+    num_extensions_++;
+  }
+  keys_ = keys;
+  return ordering_;
+}
+
+void OptimizerContext::setup(const gtsam::NonlinearFactorGraph& nfg,
+                             gtsam::LevenbergMarquardtParams* params,
+                             bool use_lambda) {
+  params->setOrdering(ordering(nfg));
+  if (use_lambda && has_lambda_) {
+    params->lambdaInitial = std::min(
+        std::max(lambda_, params->lambdaLowerBound), params->lambdaUpperBound);
+  }
+}
+
+void OptimizerContext::setup(const gtsam::NonlinearFactorGraph& nfg,
+                             gtsam::GaussNewtonParams* params) {
+  params->setOrdering(ordering(nfg));
+}
+
+void OptimizerContext::setLambda(double lambda) {
+  lambda_ = lambda;
+  has_lambda_ = true;
+}
+
+void OptimizerContext::reset() {
+  ordering_ = gtsam::Ordering();
+  keys_.clear();
+  num_keys_at_colamd_ = 0;
+  has_lambda_ = false;
+}
+
+}  // namespace KimeraRPGO
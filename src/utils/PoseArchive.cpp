@@ -0,0 +1,399 @@
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include <gtsam/geometry/Pose2.h>
+#include <gtsam/geometry/Pose3.h>
+#include <gtsam/inference/Symbol.h>
+#include <gtsam/slam/BetweenFactor.h>
+
+#include "KimeraRPGO/Logger.h"
+#include "KimeraRPGO/utils/FastBetweenFactor.h"
+#include "KimeraRPGO/utils/PoseArchive.h"
+
+namespace KimeraRPGO {
+
+namespace {
+const uint64_t kArchiveMagic = 0x314352414f475052;  // "RPGOARC1"
+const uint32_t kArchiveVersion = 1;
+
+enum NoiseModelType : uint8_t { ISOTROPIC = 0, DIAGONAL = 1, GAUSSIAN = 2 };
+
+template <class T>
+void write(std::ostream& stream, const T& value) {
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <class T>
+bool read(std::istream& stream, T* value) {
+  stream.read(reinterpret_cast<char*>(value), sizeof(T));
+  return static_cast<bool>(stream);
+}
+
+template <class T>
+void writeVector(std::ostream& stream, const std::vector<T>& values) {
+  write<uint64_t>(stream, values.size());
+  stream.write(reinterpret_cast<const char*>(values.data()),
+               values.size() * sizeof(T));
+}
+
+// bytes from the read position to the end (-1 if the stream cannot seek)
+std::streamoff bytesLeft(std::istream& stream) {
+  const std::streampos pos = stream.tellg();
+  if (pos < 0) return -1;
+  stream.seekg(0, std::ios::end);
+  const std::streampos end = stream.tellg();
+  stream.seekg(pos);
+  return end < 0 ? -1 : static_cast<std::streamoff>(end - pos);
+}
+
+// the length is read from the file: it is checked against the bytes left,
+// and the vector grows a chunk at a time as the data arrives (streams that
+// cannot seek), so that a corrupt length fails instead of allocating it
+template <class T>
+bool readVector(std::istream& stream, std::vector<T>* values) {
+  const uint64_t kChunk = 1 << 16;
+  uint64_t size;
+  if (!read(stream, &size)) return false;
+  const std::streamoff left = bytesLeft(stream);
+  if (left >= 0 && size > static_cast<uint64_t>(left) / sizeof(T)) {
+    return false;
+  }
+  values->clear();
+  while (values->size() < size) {
+    const size_t begin = values->size();
+    values->resize(begin + std::min(kChunk, size - begin));
+    stream.read(reinterpret_cast<char*>(values->data() + begin),
+                (values->size() - begin) * sizeof(T));
+    if (!stream) return false;
+  }
+  return true;
+}
+
+void packPose(const gtsam::Pose2& pose, std::vector<double>* packed) {
+  packed->insert(packed->end(), {pose.x(), pose.y(), pose.theta()});
+}
+
+void packPose(const gtsam::Pose3& pose, std::vector<double>* packed) {
+  const gtsam::Quaternion q = pose.rotation().toQuaternion();
+  const gtsam::Point3& t = pose.translation();
+  packed->insert(packed->end(),
+                 {q.w(), q.x(), q.y(), q.z(), t.x(), t.y(), t.z()});
+}
+
+gtsam::Pose2 unpackPose2(const double* packed) {
+  return gtsam::Pose2(packed[0], packed[1], packed[2]);
+}
+
+gtsam::Pose3 unpackPose3(const double* packed) {
+  return gtsam::Pose3(
+      gtsam::Rot3::Quaternion(packed[0], packed[1], packed[2], packed[3]),
+      gtsam::Point3(packed[4], packed[5], packed[6]));
+}
+}  // namespace
+
+bool PoseArchive::packable(const gtsam::NonlinearFactor& factor) {
+  const gtsam::NoiseModelFactor* noise_factor = nullptr;
+  if (dynamic_cast<const gtsam::BetweenFactor<gtsam::Pose3>*>(&factor) ||
+      dynamic_cast<const gtsam::BetweenFactor<gtsam::Pose2>*>(&factor)) {
+    noise_factor = static_cast<const gtsam::NoiseModelFactor*>(&factor);
+  }
+  if (!noise_factor) return false;
+  const gtsam::noiseModel::Base* model = noise_factor->noiseModel().get();
+  return dynamic_cast<const gtsam::noiseModel::Gaussian*>(model) &&
+         !dynamic_cast<const gtsam::noiseModel::Constrained*>(model);
+}
+
+void PoseArchive::add(const gtsam::Values& poses,
+                      const SlottedFactors& factors) {
+  if (poses.empty()) return;
+  Segment segment;
+  segment.pose3 = (*poses.begin()).value.dim() == 6;
+  const size_t n = stride(segment.pose3);
+  segment.keys.reserve(poses.size());
+  segment.poses.reserve(n * poses.size());
+  // the values iterate in key order: the keys stay sorted
+  for (const auto& v : poses) {
+    if (segment.pose3) {
+      const auto pose = dynamic_cast<const gtsam::GenericValue<gtsam::Pose3>*>(
+          &v.value);
+      if (!pose) continue;
+      packPose(pose->value(), &segment.poses);
+    } else {
+      const auto pose = dynamic_cast<const gtsam::GenericValue<gtsam::Pose2>*>(
+          &v.value);
+      if (!pose) continue;
+      packPose(pose->value(), &segment.poses);
+    }
+    segment.keys.push_back(v.key);
+  }
+
+  segment.factor_keys.reserve(2 * factors.size());
+  segment.measurements.reserve(n * factors.size());
+  segment.noise.reserve(factors.size());
+  segment.slots.reserve(factors.size());
+  for (const auto& slotted : factors) {
+    const gtsam::NonlinearFactor& factor = *slotted.second;
+    if (segment.pose3) {
+      const auto between =
+          dynamic_cast<const gtsam::BetweenFactor<gtsam::Pose3>*>(&factor);
+      if (!between) continue;
+      packPose(between->measured(), &segment.measurements);
+      segment.noise.push_back(noiseIndex(between->noiseModel()));
+    } else {
+      const auto between =
+          dynamic_cast<const gtsam::BetweenFactor<gtsam::Pose2>*>(&factor);
+      if (!between) continue;
+      packPose(between->measured(), &segment.measurements);
+      segment.noise.push_back(noiseIndex(between->noiseModel()));
+    }
+    segment.factor_keys.push_back(factor.front());
+    segment.factor_keys.push_back(factor.back());
+    segment.slots.push_back(slotted.first);
+  }
+  segments_.push_back(std::move(segment));
+}
+
+bool PoseArchive::find(gtsam::Key key, size_t* segment) const {
+  for (size_t i = 0; i < segments_.size(); i++) {
+    const std::vector<gtsam::Key>& keys = segments_[i].keys;
+    if (keys.empty() || key < keys.front() || key > keys.back()) continue;
+    if (std::binary_search(keys.begin(), keys.end(), key)) {
+      *segment = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+void PoseArchive::extract(size_t segment,
+                          gtsam::Values* poses,
+                          SlottedFactors* factors) {
+  const Segment& packed = segments_.at(segment);
+  unpackPoses(packed, poses);
+  for (size_t i = 0; i < packed.slots.size(); i++) {
+    factors->emplace_back(packed.slots[i], unpackFactor(packed, i));
+  }
+  segments_.erase(segments_.begin() + segment);
+}
+
+char PoseArchive::prefix(size_t segment) const {
+  const Segment& packed = segments_.at(segment);
+  return packed.keys.empty() ? 0 : gtsam::Symbol(packed.keys.front()).chr();
+}
+
+gtsam::KeySet PoseArchive::factorKeys() const {
+  gtsam::KeySet keys;
+  for (const Segment& segment : segments_) {
+    keys.insert(segment.factor_keys.begin(), segment.factor_keys.end());
+  }
+  return keys;
+}
+
+void PoseArchive::unpack(gtsam::NonlinearFactorGraph* nfg,
+                         gtsam::Values* poses) const {
+  for (const Segment& segment : segments_) {
+    unpackPoses(segment, poses);
+    for (size_t i = 0; i < segment.slots.size(); i++) {
+      nfg->add(unpackFactor(segment, i));
+    }
+  }
+}
+
+size_t PoseArchive::numPoses() const {
+  size_t n = 0;
+  for (const Segment& segment : segments_) n += segment.keys.size();
+  return n;
+}
+
+size_t PoseArchive::numFactors() const {
+  size_t n = 0;
+  for (const Segment& segment : segments_) n += segment.slots.size();
+  return n;
+}
+
+uint32_t PoseArchive::noiseIndex(const gtsam::SharedNoiseModel& model) {
+  const auto known = noise_index_.find(model.get());
+  if (known != noise_index_.end()) return known->second;
+  const uint32_t index = noise_models_.size();
+  noise_models_.push_back(model);
+  noise_index_[model.get()] = index;
+  return index;
+}
+
+gtsam::NonlinearFactor::shared_ptr PoseArchive::unpackFactor(
+    const Segment& segment,
+    size_t i) const {
+  const double* measured = &segment.measurements[i * stride(segment.pose3)];
+  const gtsam::Key from = segment.factor_keys[2 * i];
+  const gtsam::Key to = segment.factor_keys[2 * i + 1];
+  const gtsam::SharedNoiseModel& model = noise_models_[segment.noise[i]];
+  if (segment.pose3) {
+    return boost::make_shared<FastBetweenFactor<gtsam::Pose3>>(
+        from, to, unpackPose3(measured), model);
+  }
+  return boost::make_shared<FastBetweenFactor<gtsam::Pose2>>(
+      from, to, unpackPose2(measured), model);
+}
+
+void PoseArchive::unpackPoses(const Segment& segment,
+                              gtsam::Values* poses) const {
+  const size_t n = stride(segment.pose3);
+  for (size_t i = 0; i < segment.keys.size(); i++) {
+    if (segment.pose3) {
+      poses->insert(segment.keys[i], unpackPose3(&segment.poses[i * n]));
+    } else {
+      poses->insert(segment.keys[i], unpackPose2(&segment.poses[i * n]));
+    }
+  }
+}
+
+bool PoseArchive::consistent(
+    const Segment& segment,
+    const std::vector<gtsam::SharedNoiseModel>& noise_models) {
+  const size_t n = stride(segment.pose3);
+  const size_t num_factors = segment.slots.size();
+  if (segment.poses.size() != n * segment.keys.size() ||
+      segment.measurements.size() != n * num_factors ||
+      segment.factor_keys.size() != 2 * num_factors ||
+      segment.noise.size() != num_factors) {
+    return false;
+  }
+  // find searches the keys
+  if (std::adjacent_find(segment.keys.begin(),
+                         segment.keys.end(),
+                         std::greater_equal<gtsam::Key>()) !=
+      segment.keys.end()) {
+    return false;
+  }
+  const size_t dim = segment.pose3 ? 6 : 3;
+  for (uint32_t index : segment.noise) {
+    if (index >= noise_models.size() || noise_models[index]->dim() != dim) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PoseArchive::save(std::ostream& stream) const {
+  write(stream, kArchiveMagic);
+  write(stream, kArchiveVersion);
+
+  write<uint32_t>(stream, noise_models_.size());
+  for (const gtsam::SharedNoiseModel& model : noise_models_) {
+    const auto isotropic =
+        dynamic_cast<const gtsam::noiseModel::Isotropic*>(model.get());
+    const auto diagonal =
+        dynamic_cast<const gtsam::noiseModel::Diagonal*>(model.get());
+    const auto gaussian =
+        dynamic_cast<const gtsam::noiseModel::Gaussian*>(model.get());
+    write<uint32_t>(stream, model->dim());
+    if (isotropic) {
+      write<uint8_t>(stream, ISOTROPIC);
+      write<double>(stream, isotropic->sigma());
+    } else if (diagonal) {
+      write<uint8_t>(stream, DIAGONAL);
+      const gtsam::Vector sigmas = diagonal->sigmas();
+      stream.write(reinterpret_cast<const char*>(sigmas.data()),
+                   sigmas.size() * sizeof(double));
+    } else {
+      write<uint8_t>(stream, GAUSSIAN);
+      const gtsam::Matrix R = gaussian->R();
+      stream.write(reinterpret_cast<const char*>(R.data()),
+                   R.size() * sizeof(double));
+    }
+  }
+
+  write<uint64_t>(stream, segments_.size());
+  for (const Segment& segment : segments_) {
+    write<uint8_t>(stream, segment.pose3);
+    writeVector(stream, segment.keys);
+    writeVector(stream, segment.poses);
+    writeVector(stream, segment.factor_keys);
+    writeVector(stream, segment.measurements);
+    writeVector(stream, segment.noise);
+    writeVector(stream, segment.slots);
+  }
+}
+
+bool PoseArchive::load(std::istream& stream) {
+  uint64_t magic;
+  uint32_t version;
+  if (!read(stream, &magic) || magic != kArchiveMagic ||
+      !read(stream, &version) || version != kArchiveVersion) {
+    log<WARNING>("Not a pose archive (or unsupported version)");
+    return false;
+  }
+
+  uint32_t num_models;
+  if (!read(stream, &num_models)) return false;
+  std::vector<gtsam::SharedNoiseModel> noise_models;
+  for (uint32_t i = 0; i < num_models; i++) {
+    uint32_t dim;
+    uint8_t type;
+    if (!read(stream, &dim) || !read(stream, &type)) return false;
+    // models of Pose2 / Pose3 factors
+    if (dim != 3 && dim != 6) {
+      log<WARNING>("Corrupt pose archive: noise model of dimension %1%") % dim;
+      return false;
+    }
+    const size_t size =
+        type == GAUSSIAN ? dim * dim : type == DIAGONAL ? dim : 1;
+    std::vector<double> data(size);
+    stream.read(reinterpret_cast<char*>(data.data()), size * sizeof(double));
+    if (!stream) return false;
+    switch (type) {
+      case ISOTROPIC:
+        noise_models.push_back(
+            gtsam::noiseModel::Isotropic::Sigma(dim, data[0]));
+        break;
+      case DIAGONAL:
+        noise_models.push_back(gtsam::noiseModel::Diagonal::Sigmas(
+            Eigen::Map<const gtsam::Vector>(data.data(), dim), false));
+        break;
+      case GAUSSIAN:
+        noise_models.push_back(gtsam::noiseModel::Gaussian::SqrtInformation(
+            Eigen::Map<const gtsam::Matrix>(data.data(), dim, dim), false));
+        break;
+      default:
+        log<WARNING>("Unknown noise model type %1% in pose archive") %
+            static_cast<int>(type);
+        return false;
+    }
+  }
+
+  uint64_t num_segments;
+  if (!read(stream, &num_segments)) return false;
+  // not reserved: the count is read from the file
+  std::vector<Segment> segments;
+  for (uint64_t k = 0; k < num_segments; k++) {
+    segments.emplace_back();
+    Segment& segment = segments.back();
+    uint8_t pose3;
+    if (!read(stream, &pose3) || !readVector(stream, &segment.keys) ||
+        !readVector(stream, &segment.poses) ||
+        !readVector(stream, &segment.factor_keys) ||
+        !readVector(stream, &segment.measurements) ||
+        !readVector(stream, &segment.noise) ||
+        !readVector(stream, &segment.slots)) {
+      log<WARNING>("Truncated pose archive");
+      return false;
+    }
+    segment.pose3 = pose3;
+    if (!consistent(segment, noise_models)) {
+      log<WARNING>("Corrupt pose archive: inconsistent segment %1%") % k;
+      return false;
+    }
+  }
+
+  segments_.swap(segments);
+  noise_models_.swap(noise_models);
+  noise_index_.clear();
+  for (uint32_t i = 0; i < noise_models_.size(); i++) {
+    noise_index_[noise_models_[i].get()] = i;
+  }
+  return true;
+}
+
+}  // namespace KimeraRPGO
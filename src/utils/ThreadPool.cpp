@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef GTSAM_USE_TBB
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/partitioner.h>
+#endif
+
+#include "KimeraRPGO/utils/ThreadPool.h"
+
+namespace KimeraRPGO {
+
+namespace {
+// set while running a loop: nested loops run inline
+thread_local bool inside_loop = false;
+
+class InsideLoop {
+ public:
+  InsideLoop() : previous_(inside_loop) { inside_loop = true; }
+  ~InsideLoop() { inside_loop = previous_; }
+
+ private:
+  bool previous_;
+};
+}  // namespace
+
+ThreadPool::ThreadPool(size_t num_threads, const std::vector<int>& cpu_affinity)
+    : num_threads_(num_threads),
+#ifdef GTSAM_USE_TBB
+      arena_(nullptr),
+#endif
+      stop_(false),
+      generation_(0),
+      active_(0),
+      fn_(nullptr),
+      size_(0),
+      chunk_size_(0),
+      num_chunks_(0),
+      next_chunk_(0),
+      completed_chunks_(0) {
+  if (num_threads_ == 0) {
+    num_threads_ = std::max<size_t>(1, std::thread::hardware_concurrency());
+  }
+  // the caller is the first thread of every loop
+  for (size_t k = 1; k < num_threads_; k++) {
+    workers_.emplace_back(&ThreadPool::workerLoop, this, k, cpu_affinity);
+  }
+}
+
+#ifdef GTSAM_USE_TBB
+ThreadPool::ThreadPool(tbb::task_arena* arena) : ThreadPool(1) {
+  arena_ = arena;
+  num_threads_ = std::max(1, arena->max_concurrency());
+}
+#endif
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread& worker : workers_) worker.join();
+}
+
+void ThreadPool::workerLoop(size_t index,
+                            const std::vector<int>& cpu_affinity) {
+#ifdef __linux__
+  if (!cpu_affinity.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu_affinity[index % cpu_affinity.size()], &cpu_set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+  }
+#endif
+  InsideLoop inside;
+  size_t seen = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+    if (stop_) return;
+    seen = generation_;
+    active_++;
+    lock.unlock();
+    runChunks();
+    lock.lock();
+    active_--;
+    if (active_ == 0) done_.notify_all();
+  }
+}
+
+void ThreadPool::runChunks() {
+  size_t chunk;
+  while ((chunk = next_chunk_++) < num_chunks_) {
+    const size_t begin = chunk * chunk_size_;
+    const size_t end = std::min(size_, begin + chunk_size_);
+    try {
+      for (size_t k = begin; k < end; k++) (*fn_)(k);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_) error_ = std::current_exception();
+    }
+    if (++completed_chunks_ == num_chunks_) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::parallelFor(size_t n,
+                             const std::function<void(size_t)>& fn,
+                             size_t max_tasks) {
+  if (n == 0) return;
+  size_t num_tasks = max_tasks == 0 ? num_threads_ : max_tasks;
+  num_tasks = std::min(std::min(num_tasks, num_threads_), n);
+  if (num_tasks <= 1 || inside_loop) {
+    for (size_t k = 0; k < n; k++) fn(k);
+    return;
+  }
+  const size_t chunk_size = (n + num_tasks - 1) / num_tasks;
+
+#ifdef GTSAM_USE_TBB
+  if (arena_) {
+    arena_->execute([&] {
+      tbb::parallel_for(
+          tbb::blocked_range<size_t>(0, n, chunk_size),
+          [&](const tbb::blocked_range<size_t>& range) {
+            InsideLoop inside;
+            for (size_t k = range.begin(); k < range.end(); k++) fn(k);
+          },
+          tbb::simple_partitioner());
+    });
+    return;
+  }
+#endif
+
+  std::lock_guard<std::mutex> submit(submit_mutex_);
+  std::exception_ptr error;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // a late worker of the previous loop may still be looking for chunks
+    done_.wait(lock, [&] { return active_ == 0; });
+    fn_ = &fn;
+    size_ = n;
+    chunk_size_ = chunk_size;
+    num_chunks_ = (n + chunk_size - 1) / chunk_size;
+    next_chunk_ = 0;
+    completed_chunks_ = 0;
+    error_ = nullptr;
+    generation_++;
+  }
+  wake_.notify_all();
+  {
+    InsideLoop inside;
+    runChunks();
+  }
+  {
+    // the workers may still hold the loop: wait until they left it
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] {
+      return completed_chunks_ == num_chunks_ && active_ == 0;
+    });
+    fn_ = nullptr;
+    error = error_;
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+}  // namespace KimeraRPGO
@@ -0,0 +1,150 @@
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "KimeraRPGO/utils/Trace.h"
+
+namespace KimeraRPGO {
+
+namespace {
+
+struct TraceEvent {
+  const char* name;
+  std::string detail;
+  int64_t begin_us;
+  int64_t end_us;
+  uint32_t tid;
+};
+
+// events of every thread, appended under the mutex (events are coarse: one
+// per stage, search or iteration)
+std::mutex trace_mutex;
+std::vector<TraceEvent> trace_events;
+std::string trace_filename;
+int64_t trace_origin_us = 0;
+size_t trace_users = 0;  // starts not stopped yet
+
+std::atomic<uint32_t> next_tid(0);
+
+uint32_t threadId() {
+  thread_local const uint32_t tid = next_tid++;
+  return tid;
+}
+
+void writeJsonString(const std::string& str, std::ofstream* outfile) {
+  *outfile << '"';
+  for (const char c : str) {
+    if (c == '"' || c == '\\') {
+      *outfile << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      *outfile << ' ';
+    } else {
+      *outfile << c;
+    }
+  }
+  *outfile << '"';
+}
+
+}  // namespace
+
+std::atomic<bool> Trace::enabled_(false);
+
+int64_t Trace::now() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool Trace::start(const std::string& filename) {
+  std::lock_guard<std::mutex> lock(trace_mutex);
+  if (trace_users > 0) {
+    if (filename != trace_filename) return false;
+    trace_users++;
+    return true;
+  }
+  trace_events.clear();
+  trace_filename = filename;
+  trace_origin_us = now();
+  trace_users = 1;
+  enabled_.store(true);
+  return true;
+}
+
+bool Trace::stop() {
+  std::lock_guard<std::mutex> lock(trace_mutex);
+  if (trace_users == 0) return false;
+  // written once the last user stops
+  if (--trace_users > 0) return true;
+  enabled_.store(false);
+
+  std::ofstream outfile(trace_filename);
+  if (!outfile.is_open()) return false;
+  outfile << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (size_t k = 0; k < trace_events.size(); k++) {
+    const TraceEvent& event = trace_events[k];
+    if (k > 0) outfile << ",";
+    outfile << "\n{\"name\":";
+    writeJsonString(event.name, &outfile);
+    outfile << ",\"cat\":\"rpgo\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.tid
+            << ",\"ts\":" << event.begin_us - trace_origin_us
+            << ",\"dur\":" << event.end_us - event.begin_us;
+    if (!event.detail.empty()) {
+      outfile << ",\"args\":{\"detail\":";
+      writeJsonString(event.detail, &outfile);
+      outfile << "}";
+    }
+    outfile << "}";
+  }
+  outfile << "\n]}\n";
+  trace_events.clear();
+  return outfile.good();
+}
+
+void Trace::record(const char* name,
+                   const std::string& detail,
+                   int64_t begin_us,
+                   int64_t end_us) {
+  const uint32_t tid = threadId();
+  std::lock_guard<std::mutex> lock(trace_mutex);
+  // started before the current trace
+  if (begin_us < trace_origin_us) return;
+  trace_events.push_back(TraceEvent{name, detail, begin_us, end_us, tid});
+}
+
+gtsam::Values tracedOptimize(gtsam::NonlinearOptimizer* optimizer,
+                             const gtsam::NonlinearOptimizerParams& params,
+                             const char* iteration_name) {
+  if (!Trace::enabled()) return optimizer->optimize();
+
+  // gtsam::NonlinearOptimizer::defaultOptimize, one event per iterate()
+  while (!tracedIterate(optimizer, params, iteration_name)) {
+  }
+  return optimizer->values();
+}
+
+bool tracedIterate(gtsam::NonlinearOptimizer* optimizer,
+                   const gtsam::NonlinearOptimizerParams& params,
+                   const char* iteration_name) {
+  const double current_error = optimizer->error();
+  if (optimizer->iterations() == 0 && current_error <= params.errorTol) {
+    return true;
+  }
+  {
+    RPGO_TRACE_SCOPE_DETAIL(
+        iteration_name, "iteration " + std::to_string(optimizer->iterations()));
+    optimizer->iterate();
+  }
+  return optimizer->iterations() >= params.maxIterations ||
+         gtsam::checkConvergence(params.relativeErrorTol,
+                                 params.absoluteErrorTol,
+                                 params.errorTol,
+                                 current_error,
+                                 optimizer->error(),
+                                 params.verbosity) ||
+         !std::isfinite(current_error);
+}
+
+}  // namespace KimeraRPGO
@@ -0,0 +1,127 @@
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+
+#include <gtsam/geometry/Pose2.h>
+#include <gtsam/geometry/Pose3.h>
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/Logger.h"
+#include "KimeraRPGO/utils/ThreadPool.h"
+#include "KimeraRPGO/utils/TrajectoryExport.h"
+
+namespace KimeraRPGO {
+
+namespace {
+// planar poses are written as Pose3
+bool toPose3(const gtsam::Value& value, gtsam::Pose3* pose) {
+  const auto pose3 = dynamic_cast<const gtsam::GenericValue<gtsam::Pose3>*>(
+      &value);
+  if (pose3) {
+    *pose = pose3->value();
+    return true;
+  }
+  const auto pose2 = dynamic_cast<const gtsam::GenericValue<gtsam::Pose2>*>(
+      &value);
+  if (pose2) {
+    *pose = gtsam::Pose3(pose2->value());
+    return true;
+  }
+  return false;
+}
+
+template <class T>
+void write(std::ostream* stream, const T& value) {
+  stream->write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+}  // namespace
+
+std::vector<TrajectoryRange> splitTrajectories(const gtsam::Values& values) {
+  std::vector<TrajectoryRange> trajectories;
+  for (auto it = values.begin(); it != values.end(); ++it) {
+    const char prefix = gtsam::Symbol((*it).key).chr();
+    if (trajectories.empty() || trajectories.back().prefix != prefix) {
+      if (!trajectories.empty() && trajectories.back().num_poses == 0) {
+        trajectories.pop_back();  // no poses (landmarks)
+      }
+      trajectories.push_back(TrajectoryRange{prefix, it, it, 0});
+    }
+    TrajectoryRange& trajectory = trajectories.back();
+    trajectory.end = std::next(it);
+    if (dynamic_cast<const gtsam::GenericValue<gtsam::Pose3>*>(
+            &(*it).value) ||
+        dynamic_cast<const gtsam::GenericValue<gtsam::Pose2>*>(
+            &(*it).value)) {
+      trajectory.num_poses++;
+    }
+  }
+  if (!trajectories.empty() && trajectories.back().num_poses == 0) {
+    trajectories.pop_back();
+  }
+  return trajectories;
+}
+
+void writeTrajectory(const TrajectoryRange& trajectory,
+                     TrajectoryFormat format,
+                     std::ostream* stream) {
+  if (format == TrajectoryFormat::CSV) {
+    *stream << "#timestamp, p_RS_R_x [m], p_RS_R_y [m], p_RS_R_z [m], q_RS_w "
+               "[], q_RS_x [], q_RS_y [], q_RS_z [], \n";
+  } else {
+    write<uint64_t>(stream, trajectory.num_poses);
+  }
+  gtsam::Pose3 pose;
+  for (auto it = trajectory.begin; it != trajectory.end; ++it) {
+    if (!toPose3((*it).value, &pose)) continue;
+    const gtsam::Point3& position = pose.translation();
+    const gtsam::Quaternion quat = pose.rotation().toQuaternion();
+    if (format == TrajectoryFormat::CSV) {
+      *stream << "0 , " << position.x() << "," << position.y() << ","
+              << position.z() << "," << quat.w() << "," << quat.x() << ","
+              << quat.y() << "," << quat.z() << ",\n";
+    } else {
+      write<uint64_t>(stream, gtsam::Symbol((*it).key).index());
+      const double packed[7] = {position.x(),
+                                position.y(),
+                                position.z(),
+                                quat.w(),
+                                quat.x(),
+                                quat.y(),
+                                quat.z()};
+      stream->write(reinterpret_cast<const char*>(packed), sizeof(packed));
+    }
+  }
+}
+
+size_t writeTrajectories(const gtsam::Values& values,
+                         const std::string& folder,
+                         TrajectoryFormat format,
+                         ThreadPool* thread_pool) {
+  const std::vector<TrajectoryRange> trajectories = splitTrajectories(values);
+  const std::string extension =
+      format == TrajectoryFormat::CSV ? ".csv" : ".bin";
+  std::atomic<size_t> num_written(0);
+  auto write_file = [&](size_t i) {
+    const TrajectoryRange& trajectory = trajectories[i];
+    const std::string filename =
+        folder + "/robot_" + trajectory.prefix + extension;
+    std::ofstream output(filename, format == TrajectoryFormat::CSV
+                                       ? std::ios::out
+                                       : std::ios::out | std::ios::binary);
+    if (!output.is_open()) {
+      log<WARNING>("Failed to open %1%") % filename;
+      return;
+    }
+    writeTrajectory(trajectory, format, &output);
+    num_written++;
+  };
+  if (thread_pool) {
+    thread_pool->parallelFor(trajectories.size(), write_file);
+  } else {
+    for (size_t i = 0; i < trajectories.size(); i++) write_file(i);
+  }
+  return num_written;
+}
+
+}  // namespace KimeraRPGO
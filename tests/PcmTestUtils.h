@@ -0,0 +1,93 @@
+/**
+ * @file    PcmTestUtils.h
+ * @brief   Helpers of the Pcm3D unit tests: a straight odometry chain (1 m
+ *          steps along x, pose i at x = i) and loop closures along it
+ * @author  Yun Chang
+ */
+
+#pragma once
+
+#include <gtsam/geometry/Pose3.h>
+#include <gtsam/inference/Symbol.h>
+#include <gtsam/slam/BetweenFactor.h>
+#include <gtsam/slam/PriorFactor.h>
+
+#include "KimeraRPGO/outlier/Pcm.h"
+
+namespace pcm_test {
+
+inline const gtsam::SharedNoiseModel& noise() {
+  static const gtsam::SharedNoiseModel noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  return noise;
+}
+
+/*! \brief Poses 0 to num_poses - 1 of robot prefix, one odometry factor per
+ * update. with_prior: prior on the first pose (else only its value)
+ */
+inline void addOdometry(KimeraRPGO::Pcm3D* pcm,
+                        size_t num_poses,
+                        gtsam::NonlinearFactorGraph* nfg,
+                        gtsam::Values* est,
+                        char prefix = 'a',
+                        bool with_prior = true) {
+  gtsam::Values init_vals;
+  gtsam::NonlinearFactorGraph init_factors;
+  init_vals.insert(gtsam::Symbol(prefix, 0), gtsam::Pose3());
+  if (with_prior) {
+    init_factors.add(gtsam::PriorFactor<gtsam::Pose3>(
+        gtsam::Symbol(prefix, 0), gtsam::Pose3(), noise()));
+  }
+  pcm->removeOutliers(init_factors, init_vals, nfg, est);
+  const gtsam::Pose3 odom(gtsam::Rot3(), gtsam::Point3(1, 0, 0));
+  for (size_t i = 0; i + 1 < num_poses; i++) {
+    gtsam::Values odom_val;
+    gtsam::NonlinearFactorGraph odom_factor;
+    odom_val.insert(gtsam::Symbol(prefix, i + 1),
+                    gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(i + 1, 0, 0)));
+    odom_factor.add(gtsam::BetweenFactor<gtsam::Pose3>(
+        gtsam::Symbol(prefix, i), gtsam::Symbol(prefix, i + 1), odom,
+        noise()));
+    pcm->removeOutliers(odom_factor, odom_val, nfg, est);
+  }
+}
+
+/*! \brief Relative pose from pose from to pose to of the chain
+ */
+inline gtsam::Pose3 consistent(size_t from, size_t to) {
+  return gtsam::Pose3(gtsam::Rot3(),
+                      gtsam::Point3(static_cast<double>(to) - from, 0, 0));
+}
+
+/*! \brief Loop closure of robot a, consistent with the chain if inlier (the
+ * outliers are inconsistent with the chain and with each other)
+ */
+inline gtsam::NonlinearFactorGraph loopClosure(size_t from,
+                                               size_t to,
+                                               bool inlier) {
+  const gtsam::Pose3 measured =
+      inlier ? consistent(from, to)
+             : gtsam::Pose3(gtsam::Rot3::Ypr(0.3 * from, 0.2 * to, 0.1),
+                            gtsam::Point3(3.0 * from, -2.0 * to, 1.0));
+  gtsam::NonlinearFactorGraph lc;
+  lc.add(gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', from), gtsam::Symbol('a', to), measured, noise()));
+  return lc;
+}
+
+/*! \brief Feed the loop closure measured between poses from and to of
+ * robot a
+ */
+inline void addLoopClosure(KimeraRPGO::Pcm3D* pcm,
+                           size_t from,
+                           size_t to,
+                           const gtsam::Pose3& measured,
+                           gtsam::NonlinearFactorGraph* nfg,
+                           gtsam::Values* est) {
+  gtsam::NonlinearFactorGraph lc;
+  lc.add(gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', from), gtsam::Symbol('a', to), measured, noise()));
+  pcm->removeOutliers(lc, gtsam::Values(), nfg, est);
+}
+
+}  // namespace pcm_test
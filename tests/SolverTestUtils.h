@@ -0,0 +1,108 @@
+/**
+ * @file    SolverTestUtils.h
+ * @brief   Helpers of the RobustSolver unit tests: a straight odometry chain
+ *          (1 m steps along x, with an optional drift to the side) fed one
+ *          factor per update, and loop closures along it
+ * @author  Yun Chang
+ */
+
+#pragma once
+
+#include <memory>
+
+#include <gtsam/geometry/Pose3.h>
+#include <gtsam/inference/Symbol.h>
+#include <gtsam/slam/BetweenFactor.h>
+#include <gtsam/slam/PriorFactor.h>
+
+#include "KimeraRPGO/RobustSolver.h"
+#include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/utils/TypeUtils.h"
+
+namespace solver_test {
+
+inline const gtsam::SharedNoiseModel& noise() {
+  static const gtsam::SharedNoiseModel noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  return noise;
+}
+
+/*! \brief noise() or, if not shared, an equal model of its own (as when the
+ * factors are read from a file)
+ */
+inline gtsam::SharedNoiseModel chainNoise(bool shared_noise) {
+  return shared_noise ? noise()
+                      : gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+}
+
+/*! \brief Pose i of the chain, drift: lateral offset per step
+ */
+inline gtsam::Pose3 chainPose(size_t i, double drift = 0) {
+  return gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(i, drift * i, 0));
+}
+
+inline void addPrior(KimeraRPGO::RobustSolver* pgo,
+                     char prefix = 'a',
+                     bool shared_noise = true) {
+  gtsam::NonlinearFactorGraph prior;
+  gtsam::Values init;
+  prior.add(gtsam::PriorFactor<gtsam::Pose3>(
+      gtsam::Symbol(prefix, 0), gtsam::Pose3(), chainNoise(shared_noise)));
+  init.insert(gtsam::Symbol(prefix, 0), gtsam::Pose3());
+  pgo->update(prior, init);
+}
+
+/*! \brief Odometry from pose from to pose to of the chain, one update per
+ * factor
+ */
+inline void addOdometry(KimeraRPGO::RobustSolver* pgo,
+                        size_t from,
+                        size_t to,
+                        double drift = 0,
+                        char prefix = 'a',
+                        bool shared_noise = true) {
+  for (size_t i = from; i < to; i++) {
+    gtsam::NonlinearFactorGraph odom_factor;
+    gtsam::Values odom_val;
+    odom_factor.add(gtsam::BetweenFactor<gtsam::Pose3>(
+        gtsam::Symbol(prefix, i),
+        gtsam::Symbol(prefix, i + 1),
+        chainPose(i, drift).between(chainPose(i + 1, drift)),
+        chainNoise(shared_noise)));
+    odom_val.insert(gtsam::Symbol(prefix, i + 1), chainPose(i + 1, drift));
+    pgo->update(odom_factor, odom_val);
+  }
+}
+
+/*! \brief Solver with the prior and the odometry of num_poses poses of
+ * robot a
+ */
+inline std::unique_ptr<KimeraRPGO::RobustSolver> makeSolver(
+    const KimeraRPGO::RobustSolverParams& params,
+    size_t num_poses,
+    double drift = 0,
+    bool shared_noise = true) {
+  std::unique_ptr<KimeraRPGO::RobustSolver> pgo =
+      KimeraRPGO::make_unique<KimeraRPGO::RobustSolver>(params);
+  addPrior(pgo.get(), 'a', shared_noise);
+  addOdometry(pgo.get(), 0, num_poses - 1, drift, 'a', shared_noise);
+  return pgo;
+}
+
+/*! \brief Closure from pose from to pose to of robot a, measured along x
+ * with a lateral offset
+ */
+inline gtsam::NonlinearFactorGraph loopClosure(size_t from,
+                                               size_t to,
+                                               double offset = 0) {
+  gtsam::NonlinearFactorGraph lc;
+  lc.add(gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', from),
+      gtsam::Symbol('a', to),
+      gtsam::Pose3(gtsam::Rot3(),
+                   gtsam::Point3(static_cast<double>(to) - from, offset, 0)),
+      noise()));
+  return lc;
+}
+
+}  // namespace solver_test
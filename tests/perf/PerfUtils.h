@@ -0,0 +1,318 @@
+/**
+ * @file    PerfUtils.h
+ * @brief   Helpers of the performance regression tests: operation counters,
+ *          incremental replay of a pose graph and a synthetic graph generator
+ * @author  Yun Chang
+ *
+ * The budgets of the perf tests are on operation counts (heap allocations,
+ * pairwise consistency checks, max clique nodes expanded) so that they hold
+ * on any machine; wall times are only printed. The allocation budgets are on
+ * growth: update k is compared with update k / 2, so that a cost growing
+ * with the graph fails however small it is next to the constant part. This
+ * header replaces the global operator new and must be included by a single
+ * translation unit of each perf executable.
+ */
+
+#pragma once
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtsam/geometry/Pose3.h>
+#include <gtsam/inference/Symbol.h>
+#include <gtsam/slam/BetweenFactor.h>
+#include <gtsam/slam/PriorFactor.h>
+
+#include "KimeraRPGO/RobustSolver.h"
+
+namespace perf {
+std::atomic<size_t> num_allocations(0);
+}  // namespace perf
+
+// count every allocation of the process (the library included)
+void* operator new(std::size_t size) {
+  perf::num_allocations++;
+  if (void* ptr = std::malloc(size > 0 ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace perf {
+
+typedef std::chrono::high_resolution_clock Clock;
+
+inline size_t allocations() { return num_allocations.load(); }
+
+/*! \brief peak resident set size of the process (KiB)
+ */
+inline size_t peakMemoryKb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<size_t>(usage.ru_maxrss);
+}
+
+/*! \brief Cost of one RobustSolver::update call
+ *  num_lc and num_inliers are the totals after the update
+ */
+struct UpdateCost {
+  size_t allocations = 0;
+  size_t checks = 0;
+  size_t nodes_expanded = 0;
+  size_t num_lc = 0;
+  size_t num_inliers = 0;
+  double time_ms = 0;
+};
+
+/*! \brief Cost of an update without the optimization (the budgets are on
+ *  the outlier rejection and the bookkeeping of the solver)
+ */
+inline UpdateCost timedUpdate(KimeraRPGO::RobustSolver* pgo,
+                              const gtsam::NonlinearFactorGraph& factors,
+                              const gtsam::Values& values) {
+  const size_t checks = pgo->getNumConsistencyChecks();
+  const size_t nodes = pgo->getNumCliqueNodesExpanded();
+  const size_t allocs = allocations();
+  const Clock::time_point start = Clock::now();
+  pgo->update(factors, values, false);
+  UpdateCost cost;
+  cost.time_ms =
+      std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  cost.allocations = allocations() - allocs;
+  cost.checks = pgo->getNumConsistencyChecks() - checks;
+  cost.nodes_expanded = pgo->getNumCliqueNodesExpanded() - nodes;
+  cost.num_lc = pgo->getNumLC();
+  cost.num_inliers = pgo->getNumLCInliers();
+  return cost;
+}
+
+/*! \brief Pose graph split for an incremental replay
+ *  - odometry: priors and between factors of consecutive poses of a robot
+ *  - loop_closures: all other factors
+ */
+struct PoseGraph {
+  gtsam::NonlinearFactorGraph odometry;
+  gtsam::NonlinearFactorGraph loop_closures;
+  gtsam::Values values;
+};
+
+inline PoseGraph splitPoseGraph(const gtsam::NonlinearFactorGraph& nfg,
+                                const gtsam::Values& values) {
+  PoseGraph graph;
+  graph.values = values;
+  for (const auto& factor : nfg) {
+    if (!factor) continue;
+    bool is_odometry = factor->keys().size() == 1;
+    if (factor->keys().size() == 2) {
+      const gtsam::Symbol front(factor->front());
+      const gtsam::Symbol back(factor->back());
+      is_odometry =
+          front.chr() == back.chr() && back.index() == front.index() + 1;
+    }
+    if (is_odometry) {
+      graph.odometry.add(factor);
+    } else {
+      graph.loop_closures.add(factor);
+    }
+  }
+  return graph;
+}
+
+/*! \brief Synthetic single robot pose graph
+ *  spiral trajectory with noisy odometry, loop closures between random poses
+ *  (num_inliers correct ones followed by num_outliers random ones)
+ */
+inline PoseGraph makeSyntheticGraph(size_t num_poses,
+                                    size_t num_inliers,
+                                    size_t num_outliers,
+                                    unsigned int seed = 0) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0.0, 0.01);
+  std::uniform_real_distribution<double> angle(-3.0, 3.0);
+  std::uniform_real_distribution<double> position(-20.0, 20.0);
+  std::uniform_int_distribution<size_t> pick(0, num_poses - 1);
+  static const gtsam::SharedNoiseModel& model =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+
+  std::vector<gtsam::Pose3> poses;
+  for (size_t i = 0; i < num_poses; i++) {
+    const double t = 0.05 * i;
+    poses.push_back(
+        gtsam::Pose3(gtsam::Rot3::Yaw(t),
+                     gtsam::Point3(10 * std::cos(t), 10 * std::sin(t), t)));
+  }
+  auto perturb = [&](const gtsam::Pose3& pose) {
+    gtsam::Vector6 delta;
+    for (size_t d = 0; d < 6; d++) delta(d) = noise(rng);
+    return pose.retract(delta);
+  };
+
+  PoseGraph graph;
+  graph.odometry.add(gtsam::PriorFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', 0), poses[0], model));
+  graph.values.insert(gtsam::Symbol('a', 0), poses[0]);
+  gtsam::Pose3 dead_reckoning = poses[0];
+  for (size_t i = 0; i + 1 < num_poses; i++) {
+    const gtsam::Pose3 odom = perturb(poses[i].between(poses[i + 1]));
+    graph.odometry.add(gtsam::BetweenFactor<gtsam::Pose3>(
+        gtsam::Symbol('a', i), gtsam::Symbol('a', i + 1), odom, model));
+    dead_reckoning = dead_reckoning.compose(odom);
+    graph.values.insert(gtsam::Symbol('a', i + 1), dead_reckoning);
+  }
+  size_t k = 0;
+  while (k < num_inliers + num_outliers) {
+    const size_t i = pick(rng), j = pick(rng);
+    if (i + 1 >= j) continue;
+    const gtsam::Pose3 measured =
+        k < num_inliers
+            ? perturb(poses[i].between(poses[j]))
+            : gtsam::Pose3(
+                  gtsam::Rot3::Ypr(angle(rng), angle(rng) / 2, angle(rng)),
+                  gtsam::Point3(position(rng), position(rng), position(rng)));
+    graph.loop_closures.add(gtsam::BetweenFactor<gtsam::Pose3>(
+        gtsam::Symbol('a', i), gtsam::Symbol('a', j), measured, model));
+    k++;
+  }
+  return graph;
+}
+
+/*! \brief Costs of the updates of a replay, in order
+ */
+struct ReplayCosts {
+  std::vector<UpdateCost> odometry;
+  std::vector<UpdateCost> loop_closures;
+};
+
+/*! \brief Replay of a pose graph one factor per update: the priors, the
+ *  odometry (with the poses it reaches first), then the loop closures
+ */
+inline ReplayCosts replay(KimeraRPGO::RobustSolver* pgo,
+                          const PoseGraph& graph) {
+  ReplayCosts costs;
+  gtsam::KeySet inserted;
+  for (bool priors : {true, false}) {
+    for (const auto& factor : graph.odometry) {
+      if ((factor->keys().size() == 1) != priors) continue;
+      gtsam::NonlinearFactorGraph odom;
+      odom.add(factor);
+      gtsam::Values values;
+      for (const gtsam::Key& key : factor->keys()) {
+        if (inserted.insert(key).second) {
+          values.insert(key, graph.values.at(key));
+        }
+      }
+      costs.odometry.push_back(timedUpdate(pgo, odom, values));
+    }
+  }
+  for (const auto& factor : graph.loop_closures) {
+    gtsam::NonlinearFactorGraph lc;
+    lc.add(factor);
+    costs.loop_closures.push_back(timedUpdate(pgo, lc, gtsam::Values()));
+  }
+  return costs;
+}
+
+// the first updates set up the containers of the solver
+const size_t kMinGrowthUpdate = 8;
+
+/*! \brief Allocations of update k against update k / 2
+ *  - growth: allowed factor, 1 for O(1) updates, 2 for linear ones
+ *  - slack: allowed difference (containers doubling at one of the two)
+ *  Returns the number of violations (printed)
+ */
+inline size_t countGrowthViolations(const std::string& name,
+                                    const std::vector<UpdateCost>& costs,
+                                    size_t growth,
+                                    size_t slack) {
+  size_t violations = 0;
+  for (size_t k = 2 * kMinGrowthUpdate; k < costs.size(); k++) {
+    const size_t budget = growth * costs[k / 2].allocations + slack;
+    if (costs[k].allocations > budget) {
+      std::cout << name << " update " << k << ": " << costs[k].allocations
+                << " allocations, " << costs[k / 2].allocations
+                << " at update " << k / 2 << ", budget " << budget
+                << std::endl;
+      violations++;
+    }
+  }
+  return violations;
+}
+
+/*! \brief Budgets of a replay
+ *  - odometry updates: O(1) allocations (no growth)
+ *  - loop closure updates: allocations at most linear in the closures so far
+ *    (the adjacency and the max clique search grow with the group)
+ *  - incremental_checks: an update checks the new loop closure against the
+ *    others at most once (not true for the lazy check)
+ *  The clique nodes expanded are bounded by the vertices times the max
+ *  clique size of the heuristic search, and the checks over all updates by
+ *  the number of pairs. Returns the number of violations (printed).
+ */
+inline size_t countBudgetViolations(const ReplayCosts& replay_costs,
+                                    bool incremental_checks) {
+  // a few containers of the solver may double in the same update
+  const size_t kOdometrySlack = 16;
+  const size_t kLoopClosureSlack = 64;
+  size_t violations =
+      countGrowthViolations("odometry", replay_costs.odometry, 1,
+                            kOdometrySlack) +
+      countGrowthViolations("loop closure", replay_costs.loop_closures, 2,
+                            kLoopClosureSlack);
+  const std::vector<UpdateCost>& costs = replay_costs.loop_closures;
+  size_t total_checks = 0;
+  for (size_t k = 0; k < costs.size(); k++) {
+    const UpdateCost& cost = costs[k];
+    total_checks += cost.checks;
+    const size_t max_nodes =
+        cost.num_lc * std::max<size_t>(1, cost.num_inliers);
+    if (incremental_checks && cost.checks > cost.num_lc) {
+      std::cout << "update " << k << ": " << cost.checks
+                << " consistency checks, budget " << cost.num_lc << std::endl;
+      violations++;
+    }
+    if (cost.nodes_expanded > max_nodes) {
+      std::cout << "update " << k << ": " << cost.nodes_expanded
+                << " clique nodes expanded, budget " << max_nodes
+                << std::endl;
+      violations++;
+    }
+  }
+  const size_t num_lc = costs.empty() ? 0 : costs.back().num_lc;
+  const size_t max_checks = num_lc * (num_lc - 1) / 2;
+  if (num_lc > 0 && total_checks > max_checks) {
+    std::cout << total_checks << " consistency checks, budget " << max_checks
+              << std::endl;
+    violations++;
+  }
+  return violations;
+}
+
+inline void printCosts(const std::string& name,
+                       const std::vector<UpdateCost>& costs) {
+  double total_ms = 0, max_ms = 0;
+  size_t max_allocations = 0, checks = 0, nodes = 0;
+  for (const UpdateCost& cost : costs) {
+    total_ms += cost.time_ms;
+    max_ms = std::max(max_ms, cost.time_ms);
+    max_allocations = std::max(max_allocations, cost.allocations);
+    checks += cost.checks;
+    nodes += cost.nodes_expanded;
+  }
+  std::cout << name << ": " << costs.size() << " updates, mean "
+            << (costs.empty() ? 0 : total_ms / costs.size()) << " ms, max "
+            << max_ms << " ms, max allocations " << max_allocations
+            << ", checks " << checks << ", nodes expanded " << nodes
+            << ", peak memory " << peakMemoryKb() << " KiB" << std::endl;
+}
+
+}  // namespace perf
@@ -0,0 +1,65 @@
+/**
+ * @file    perfDataset.cpp
+ * @brief   Performance budgets of RobustSolver on the test datasets
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+#include <memory>
+#include <string>
+
+#include <gtsam/slam/dataset.h>
+
+#include "KimeraRPGO/RobustSolver.h"
+#include "KimeraRPGO/SolverParams.h"
+#include "PerfUtils.h"
+#include "test_config.h"
+
+using namespace KimeraRPGO;
+
+namespace {
+const size_t kMaxPeakMemoryKb = 256 * 1024;
+
+size_t replayDataset(const std::string& file) {
+  gtsam::NonlinearFactorGraph::shared_ptr nfg;
+  gtsam::Values::shared_ptr values;
+  boost::tie(nfg, values) = gtsam::load3D(std::string(DATASET_PATH) + file);
+
+  // prior on the first pose
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  const gtsam::Key init_key = values->keys().front();
+  nfg->add(gtsam::PriorFactor<gtsam::Pose3>(
+      init_key, values->at<gtsam::Pose3>(init_key), noise));
+
+  RobustSolverParams params;
+  params.setPcm3DParams(100.0, 100.0, Verbosity::QUIET);
+  std::unique_ptr<RobustSolver> pgo =
+      KimeraRPGO::make_unique<RobustSolver>(params);
+
+  const perf::PoseGraph graph = perf::splitPoseGraph(*nfg, *values);
+  const perf::ReplayCosts costs = perf::replay(pgo.get(), graph);
+  perf::printCosts(file + " odometry", costs.odometry);
+  perf::printCosts(file + " loop closures", costs.loop_closures);
+  return perf::countBudgetViolations(costs, true);
+}
+}  // namespace
+
+/* ************************************************************************* */
+TEST(PerfDataset, RobotA) {
+  EXPECT(size_t(0) == replayDataset("/robot_a.g2o"));
+  EXPECT(perf::peakMemoryKb() <= kMaxPeakMemoryKb);
+}
+
+/* ************************************************************************* */
+TEST(PerfDataset, RobotB) {
+  EXPECT(size_t(0) == replayDataset("/robot_b.g2o"));
+  EXPECT(perf::peakMemoryKb() <= kMaxPeakMemoryKb);
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
@@ -0,0 +1,65 @@
+/**
+ * @file    perfSynthetic.cpp
+ * @brief   Performance budgets of RobustSolver on a generated pose graph
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+#include <memory>
+
+#include "KimeraRPGO/RobustSolver.h"
+#include "KimeraRPGO/SolverParams.h"
+#include "PerfUtils.h"
+
+using namespace KimeraRPGO;
+
+namespace {
+const size_t kNumPoses = 1000;
+const size_t kNumInliers = 40;
+const size_t kNumOutliers = 40;
+const size_t kMaxPeakMemoryKb = 512 * 1024;
+
+RobustSolverParams pcmParams(bool lazy) {
+  RobustSolverParams params;
+  params.setPcm3DParams(100.0, 10.0, Verbosity::QUIET);
+  if (lazy) params.setLazyConsistency();
+  return params;
+}
+}  // namespace
+
+/* ************************************************************************* */
+TEST(PerfSynthetic, Incremental) {
+  const perf::PoseGraph graph =
+      perf::makeSyntheticGraph(kNumPoses, kNumInliers, kNumOutliers);
+  std::unique_ptr<RobustSolver> pgo =
+      KimeraRPGO::make_unique<RobustSolver>(pcmParams(false));
+  const perf::ReplayCosts costs = perf::replay(pgo.get(), graph);
+  perf::printCosts("synthetic odometry", costs.odometry);
+  perf::printCosts("synthetic loop closures", costs.loop_closures);
+  EXPECT(size_t(0) == perf::countBudgetViolations(costs, true));
+  EXPECT(perf::peakMemoryKb() <= kMaxPeakMemoryKb);
+}
+
+/* ************************************************************************* */
+TEST(PerfSynthetic, LazyConsistency) {
+  const perf::PoseGraph graph =
+      perf::makeSyntheticGraph(kNumPoses, kNumInliers, kNumOutliers);
+  std::unique_ptr<RobustSolver> eager =
+      KimeraRPGO::make_unique<RobustSolver>(pcmParams(false));
+  std::unique_ptr<RobustSolver> lazy =
+      KimeraRPGO::make_unique<RobustSolver>(pcmParams(true));
+  perf::replay(eager.get(), graph);
+  const perf::ReplayCosts costs = perf::replay(lazy.get(), graph);
+  perf::printCosts("synthetic loop closures (lazy)", costs.loop_closures);
+  EXPECT(size_t(0) == perf::countBudgetViolations(costs, false));
+  // the lazy search never checks more pairs than the full matrix
+  EXPECT(lazy->getNumConsistencyChecks() <= eager->getNumConsistencyChecks());
+  EXPECT(perf::peakMemoryKb() <= kMaxPeakMemoryKb);
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
@@ -0,0 +1,148 @@
+/**
+ * @file    testBulkOdometry.cpp
+ * @brief   Unit test for odometry loaded in bulk (runs composed at once)
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+#include <memory>
+
+#include <gtsam/geometry/Pose2.h>
+#include <gtsam/geometry/Pose3.h>
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/RobustSolver.h"
+#include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/utils/GeometryUtils.h"
+#include "KimeraRPGO/utils/TypeUtils.h"
+#include "SolverTestUtils.h"
+
+using KimeraRPGO::PoseWithCovariance;
+using KimeraRPGO::PoseWithNode;
+using KimeraRPGO::RobustSolver;
+using KimeraRPGO::RobustSolverParams;
+using KimeraRPGO::Verbosity;
+using solver_test::noise;
+
+namespace {
+const size_t kNumPoses = 20;
+
+gtsam::Pose3 odometry(size_t i) {
+  return gtsam::Pose3(gtsam::Rot3::Yaw(0.05), gtsam::Point3(1, 0.01 * i, 0));
+}
+
+// both robots start at the origin of their frame
+gtsam::Pose3 truePose(size_t i) {
+  gtsam::Pose3 pose;
+  for (size_t j = 0; j < i; j++) pose = pose.compose(odometry(j));
+  return pose;
+}
+
+void addOdometry(char robot,
+                 size_t i,
+                 gtsam::NonlinearFactorGraph* factors,
+                 gtsam::Values* values) {
+  factors->add(gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol(robot, i), gtsam::Symbol(robot, i + 1), odometry(i),
+      noise()));
+  values->insert(gtsam::Symbol(robot, i + 1), truePose(i + 1));
+}
+
+void addPrior(char robot,
+              gtsam::NonlinearFactorGraph* factors,
+              gtsam::Values* values) {
+  factors->add(gtsam::PriorFactor<gtsam::Pose3>(
+      gtsam::Symbol(robot, 0), gtsam::Pose3(), noise()));
+  values->insert(gtsam::Symbol(robot, 0), gtsam::Pose3());
+}
+
+// loop closures on robot a: consistent with the odometry, and not
+gtsam::NonlinearFactorGraph loopClosures() {
+  gtsam::NonlinearFactorGraph lc;
+  lc.add(gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', 5), gtsam::Symbol('a', 15),
+      truePose(5).between(truePose(15)), noise()));
+  lc.add(gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', 2), gtsam::Symbol('a', 18),
+      gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(-3, 4, 0)), noise()));
+  return lc;
+}
+}  // namespace
+
+/* ************************************************************************* */
+TEST(BulkOdometry, Compose) {
+  gtsam::Matrix6 covariance = 0.01 * gtsam::I_6x6;
+  covariance(0, 0) = 0.02;
+  const PoseWithCovariance<gtsam::Pose3> a(odometry(1), covariance);
+  const PoseWithCovariance<gtsam::Pose3> b(odometry(2), 2 * covariance);
+  PoseWithCovariance<gtsam::Pose3> in_place = a;
+  in_place.composeInPlace(b);
+  const PoseWithCovariance<gtsam::Pose3> composed = a.compose(b);
+  EXPECT(gtsam::assert_equal(composed.pose, in_place.pose));
+  EXPECT(gtsam::assert_equal(gtsam::Matrix(composed.covariance_matrix),
+                             gtsam::Matrix(in_place.covariance_matrix)));
+
+  PoseWithNode<gtsam::Pose2> c(gtsam::Pose2(1, 0, 0.1), 1);
+  c.composeInPlace(PoseWithNode<gtsam::Pose2>(gtsam::Pose2(1, 0, 0.1), 2));
+  EXPECT(gtsam::assert_equal(gtsam::Pose2(1, 0, 0.1).compose(
+                                 gtsam::Pose2(1, 0, 0.1)),
+                             c.pose));
+  EXPECT(c.node == 3);
+}
+
+/* ************************************************************************* */
+TEST(BulkOdometry, SameAsIncremental) {
+  RobustSolverParams params;
+  params.setPcm3DParams(3.0, 3.0, Verbosity::QUIET);
+
+  // one update: both robots, with the odometry of robot b in two runs
+  // interleaved with robot a
+  RobustSolver bulk(params);
+  gtsam::NonlinearFactorGraph factors;
+  gtsam::Values values;
+  addPrior('a', &factors, &values);
+  addPrior('b', &factors, &values);
+  for (size_t i = 0; i < kNumPoses; i++) {
+    if (i == kNumPoses / 2) {
+      for (size_t j = 0; j < kNumPoses / 2; j++) {
+        addOdometry('b', j, &factors, &values);
+      }
+    }
+    addOdometry('a', i, &factors, &values);
+  }
+  for (size_t j = kNumPoses / 2; j < kNumPoses; j++) {
+    addOdometry('b', j, &factors, &values);
+  }
+  bulk.update(factors, values);
+
+  RobustSolver incremental(params);
+  gtsam::NonlinearFactorGraph priors;
+  gtsam::Values prior_values;
+  addPrior('a', &priors, &prior_values);
+  addPrior('b', &priors, &prior_values);
+  incremental.update(priors, prior_values);
+  for (size_t i = 0; i < kNumPoses; i++) {
+    for (char robot : {'a', 'b'}) {
+      gtsam::NonlinearFactorGraph odom;
+      gtsam::Values odom_values;
+      addOdometry(robot, i, &odom, &odom_values);
+      incremental.update(odom, odom_values);
+    }
+  }
+
+  // the consistency checks use the composed trajectories
+  bulk.update(loopClosures());
+  incremental.update(loopClosures());
+  EXPECT(bulk.getNumLC() == incremental.getNumLC());
+  EXPECT(bulk.getNumLCInliers() == 1);
+  EXPECT(incremental.getNumLCInliers() == 1);
+  EXPECT(gtsam::assert_equal(incremental.calculateEstimate(),
+                             bulk.calculateEstimate(), 1e-4));
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
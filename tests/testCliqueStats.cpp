@@ -0,0 +1,167 @@
+/**
+ * @file    testCliqueStats.cpp
+ * @brief   Unit test for the max clique search statistics
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/outlier/Pcm.h"
+#include "KimeraRPGO/utils/GraphUtils.h"
+
+using KimeraRPGO::CliqueStatsSummary;
+using KimeraRPGO::MaxCliqueStats;
+using KimeraRPGO::ObservationId;
+using KimeraRPGO::Pcm3D;
+using KimeraRPGO::PcmParams;
+
+namespace {
+// 4-clique (0-3) plus a disconnected edge (4-5)
+Eigen::MatrixXd cliqueWithEdge() {
+  Eigen::MatrixXd adj = Eigen::MatrixXd::Zero(6, 6);
+  for (size_t i = 0; i < 4; i++) {
+    for (size_t j = 0; j < 4; j++) {
+      if (i != j) adj(i, j) = 1;
+    }
+  }
+  adj(4, 5) = 1;
+  adj(5, 4) = 1;
+  return adj;
+}
+
+void addRobot(Pcm3D* pcm,
+              char prefix,
+              size_t num_poses,
+              gtsam::NonlinearFactorGraph* nfg,
+              gtsam::Values* est) {
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.1);
+  gtsam::Values init_vals;
+  gtsam::NonlinearFactorGraph init_factors;
+  init_vals.insert(gtsam::Symbol(prefix, 0), gtsam::Pose3());
+  init_factors.add(gtsam::PriorFactor<gtsam::Pose3>(
+      gtsam::Symbol(prefix, 0), gtsam::Pose3(), noise));
+  pcm->removeOutliers(init_factors, init_vals, nfg, est);
+  for (size_t i = 0; i + 1 < num_poses; i++) {
+    gtsam::Values odom_val;
+    gtsam::NonlinearFactorGraph odom_factor;
+    gtsam::Pose3 odom(gtsam::Rot3(), gtsam::Point3(1, 0, 0));
+    odom_val.insert(gtsam::Symbol(prefix, i + 1),
+                    gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(i + 1, 0, 0)));
+    odom_factor.add(gtsam::BetweenFactor<gtsam::Pose3>(
+        gtsam::Symbol(prefix, i), gtsam::Symbol(prefix, i + 1), odom, noise));
+    pcm->removeOutliers(odom_factor, odom_val, nfg, est);
+  }
+}
+
+gtsam::BetweenFactor<gtsam::Pose3> loopClosure(char prefix,
+                                               size_t from,
+                                               size_t to) {
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.1);
+  gtsam::Pose3 measured(gtsam::Rot3(),
+                        gtsam::Point3(static_cast<double>(to) - from, 0, 0));
+  return gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol(prefix, from), gtsam::Symbol(prefix, to), measured, noise);
+}
+}  // namespace
+
+/* ************************************************************************* */
+TEST(MaxCliqueStats, Heuristic) {
+  std::vector<int> clique;
+  MaxCliqueStats stats;
+  int size = KimeraRPGO::findMaxCliqueHeu(cliqueWithEdge(), &clique, &stats);
+
+  EXPECT(size == 4);
+  EXPECT(stats.clique_size == 4);
+  EXPECT(stats.num_vertices == 6);
+  EXPECT(stats.num_edges == 7);
+  DOUBLES_EQUAL(7.0 / 15.0, stats.density, 1e-9);
+  // every vertex after the first clique vertex is skipped by pruning 1
+  EXPECT(stats.not_computed == 5);
+  EXPECT(stats.pruned1 == 5);
+  EXPECT(stats.nodes_expanded == 4);
+  EXPECT(stats.time_ms >= 0);
+}
+
+/* ************************************************************************* */
+TEST(MaxCliqueStats, Exact) {
+  std::vector<int> clique;
+  MaxCliqueStats stats;
+  int size = KimeraRPGO::findMaxClique(cliqueWithEdge(), &clique, &stats);
+
+  EXPECT(size == 4);
+  EXPECT(stats.clique_size == 4);
+  EXPECT(stats.num_vertices == 6);
+  EXPECT(stats.num_edges == 7);
+  EXPECT(stats.nodes_expanded > 0);
+  EXPECT(stats.pruned1 > 0);
+}
+
+/* ************************************************************************* */
+TEST(MaxCliqueStats, Summary) {
+  CliqueStatsSummary summary;
+  MaxCliqueStats a, b;
+  a.nodes_expanded = 3;
+  a.time_ms = 2.0;
+  b.nodes_expanded = 5;
+  b.time_ms = 1.0;
+  b.clique_size = 7;
+  summary.add(a);
+  summary.add(b);
+
+  EXPECT(summary.num_searches == 2);
+  EXPECT(summary.total_nodes_expanded == 8);
+  DOUBLES_EQUAL(3.0, summary.total_time_ms, 1e-9);
+  DOUBLES_EQUAL(2.0, summary.max_time_ms, 1e-9);
+  EXPECT(summary.last.clique_size == 7);
+}
+
+/* ************************************************************************* */
+TEST(MaxCliqueStats, PcmPerRobotPair) {
+  PcmParams params;
+  params.odom_threshold = 100;
+  params.lc_threshold = 100;
+  Pcm3D pcm(params);
+  pcm.setQuiet();
+
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values est;
+  addRobot(&pcm, 'a', 5, &nfg, &est);
+  addRobot(&pcm, 'b', 5, &nfg, &est);
+  EXPECT(pcm.getCliqueStats().size() == 0);
+
+  // two intra robot loop closures for robot a
+  gtsam::NonlinearFactorGraph lc_a;
+  lc_a.add(loopClosure('a', 0, 3));
+  lc_a.add(loopClosure('a', 1, 4));
+  pcm.removeOutliers(lc_a, gtsam::Values(), &nfg, &est);
+
+  ObservationId aa('a', 'a'), bb('b', 'b');
+  EXPECT(pcm.getCliqueStats().size() == 1);
+  const CliqueStatsSummary& stats_aa = pcm.getCliqueStats().at(aa);
+  EXPECT(stats_aa.num_searches == 1);
+  EXPECT(stats_aa.last.num_vertices == 2);
+  EXPECT(stats_aa.last.num_edges == 1);
+  EXPECT(stats_aa.last.clique_size == 2);
+
+  // one loop closure for robot b: all groups are searched again
+  gtsam::NonlinearFactorGraph lc_b;
+  lc_b.add(loopClosure('b', 0, 3));
+  pcm.removeOutliers(lc_b, gtsam::Values(), &nfg, &est);
+
+  EXPECT(pcm.getCliqueStats().size() == 2);
+  EXPECT(pcm.getCliqueStats().at(aa).num_searches == 2);
+  EXPECT(pcm.getCliqueStats().at(bb).num_searches == 1);
+  EXPECT(pcm.getCliqueStats().at(bb).last.num_vertices == 1);
+  EXPECT(pcm.getLandmarkCliqueStats().num_searches == 0);
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
@@ -0,0 +1,246 @@
+/**
+ * @file    testFactorIds.cpp
+ * @brief   Unit test for the factor ids and slot compaction of GenericSolver
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gtsam/geometry/Pose2.h>
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/GenericSolver.h"
+#include "KimeraRPGO/RobustSolver.h"
+#include "SolverTestUtils.h"
+
+using KimeraRPGO::FactorId;
+using KimeraRPGO::FactorIds;
+using KimeraRPGO::GenericSolver;
+using KimeraRPGO::RobustSolver;
+using KimeraRPGO::RobustSolverParams;
+using KimeraRPGO::Verbosity;
+
+namespace {
+const size_t kNumPoses = 100;
+
+// prior and odometry of a straight line
+void makeChain(gtsam::NonlinearFactorGraph* nfg, gtsam::Values* values) {
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(3, 0.01);
+  nfg->add(gtsam::PriorFactor<gtsam::Pose2>(
+      gtsam::Symbol('a', 0), gtsam::Pose2(), noise));
+  values->insert(gtsam::Symbol('a', 0), gtsam::Pose2());
+  for (size_t i = 0; i + 1 < kNumPoses; i++) {
+    nfg->add(gtsam::BetweenFactor<gtsam::Pose2>(gtsam::Symbol('a', i),
+                                                gtsam::Symbol('a', i + 1),
+                                                gtsam::Pose2(1, 0, 0),
+                                                noise));
+    values->insert(gtsam::Symbol('a', i + 1), gtsam::Pose2(i + 1, 0, 0));
+  }
+}
+
+gtsam::NonlinearFactorGraph loopClosure(size_t from, size_t to) {
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(3, 0.01);
+  gtsam::NonlinearFactorGraph lc;
+  lc.add(gtsam::BetweenFactor<gtsam::Pose2>(
+      gtsam::Symbol('a', from),
+      gtsam::Symbol('a', to),
+      gtsam::Pose2(static_cast<double>(to) - from, 0, 0),
+      noise));
+  return lc;
+}
+// rebuilds nfg_ like the outlier rejection of RobustSolver: same factors in
+// another order, some dropped
+class RebuildingSolver : public GenericSolver {
+ public:
+  void rebuildWithout(size_t slot) {
+    gtsam::NonlinearFactorGraph rebuilt;
+    for (size_t i = nfg_.size(); i-- > 0;) {
+      if (i != slot) rebuilt.add(nfg_[i]);
+    }
+    nfg_ = rebuilt;
+    invalidateFactorIds();
+  }
+};
+}  // namespace
+
+/* ************************************************************************* */
+TEST(FactorIds, StableAcrossCompaction) {
+  GenericSolver solver;
+  solver.setQuiet();
+  solver.compactFactors();
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values values;
+  makeChain(&nfg, &values);
+  const FactorIds ids = solver.update(nfg, values);
+  EXPECT(ids.size() == kNumPoses);
+  for (size_t i = 0; i < ids.size(); i++) {
+    EXPECT(ids[i].valid());
+    EXPECT(solver.getFactorSlot(ids[i]) == i);
+    EXPECT(solver.getFactorId(i) == ids[i]);
+  }
+
+  // a loop closure added and removed by id
+  const FactorIds lc_ids = solver.update(loopClosure(0, 50), gtsam::Values());
+  EXPECT(lc_ids.size() == 1);
+  solver.update(gtsam::NonlinearFactorGraph(), gtsam::Values(), lc_ids);
+  EXPECT(solver.getFactorSlot(lc_ids[0]) == solver.size());
+  EXPECT(solver.size() == kNumPoses + 1);  // removed slot not compacted yet
+
+  // removed ids are never reused
+  const FactorIds new_ids = solver.update(loopClosure(0, 60), gtsam::Values());
+  for (const FactorId& id : ids) EXPECT(id != new_ids[0]);
+  EXPECT(lc_ids[0] != new_ids[0]);
+
+  // less than half the slots removed: the graph keeps its removed slots
+  FactorIds removed;
+  for (size_t i = 1; i < 40; i++) removed.push_back(ids[i]);
+  solver.removeFactorsNoUpdate(removed);
+  EXPECT(solver.size() == kNumPoses + 2);
+  EXPECT(!solver.getFactorsUnsafe()[1]);
+  EXPECT(!solver.getFactorId(1).valid());
+
+  // more than half: compacted, the remaining ids follow their factors
+  removed.clear();
+  for (size_t i = 40; i < 60; i++) removed.push_back(ids[i]);
+  solver.removeFactorsNoUpdate(removed);
+  EXPECT(solver.size() == kNumPoses - 58);
+  EXPECT(solver.getFactorSlot(new_ids[0]) == solver.size() - 1);
+  for (size_t i = 0; i < ids.size(); i++) {
+    const size_t slot = solver.getFactorSlot(ids[i]);
+    if (i > 0 && i < 60) {
+      EXPECT(slot == solver.size());
+      continue;
+    }
+    EXPECT(slot < solver.size());
+    EXPECT(solver.getFactorsUnsafe()[slot]->keys() == nfg[i]->keys());
+    EXPECT(solver.getFactorId(slot) == ids[i]);
+  }
+}
+
+/* ************************************************************************* */
+TEST(FactorIds, RemoveLastFactor) {
+  GenericSolver solver;
+  solver.setQuiet();
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values values;
+  makeChain(&nfg, &values);
+  const FactorIds ids = solver.update(nfg, values);
+  const FactorIds lc_ids = solver.update(loopClosure(0, 50), gtsam::Values());
+
+  // the last factor was removed already: the one before it goes
+  solver.removeFactorsNoUpdate(lc_ids);
+  KimeraRPGO::EdgePtr edge = solver.removeLastFactor();
+  EXPECT(edge);
+  EXPECT(edge->from_key == gtsam::Symbol('a', kNumPoses - 2));
+  EXPECT(edge->to_key == gtsam::Symbol('a', kNumPoses - 1));
+  EXPECT(solver.size() == kNumPoses - 1);
+  EXPECT(solver.getFactorSlot(ids.back()) == solver.size());
+  EXPECT(solver.getFactorSlot(ids.front()) == 0);
+
+  // positional removal still works on the current slots
+  solver.removeFactorsNoUpdate(gtsam::FactorIndices{1});
+  EXPECT(solver.getFactorSlot(ids[1]) == solver.size());
+  EXPECT(solver.getFactorSlot(ids[2]) == 2);
+}
+
+/* ************************************************************************* */
+TEST(FactorIds, SlotsWithoutCompaction) {
+  GenericSolver solver;
+  solver.setQuiet();
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values values;
+  makeChain(&nfg, &values);
+  const FactorIds ids = solver.update(nfg, values);
+
+  // the removed slots stay: a saved slot still names its factor
+  solver.removeFactorsNoUpdate(gtsam::FactorIndices{1, 2, 3});
+  for (size_t i = 10; i < 90; i++) {
+    solver.removeFactorsNoUpdate(FactorIds{ids[i]});
+  }
+  EXPECT(solver.size() == kNumPoses);
+  EXPECT(solver.getFactorSlot(ids[95]) == 95);
+  solver.removeFactorsNoUpdate(gtsam::FactorIndices{95});
+  EXPECT(solver.getFactorSlot(ids[95]) == solver.size());
+  EXPECT(solver.getFactorSlot(ids[96]) == 96);
+}
+
+/* ************************************************************************* */
+TEST(FactorIds, KeptAcrossRebuild) {
+  RebuildingSolver solver;
+  solver.setQuiet();
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values values;
+  makeChain(&nfg, &values);
+  const FactorIds ids = solver.update(nfg, values);
+
+  // the factors follow their ids to the new slots, the dropped one is gone
+  solver.rebuildWithout(10);
+  EXPECT(solver.size() == kNumPoses - 1);
+  EXPECT(solver.getFactorSlot(ids[10]) == solver.size());
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (i == 10) continue;
+    const size_t slot = solver.getFactorSlot(ids[i]);
+    EXPECT(slot < solver.size());
+    EXPECT(solver.getFactorsUnsafe()[slot]->keys() == nfg[i]->keys());
+    EXPECT(solver.getFactorId(slot) == ids[i]);
+  }
+
+  // and again after a second rebuild with a new factor
+  const FactorIds lc_ids = solver.update(loopClosure(0, 50), gtsam::Values());
+  solver.rebuildWithout(0);
+  EXPECT(solver.getFactorsUnsafe()[solver.getFactorSlot(lc_ids[0])]->keys() ==
+         loopClosure(0, 50)[0]->keys());
+  EXPECT(solver.getFactorsUnsafe()[solver.getFactorSlot(ids[0])]->keys() ==
+         nfg[0]->keys());
+}
+
+/* ************************************************************************* */
+TEST(FactorIds, RobustSolverUpdate) {
+  RobustSolverParams params;
+  params.setPcm3DParams(3.0, 3.0, Verbosity::QUIET);
+  std::unique_ptr<RobustSolver> pgo =
+      solver_test::makeSolver(params, kNumPoses);
+
+  // odometry (appended by PCM) and an inlier closure (graph rebuilt)
+  gtsam::NonlinearFactorGraph odom;
+  gtsam::Values odom_val;
+  odom.add(gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', kNumPoses - 1),
+      gtsam::Symbol('a', kNumPoses),
+      gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(1, 0, 0)),
+      solver_test::noise()));
+  odom_val.insert(gtsam::Symbol('a', kNumPoses),
+                  solver_test::chainPose(kNumPoses));
+  const FactorIds odom_ids = pgo->update(odom, odom_val);
+  const FactorIds inlier_ids = pgo->update(solver_test::loopClosure(0, 50));
+  CHECK(odom_ids.size() == 1 && odom_ids[0].valid());
+  CHECK(inlier_ids.size() == 1 && inlier_ids[0].valid());
+
+  // the closure inconsistent with the odometry is rejected
+  const FactorIds outlier_ids =
+      pgo->update(solver_test::loopClosure(10, 60, 20.0));
+  CHECK(outlier_ids.size() == 1);
+  EXPECT(!outlier_ids[0].valid());
+
+  // the ids follow the factors through the rebuilds of PCM
+  const gtsam::NonlinearFactorGraph& nfg = pgo->getFactorsUnsafe();
+  const size_t odom_slot = pgo->getFactorSlot(odom_ids[0]);
+  CHECK(odom_slot < pgo->size());
+  EXPECT(nfg[odom_slot]->keys() == odom[0]->keys());
+  const size_t inlier_slot = pgo->getFactorSlot(inlier_ids[0]);
+  CHECK(inlier_slot < pgo->size());
+  EXPECT(nfg[inlier_slot]->keys() ==
+         solver_test::loopClosure(0, 50)[0]->keys());
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
@@ -0,0 +1,111 @@
+/**
+ * @file    testFastBetweenFactor.cpp
+ * @brief   Unit test for the analytic relative pose factor
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+
+#include <gtsam/base/numericalDerivative.h>
+#include <gtsam/inference/Symbol.h>
+#include <gtsam/slam/PriorFactor.h>
+
+#include "KimeraRPGO/utils/FastBetweenFactor.h"
+
+using KimeraRPGO::FastBetweenFactor;
+
+namespace {
+template <class T>
+void checkJacobians(const FastBetweenFactor<T>& factor,
+                    const T& p1,
+                    const T& p2) {
+  gtsam::Matrix H1, H2;
+  factor.evaluateError(p1, p2, H1, H2);
+  boost::function<gtsam::Vector(const T&, const T&)> error =
+      [&factor](const T& a, const T& b) { return factor.evaluateError(a, b); };
+  const gtsam::Matrix H1_num =
+      gtsam::numericalDerivative21<gtsam::Vector, T, T>(error, p1, p2, 1e-5);
+  const gtsam::Matrix H2_num =
+      gtsam::numericalDerivative22<gtsam::Vector, T, T>(error, p1, p2, 1e-5);
+  EXPECT(gtsam::assert_equal(H1_num, H1, 1e-5));
+  EXPECT(gtsam::assert_equal(H2_num, H2, 1e-5));
+}
+}  // namespace
+
+/* ************************************************************************* */
+TEST(FastBetweenFactor, Pose3Jacobians) {
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  const gtsam::Pose3 measured(gtsam::Rot3::Ypr(0.3, -0.2, 0.1),
+                              gtsam::Point3(1.0, 0.5, -0.2));
+  FastBetweenFactor<gtsam::Pose3> factor(0, 1, measured, noise);
+
+  const gtsam::Pose3 p1(gtsam::Rot3::Ypr(0.1, 0.2, -0.4),
+                        gtsam::Point3(0.3, -1.0, 2.0));
+  // at the measurement the error is zero
+  EXPECT(gtsam::assert_equal(gtsam::Vector(gtsam::Vector6::Zero()),
+                             factor.evaluateError(p1, p1.compose(measured)),
+                             1e-9));
+  // and the Jacobians are correct away from it (large rotation error)
+  checkJacobians(factor, p1, p1.compose(measured));
+  checkJacobians(factor,
+                 p1,
+                 gtsam::Pose3(gtsam::Rot3::Ypr(1.2, -0.7, 0.9),
+                              gtsam::Point3(-2.0, 0.4, 1.0)));
+}
+
+/* ************************************************************************* */
+TEST(FastBetweenFactor, Pose2Jacobians) {
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(3, 0.01);
+  const gtsam::Pose2 measured(1.0, -0.5, 0.4);
+  FastBetweenFactor<gtsam::Pose2> factor(0, 1, measured, noise);
+
+  const gtsam::Pose2 p1(0.3, 2.0, -0.8);
+  checkJacobians(factor, p1, p1.compose(measured));
+  checkJacobians(factor, p1, gtsam::Pose2(-1.0, 0.5, 2.5));
+}
+
+/* ************************************************************************* */
+TEST(FastBetweenFactor, ConvertGraph) {
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  gtsam::NonlinearFactorGraph nfg;
+  nfg.add(gtsam::PriorFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', 0), gtsam::Pose3(), noise));
+  nfg.add(gtsam::BetweenFactor<gtsam::Pose3>(gtsam::Symbol('a', 0),
+                                             gtsam::Symbol('a', 1),
+                                             gtsam::Pose3(),
+                                             noise));
+  nfg.add(gtsam::BetweenFactor<gtsam::Pose2>(
+      gtsam::Symbol('b', 0),
+      gtsam::Symbol('b', 1),
+      gtsam::Pose2(),
+      gtsam::noiseModel::Isotropic::Variance(3, 0.01)));
+
+  gtsam::NonlinearFactorGraph converted =
+      KimeraRPGO::toFastBetweenFactors(nfg);
+  EXPECT(converted.size() == nfg.size());
+  // priors are shared, between factors are replaced
+  EXPECT(converted[0] == nfg[0]);
+  EXPECT(boost::dynamic_pointer_cast<FastBetweenFactor<gtsam::Pose3>>(
+      converted[1]));
+  EXPECT(boost::dynamic_pointer_cast<FastBetweenFactor<gtsam::Pose2>>(
+      converted[2]));
+  // still seen as between factors (PCM, writeG2o)
+  EXPECT(boost::dynamic_pointer_cast<gtsam::BetweenFactor<gtsam::Pose3>>(
+      converted[1]));
+  EXPECT(converted[1]->equals(*nfg[1]));
+
+  // converting again is a no-op
+  gtsam::NonlinearFactorGraph twice =
+      KimeraRPGO::toFastBetweenFactors(converted);
+  EXPECT(twice[1] == converted[1]);
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
@@ -0,0 +1,105 @@
+/**
+ * @file    testFlatHashMap.cpp
+ * @brief   Unit test for the flat hash map and ObservationId hashing
+ */
+
+#include <CppUnitLite/TestHarness.h>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/utils/FlatHashMap.h"
+#include "KimeraRPGO/utils/TypeUtils.h"
+
+using KimeraRPGO::FlatHashMap;
+using KimeraRPGO::ObservationId;
+
+/* ************************************************************************* */
+TEST(FlatHashMap, ObservationIdCanonical) {
+  ObservationId ab('a', 'b');
+  ObservationId ba('b', 'a');
+  EXPECT(ab == ba);
+  EXPECT(ab.id1 == 'a' && ab.id2 == 'b');
+  EXPECT(ba.id1 == 'a' && ba.id2 == 'b');
+  EXPECT(std::hash<ObservationId>()(ab) == std::hash<ObservationId>()(ba));
+
+  // All unordered pairs of printable prefixes hash differently
+  std::unordered_set<size_t> hashes;
+  size_t num_pairs = 0;
+  for (char c1 = 'a'; c1 <= 'z'; c1++) {
+    for (char c2 = c1; c2 <= 'z'; c2++) {
+      hashes.insert(std::hash<ObservationId>()(ObservationId(c1, c2)));
+      num_pairs++;
+    }
+  }
+  EXPECT(hashes.size() == num_pairs);
+}
+
+/* ************************************************************************* */
+TEST(FlatHashMap, InsertFindErase) {
+  FlatHashMap<ObservationId, int> map;
+  EXPECT(map.empty());
+  map[ObservationId('a', 'b')] = 1;
+  map[ObservationId('c', 'a')] = 2;
+  map[ObservationId('a', 'a')] = 3;
+  EXPECT(map.size() == 3);
+  EXPECT(map.at(ObservationId('b', 'a')) == 1);
+  EXPECT(map[ObservationId('a', 'c')] == 2);
+  EXPECT(map.find(ObservationId('b', 'b')) == map.end());
+  EXPECT(map.count(ObservationId('a', 'a')) == 1);
+
+  // Iteration follows insertion order
+  FlatHashMap<ObservationId, int>::iterator it = map.begin();
+  EXPECT(it->second == 1);
+  it++;
+  EXPECT(it->second == 2);
+
+  EXPECT(map.erase(ObservationId('a', 'b')) == 1);
+  EXPECT(map.erase(ObservationId('a', 'b')) == 0);
+  EXPECT(map.size() == 2);
+  EXPECT(map.at(ObservationId('a', 'c')) == 2);
+  EXPECT(map.at(ObservationId('a', 'a')) == 3);
+
+  bool thrown = false;
+  try {
+    map.at(ObservationId('z', 'z'));
+  } catch (std::out_of_range& e) {
+    thrown = true;
+  }
+  EXPECT(thrown);
+}
+
+/* ************************************************************************* */
+TEST(FlatHashMap, MatchesUnorderedMap) {
+  // Random operations on symbol keys (clustered in the low bits)
+  FlatHashMap<gtsam::Key, size_t> map;
+  std::unordered_map<gtsam::Key, size_t> reference;
+  std::mt19937 rng(42);
+  for (size_t i = 0; i < 20000; i++) {
+    gtsam::Key key = gtsam::Symbol('a' + rng() % 4, rng() % 500);
+    switch (rng() % 3) {
+      case 0:
+        map[key] += i;
+        reference[key] += i;
+        break;
+      case 1:
+        EXPECT(map.erase(key) == reference.erase(key));
+        break;
+      default:
+        EXPECT(map.count(key) == reference.count(key));
+    }
+  }
+  EXPECT(map.size() == reference.size());
+  for (const auto& entry : map) {
+    EXPECT(reference.at(entry.first) == entry.second);
+  }
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
@@ -6,16 +6,20 @@
 
 #include <CppUnitLite/TestHarness.h>
 #include <memory>
+#include <numeric>
 #include <random>
 #include <string>
 #include <vector>
 
+#include <gtsam/geometry/Pose2.h>
 #include <gtsam/geometry/Pose3.h>
 #include <gtsam/inference/Symbol.h>
+#include <gtsam/nonlinear/GncOptimizer.h>
 #include <gtsam/slam/dataset.h>
 
 #include "KimeraRPGO/RobustSolver.h"
 #include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/utils/GncSolver.h"
 #include "KimeraRPGO/utils/TypeUtils.h"
 #include "test_config.h"
 
@@ -259,6 +263,126 @@ TEST(RobustSolver, GncMultirobotHighThreshold) {
   EXPECT(pgo->getNumLCInliers() == 7);
 }
 
+/* ************************************************************************* */
+namespace {
+// Robot a, robot b, then two inter-robot loop closures. Returns the weights
+// and estimates after each step.
+void runMultirobot(const RobustSolverParams& params,
+                   std::vector<gtsam::Vector>* weights,
+                   std::vector<gtsam::Values>* estimates) {
+  gtsam::NonlinearFactorGraph::shared_ptr nfg;
+  gtsam::Values::shared_ptr values;
+  boost::tie(nfg, values) =
+      gtsam::load3D(std::string(DATASET_PATH) + "/robot_a.g2o");
+  std::unique_ptr<RobustSolver> pgo =
+      KimeraRPGO::make_unique<RobustSolver>(params);
+
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  gtsam::Key init_key = gtsam::Symbol('a', 0);
+  nfg->add(gtsam::PriorFactor<gtsam::Pose3>(
+      init_key, values->at<gtsam::Pose3>(init_key), noise));
+  pgo->update(*nfg, *values);
+  weights->push_back(pgo->getGncWeights());
+  estimates->push_back(pgo->calculateEstimate());
+
+  gtsam::NonlinearFactorGraph::shared_ptr nfg_b;
+  gtsam::Values::shared_ptr values_b;
+  boost::tie(nfg_b, values_b) =
+      gtsam::load3D(std::string(DATASET_PATH) + "/robot_b.g2o");
+  pgo->update(*nfg_b, *values_b);
+  weights->push_back(pgo->getGncWeights());
+  estimates->push_back(pgo->calculateEstimate());
+
+  gtsam::NonlinearFactorGraph newfactors;
+  newfactors.add(gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', 1), gtsam::Symbol('b', 1), gtsam::Pose3(), noise));
+  newfactors.add(gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', 2), gtsam::Symbol('b', 2), gtsam::Pose3(), noise));
+  pgo->update(newfactors, gtsam::Values());
+  weights->push_back(pgo->getGncWeights());
+  estimates->push_back(pgo->calculateEstimate());
+}
+}  // namespace
+
+/* ************************************************************************* */
+TEST(RobustSolver, GncNativeMatchesGtsam) {
+  std::vector<RobustSolverParams> all_params(3);
+  all_params[0].setGncInlierCostThresholdsAtProbability(0.01);
+  all_params[1].setGncInlierCostThresholds(1.0);
+  all_params[2].setGncInlierCostThresholds(100.0);
+
+  for (RobustSolverParams& params : all_params) {
+    params.setPcm3DParams(100.0, 100.0, Verbosity::QUIET);
+    std::vector<gtsam::Vector> gtsam_weights, native_weights;
+    std::vector<gtsam::Values> gtsam_estimates, native_estimates;
+    runMultirobot(params, &gtsam_weights, &gtsam_estimates);
+    params.setThreads(2);
+    params.gncNative();
+    runMultirobot(params, &native_weights, &native_estimates);
+
+    for (size_t i = 0; i < gtsam_weights.size(); i++) {
+      EXPECT(gtsam::assert_equal(gtsam_weights[i], native_weights[i], 1e-3));
+      EXPECT(
+          gtsam::assert_equal(gtsam_estimates[i], native_estimates[i], 1e-2));
+    }
+  }
+}
+
+/* ************************************************************************* */
+TEST(GncSolver, InitialMuAsGtsam) {
+  // chain with a wrong initial estimate, one good and two wildly wrong loop
+  // closures: mu starts from the initial residuals, floored at 1e-6
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(3, 0.01);
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values initial;
+  nfg.add(gtsam::PriorFactor<gtsam::Pose2>(
+      gtsam::Symbol('a', 0), gtsam::Pose2(), noise));
+  initial.insert(gtsam::Symbol('a', 0), gtsam::Pose2());
+  for (size_t i = 0; i < 9; i++) {
+    nfg.add(gtsam::BetweenFactor<gtsam::Pose2>(gtsam::Symbol('a', i),
+                                               gtsam::Symbol('a', i + 1),
+                                               gtsam::Pose2(1, 0, 0.1),
+                                               noise));
+    initial.insert(gtsam::Symbol('a', i + 1), gtsam::Pose2(i + 1, 0.5, 0));
+  }
+  std::vector<size_t> known_inliers(nfg.size());
+  std::iota(known_inliers.begin(), known_inliers.end(), 0);
+  gtsam::Pose2 pose;
+  for (size_t i = 0; i < 5; i++) pose = pose.compose(gtsam::Pose2(1, 0, 0.1));
+  nfg.add(gtsam::BetweenFactor<gtsam::Pose2>(
+      gtsam::Symbol('a', 0), gtsam::Symbol('a', 5), pose, noise));
+  nfg.add(gtsam::BetweenFactor<gtsam::Pose2>(
+      gtsam::Symbol('a', 2), gtsam::Symbol('a', 9), gtsam::Pose2(1e4, 0, 0),
+      noise));
+  nfg.add(gtsam::BetweenFactor<gtsam::Pose2>(
+      gtsam::Symbol('a', 1), gtsam::Symbol('a', 8), gtsam::Pose2(0, -1e4, 2),
+      noise));
+
+  gtsam::LevenbergMarquardtParams lm_params;
+  gtsam::GncParams<gtsam::LevenbergMarquardtParams> gtsam_params(lm_params);
+  gtsam_params.setLossType(gtsam::GncLossType::TLS);
+  gtsam_params.setKnownInliers(
+      decltype(gtsam_params.knownInliers)(known_inliers.begin(),
+                                          known_inliers.end()));
+  gtsam::GncOptimizer<gtsam::GncParams<gtsam::LevenbergMarquardtParams>>
+      gtsam_gnc(nfg, initial, gtsam_params);
+  gtsam_gnc.setInlierCostThresholdsAtProbability(0.99);
+  const gtsam::Values gtsam_estimate = gtsam_gnc.optimize();
+
+  GncParams params;
+  params.gnc_inlier_threshold_ = 0.99;
+  GncSolver gnc(nfg, initial, lm_params, params, known_inliers);
+  const gtsam::Values estimate = gnc.optimize();
+
+  EXPECT(gtsam::assert_equal(gtsam_gnc.getWeights(), gnc.getWeights(), 1e-3));
+  EXPECT(gnc.getWeights()(10) == 1);
+  EXPECT(gnc.getWeights()(11) == 0);
+  EXPECT(gnc.getWeights()(12) == 0);
+  EXPECT(gtsam::assert_equal(gtsam_estimate, estimate, 1e-2));
+}
+
 /* ************************************************************************* */
 int main() {
   TestResult tr;
@@ -0,0 +1,200 @@
+/**
+ * @file    testLazyConsistency.cpp
+ * @brief   Unit test for the pairwise consistency checked on demand by the
+ *          max clique search
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/outlier/Pcm.h"
+#include "KimeraRPGO/utils/GraphUtils.h"
+#include "PcmTestUtils.h"
+
+using KimeraRPGO::EdgeOracle;
+using KimeraRPGO::MaxCliqueStats;
+using KimeraRPGO::ObservationId;
+using KimeraRPGO::Pcm3D;
+using KimeraRPGO::PcmParams;
+using pcm_test::addOdometry;
+using pcm_test::loopClosure;
+
+namespace {
+const size_t kNumPoses = 30;
+
+// 5-clique (0-4), 15 outliers with a few spurious edges
+Eigen::MatrixXd cliqueWithOutliers() {
+  const size_t n = 20;
+  Eigen::MatrixXd adj = Eigen::MatrixXd::Zero(n, n);
+  for (size_t i = 0; i < 5; i++) {
+    for (size_t j = 0; j < 5; j++) {
+      if (i != j) adj(i, j) = 1;
+    }
+  }
+  for (size_t i = 5; i + 3 < n; i += 3) {
+    adj(i, i + 3) = 1;
+    adj(i + 3, i) = 1;
+  }
+  adj(2, 7) = 1;
+  adj(7, 2) = 1;
+  return adj;
+}
+
+// planted clique of 3 to 10 vertices among 10 to 49, random edges between
+// the others (raw mt19937 draws: the same graphs on every platform)
+Eigen::MatrixXd randomGraph(std::mt19937* rng) {
+  const size_t n = 10 + (*rng)() % 40;
+  const size_t clique_size = 3 + (*rng)() % 8;
+  const size_t density = (*rng)() % 30;  // percent
+  std::vector<size_t> vertices(n);
+  for (size_t i = 0; i < n; i++) vertices[i] = i;
+  for (size_t i = n - 1; i > 0; i--) {
+    std::swap(vertices[i], vertices[(*rng)() % (i + 1)]);
+  }
+  Eigen::MatrixXd adj = Eigen::MatrixXd::Zero(n, n);
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = i + 1; j < n; j++) {
+      if ((*rng)() % 100 < density) adj(i, j) = adj(j, i) = 1;
+    }
+  }
+  for (size_t a = 0; a < clique_size; a++) {
+    for (size_t b = a + 1; b < clique_size; b++) {
+      adj(vertices[a], vertices[b]) = adj(vertices[b], vertices[a]) = 1;
+    }
+  }
+  return adj;
+}
+
+}  // namespace
+
+/* ************************************************************************* */
+TEST(LazyConsistency, MaxClique) {
+  const Eigen::MatrixXd truth = cliqueWithOutliers();
+  const size_t n = truth.rows();
+  std::vector<int> eager_clique;
+  int eager_size = KimeraRPGO::findMaxCliqueHeu(truth, &eager_clique);
+
+  // nothing is known beforehand
+  Eigen::MatrixXd adj = Eigen::MatrixXd::Constant(n, n, -1);
+  adj.diagonal().setZero();
+  size_t num_checks = 0, num_unordered = 0;
+  EdgeOracle check = [&](size_t i, size_t j) {
+    if (i >= j) num_unordered++;
+    num_checks++;
+    return truth(i, j) != 0;
+  };
+  std::vector<int> lazy_clique;
+  MaxCliqueStats stats;
+  int lazy_size =
+      KimeraRPGO::findMaxCliqueHeuLazy(&adj, check, &lazy_clique, &stats);
+
+  EXPECT(lazy_size == eager_size);
+  EXPECT(lazy_size == 5);
+  EXPECT(stats.clique_size == 5);
+  EXPECT(stats.num_checks == num_checks);
+  EXPECT(num_unordered == 0);
+  EXPECT(num_checks < n * (n - 1) / 2);
+  for (size_t i = 0; i < lazy_clique.size(); i++) {
+    EXPECT(lazy_clique[i] < 5);
+  }
+  // checked entries are memoized, the others stay unknown
+  size_t num_known = 0;
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = i + 1; j < n; j++) {
+      if (adj(i, j) < 0) continue;
+      num_known++;
+      EXPECT(adj(i, j) == truth(i, j));
+      EXPECT(adj(j, i) == truth(i, j));
+    }
+  }
+  EXPECT(num_known == num_checks);
+
+  // a second search on the same matrix does not check anything
+  std::vector<int> again;
+  KimeraRPGO::findMaxCliqueHeuLazy(&adj, check, &again, &stats);
+  EXPECT(stats.num_checks == 0);
+  EXPECT(again.size() == lazy_clique.size());
+}
+
+/* ************************************************************************* */
+TEST(LazyConsistency, RandomGraphs) {
+  // a different visiting order than findMaxCliqueHeu: the sizes agree on
+  // most graphs, and the lazy search is never worse by more than one
+  size_t lazy_total = 0, eager_total = 0, num_equal = 0;
+  const size_t num_seeds = 500;
+  for (size_t seed = 0; seed < num_seeds; seed++) {
+    std::mt19937 rng(seed);
+    const Eigen::MatrixXd truth = randomGraph(&rng);
+    std::vector<int> eager_clique, lazy_clique, exact_clique;
+    const int eager_size = KimeraRPGO::findMaxCliqueHeu(truth, &eager_clique);
+    const int exact_size = KimeraRPGO::findMaxClique(truth, &exact_clique);
+
+    Eigen::MatrixXd adj = Eigen::MatrixXd::Constant(
+        truth.rows(), truth.cols(), -1);
+    adj.diagonal().setZero();
+    const int lazy_size = KimeraRPGO::findMaxCliqueHeuLazy(
+        &adj,
+        [&truth](size_t i, size_t j) { return truth(i, j) != 0; },
+        &lazy_clique);
+
+    // a clique of the true graph
+    EXPECT(lazy_size == static_cast<int>(lazy_clique.size()));
+    for (size_t a = 0; a < lazy_clique.size(); a++) {
+      for (size_t b = a + 1; b < lazy_clique.size(); b++) {
+        EXPECT(truth(lazy_clique[a], lazy_clique[b]) != 0);
+      }
+    }
+    EXPECT(lazy_size <= exact_size);
+    EXPECT(lazy_size + 1 >= eager_size);
+    lazy_total += lazy_size;
+    eager_total += eager_size;
+    if (lazy_size == eager_size) num_equal++;
+  }
+  EXPECT(lazy_total >= eager_total);
+  EXPECT(num_equal >= 9 * num_seeds / 10);
+}
+
+/* ************************************************************************* */
+TEST(LazyConsistency, Pcm) {
+  PcmParams params;
+  params.odom_threshold = -1;  // outliers reach the pairwise check
+  params.lc_threshold = 5;
+  Pcm3D eager(params);
+  eager.setQuiet();
+  params.lazy_consistency = true;
+  Pcm3D lazy(params);
+  lazy.setQuiet();
+
+  gtsam::NonlinearFactorGraph eager_nfg, lazy_nfg;
+  gtsam::Values eager_est, lazy_est;
+  addOdometry(&eager, kNumPoses, &eager_nfg, &eager_est);
+  addOdometry(&lazy, kNumPoses, &lazy_nfg, &lazy_est);
+  for (size_t i = 0; i + 5 < kNumPoses; i++) {
+    const gtsam::NonlinearFactorGraph lc = loopClosure(i, i + 5, i % 3 == 0);
+    eager.removeOutliers(lc, gtsam::Values(), &eager_nfg, &eager_est);
+    lazy.removeOutliers(lc, gtsam::Values(), &lazy_nfg, &lazy_est);
+  }
+
+  EXPECT(lazy.getNumLC() == eager.getNumLC());
+  EXPECT(lazy.getNumLCInliers() == eager.getNumLCInliers());
+  EXPECT(size_t(9) == lazy.getNumLCInliers());
+  EXPECT(lazy_nfg.size() == eager_nfg.size());
+  EXPECT(lazy.getNumConsistencyChecks() < eager.getNumConsistencyChecks());
+
+  const ObservationId aa('a', 'a');
+  EXPECT(lazy.getCliqueStats().at(aa).total_checks ==
+         lazy.getNumConsistencyChecks());
+  EXPECT(eager.getCliqueStats().at(aa).total_checks == 0);
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
@@ -0,0 +1,126 @@
+/**
+ * @file    testMappedAdjacency.cpp
+ * @brief   Unit test for the out-of-core adjacency and its clique heuristic
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+#include <algorithm>
+#include <random>
+
+#include "KimeraRPGO/utils/GraphUtils.h"
+#include "KimeraRPGO/utils/MappedAdjacency.h"
+
+using KimeraRPGO::MappedAdjacency;
+using KimeraRPGO::MaxCliqueStats;
+
+/* ************************************************************************* */
+TEST(MappedAdjacency, MatchesDense) {
+  // small tiles so that the matrix spans several shells
+  MappedAdjacency adjacency("", 64);
+  const size_t n = 300;
+  adjacency.resize(n);
+  EXPECT(adjacency.size() == n);
+  EXPECT(adjacency.rowWords() == 5 * 1);
+
+  Eigen::MatrixXd dense = Eigen::MatrixXd::Zero(n, n);
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<size_t> pick(0, n - 1);
+  for (size_t e = 0; e < 2000; e++) {
+    size_t i = pick(rng), j = pick(rng);
+    if (i == j) continue;
+    adjacency.setEdge(i, j);
+    dense(i, j) = 1;
+    dense(j, i) = 1;
+  }
+
+  std::vector<uint64_t> row;
+  for (size_t i = 0; i < n; i++) {
+    adjacency.getRow(i, &row);
+    size_t degree = 0;
+    for (size_t j = 0; j < n; j++) {
+      const bool expected = dense(i, j) == 1;
+      EXPECT(adjacency.hasEdge(i, j) == expected);
+      EXPECT(((row[j / 64] >> (j % 64)) & 1) == expected);
+      if (expected) degree++;
+    }
+    EXPECT(adjacency.degree(i) == degree);
+  }
+}
+
+/* ************************************************************************* */
+TEST(MappedAdjacency, GrowKeepsEdges) {
+  MappedAdjacency adjacency("", 64);
+  adjacency.resize(10);
+  adjacency.setEdge(2, 7);
+  adjacency.setEdge(9, 0);
+  adjacency.resize(200);  // adds two shells
+  adjacency.setEdge(150, 2);
+  adjacency.setEdge(3, 3);  // self loops are ignored
+
+  EXPECT(adjacency.hasEdge(7, 2));
+  EXPECT(adjacency.hasEdge(0, 9));
+  EXPECT(adjacency.hasEdge(2, 150));
+  EXPECT(!adjacency.hasEdge(3, 3));
+  EXPECT(!adjacency.hasEdge(150, 7));
+  EXPECT(adjacency.degree(2) == 2);
+
+  adjacency.setEdge(2, 7, false);
+  EXPECT(!adjacency.hasEdge(7, 2));
+  EXPECT(adjacency.degree(2) == 1);
+}
+
+/* ************************************************************************* */
+TEST(MappedAdjacency, MaxCliqueHeu) {
+  MappedAdjacency adjacency("", 64);
+  const size_t n = 500;
+  adjacency.resize(n);
+
+  // planted clique across several tiles plus sparse noise among the others
+  std::vector<int> planted;
+  for (size_t i = 3; i < n; i += 41) planted.push_back(i);
+  for (size_t a = 0; a < planted.size(); a++) {
+    for (size_t b = a + 1; b < planted.size(); b++) {
+      adjacency.setEdge(planted[a], planted[b]);
+    }
+  }
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<size_t> pick(0, n - 1);
+  for (size_t e = 0; e < 1000; e++) {
+    size_t i = pick(rng), j = pick(rng);
+    if (i % 41 == 3 || j % 41 == 3) continue;
+    adjacency.setEdge(i, j);
+  }
+
+  std::vector<int> clique;
+  MaxCliqueStats stats;
+  int size = KimeraRPGO::findMaxCliqueHeu(adjacency, &clique, &stats);
+
+  EXPECT(size == static_cast<int>(planted.size()));
+  EXPECT(clique.size() == planted.size());
+  std::sort(clique.begin(), clique.end());
+  EXPECT(clique == planted);
+  EXPECT(stats.num_vertices == n);
+  EXPECT(stats.clique_size == planted.size());
+  EXPECT(stats.nodes_expanded > 0);
+
+  // same answer as the in-memory heuristic on the dense matrix
+  Eigen::MatrixXd dense = Eigen::MatrixXd::Zero(n, n);
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      if (adjacency.hasEdge(i, j)) dense(i, j) = 1;
+    }
+  }
+  std::vector<int> dense_clique;
+  MaxCliqueStats dense_stats;
+  EXPECT(KimeraRPGO::findMaxCliqueHeu(dense, &dense_clique, &dense_stats) ==
+         size);
+  EXPECT(dense_stats.num_edges == stats.num_edges);
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
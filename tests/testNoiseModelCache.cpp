@@ -0,0 +1,128 @@
+/**
+ * @file    testNoiseModelCache.cpp
+ * @brief   Unit test for the noise model interning
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+#include <memory>
+
+#include <gtsam/geometry/Pose3.h>
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/RobustSolver.h"
+#include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/utils/NoiseModelCache.h"
+#include "KimeraRPGO/utils/TypeUtils.h"
+#include "SolverTestUtils.h"
+
+using KimeraRPGO::NoiseModelCache;
+using KimeraRPGO::RobustSolver;
+using KimeraRPGO::RobustSolverParams;
+using KimeraRPGO::Verbosity;
+
+namespace {
+const size_t kNumPoses = 30;
+
+// every factor gets its own (equal) noise model, as when read from a file
+std::unique_ptr<RobustSolver> makeSolver(const RobustSolverParams& params) {
+  std::unique_ptr<RobustSolver> pgo =
+      solver_test::makeSolver(params, kNumPoses, 0, false);
+  gtsam::NonlinearFactorGraph lc;
+  for (size_t i = 0; i < 3; i++) {
+    lc.add(gtsam::BetweenFactor<gtsam::Pose3>(
+        gtsam::Symbol('a', i),
+        gtsam::Symbol('a', i + 20),
+        gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(20, 0.1, 0)),
+        gtsam::noiseModel::Diagonal::Sigmas(
+            (gtsam::Vector(6) << 0.1, 0.1, 0.1, 0.2, 0.2, 0.2).finished())));
+  }
+  pgo->update(lc, gtsam::Values());
+  return pgo;
+}
+}  // namespace
+
+/* ************************************************************************* */
+TEST(NoiseModelCache, Intern) {
+  NoiseModelCache cache;
+  const gtsam::SharedNoiseModel a =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  const gtsam::SharedNoiseModel b =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  EXPECT(cache.intern(a) == a);
+  EXPECT(cache.intern(b) == a);
+  EXPECT(cache.intern(a) == a);
+  EXPECT(cache.size() == 1);
+
+  // same sigmas but another type, another variance, another dimension
+  const gtsam::SharedNoiseModel diagonal = gtsam::noiseModel::Diagonal::Sigmas(
+      gtsam::Vector6::Constant(0.1), false);
+  const gtsam::SharedNoiseModel wider =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.02);
+  const gtsam::SharedNoiseModel planar =
+      gtsam::noiseModel::Isotropic::Variance(3, 0.01);
+  EXPECT(cache.intern(diagonal) == diagonal);
+  EXPECT(cache.intern(wider) == wider);
+  EXPECT(cache.intern(planar) == planar);
+  EXPECT(cache.size() == 4);
+
+  // robust models are left alone
+  const gtsam::SharedNoiseModel robust = gtsam::noiseModel::Robust::Create(
+      gtsam::noiseModel::mEstimator::Huber::Create(1.0), a);
+  EXPECT(cache.intern(robust) == robust);
+  EXPECT(!cache.find(robust));
+  EXPECT(cache.size() == 4);
+
+  // decoded once, found by instance or by value
+  const NoiseModelCache::Entry* entry = cache.find(b);
+  EXPECT(entry);
+  EXPECT(entry->model == a);
+  EXPECT(gtsam::assert_equal(gtsam::Matrix(0.01 * gtsam::I_6x6),
+                             entry->covariance));
+  EXPECT(gtsam::assert_equal(gtsam::Matrix(100 * gtsam::I_6x6),
+                             entry->information));
+  EXPECT(!cache.find(gtsam::noiseModel::Isotropic::Variance(6, 0.03)));
+}
+
+/* ************************************************************************* */
+TEST(NoiseModelCache, RobustSolver) {
+  RobustSolverParams params;
+  params.setPcm3DParams(3.0, 3.0, Verbosity::QUIET);
+  std::unique_ptr<RobustSolver> pgo = makeSolver(params);
+  params.setNoiseModelInterning(false);
+  std::unique_ptr<RobustSolver> reference = makeSolver(params);
+  EXPECT(reference->getNumNoiseModels() == 0);
+
+  // one model for the odometry, one for the loop closures
+  EXPECT(pgo->getNumNoiseModels() == 2);
+  gtsam::SharedNoiseModel odom_model, lc_model;
+  size_t num_between = 0;
+  for (const auto& factor : pgo->getFactorsUnsafe()) {
+    auto between =
+        boost::dynamic_pointer_cast<gtsam::BetweenFactor<gtsam::Pose3>>(
+            factor);
+    if (!between) continue;
+    num_between++;
+    gtsam::SharedNoiseModel& model =
+        gtsam::Symbol(between->key1()).index() + 1 ==
+                gtsam::Symbol(between->key2()).index()
+            ? odom_model
+            : lc_model;
+    if (!model) model = between->noiseModel();
+    EXPECT(between->noiseModel() == model);
+  }
+  EXPECT(num_between == kNumPoses - 1 + pgo->getNumLCInliers());
+  EXPECT(odom_model != lc_model);
+
+  // same decisions and solution
+  EXPECT(pgo->getNumLCInliers() == reference->getNumLCInliers());
+  EXPECT(gtsam::assert_equal(reference->calculateEstimate(),
+                             pgo->calculateEstimate()));
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
@@ -0,0 +1,143 @@
+/**
+ * @file    testOptimizerContext.cpp
+ * @brief   Unit test for the ordering / damping kept between optimize calls
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+#include <memory>
+#include <string>
+
+#include <gtsam/geometry/Pose3.h>
+#include <gtsam/inference/Symbol.h>
+#include <gtsam/slam/dataset.h>
+
+#include "KimeraRPGO/RobustSolver.h"
+#include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/utils/OptimizerContext.h"
+#include "KimeraRPGO/utils/TypeUtils.h"
+#include "test_config.h"
+
+using namespace KimeraRPGO;
+
+namespace {
+void addChain(size_t from, size_t to, gtsam::NonlinearFactorGraph* nfg) {
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  for (size_t i = from; i < to; i++) {
+    nfg->add(gtsam::BetweenFactor<gtsam::Pose3>(gtsam::Symbol('a', i),
+                                                gtsam::Symbol('a', i + 1),
+                                                gtsam::Pose3(),
+                                                noise));
+  }
+}
+}  // namespace
+
+/* ************************************************************************* */
+TEST(OptimizerContext, Ordering) {
+  OptimizerContext context(0.2);
+  gtsam::NonlinearFactorGraph nfg;
+  addChain(0, 20, &nfg);
+
+  EXPECT(context.ordering(nfg).size() == size_t(21));
+  EXPECT(context.numFullOrderings() == size_t(1));
+
+  // same graph: nothing to do
+  context.ordering(nfg);
+  EXPECT(context.numFullOrderings() == size_t(1));
+  EXPECT(context.numExtensions() == size_t(0));
+
+  // a couple of new poses are appended
+  addChain(20, 22, &nfg);
+  const gtsam::Ordering& extended = context.ordering(nfg);
+  EXPECT(extended.size() == size_t(23));
+  EXPECT(extended.back() == gtsam::Symbol('a', 22));
+  EXPECT(context.numFullOrderings() == size_t(1));
+  EXPECT(context.numExtensions() == size_t(1));
+
+  // more than 20% growth since the last COLAMD: reorder
+  addChain(22, 30, &nfg);
+  EXPECT(context.ordering(nfg).size() == size_t(31));
+  EXPECT(context.numFullOrderings() == size_t(2));
+
+  // removed keys: reorder
+  gtsam::NonlinearFactorGraph smaller;
+  addChain(0, 25, &smaller);
+  EXPECT(context.ordering(smaller).size() == size_t(26));
+  EXPECT(context.numFullOrderings() == size_t(3));
+}
+
+/* ************************************************************************* */
+TEST(OptimizerContext, Lambda) {
+  OptimizerContext context;
+  gtsam::NonlinearFactorGraph nfg;
+  addChain(0, 5, &nfg);
+
+  gtsam::LevenbergMarquardtParams params;
+  const double default_lambda = params.lambdaInitial;
+  context.setup(nfg, &params);
+  EXPECT(params.lambdaInitial == default_lambda);
+  EXPECT(params.orderingType == gtsam::Ordering::CUSTOM);
+
+  context.setLambda(1e-3);
+  context.setup(nfg, &params);
+  EXPECT(params.lambdaInitial == 1e-3);
+
+  // clamped to the LM bounds
+  context.setLambda(0.0);
+  context.setup(nfg, &params);
+  EXPECT(params.lambdaInitial == params.lambdaLowerBound);
+}
+
+/* ************************************************************************* */
+TEST(RobustSolver, ReuseOptimizerContext) {
+  gtsam::NonlinearFactorGraph::shared_ptr nfg;
+  gtsam::Values::shared_ptr values;
+  boost::tie(nfg, values) =
+      gtsam::load3D(std::string(DATASET_PATH) + "/robot_a.g2o");
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  gtsam::Key init_key = gtsam::Symbol('a', 0);
+  gtsam::NonlinearFactorGraph full;
+  full.add(gtsam::PriorFactor<gtsam::Pose3>(
+      init_key, values->at<gtsam::Pose3>(init_key), noise));
+  full.add(*nfg);
+
+  RobustSolverParams params;
+  params.setPcm3DParams(100.0, 100.0, Verbosity::QUIET);
+  std::unique_ptr<RobustSolver> fresh =
+      KimeraRPGO::make_unique<RobustSolver>(params);
+  params.setReuseOptimizerContext();
+  std::unique_ptr<RobustSolver> reuse =
+      KimeraRPGO::make_unique<RobustSolver>(params);
+
+  // feed the graph in two halves so that the second solve reuses the context
+  const size_t half = full.size() / 2;
+  gtsam::NonlinearFactorGraph first(full.begin(), full.begin() + half);
+  gtsam::NonlinearFactorGraph second(full.begin() + half, full.end());
+  gtsam::Values first_values, second_values;
+  for (const auto& key_value : *values) {
+    if (first.keys().count(key_value.key)) {
+      first_values.insert(key_value.key, key_value.value);
+    } else {
+      second_values.insert(key_value.key, key_value.value);
+    }
+  }
+  fresh->update(first, first_values);
+  fresh->update(second, second_values);
+  reuse->update(first, first_values);
+  reuse->update(second, second_values);
+
+  const gtsam::NonlinearFactorGraph out = fresh->getFactorsUnsafe();
+  EXPECT(out.size() == reuse->getFactorsUnsafe().size());
+  const double fresh_error = out.error(fresh->calculateEstimate());
+  const double reuse_error = out.error(reuse->calculateEstimate());
+  EXPECT(std::abs(fresh_error - reuse_error) <= 1e-3 * (1.0 + fresh_error));
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
@@ -0,0 +1,141 @@
+/**
+ * @file    testPcmAdmission.cpp
+ * @brief   Unit test for the loop closure admission queue in front of Pcm
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/outlier/Pcm.h"
+#include "PcmTestUtils.h"
+
+using KimeraRPGO::Pcm3D;
+using KimeraRPGO::PcmAdmissionPolicy;
+using KimeraRPGO::PcmParams;
+using pcm_test::addOdometry;
+using pcm_test::consistent;
+
+namespace {
+const size_t kNumPoses = 30;
+
+void addLoopClosure(size_t from, size_t to, gtsam::NonlinearFactorGraph* lc) {
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  lc->add(gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', from),
+      gtsam::Symbol('a', to),
+      consistent(from, to),
+      noise));
+}
+
+bool hasFactor(const gtsam::NonlinearFactorGraph& nfg,
+               size_t from,
+               size_t to) {
+  for (const auto& factor : nfg) {
+    if (factor && factor->front() == gtsam::Symbol('a', from) &&
+        factor->back() == gtsam::Symbol('a', to)) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+/* ************************************************************************* */
+TEST(PcmAdmission, Budget) {
+  PcmParams params;
+  params.odom_threshold = 3.0;
+  params.lc_threshold = 3.0;
+  params.admission.check_budget = 3;
+  Pcm3D pcm(params);
+  pcm.setQuiet();
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values est;
+  addOdometry(&pcm, kNumPoses, &nfg, &est);
+
+  // a burst of six closures: 0 + 1 + 2 checks fit the budget
+  gtsam::NonlinearFactorGraph lc;
+  for (size_t i = 0; i < 6; i++) addLoopClosure(i, i + 20, &lc);
+  EXPECT(pcm.removeOutliers(lc, gtsam::Values(), &nfg, &est));
+  EXPECT(pcm.getNumLC() == 3);
+  EXPECT(pcm.getNumQueuedLoopClosures() == 3);
+  EXPECT(hasFactor(nfg, 2, 22));
+  EXPECT(!hasFactor(nfg, 3, 23));
+
+  // the deferred ones are admitted by the next spins (at least one each)
+  size_t spins = 0;
+  while (pcm.getNumQueuedLoopClosures() > 0 && spins < 10) {
+    const size_t queued = pcm.getNumQueuedLoopClosures();
+    pcm.removeOutliers(
+        gtsam::NonlinearFactorGraph(), gtsam::Values(), &nfg, &est);
+    EXPECT(pcm.getNumQueuedLoopClosures() < queued);
+    spins++;
+  }
+  EXPECT(pcm.getNumQueuedLoopClosures() == 0);
+  EXPECT(pcm.getNumLC() == 6);
+  EXPECT(pcm.getNumLCInliers() == 6);
+  EXPECT(hasFactor(nfg, 5, 25));
+
+  // nothing queued: an empty update does not optimize
+  EXPECT(!pcm.removeOutliers(
+      gtsam::NonlinearFactorGraph(), gtsam::Values(), &nfg, &est));
+}
+
+/* ************************************************************************* */
+TEST(PcmAdmission, Policies) {
+  PcmParams params;
+  params.odom_threshold = 3.0;
+  params.lc_threshold = 3.0;
+  params.admission.check_budget = 1;
+
+  // larger odometry gap first: two closures fit (0 + 1 checks)
+  params.admission.policy = PcmAdmissionPolicy::ODOMETRY_GAP;
+  {
+    Pcm3D pcm(params);
+    pcm.setQuiet();
+    gtsam::NonlinearFactorGraph nfg;
+    gtsam::Values est;
+    addOdometry(&pcm, kNumPoses, &nfg, &est);
+    gtsam::NonlinearFactorGraph lc;
+    addLoopClosure(0, 5, &lc);
+    addLoopClosure(0, 25, &lc);
+    addLoopClosure(2, 12, &lc);
+    pcm.removeOutliers(lc, gtsam::Values(), &nfg, &est);
+    EXPECT(pcm.getNumQueuedLoopClosures() == 1);
+    EXPECT(hasFactor(nfg, 0, 25));
+    EXPECT(hasFactor(nfg, 2, 12));
+    EXPECT(!hasFactor(nfg, 0, 5));
+  }
+
+  // user score: the closures ending furthest along go first
+  params.admission.policy = PcmAdmissionPolicy::SCORE;
+  params.admission.score = [](const gtsam::NonlinearFactor& factor) {
+    return static_cast<double>(gtsam::Symbol(factor.back()).index());
+  };
+  {
+    Pcm3D pcm(params);
+    pcm.setQuiet();
+    gtsam::NonlinearFactorGraph nfg;
+    gtsam::Values est;
+    addOdometry(&pcm, kNumPoses, &nfg, &est);
+    gtsam::NonlinearFactorGraph lc;
+    addLoopClosure(0, 25, &lc);
+    addLoopClosure(10, 20, &lc);
+    addLoopClosure(15, 28, &lc);
+    pcm.removeOutliers(lc, gtsam::Values(), &nfg, &est);
+    EXPECT(pcm.getNumQueuedLoopClosures() == 1);
+    EXPECT(hasFactor(nfg, 15, 28));
+    EXPECT(hasFactor(nfg, 0, 25));
+    EXPECT(!hasFactor(nfg, 10, 20));
+  }
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
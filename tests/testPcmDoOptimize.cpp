@@ -139,6 +139,66 @@ TEST(PcmDoOptimize, LoopClosure) {
   EXPECT(do_optimize == true);
 }
 
+/* ************************************************************************* */
+TEST(PcmDoOptimize, OdometryAppend) {
+  // odometry only spins append to the output graph, GNC layout restored after
+  PcmParams params;
+  params.lc_threshold = 1.0;
+  params.odom_threshold = -1;
+
+  OutlierRemoval* pcm = new Pcm3D(params);
+  pcm->setQuiet();
+
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  const gtsam::Pose3 odom(gtsam::Rot3(), gtsam::Point3(1, 0, 0));
+
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values est;
+  gtsam::Values init_vals;
+  gtsam::NonlinearFactorGraph init_factors;
+  init_vals.insert(0, gtsam::Pose3());
+  init_factors.add(gtsam::PriorFactor<gtsam::Pose3>(0, gtsam::Pose3(), noise));
+  pcm->removeOutliers(init_factors, init_vals, &nfg, &est);
+  auto addOdometry = [&](size_t i, gtsam::NonlinearFactorGraph* output) {
+    gtsam::Values vals;
+    gtsam::NonlinearFactorGraph factors;
+    vals.insert(i + 1, gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(i + 1, 0, 0)));
+    factors.add(gtsam::BetweenFactor<gtsam::Pose3>(i, i + 1, odom, noise));
+    return pcm->removeOutliers(factors, vals, output, &est);
+  };
+  for (size_t i = 0; i < 10; i++) addOdometry(i, &nfg);
+
+  // loop closure: rebuilt as odometry, prior, loop closure
+  gtsam::NonlinearFactorGraph lc;
+  lc.add(gtsam::BetweenFactor<gtsam::Pose3>(
+      0, 10, gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(10, 0, 0)), noise));
+  EXPECT(pcm->removeOutliers(lc, gtsam::Values(), &nfg, &est));
+  EXPECT(nfg.size() == size_t(12));
+  EXPECT(nfg[11]->front() == 0 && nfg[11]->back() == 10);
+
+  // appended after the loop closure
+  for (size_t i = 10; i < 15; i++) EXPECT(!addOdometry(i, &nfg));
+  EXPECT(nfg.size() == size_t(17));
+  EXPECT(est.size() == size_t(16));
+  EXPECT(nfg[11]->front() == 0 && nfg[11]->back() == 10);
+  EXPECT(nfg[16]->front() == 14 && nfg[16]->back() == 15);
+
+  pcm->restoreOutputLayout(&nfg);
+  EXPECT(nfg.size() == size_t(17));
+  for (size_t i = 0; i < pcm->getNumOdomFactors(); i++) {
+    EXPECT(nfg[i]->front() + 1 == nfg[i]->back());
+  }
+  EXPECT(boost::dynamic_pointer_cast<gtsam::PriorFactor<gtsam::Pose3>>(
+      nfg[pcm->getNumOdomFactors()]));
+  EXPECT(nfg[16]->front() == 0 && nfg[16]->back() == 10);
+
+  // a graph that is not the previous output is rebuilt
+  gtsam::NonlinearFactorGraph other;
+  addOdometry(15, &other);
+  EXPECT(other.size() == size_t(18));
+}
+
 /* ************************************************************************* */
 TEST(PcmDoOptimize, landmarks) {
   // test optimize condition for landmarks
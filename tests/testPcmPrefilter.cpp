@@ -0,0 +1,108 @@
+/**
+ * @file    testPcmPrefilter.cpp
+ * @brief   Unit test for the loop closure filters in front of Pcm
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/outlier/Pcm.h"
+#include "PcmTestUtils.h"
+
+using KimeraRPGO::Pcm3D;
+using KimeraRPGO::PcmParams;
+using KimeraRPGO::PcmPrefilter;
+using KimeraRPGO::PrefilterStats;
+using pcm_test::addLoopClosure;
+using pcm_test::addOdometry;
+using pcm_test::consistent;
+
+namespace {
+const size_t kNumPoses = 10;
+}  // namespace
+
+/* ************************************************************************* */
+TEST(PcmPrefilter, Cascade) {
+  PcmParams params;
+  params.odom_threshold = 100;
+  params.lc_threshold = 5;
+  params.prefilter.stages = {PcmPrefilter::NODE_DISTANCE,
+                             PcmPrefilter::DUPLICATE,
+                             PcmPrefilter::ODOMETRY};
+  params.prefilter.min_node_distance = 3;
+  Pcm3D pcm(params);
+  pcm.setQuiet();
+
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values est;
+  addOdometry(&pcm, kNumPoses, &nfg, &est);
+
+  // too close to the odometry
+  addLoopClosure(&pcm, 0, 1, consistent(0, 1), &nfg, &est);
+  // accepted
+  addLoopClosure(&pcm, 0, 5, consistent(0, 5), &nfg, &est);
+  // the same closure again (in the other direction)
+  addLoopClosure(&pcm, 5, 0, consistent(5, 0), &nfg, &est);
+  // 10 m away from the odometry: rejected before Pcm
+  addLoopClosure(&pcm, 1, 6, consistent(1, 16), &nfg, &est);
+  // accepted
+  addLoopClosure(&pcm, 2, 8, consistent(2, 8), &nfg, &est);
+
+  EXPECT(size_t(2) == pcm.getNumLC());
+  EXPECT(size_t(2) == pcm.getNumLCInliers());
+  EXPECT(size_t(12) == nfg.size());
+
+  const std::vector<PrefilterStats>& stats = pcm.getPrefilterStats();
+  EXPECT(size_t(3) == stats.size());
+  EXPECT(stats[0].stage == PcmPrefilter::NODE_DISTANCE);
+  EXPECT(size_t(5) == stats[0].num_checked);
+  EXPECT(size_t(1) == stats[0].num_rejected);
+  DOUBLES_EQUAL(0.2, stats[0].rejectionRate(), 1e-9);
+  EXPECT(stats[1].stage == PcmPrefilter::DUPLICATE);
+  EXPECT(size_t(4) == stats[1].num_checked);
+  EXPECT(size_t(1) == stats[1].num_rejected);
+  EXPECT(stats[2].stage == PcmPrefilter::ODOMETRY);
+  EXPECT(size_t(3) == stats[2].num_checked);
+  EXPECT(size_t(1) == stats[2].num_rejected);
+  for (const PrefilterStats& stage : stats) EXPECT(stage.time_ms >= 0);
+}
+
+/* ************************************************************************* */
+TEST(PcmPrefilter, InterRobot) {
+  PcmParams params;
+  params.odom_threshold = 100;
+  params.lc_threshold = 100;
+  params.prefilter.stages = {PcmPrefilter::NODE_DISTANCE,
+                             PcmPrefilter::ODOMETRY};
+  Pcm3D pcm(params);
+  pcm.setQuiet();
+
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values est;
+  addOdometry(&pcm, kNumPoses, &nfg, &est);
+  gtsam::Values b_vals;
+  b_vals.insert(gtsam::Symbol('b', 0), gtsam::Pose3());
+  pcm.removeOutliers(gtsam::NonlinearFactorGraph(), b_vals, &nfg, &est);
+
+  // the odometry and node distance filters only apply within a robot
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  gtsam::NonlinearFactorGraph lc;
+  lc.add(gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', 1), gtsam::Symbol('b', 0), gtsam::Pose3(), noise));
+  pcm.removeOutliers(lc, gtsam::Values(), &nfg, &est);
+
+  EXPECT(size_t(1) == pcm.getNumLC());
+  EXPECT(size_t(0) == pcm.getPrefilterStats()[0].num_checked);
+  EXPECT(size_t(0) == pcm.getPrefilterStats()[1].num_checked);
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
@@ -0,0 +1,116 @@
+/**
+ * @file    testPcmWindow.cpp
+ * @brief   Unit test for the bounded (windowed) Pcm groups
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/outlier/Pcm.h"
+#include "PcmTestUtils.h"
+
+using KimeraRPGO::ObservationId;
+using KimeraRPGO::Pcm3D;
+using KimeraRPGO::PcmParams;
+using KimeraRPGO::PcmWindowPolicy;
+using pcm_test::addLoopClosure;
+using pcm_test::addOdometry;
+using pcm_test::consistent;
+
+namespace {
+const size_t kNumPoses = 10;
+}  // namespace
+
+/* ************************************************************************* */
+TEST(PcmWindow, Unbounded) {
+  PcmParams params;
+  params.odom_threshold = 100;
+  params.lc_threshold = 5;
+  Pcm3D pcm(params);
+  pcm.setQuiet();
+
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values est;
+  addOdometry(&pcm, kNumPoses, &nfg, &est);
+  for (size_t i = 0; i < 6; i++) {
+    addLoopClosure(&pcm, i, i + 3, consistent(i, i + 3), &nfg, &est);
+  }
+
+  EXPECT(size_t(16) == nfg.size());
+  EXPECT(size_t(6) == pcm.getNumLCInliers());
+  // the whole history takes part in the consistency graph
+  EXPECT(pcm.getCliqueStats().at(ObservationId('a', 'a')).last.num_vertices ==
+         6);
+}
+
+/* ************************************************************************* */
+TEST(PcmWindow, Sliding) {
+  PcmParams params;
+  params.odom_threshold = 100;
+  params.lc_threshold = 5;
+  params.window_policy = PcmWindowPolicy::SLIDING;
+  params.window_size = 3;
+  Pcm3D pcm(params);
+  pcm.setQuiet();
+
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values est;
+  addOdometry(&pcm, kNumPoses, &nfg, &est);
+
+  addLoopClosure(&pcm, 0, 3, consistent(0, 3), &nfg, &est);
+  // outlier
+  addLoopClosure(
+      &pcm,
+      1,
+      5,
+      gtsam::Pose3(gtsam::Rot3::Ypr(1.0, 0, 0), gtsam::Point3(10, 10, 0)),
+      &nfg,
+      &est);
+  addLoopClosure(&pcm, 2, 5, consistent(2, 5), &nfg, &est);
+  addLoopClosure(&pcm, 3, 6, consistent(3, 6), &nfg, &est);
+  EXPECT(size_t(13) == nfg.size());
+  EXPECT(size_t(3) == pcm.getNumLCInliers());
+
+  addLoopClosure(&pcm, 4, 7, consistent(4, 7), &nfg, &est);
+  addLoopClosure(&pcm, 5, 8, consistent(5, 8), &nfg, &est);
+
+  // evicted inliers stay in the graph, the evicted outlier stays out
+  EXPECT(size_t(15) == nfg.size());
+  EXPECT(size_t(5) == pcm.getNumLCInliers());
+  EXPECT(size_t(6) == pcm.getNumLC());
+  // at most window + new measurements in the consistency graph
+  EXPECT(pcm.getCliqueStats().at(ObservationId('a', 'a')).last.num_vertices ==
+         4);
+}
+
+/* ************************************************************************* */
+TEST(PcmWindow, Reservoir) {
+  PcmParams params;
+  params.odom_threshold = 100;
+  params.lc_threshold = 5;
+  params.window_policy = PcmWindowPolicy::RESERVOIR;
+  params.window_size = 3;
+  Pcm3D pcm(params);
+  pcm.setQuiet();
+
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values est;
+  addOdometry(&pcm, kNumPoses, &nfg, &est);
+  for (size_t i = 0; i < 6; i++) {
+    addLoopClosure(&pcm, i, i + 3, consistent(i, i + 3), &nfg, &est);
+    EXPECT(pcm.getCliqueStats().at(ObservationId('a', 'a')).last.num_vertices <=
+           4);
+  }
+
+  EXPECT(size_t(16) == nfg.size());
+  EXPECT(size_t(6) == pcm.getNumLCInliers());
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
@@ -0,0 +1,245 @@
+/**
+ * @file    testPoseArchive.cpp
+ * @brief   Unit test for archiving settled poses
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtsam/geometry/Pose2.h>
+#include <gtsam/geometry/Pose3.h>
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/RobustSolver.h"
+#include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/utils/PoseArchive.h"
+#include "KimeraRPGO/utils/TypeUtils.h"
+#include "SolverTestUtils.h"
+
+using KimeraRPGO::PoseArchive;
+using KimeraRPGO::RobustSolver;
+using KimeraRPGO::RobustSolverParams;
+using KimeraRPGO::SlottedFactors;
+using KimeraRPGO::Verbosity;
+using solver_test::addOdometry;
+using solver_test::loopClosure;
+using solver_test::makeSolver;
+
+namespace {
+const size_t kNumPoses = 30;
+const std::string kOutputFolder = "/tmp";
+// odometry with a drift of 2 mm per step to the side
+const double kDrift = 0.002;
+
+RobustSolverParams pcmParams() {
+  RobustSolverParams params;
+  params.setPcm3DParams(3.0, 3.0, Verbosity::QUIET);
+  return params;
+}
+
+template <class T>
+void write(std::ostream* stream, const T& value) {
+  stream->write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <class T>
+void writeVector(std::ostream* stream, const std::vector<T>& values) {
+  write<uint64_t>(stream, values.size());
+  stream->write(reinterpret_cast<const char*>(values.data()),
+                values.size() * sizeof(T));
+}
+
+// archive in the format of PoseArchive::save: one isotropic noise model and
+// one Pose2 segment with a factor between the first two keys
+std::string pose2Archive(const std::vector<gtsam::Key>& keys,
+                         const std::vector<double>& poses) {
+  std::stringstream stream;
+  write<uint64_t>(&stream, 0x314352414f475052);  // "RPGOARC1"
+  write<uint32_t>(&stream, 1);                   // version
+  write<uint32_t>(&stream, 1);                   // noise models
+  write<uint32_t>(&stream, 3);
+  write<uint8_t>(&stream, 0);  // isotropic
+  write<double>(&stream, 0.1);
+  write<uint64_t>(&stream, 1);  // segments
+  write<uint8_t>(&stream, 0);   // Pose2
+  writeVector(&stream, keys);
+  writeVector(&stream, poses);
+  writeVector(&stream, std::vector<gtsam::Key>{keys[0], keys[1]});
+  writeVector(&stream, std::vector<double>{1, 0, 0});
+  writeVector(&stream, std::vector<uint32_t>{0});
+  writeVector(&stream, std::vector<uint64_t>{0});
+  return stream.str();
+}
+
+size_t countLines(const std::string& filename, const std::string& prefix) {
+  std::ifstream infile(filename);
+  size_t num = 0;
+  std::string line;
+  while (std::getline(infile, line)) {
+    if (line.compare(0, prefix.size(), prefix) == 0) num++;
+  }
+  return num;
+}
+}  // namespace
+
+/* ************************************************************************* */
+TEST(PoseArchive, PackAndLoad) {
+  PoseArchive archive;
+  gtsam::Values poses;
+  SlottedFactors factors;
+  const gtsam::SharedNoiseModel diagonal = gtsam::noiseModel::Diagonal::Sigmas(
+      gtsam::Vector3(0.1, 0.1, 0.05), false);
+  for (size_t i = 0; i < 5; i++) {
+    poses.insert(gtsam::Symbol('b', i), gtsam::Pose2(i, 0.5 * i, 0.1 * i));
+    if (i == 0) continue;
+    factors.emplace_back(
+        2 * i,
+        boost::make_shared<gtsam::BetweenFactor<gtsam::Pose2>>(
+            gtsam::Symbol('b', i - 1),
+            gtsam::Symbol('b', i),
+            gtsam::Pose2(1, 0.5, 0.1),
+            diagonal));
+  }
+  EXPECT(PoseArchive::packable(*factors.front().second));
+  EXPECT(!PoseArchive::packable(gtsam::PriorFactor<gtsam::Pose2>(
+      gtsam::Symbol('b', 0), gtsam::Pose2(), diagonal)));
+  archive.add(poses, factors);
+  EXPECT(archive.numSegments() == 1);
+  EXPECT(archive.numPoses() == 5);
+  EXPECT(archive.numFactors() == 4);
+  EXPECT(archive.contains(gtsam::Symbol('b', 3)));
+  EXPECT(!archive.contains(gtsam::Symbol('b', 5)));
+  EXPECT(archive.prefix(0) == 'b');
+
+  std::stringstream stream;
+  archive.save(stream);
+  PoseArchive loaded;
+  EXPECT(loaded.load(stream));
+  EXPECT(loaded.numPoses() == 5);
+
+  gtsam::Values unpacked;
+  SlottedFactors unpacked_factors;
+  loaded.extract(0, &unpacked, &unpacked_factors);
+  EXPECT(loaded.empty());
+  EXPECT(gtsam::assert_equal(poses, unpacked));
+  EXPECT(unpacked_factors.size() == factors.size());
+  for (size_t i = 0; i < factors.size(); i++) {
+    EXPECT(unpacked_factors[i].first == factors[i].first);
+    EXPECT(factors[i].second->equals(*unpacked_factors[i].second));
+  }
+
+  std::stringstream garbage("not an archive");
+  EXPECT(!loaded.load(garbage));
+}
+
+/* ************************************************************************* */
+TEST(PoseArchive, LoadCorrupt) {
+  const std::vector<gtsam::Key> keys = {gtsam::Symbol('b', 0),
+                                        gtsam::Symbol('b', 1)};
+  const std::vector<double> poses = {0, 0, 0, 1, 0, 0};
+  const std::string valid = pose2Archive(keys, poses);
+  PoseArchive archive;
+  std::stringstream valid_stream(valid);
+  EXPECT(archive.load(valid_stream));
+  EXPECT(archive.numPoses() == 2);
+  EXPECT(archive.contains(gtsam::Symbol('b', 1)));
+
+  // truncated
+  std::stringstream truncated(valid.substr(0, valid.size() - 4));
+  EXPECT(!archive.load(truncated));
+  // length of the keys far beyond the end of the file
+  std::string huge = valid;
+  const uint64_t huge_size = uint64_t(1) << 60;
+  huge.replace(38, sizeof(huge_size),
+               reinterpret_cast<const char*>(&huge_size), sizeof(huge_size));
+  std::stringstream huge_stream(huge);
+  EXPECT(!archive.load(huge_stream));
+  // unsorted keys
+  std::stringstream unsorted(pose2Archive({keys[1], keys[0]}, poses));
+  EXPECT(!archive.load(unsorted));
+  // one pose short
+  std::stringstream short_poses(
+      pose2Archive(keys, std::vector<double>(poses.begin(), poses.end() - 3)));
+  EXPECT(!archive.load(short_poses));
+
+  // a rejected file leaves the archive as it was
+  EXPECT(archive.numPoses() == 2);
+}
+
+/* ************************************************************************* */
+TEST(PoseArchive, ArchiveAndRehydrate) {
+  std::unique_ptr<RobustSolver> pgo =
+      makeSolver(pcmParams(), kNumPoses, kDrift);
+  std::unique_ptr<RobustSolver> reference =
+      makeSolver(pcmParams(), kNumPoses, kDrift);
+  const gtsam::Values before = pgo->calculateEstimate();
+
+  // a19 stays live: its odometry leaves the region
+  EXPECT(pgo->archive('a', 20));
+  EXPECT(pgo->getNumArchivedPoses() == 19);
+  gtsam::Values estimate = pgo->calculateEstimate();
+  EXPECT(estimate.size() == kNumPoses - 19);
+  EXPECT(estimate.exists(gtsam::Symbol('a', 19)));
+  for (const auto& v : estimate) {
+    EXPECT(gtsam::assert_equal(before.at<gtsam::Pose3>(v.key),
+                               estimate.at<gtsam::Pose3>(v.key)));
+  }
+  EXPECT(!pgo->archive('a', 10));  // nothing live left below a10
+
+  // the live part keeps optimizing
+  for (RobustSolver* solver : {pgo.get(), reference.get()}) {
+    addOdometry(solver, kNumPoses - 1, kNumPoses, kDrift);
+  }
+  estimate = pgo->calculateEstimate();
+  EXPECT(estimate.size() == kNumPoses + 1 - 19);
+  EXPECT(gtsam::assert_equal(
+      reference->calculateEstimate().at<gtsam::Pose3>(
+          gtsam::Symbol('a', kNumPoses)),
+      estimate.at<gtsam::Pose3>(gtsam::Symbol('a', kNumPoses)),
+      1e-6));
+
+  // a loop closure to an archived pose brings the archive back
+  pgo->update(loopClosure(5, 25));
+  reference->update(loopClosure(5, 25));
+  EXPECT(pgo->getNumArchivedPoses() == 0);
+  EXPECT(pgo->getNumLCInliers() == 1);
+  EXPECT(pgo->getNumLCInliers() == reference->getNumLCInliers());
+  EXPECT(gtsam::assert_equal(
+      reference->calculateEstimate(), pgo->calculateEstimate(), 1e-4));
+}
+
+/* ************************************************************************* */
+TEST(PoseArchive, SaveData) {
+  std::unique_ptr<RobustSolver> pgo =
+      makeSolver(pcmParams(), kNumPoses, kDrift);
+  EXPECT(pgo->archive('a', 20));
+  pgo->saveData(kOutputFolder);
+
+  // the g2o file has the whole graph
+  const std::string g2o_file = kOutputFolder + "/result.g2o";
+  EXPECT(countLines(g2o_file, "VERTEX_SE3:QUAT") == kNumPoses);
+  EXPECT(countLines(g2o_file, "EDGE_SE3:QUAT") == kNumPoses - 1);
+
+  PoseArchive archive;
+  std::ifstream archive_file(kOutputFolder + "/archive.bin", std::ios::binary);
+  EXPECT(archive.load(archive_file));
+  EXPECT(archive.numPoses() == 19);
+  EXPECT(archive.numFactors() == 19);
+
+  pgo->rehydrateAll();
+  EXPECT(pgo->getNumArchivedPoses() == 0);
+  EXPECT(pgo->calculateEstimate().size() == kNumPoses);
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
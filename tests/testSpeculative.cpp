@@ -0,0 +1,120 @@
+/**
+ * @file    testSpeculative.cpp
+ * @brief   Unit test for the speculative updates of RobustSolver
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+#include <memory>
+
+#include <gtsam/geometry/Pose3.h>
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/RobustSolver.h"
+#include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/utils/TypeUtils.h"
+#include "SolverTestUtils.h"
+
+using KimeraRPGO::RobustSolver;
+using KimeraRPGO::RobustSolverParams;
+using KimeraRPGO::Verbosity;
+using solver_test::addOdometry;
+using solver_test::loopClosure;
+
+namespace {
+const size_t kNumPoses = 30;
+
+std::unique_ptr<RobustSolver> makeSolver() {
+  RobustSolverParams params;
+  params.setPcm3DParams(3.0, 3.0, Verbosity::QUIET);
+  return solver_test::makeSolver(params, kNumPoses);
+}
+}  // namespace
+
+/* ************************************************************************* */
+TEST(Speculative, Rollback) {
+  std::unique_ptr<RobustSolver> pgo = makeSolver();
+  pgo->update(loopClosure(0, 20), gtsam::Values());
+  const gtsam::Values estimate = pgo->calculateEstimate();
+  const size_t num_factors = pgo->size();
+  const size_t num_lc = pgo->getNumLC();
+  const size_t num_inliers = pgo->getNumLCInliers();
+
+  EXPECT(pgo->beginSpeculative());
+  EXPECT(pgo->isSpeculative());
+  EXPECT(!pgo->beginSpeculative());  // not nested
+  // more odometry, a closure pulling the trajectory and a removal
+  addOdometry(pgo.get(), kNumPoses - 1, kNumPoses + 4);
+  pgo->update(loopClosure(5, 25, 0.1), gtsam::Values());
+  pgo->update(loopClosure(10, 30, 0.1), gtsam::Values());
+  EXPECT(pgo->getNumLC() == num_lc + 2);
+  EXPECT(pgo->calculateEstimate().exists(gtsam::Symbol('a', kNumPoses + 3)));
+  EXPECT(!pgo->calculateEstimate()
+              .at<gtsam::Pose3>(gtsam::Symbol('a', 20))
+              .equals(estimate.at<gtsam::Pose3>(gtsam::Symbol('a', 20)),
+                      1e-6));
+  // the last one is from before beginSpeculative
+  for (size_t i = 0; i < 3; i++) EXPECT(pgo->removeLastLoopClosure());
+
+  pgo->rollback();
+  EXPECT(!pgo->isSpeculative());
+  EXPECT(pgo->size() == num_factors);
+  EXPECT(pgo->getNumLC() == num_lc);
+  EXPECT(pgo->getNumLCInliers() == num_inliers);
+  EXPECT(gtsam::assert_equal(estimate, pgo->calculateEstimate()));
+
+  // the removed closure is back: it can be removed again
+  KimeraRPGO::EdgePtr removed = pgo->removeLastLoopClosure();
+  EXPECT(removed);
+  EXPECT(removed->from_key == gtsam::Symbol('a', 0));
+  EXPECT(removed->to_key == gtsam::Symbol('a', 20));
+}
+
+/* ************************************************************************* */
+TEST(Speculative, SameAsWithout) {
+  // after a rollback the solver continues as if nothing happened
+  std::unique_ptr<RobustSolver> pgo = makeSolver();
+  std::unique_ptr<RobustSolver> reference = makeSolver();
+
+  EXPECT(pgo->beginSpeculative());
+  pgo->update(loopClosure(3, 23), gtsam::Values());
+  pgo->update(loopClosure(4, 24, 2.0), gtsam::Values());
+  pgo->ignorePrefix('a');
+  pgo->rollback();
+
+  for (RobustSolver* solver : {pgo.get(), reference.get()}) {
+    solver->update(loopClosure(0, 20), gtsam::Values());
+    solver->update(loopClosure(2, 22), gtsam::Values());
+    addOdometry(solver, kNumPoses - 1, kNumPoses + 1);
+  }
+  EXPECT(pgo->size() == reference->size());
+  EXPECT(pgo->getNumLC() == reference->getNumLC());
+  EXPECT(pgo->getNumLCInliers() == reference->getNumLCInliers());
+  EXPECT(pgo->getIgnoredPrefixes().empty());
+  EXPECT(gtsam::assert_equal(reference->calculateEstimate(),
+                             pgo->calculateEstimate()));
+}
+
+/* ************************************************************************* */
+TEST(Speculative, Commit) {
+  std::unique_ptr<RobustSolver> pgo = makeSolver();
+  const size_t num_lc = pgo->getNumLC();
+  EXPECT(pgo->beginSpeculative());
+  pgo->update(loopClosure(0, 20), gtsam::Values());
+  pgo->commit();
+  EXPECT(!pgo->isSpeculative());
+  EXPECT(pgo->getNumLC() == num_lc + 1);
+
+  // nothing to undo: rollback does not change anything
+  const gtsam::Values estimate = pgo->calculateEstimate();
+  pgo->rollback();
+  EXPECT(pgo->getNumLC() == num_lc + 1);
+  EXPECT(gtsam::assert_equal(estimate, pgo->calculateEstimate()));
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
@@ -95,6 +95,118 @@ TEST(RobustSolver, TemporaryFactors) {
   EXPECT(pgo->getNumLCInliers() == 0);
 }
 
+/* ************************************************************************* */
+TEST(RobustSolver, TemporaryFactorsFastPath) {
+  gtsam::NonlinearFactorGraph::shared_ptr nfg;
+  gtsam::Values::shared_ptr values;
+  boost::tie(nfg, values) =
+      gtsam::load3D(std::string(DATASET_PATH) + "/robot_a.g2o");
+
+  RobustSolverParams params;
+  params.setPcm3DParams(100.0, 100.0, Verbosity::QUIET);
+  params.setGncInlierCostThresholdsAtProbability(0.01);
+
+  // reference: full robust re-solve
+  std::unique_ptr<RobustSolver> full =
+      KimeraRPGO::make_unique<RobustSolver>(params);
+  // fast path: temporary factors only
+  std::unique_ptr<RobustSolver> fast =
+      KimeraRPGO::make_unique<RobustSolver>(params);
+  full->update(*nfg, *values);
+  fast->update(*nfg, *values);
+  const gtsam::Values permanent_estimate = fast->calculateEstimate();
+
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  const gtsam::Symbol temp_key('b', 0);
+  for (size_t i = 0; i < 3; i++) {
+    gtsam::Values temp_values;
+    gtsam::NonlinearFactorGraph temp_factors;
+    temp_values.insert(temp_key, gtsam::Pose3());
+    const gtsam::Pose3 measured(gtsam::Rot3(),
+                                gtsam::Point3(0.1 * i, 0.0, 0.0));
+    temp_factors.add(gtsam::BetweenFactor<gtsam::Pose3>(
+        gtsam::Symbol('a', 10), temp_key, measured, noise));
+
+    full->replaceTempFactorsValues(temp_factors, temp_values);
+    full->forceUpdate();
+    fast->replaceTempFactorsValues(temp_factors, temp_values);
+    fast->updateTempFactors();
+
+    // GNC decision on the permanent graph is kept
+    gtsam::Vector weights = fast->getGncWeights();
+    EXPECT(weights.size() == size_t(52));
+    EXPECT(weights.segment(49, 3).sum() == 0);
+    EXPECT(fast->getNumLCInliers() == 0);
+    EXPECT(fast->getFactorsUnsafe().size() == size_t(52));
+    EXPECT(fast->calculateEstimate().size() == size_t(50));
+
+    // the temporary leaf does not move the permanent graph
+    EXPECT(gtsam::assert_equal(
+        permanent_estimate, fast->calculateEstimate(), 1e-3));
+    EXPECT(gtsam::assert_equal(full->getTempValues().at<gtsam::Pose3>(temp_key),
+                               fast->getTempValues().at<gtsam::Pose3>(temp_key),
+                               1e-3));
+  }
+
+  // removing the temporary values reseeds the incremental solver
+  fast->clearTempFactorsValues();
+  fast->updateTempFactors();
+  EXPECT(fast->getTempValues().size() == size_t(0));
+  EXPECT(gtsam::assert_equal(
+      permanent_estimate, fast->calculateEstimate(), 1e-3));
+}
+
+/* ************************************************************************* */
+TEST(RobustSolver, TemporaryFactorsAfterOdometry) {
+  gtsam::NonlinearFactorGraph::shared_ptr nfg;
+  gtsam::Values::shared_ptr values;
+  boost::tie(nfg, values) =
+      gtsam::load3D(std::string(DATASET_PATH) + "/robot_a.g2o");
+
+  RobustSolverParams params;
+  params.setPcm3DParams(100.0, 100.0, Verbosity::QUIET);
+  params.setGncInlierCostThresholdsAtProbability(0.01);
+  std::unique_ptr<RobustSolver> pgo =
+      KimeraRPGO::make_unique<RobustSolver>(params);
+  pgo->update(*nfg, *values);
+  EXPECT(pgo->getGncWeights().segment(49, 3).sum() == 0);
+  const gtsam::Values permanent_estimate = pgo->calculateEstimate();
+
+  // odometry only: appended without a new GNC solve
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  const gtsam::Pose3 odometry(gtsam::Rot3(), gtsam::Point3(1, 0, 0));
+  gtsam::NonlinearFactorGraph odom_factors;
+  gtsam::Values odom_values;
+  odom_factors.add(gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', 49), gtsam::Symbol('a', 50), odometry, noise));
+  odom_values.insert(
+      gtsam::Symbol('a', 50),
+      permanent_estimate.at<gtsam::Pose3>(gtsam::Symbol('a', 49))
+          .compose(odometry));
+  pgo->update(odom_factors, odom_values);
+  EXPECT(pgo->getFactorsUnsafe().size() == size_t(53));
+  EXPECT(pgo->getGncWeights().size() == size_t(52));
+
+  gtsam::Values temp_values;
+  gtsam::NonlinearFactorGraph temp_factors;
+  temp_values.insert(gtsam::Symbol('b', 0), gtsam::Pose3());
+  temp_factors.add(gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', 10), gtsam::Symbol('b', 0), gtsam::Pose3(), noise));
+  pgo->replaceTempFactorsValues(temp_factors, temp_values);
+  pgo->updateTempFactors();
+
+  // the loop closures rejected by GNC do not pull the estimate
+  const gtsam::Values estimate = pgo->calculateEstimate();
+  EXPECT(estimate.size() == size_t(51));
+  for (const auto& v : permanent_estimate) {
+    EXPECT(gtsam::assert_equal(v.value.cast<gtsam::Pose3>(),
+                               estimate.at<gtsam::Pose3>(v.key),
+                               1e-3));
+  }
+}
+
 /* ************************************************************************* */
 int main() {
   TestResult tr;
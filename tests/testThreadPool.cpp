@@ -0,0 +1,106 @@
+/**
+ * @file    testThreadPool.cpp
+ * @brief   Unit test for the thread pool shared by the parallel stages
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/outlier/Pcm.h"
+#include "KimeraRPGO/utils/ThreadPool.h"
+#include "PcmTestUtils.h"
+
+using KimeraRPGO::Pcm3D;
+using KimeraRPGO::PcmParams;
+using KimeraRPGO::ThreadPool;
+using pcm_test::addOdometry;
+using pcm_test::loopClosure;
+
+namespace {
+const size_t kNumPoses = 200;
+}  // namespace
+
+/* ************************************************************************* */
+TEST(ThreadPool, ParallelFor) {
+  ThreadPool pool(4);
+  EXPECT(size_t(4) == pool.numThreads());
+  for (size_t rep = 0; rep < 100; rep++) {
+    std::vector<size_t> out(1000, 0);
+    pool.parallelFor(out.size(), [&](size_t k) { out[k] += k; });
+    for (size_t k = 0; k < out.size(); k++) EXPECT(k == out[k]);
+  }
+
+  // bounded concurrency
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  pool.parallelFor(
+      100,
+      [&](size_t) {
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.insert(std::this_thread::get_id());
+      },
+      2);
+  EXPECT(threads.size() <= 2);
+
+  // nested loops run inline
+  std::atomic<size_t> count(0);
+  pool.parallelFor(10, [&](size_t) {
+    pool.parallelFor(10, [&](size_t) { count++; });
+  });
+  EXPECT(size_t(100) == count);
+
+  bool thrown = false;
+  try {
+    pool.parallelFor(10, [](size_t k) {
+      if (k == 7) throw std::runtime_error("failed");
+    });
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  EXPECT(thrown);
+}
+
+/* ************************************************************************* */
+TEST(ThreadPool, Pcm) {
+  // the parallel rows and group searches give the serial result
+  PcmParams params;
+  params.odom_threshold = -1;  // outliers reach the pairwise check
+  params.lc_threshold = 5;
+  Pcm3D serial(params);
+  serial.setQuiet();
+  Pcm3D parallel(params);
+  parallel.setQuiet();
+  ThreadPool pool(4);
+  parallel.setThreadPool(&pool);
+
+  gtsam::NonlinearFactorGraph serial_nfg, parallel_nfg;
+  gtsam::Values serial_est, parallel_est;
+  addOdometry(&serial, kNumPoses, &serial_nfg, &serial_est);
+  addOdometry(&parallel, kNumPoses, &parallel_nfg, &parallel_est);
+  for (size_t i = 0; i + 20 < kNumPoses; i++) {
+    const gtsam::NonlinearFactorGraph lc = loopClosure(i, i + 20, i % 3 != 0);
+    serial.removeOutliers(lc, gtsam::Values(), &serial_nfg, &serial_est);
+    parallel.removeOutliers(lc, gtsam::Values(), &parallel_nfg, &parallel_est);
+  }
+
+  EXPECT(parallel.getNumLC() == serial.getNumLC());
+  EXPECT(parallel.getNumLCInliers() == serial.getNumLCInliers());
+  EXPECT(parallel.getNumConsistencyChecks() ==
+         serial.getNumConsistencyChecks());
+  EXPECT(parallel_nfg.size() == serial_nfg.size());
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
@@ -0,0 +1,130 @@
+/**
+ * @file    testTimeSlice.cpp
+ * @brief   Unit test for the time sliced optimization of RobustSolver
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+#include <memory>
+
+#include <gtsam/geometry/Pose3.h>
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/RobustSolver.h"
+#include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/utils/TypeUtils.h"
+#include "SolverTestUtils.h"
+
+using KimeraRPGO::RobustSolver;
+using KimeraRPGO::RobustSolverParams;
+using KimeraRPGO::Verbosity;
+using solver_test::loopClosure;
+
+namespace {
+const size_t kNumPoses = 30;
+
+// run the sliced optimization to convergence, returns the number of slices
+size_t resumeToConvergence(RobustSolver* pgo) {
+  size_t slices = 1;
+  while (!pgo->resumeOptimization() && slices < 1000) slices++;
+  return slices;
+}
+
+// odometry with a drift of 2 mm per step to the side, solved
+std::unique_ptr<RobustSolver> makeSolver(const RobustSolverParams& params) {
+  std::unique_ptr<RobustSolver> pgo =
+      solver_test::makeSolver(params, kNumPoses, 0.002);
+  resumeToConvergence(pgo.get());
+  return pgo;
+}
+}  // namespace
+
+/* ************************************************************************* */
+TEST(TimeSlice, SameAsBlocking) {
+  RobustSolverParams params;
+  params.setPcm3DParams(3.0, 3.0, Verbosity::QUIET);
+  std::unique_ptr<RobustSolver> reference = makeSolver(params);
+  params.setOptimizationSlice(0, 1);
+  std::unique_ptr<RobustSolver> pgo = makeSolver(params);
+  EXPECT(!pgo->isOptimizing());
+  EXPECT(pgo->resumeOptimization());  // nothing to run
+
+  const gtsam::Values before = pgo->calculateEstimate();
+  reference->update(loopClosure(0, 25), gtsam::Values());
+  pgo->update(loopClosure(0, 25), gtsam::Values());
+  // only set up: the estimate did not move yet
+  EXPECT(pgo->isOptimizing());
+  EXPECT(gtsam::assert_equal(before, pgo->calculateEstimate()));
+
+  // each slice publishes its estimate
+  EXPECT(!pgo->resumeOptimization());
+  EXPECT(!before.at<gtsam::Pose3>(gtsam::Symbol('a', 25))
+              .equals(pgo->calculateEstimate().at<gtsam::Pose3>(
+                          gtsam::Symbol('a', 25)),
+                      1e-6));
+  resumeToConvergence(pgo.get());
+  EXPECT(!pgo->isOptimizing());
+  EXPECT(pgo->getNumLCInliers() == reference->getNumLCInliers());
+  EXPECT(gtsam::assert_equal(
+      reference->calculateEstimate(), pgo->calculateEstimate(), 1e-6));
+}
+
+/* ************************************************************************* */
+TEST(TimeSlice, Supersede) {
+  RobustSolverParams params;
+  params.setPcm3DParams(3.0, 3.0, Verbosity::QUIET);
+  std::unique_ptr<RobustSolver> reference = makeSolver(params);
+  params.setOptimizationSlice(0, 1);
+  std::unique_ptr<RobustSolver> pgo = makeSolver(params);
+
+  // a second closure arrives while the first optimization is running
+  pgo->update(loopClosure(0, 25), gtsam::Values());
+  pgo->resumeOptimization();
+  pgo->update(loopClosure(5, 29, 0.05), gtsam::Values());
+  EXPECT(pgo->isOptimizing());
+  resumeToConvergence(pgo.get());
+
+  reference->update(loopClosure(0, 25), gtsam::Values());
+  reference->update(loopClosure(5, 29, 0.05), gtsam::Values());
+  EXPECT(pgo->getNumLC() == reference->getNumLC());
+  EXPECT(gtsam::assert_equal(
+      reference->calculateEstimate(), pgo->calculateEstimate(), 1e-3));
+}
+
+/* ************************************************************************* */
+TEST(TimeSlice, Gnc) {
+  RobustSolverParams params;
+  // high PCM thresholds: only GNC
+  params.setPcm3DParams(100.0, 100.0, Verbosity::QUIET);
+  params.setGncInlierCostThresholdsAtProbability(0.01);
+  params.gncNative();
+  std::unique_ptr<RobustSolver> reference = makeSolver(params);
+  params.setOptimizationSlice(0, 2);
+  std::unique_ptr<RobustSolver> pgo = makeSolver(params);
+
+  // an inlier and an outlier closure
+  gtsam::NonlinearFactorGraph lc = loopClosure(0, 25);
+  lc.add(loopClosure(3, 20, 5.0));
+  reference->update(lc, gtsam::Values());
+  pgo->update(lc, gtsam::Values());
+  EXPECT(resumeToConvergence(pgo.get()) > 1);
+  EXPECT(gtsam::assert_equal(reference->getGncWeights(), pgo->getGncWeights()));
+  EXPECT(pgo->getNumLCInliers() == reference->getNumLCInliers());
+  EXPECT(gtsam::assert_equal(
+      reference->calculateEstimate(), pgo->calculateEstimate(), 1e-6));
+
+  // a time budget alone also converges
+  params.setOptimizationSlice(0.5);
+  std::unique_ptr<RobustSolver> timed = makeSolver(params);
+  timed->update(lc, gtsam::Values());
+  resumeToConvergence(timed.get());
+  EXPECT(gtsam::assert_equal(
+      reference->calculateEstimate(), timed->calculateEstimate(), 1e-6));
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
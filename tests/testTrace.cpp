@@ -0,0 +1,151 @@
+/**
+ * @file    testTrace.cpp
+ * @brief   Unit test for the Chrome trace of the solver internals
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/RobustSolver.h"
+#include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/utils/Trace.h"
+#include "SolverTestUtils.h"
+
+using namespace KimeraRPGO;
+using solver_test::addPrior;
+using solver_test::noise;
+
+namespace {
+const std::string kTraceFile = "/tmp/rpgo_test_trace.json";
+
+std::string readFile(const std::string& filename) {
+  std::ifstream infile(filename);
+  std::stringstream content;
+  content << infile.rdbuf();
+  return content.str();
+}
+
+size_t count(const std::string& content, const std::string& pattern) {
+  size_t num = 0;
+  for (size_t pos = content.find(pattern); pos != std::string::npos;
+       pos = content.find(pattern, pos + 1)) {
+    num++;
+  }
+  return num;
+}
+}  // namespace
+
+/* ************************************************************************* */
+TEST(Trace, Scopes) {
+  { RPGO_TRACE_SCOPE("before start"); }
+  Trace::start(kTraceFile);
+  {
+    RPGO_TRACE_SCOPE_DETAIL("main", "robots \"ab\"");
+    std::thread worker([] { RPGO_TRACE_SCOPE("worker"); });
+    worker.join();
+  }
+  EXPECT(Trace::stop());
+  EXPECT(!Trace::enabled());
+  { RPGO_TRACE_SCOPE("after stop"); }
+
+  const std::string content = readFile(kTraceFile);
+  EXPECT(count(content, "\"ph\":\"X\"") == 2);
+  EXPECT(count(content, "\"name\":\"worker\"") == 1);
+  EXPECT(count(content, "\"detail\":\"robots \\\"ab\\\"\"") == 1);
+  EXPECT(count(content, "before start") == 0);
+  EXPECT(count(content, "after stop") == 0);
+}
+
+/* ************************************************************************* */
+TEST(Trace, RobustSolver) {
+  RobustSolverParams params;
+  params.setPcm3DParams(100.0, 100.0, Verbosity::QUIET);
+  params.traceOutput(kTraceFile);
+  std::unique_ptr<RobustSolver> pgo =
+      KimeraRPGO::make_unique<RobustSolver>(params);
+
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values values;
+  nfg.add(gtsam::PriorFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', 0), gtsam::Pose3(), noise()));
+  values.insert(gtsam::Symbol('a', 0), gtsam::Pose3());
+  for (size_t i = 0; i < 5; i++) {
+    nfg.add(gtsam::BetweenFactor<gtsam::Pose3>(
+        gtsam::Symbol('a', i),
+        gtsam::Symbol('a', i + 1),
+        gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(1, 0, 0)),
+        noise()));
+    values.insert(gtsam::Symbol('a', i + 1),
+                  gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(i + 1, 0, 0)));
+  }
+  pgo->update(nfg, values);
+  gtsam::NonlinearFactorGraph lc;
+  // slightly off so that LM iterates
+  lc.add(gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', 0),
+      gtsam::Symbol('a', 5),
+      gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(5.1, 0, 0)),
+      noise()));
+  pgo->update(lc, gtsam::Values());
+  EXPECT(Trace::enabled());
+  pgo.reset();  // writes the trace
+
+  const std::string content = readFile(kTraceFile);
+  EXPECT(count(content, "\"name\":\"RobustSolver::update\"") == 2);
+  EXPECT(count(content, "\"name\":\"Pcm max clique\"") == 1);
+  EXPECT(count(content, "\"name\":\"Pcm adjacency row\"") == 1);
+  EXPECT(count(content, "\"detail\":\"aa\"") == 2);
+  EXPECT(count(content, "\"name\":\"LM iteration\"") >= 1);
+}
+
+/* ************************************************************************* */
+TEST(Trace, Shared) {
+  EXPECT(!Trace::stop());  // not started
+  EXPECT(Trace::start(kTraceFile));
+  EXPECT(Trace::start(kTraceFile));
+  EXPECT(!Trace::start("/tmp/rpgo_test_other_trace.json"));
+  EXPECT(Trace::stop());
+  EXPECT(Trace::enabled());
+  EXPECT(Trace::stop());
+  EXPECT(!Trace::enabled());
+
+  // solvers tracing to the same file share the trace, the last one
+  // destroyed writes the events of both
+  RobustSolverParams params;
+  params.setPcm3DParams(100.0, 100.0, Verbosity::QUIET);
+  params.traceOutput(kTraceFile);
+  std::unique_ptr<RobustSolver> first =
+      KimeraRPGO::make_unique<RobustSolver>(params);
+  std::unique_ptr<RobustSolver> second =
+      KimeraRPGO::make_unique<RobustSolver>(params);
+  params.traceOutput("/tmp/rpgo_test_other_trace.json");
+  std::unique_ptr<RobustSolver> other =
+      KimeraRPGO::make_unique<RobustSolver>(params);
+  addPrior(first.get(), 'a');
+  addPrior(second.get(), 'b');
+  addPrior(other.get(), 'c');
+  std::ofstream(kTraceFile).close();
+  first.reset();
+  other.reset();
+  EXPECT(Trace::enabled());
+  EXPECT(readFile(kTraceFile).empty());
+  second.reset();
+  EXPECT(!Trace::enabled());
+
+  const std::string content = readFile(kTraceFile);
+  EXPECT(count(content, "\"name\":\"RobustSolver::update\"") == 3);
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
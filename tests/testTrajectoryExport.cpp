@@ -0,0 +1,143 @@
+/**
+ * @file    testTrajectoryExport.cpp
+ * @brief   Unit test for the per robot trajectory export
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include <gtsam/geometry/Point3.h>
+#include <gtsam/geometry/Pose2.h>
+#include <gtsam/geometry/Pose3.h>
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/RobustSolver.h"
+#include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/utils/ThreadPool.h"
+#include "KimeraRPGO/utils/TrajectoryExport.h"
+#include "KimeraRPGO/utils/TypeUtils.h"
+
+using KimeraRPGO::RobustSolver;
+using KimeraRPGO::RobustSolverParams;
+using KimeraRPGO::TrajectoryFormat;
+using KimeraRPGO::TrajectoryRange;
+using KimeraRPGO::Verbosity;
+
+namespace {
+const std::string kOutputFolder = "/tmp";
+
+// robot a in 3D, robot b in 2D, landmarks l (not a trajectory)
+gtsam::Values makeValues() {
+  gtsam::Values values;
+  for (size_t i = 0; i < 5; i++) {
+    values.insert(gtsam::Symbol('b', 4 - i), gtsam::Pose2(4 - i, 1, 0.1));
+    values.insert(gtsam::Symbol('a', i),
+                  gtsam::Pose3(gtsam::Rot3::Yaw(0.1 * i),
+                               gtsam::Point3(i, 0, 0.5)));
+  }
+  values.insert(gtsam::Symbol('l', 0), gtsam::Point3(1, 2, 3));
+  return values;
+}
+
+size_t countLines(const std::string& filename) {
+  std::ifstream infile(filename);
+  size_t num = 0;
+  std::string line;
+  while (std::getline(infile, line)) num++;
+  return num;
+}
+}  // namespace
+
+/* ************************************************************************* */
+TEST(TrajectoryExport, Split) {
+  const gtsam::Values values = makeValues();
+  const std::vector<TrajectoryRange> trajectories =
+      KimeraRPGO::splitTrajectories(values);
+  EXPECT(trajectories.size() == 2);
+  EXPECT(trajectories[0].prefix == 'a');
+  EXPECT(trajectories[1].prefix == 'b');
+  for (const TrajectoryRange& trajectory : trajectories) {
+    EXPECT(trajectory.num_poses == 5);
+    size_t index = 0;
+    for (auto it = trajectory.begin; it != trajectory.end; ++it) {
+      EXPECT(gtsam::Symbol((*it).key).index() == index++);
+    }
+  }
+
+  // binary: indices and poses in order, planar poses lifted to 3D
+  std::stringstream stream;
+  KimeraRPGO::writeTrajectory(trajectories[1], TrajectoryFormat::BINARY,
+                              &stream);
+  uint64_t num_poses;
+  stream.read(reinterpret_cast<char*>(&num_poses), sizeof(num_poses));
+  EXPECT(num_poses == 5);
+  for (size_t i = 0; i < num_poses; i++) {
+    uint64_t index;
+    double pose[7];
+    stream.read(reinterpret_cast<char*>(&index), sizeof(index));
+    stream.read(reinterpret_cast<char*>(pose), sizeof(pose));
+    EXPECT(index == i);
+    EXPECT(gtsam::assert_equal(
+        gtsam::Pose3(gtsam::Pose2(i, 1, 0.1)),
+        gtsam::Pose3(
+            gtsam::Rot3::Quaternion(pose[3], pose[4], pose[5], pose[6]),
+            gtsam::Point3(pose[0], pose[1], pose[2]))));
+  }
+  EXPECT(static_cast<bool>(stream));
+}
+
+/* ************************************************************************* */
+TEST(TrajectoryExport, Files) {
+  KimeraRPGO::ThreadPool thread_pool(2);
+  EXPECT(KimeraRPGO::writeTrajectories(
+             makeValues(), kOutputFolder, TrajectoryFormat::CSV,
+             &thread_pool) == 2);
+  // header and one line per pose
+  EXPECT(countLines(kOutputFolder + "/robot_a.csv") == 6);
+  EXPECT(countLines(kOutputFolder + "/robot_b.csv") == 6);
+}
+
+/* ************************************************************************* */
+TEST(TrajectoryExport, RobustSolver) {
+  RobustSolverParams params;
+  params.setPcm3DParams(3.0, 3.0, Verbosity::QUIET);
+  params.setThreads(2);
+  RobustSolver pgo(params);
+  const gtsam::SharedNoiseModel noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  for (char prefix : {'a', 'c'}) {
+    gtsam::NonlinearFactorGraph factors;
+    gtsam::Values values;
+    factors.add(gtsam::PriorFactor<gtsam::Pose3>(
+        gtsam::Symbol(prefix, 0), gtsam::Pose3(), noise));
+    values.insert(gtsam::Symbol(prefix, 0), gtsam::Pose3());
+    for (size_t i = 0; i < 3; i++) {
+      factors.add(gtsam::BetweenFactor<gtsam::Pose3>(
+          gtsam::Symbol(prefix, i),
+          gtsam::Symbol(prefix, i + 1),
+          gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(1, 0, 0)),
+          noise));
+      values.insert(gtsam::Symbol(prefix, i + 1),
+                    gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(i + 1, 0, 0)));
+    }
+    pgo.update(factors, values);
+  }
+  EXPECT(pgo.exportTrajectories(kOutputFolder, TrajectoryFormat::BINARY) ==
+         2);
+  std::ifstream infile(kOutputFolder + "/robot_c.bin", std::ios::binary);
+  uint64_t num_poses = 0;
+  infile.read(reinterpret_cast<char*>(&num_poses), sizeof(num_poses));
+  EXPECT(num_poses == 4);
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
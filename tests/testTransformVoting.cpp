@@ -0,0 +1,120 @@
+/**
+ * @file    testTransformVoting.cpp
+ * @brief   Unit test for the frame transform voting of inter robot loop
+ *          closures
+ * @author  Yun Chang
+ */
+
+#include <CppUnitLite/TestHarness.h>
+
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/outlier/Pcm.h"
+#include "PcmTestUtils.h"
+
+using KimeraRPGO::ObservationId;
+using KimeraRPGO::Pcm3D;
+using KimeraRPGO::PcmParams;
+using pcm_test::addOdometry;
+
+namespace {
+const size_t kNumPoses = 10;
+const size_t kNumInliers = 6;
+const size_t kNumOutliers = 6;
+
+// robot b starts 5 m to the left of robot a: inliers imply T_wa_wb = (0, 5, 0)
+// and every outlier implies a different transform
+gtsam::NonlinearFactorGraph interRobotClosures() {
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  gtsam::NonlinearFactorGraph lcs;
+  for (size_t k = 0; k < kNumInliers; k++) {
+    lcs.add(gtsam::BetweenFactor<gtsam::Pose3>(
+        gtsam::Symbol('a', k),
+        gtsam::Symbol('b', k + 1),
+        gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(1, 5, 0)),
+        noise));
+  }
+  for (size_t k = 0; k < kNumOutliers; k++) {
+    lcs.add(gtsam::BetweenFactor<gtsam::Pose3>(
+        gtsam::Symbol('a', k),
+        gtsam::Symbol('b', k),
+        gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(0, 15.0 + 4.0 * k, 0)),
+        noise));
+  }
+  return lcs;
+}
+
+size_t runPcm(const PcmParams& params, size_t* num_checks) {
+  Pcm3D pcm(params);
+  pcm.setQuiet();
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values est;
+  addOdometry(&pcm, kNumPoses, &nfg, &est, 'a', false);
+  addOdometry(&pcm, kNumPoses, &nfg, &est, 'b', false);
+  pcm.removeOutliers(interRobotClosures(), gtsam::Values(), &nfg, &est);
+  *num_checks = pcm.getNumConsistencyChecks();
+  return pcm.getNumLCInliers();
+}
+}  // namespace
+
+/* ************************************************************************* */
+TEST(TransformVoting, DominantMode) {
+  PcmParams params;
+  params.odom_threshold = 100;
+  params.lc_threshold = 5;
+  size_t full_checks = 0;
+  const size_t full_inliers = runPcm(params, &full_checks);
+
+  params.transform_voting = true;
+  size_t voting_checks = 0;
+  const size_t voting_inliers = runPcm(params, &voting_checks);
+
+  EXPECT(kNumInliers == full_inliers);
+  EXPECT(kNumInliers == voting_inliers);
+  const size_t num_lc = kNumInliers + kNumOutliers;
+  EXPECT(num_lc * (num_lc - 1) / 2 == full_checks);
+  // only the closures in the winning cell are compared
+  EXPECT(kNumInliers * (kNumInliers - 1) / 2 == voting_checks);
+
+  // same with the lazy search
+  params.lazy_consistency = true;
+  size_t lazy_checks = 0;
+  EXPECT(kNumInliers == runPcm(params, &lazy_checks));
+  EXPECT(lazy_checks <= voting_checks);
+}
+
+/* ************************************************************************* */
+TEST(TransformVoting, IntraRobot) {
+  // intra robot groups are not affected
+  PcmParams params;
+  params.odom_threshold = 100;
+  params.lc_threshold = 5;
+  params.transform_voting = true;
+  Pcm3D pcm(params);
+  pcm.setQuiet();
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values est;
+  addOdometry(&pcm, kNumPoses, &nfg, &est, 'a', false);
+
+  static const gtsam::SharedNoiseModel& noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  gtsam::NonlinearFactorGraph lcs;
+  for (size_t k = 0; k < 3; k++) {
+    lcs.add(gtsam::BetweenFactor<gtsam::Pose3>(
+        gtsam::Symbol('a', k),
+        gtsam::Symbol('a', k + 5),
+        gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(5, 0, 0)),
+        noise));
+  }
+  pcm.removeOutliers(lcs, gtsam::Values(), &nfg, &est);
+  EXPECT(size_t(3) == pcm.getNumLCInliers());
+  EXPECT(size_t(3) == pcm.getNumConsistencyChecks());
+}
+
+/* ************************************************************************* */
+int main() {
+  TestResult tr;
+  return TestRegistry::runAllTests(tr);
+}
+/* ************************************************************************* */
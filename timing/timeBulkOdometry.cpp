@@ -0,0 +1,68 @@
+/*
+Timing of a bulk load of odometry through RobustSolver::update
+One update with the prior and the whole odometry of a few robots (e.g. a
+previous session), the odometry of each robot chained in order. PCM composes
+each run of odometry in one loop (see Pcm::updateOdometry)
+Usage: ./timeBulkOdometry <optional:poses-per-robot> <optional:num-robots>
+*/
+
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/RobustSolver.h"
+#include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/utils/TypeUtils.h"
+
+using namespace KimeraRPGO;
+
+int main(int argc, char* argv[]) {
+  size_t num_poses = 250000;
+  size_t num_robots = 4;
+  if (argc > 1) num_poses = atoi(argv[1]);
+  if (argc > 2) num_robots = atoi(argv[2]);
+
+  const gtsam::SharedNoiseModel noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  const gtsam::Pose3 odometry(gtsam::Rot3::Yaw(0.001),
+                              gtsam::Point3(1, 0, 0));
+  gtsam::NonlinearFactorGraph factors;
+  gtsam::Values values;
+  for (size_t r = 0; r < num_robots; r++) {
+    const char robot = 'a' + r;
+    gtsam::Pose3 pose;
+    factors.add(gtsam::PriorFactor<gtsam::Pose3>(
+        gtsam::Symbol(robot, 0), pose, noise));
+    values.insert(gtsam::Symbol(robot, 0), pose);
+    for (size_t i = 0; i + 1 < num_poses; i++) {
+      pose = pose.compose(odometry);
+      factors.add(gtsam::BetweenFactor<gtsam::Pose3>(
+          gtsam::Symbol(robot, i), gtsam::Symbol(robot, i + 1), odometry,
+          noise));
+      values.insert(gtsam::Symbol(robot, i + 1), pose);
+    }
+  }
+
+  for (bool pcm : {true, false}) {
+    RobustSolverParams params;
+    if (pcm) {
+      params.setPcm3DParams(3.0, 3.0, Verbosity::QUIET);
+    } else {
+      params.setNoRejection(Verbosity::QUIET);
+    }
+    std::unique_ptr<RobustSolver> pgo =
+        KimeraRPGO::make_unique<RobustSolver>(params);
+    auto start = std::chrono::high_resolution_clock::now();
+    // load only: the optimization is not part of the ingestion
+    pgo->update(factors, values, false);
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::cout << (pcm ? "PCM" : "no rejection") << ": "
+              << factors.size() - num_robots << " odometry factors in "
+              << std::chrono::duration<double, std::milli>(stop - start).count()
+              << " ms" << std::endl;
+  }
+  return 0;
+}
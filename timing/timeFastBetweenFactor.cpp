@@ -0,0 +1,132 @@
+/*
+Timing of the relative pose factors
+Compares residual and Jacobian evaluation (and linearization) of the analytic
+FastBetweenFactor against gtsam's BetweenFactor on the path enabled by
+SLOW_BUT_CORRECT_BETWEENFACTOR (chain rule through the Local Jacobian)
+Usage: ./timeFastBetweenFactor <optional:num-evaluations>
+*/
+
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtsam/nonlinear/Values.h>
+
+#include "KimeraRPGO/utils/FastBetweenFactor.h"
+
+using namespace KimeraRPGO;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double seconds(const Clock::time_point& start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/* Error and Jacobians as computed by gtsam::BetweenFactor when
+ * SLOW_BUT_CORRECT_BETWEENFACTOR is defined (reimplemented here so that this
+ * file does not instantiate BetweenFactor with a different definition)
+ */
+template <class T>
+gtsam::Vector slowBetweenError(const T& measured,
+                               const T& p1,
+                               const T& p2,
+                               boost::optional<gtsam::Matrix&> H1,
+                               boost::optional<gtsam::Matrix&> H2) {
+  T hx = gtsam::traits<T>::Between(p1, p2, H1, H2);
+  typename gtsam::traits<T>::ChartJacobian::Jacobian Hlocal;
+  gtsam::Vector rval = gtsam::traits<T>::Local(
+      measured, hx, boost::none, (H1 || H2) ? &Hlocal : 0);
+  if (H1) *H1 = Hlocal * (*H1);
+  if (H2) *H2 = Hlocal * (*H2);
+  return rval;
+}
+
+template <class T>
+void timeFactor(const std::string& name,
+                size_t num_evaluations,
+                const std::vector<T>& poses) {
+  const gtsam::SharedNoiseModel noise =
+      gtsam::noiseModel::Isotropic::Variance(T::dimension, 0.01);
+  const size_t n = poses.size();
+  std::vector<FastBetweenFactor<T>> factors;
+  for (size_t i = 0; i + 1 < n; i++) {
+    factors.push_back(FastBetweenFactor<T>(
+        i, i + 1, poses[i].between(poses[i + 1]), noise));
+  }
+  gtsam::Values values;
+  for (size_t i = 0; i < n; i++) values.insert(i, poses[(i * 7) % n]);
+
+  gtsam::Matrix H1, H2;
+  double checksum = 0;
+
+  auto start = Clock::now();
+  for (size_t k = 0; k < num_evaluations; k++) {
+    const FastBetweenFactor<T>& f = factors[k % factors.size()];
+    checksum += slowBetweenError<T>(f.measured(),
+                                    values.at<T>(f.key1()),
+                                    values.at<T>(f.key2()),
+                                    H1,
+                                    H2)(0);
+  }
+  const double slow_time = seconds(start);
+
+  start = Clock::now();
+  for (size_t k = 0; k < num_evaluations; k++) {
+    const FastBetweenFactor<T>& f = factors[k % factors.size()];
+    checksum += f.evaluateError(values.at<T>(f.key1()),
+                                values.at<T>(f.key2()),
+                                H1,
+                                H2)(0);
+  }
+  const double fast_time = seconds(start);
+
+  start = Clock::now();
+  for (size_t k = 0; k < num_evaluations; k++) {
+    const FastBetweenFactor<T>& f = factors[k % factors.size()];
+    checksum += f.evaluateError(values.at<T>(f.key1()),
+                                values.at<T>(f.key2()))(0);
+  }
+  const double residual_time = seconds(start);
+
+  start = Clock::now();
+  for (size_t k = 0; k < num_evaluations; k++) {
+    checksum += factors[k % factors.size()].linearize(values)->rows();
+  }
+  const double linearize_time = seconds(start);
+
+  std::cout << name << std::endl;
+  std::cout << "  residual + Jacobians, gtsam slow path (M/s): "
+            << num_evaluations / slow_time * 1e-6 << std::endl;
+  std::cout << "  residual + Jacobians, analytic (M/s): "
+            << num_evaluations / fast_time * 1e-6
+            << ", speedup: " << slow_time / fast_time << std::endl;
+  std::cout << "  residual only, analytic (M/s): "
+            << num_evaluations / residual_time * 1e-6 << std::endl;
+  std::cout << "  linearize, analytic (M/s): "
+            << num_evaluations / linearize_time * 1e-6 << std::endl;
+  if (checksum == 0) std::cout << "";
+}
+
+int main(int argc, char* argv[]) {
+  size_t num_evaluations = 1000000;
+  if (argc > 1) num_evaluations = atoi(argv[1]);
+
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> angle(-3.0, 3.0);
+  std::uniform_real_distribution<double> position(-10.0, 10.0);
+  std::vector<gtsam::Pose3> poses3;
+  std::vector<gtsam::Pose2> poses2;
+  for (size_t i = 0; i < 1000; i++) {
+    poses3.push_back(gtsam::Pose3(
+        gtsam::Rot3::Ypr(angle(rng), angle(rng) / 2, angle(rng)),
+        gtsam::Point3(position(rng), position(rng), position(rng))));
+    poses2.push_back(gtsam::Pose2(position(rng), position(rng), angle(rng)));
+  }
+
+  timeFactor<gtsam::Pose3>("Pose3", num_evaluations, poses3);
+  timeFactor<gtsam::Pose2>("Pose2", num_evaluations, poses2);
+  return 0;
+}
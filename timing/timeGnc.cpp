@@ -0,0 +1,142 @@
+/*
+Timing of GNC
+Runs gtsam::GncOptimizer and the in-library GncSolver on a synthetic pose graph
+(odometry chain, correct loop closures and random outliers) and reports time,
+iterations and agreement of the weights
+Usage: ./timeGnc <optional:num-poses> <optional:num-inliers>
+       <optional:num-outliers> <optional:num-threads>
+*/
+
+#include <stdlib.h>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <gtsam/inference/Symbol.h>
+#include <gtsam/nonlinear/GncOptimizer.h>
+#include <gtsam/slam/PriorFactor.h>
+
+#include "KimeraRPGO/utils/FastBetweenFactor.h"
+#include "KimeraRPGO/utils/GncSolver.h"
+
+using namespace KimeraRPGO;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double seconds(const Clock::time_point& start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+  size_t num_poses = 2000;
+  size_t num_inliers = 200;
+  size_t num_outliers = 50;
+  size_t num_threads = 0;
+  if (argc > 1) num_poses = atoi(argv[1]);
+  if (argc > 2) num_inliers = atoi(argv[2]);
+  if (argc > 3) num_outliers = atoi(argv[3]);
+  if (argc > 4) num_threads = atoi(argv[4]);
+
+  std::mt19937 rng(0);
+  std::normal_distribution<double> noise(0.0, 0.05);
+  std::uniform_real_distribution<double> angle(-3.0, 3.0);
+  std::uniform_real_distribution<double> position(-20.0, 20.0);
+  std::uniform_int_distribution<size_t> pick(0, num_poses - 1);
+  const gtsam::SharedNoiseModel model =
+      gtsam::noiseModel::Isotropic::Sigma(6, 0.05);
+
+  // ground truth: a spiral
+  std::vector<gtsam::Pose3> poses;
+  for (size_t i = 0; i < num_poses; i++) {
+    const double t = 0.05 * i;
+    poses.push_back(
+        gtsam::Pose3(gtsam::Rot3::Yaw(t),
+                     gtsam::Point3(10 * std::cos(t), 10 * std::sin(t), t)));
+  }
+  auto perturb = [&](const gtsam::Pose3& pose) {
+    gtsam::Vector6 delta;
+    for (size_t d = 0; d < 6; d++) delta(d) = noise(rng);
+    return pose.retract(delta);
+  };
+
+  gtsam::NonlinearFactorGraph nfg;
+  gtsam::Values initial;
+  std::vector<size_t> known_inliers;
+  nfg.add(gtsam::PriorFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', 0), poses[0], model));
+  known_inliers.push_back(0);
+  initial.insert(gtsam::Symbol('a', 0), poses[0]);
+  gtsam::Pose3 dead_reckoning = poses[0];
+  for (size_t i = 0; i + 1 < num_poses; i++) {
+    const gtsam::Pose3 odom = perturb(poses[i].between(poses[i + 1]));
+    known_inliers.push_back(nfg.size());
+    nfg.add(FastBetweenFactor3D(
+        gtsam::Symbol('a', i), gtsam::Symbol('a', i + 1), odom, model));
+    dead_reckoning = dead_reckoning.compose(odom);
+    initial.insert(gtsam::Symbol('a', i + 1), dead_reckoning);
+  }
+  for (size_t k = 0; k < num_inliers + num_outliers; k++) {
+    const size_t i = pick(rng), j = pick(rng);
+    if (i == j) continue;
+    const gtsam::Pose3 measured =
+        k < num_inliers
+            ? perturb(poses[i].between(poses[j]))
+            : gtsam::Pose3(
+                  gtsam::Rot3::Ypr(angle(rng), angle(rng) / 2, angle(rng)),
+                  gtsam::Point3(position(rng), position(rng), position(rng)));
+    nfg.add(FastBetweenFactor3D(
+        gtsam::Symbol('a', i), gtsam::Symbol('a', j), measured, model));
+  }
+
+  gtsam::LevenbergMarquardtParams lm_params;
+  lm_params.diagonalDamping = true;
+  GncParams gnc_params;
+  gnc_params.gnc_inlier_threshold_ = 0.99;
+
+  // gtsam
+  auto start = Clock::now();
+  gtsam::GncParams<gtsam::LevenbergMarquardtParams> params(lm_params);
+  params.setKnownInliers(decltype(params.knownInliers)(known_inliers.begin(),
+                                                       known_inliers.end()));
+  params.setMaxIterations(gnc_params.max_iterations_);
+  params.setMuStep(gnc_params.mu_step_);
+  params.setRelativeCostTol(gnc_params.relative_cost_tol_);
+  params.setWeightsTol(gnc_params.weights_tol_);
+  gtsam::GncOptimizer<gtsam::GncParams<gtsam::LevenbergMarquardtParams>>
+      gnc_optimizer(nfg, initial, params);
+  gnc_optimizer.setInlierCostThresholdsAtProbability(
+      gnc_params.gnc_inlier_threshold_);
+  const gtsam::Values gtsam_result = gnc_optimizer.optimize();
+  const double gtsam_time = seconds(start);
+  const gtsam::Vector gtsam_weights = gnc_optimizer.getWeights();
+
+  // native
+  start = Clock::now();
+  GncSolver gnc_solver(
+      nfg, initial, lm_params, gnc_params, known_inliers, num_threads);
+  const gtsam::Values native_result = gnc_solver.optimize();
+  const double native_time = seconds(start);
+  const gtsam::Vector native_weights = gnc_solver.getWeights();
+
+  size_t disagreements = 0;
+  for (int k = 0; k < gtsam_weights.size(); k++) {
+    if (std::round(gtsam_weights(k)) != std::round(native_weights(k))) {
+      disagreements++;
+    }
+  }
+  std::cout << "factors: " << nfg.size() << ", poses: " << num_poses
+            << std::endl;
+  std::cout << "gtsam GncOptimizer (s): " << gtsam_time
+            << ", inliers: " << gtsam_weights.sum()
+            << ", cost: " << nfg.error(gtsam_result) << std::endl;
+  std::cout << "GncSolver (s): " << native_time
+            << ", inliers: " << native_weights.sum()
+            << ", cost: " << nfg.error(native_result)
+            << ", gnc iterations: " << gnc_solver.iterations()
+            << ", LM iterations: " << gnc_solver.innerIterations() << std::endl;
+  std::cout << "speedup: " << gtsam_time / native_time
+            << ", weight disagreements: " << disagreements << std::endl;
+  return 0;
+}
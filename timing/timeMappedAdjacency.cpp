@@ -0,0 +1,94 @@
+/*
+Timing of the out-of-core consistency graph
+Builds a random consistency graph with a planted clique in a memory mapped
+adjacency, then reports build, row scan and max clique throughput
+Usage: ./timeMappedAdjacency <optional:num-vertices> <optional:avg-degree>
+       <optional:clique-size> <optional:backing-file>
+*/
+
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "KimeraRPGO/utils/GraphUtils.h"
+#include "KimeraRPGO/utils/MappedAdjacency.h"
+
+using namespace KimeraRPGO;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double seconds(const Clock::time_point& start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+  size_t num_vertices = 100000;
+  size_t avg_degree = 20;
+  size_t clique_size = 50;
+  std::string path;
+  if (argc > 1) num_vertices = atoi(argv[1]);
+  if (argc > 2) avg_degree = atoi(argv[2]);
+  if (argc > 3) clique_size = atoi(argv[3]);
+  if (argc > 4) path = argv[4];
+
+  MappedAdjacency adjacency(path);
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<size_t> pick(0, num_vertices - 1);
+
+  // build
+  auto start = Clock::now();
+  adjacency.resize(num_vertices);
+  const size_t num_random_edges = num_vertices * avg_degree / 2;
+  for (size_t e = 0; e < num_random_edges; e++) {
+    adjacency.setEdge(pick(rng), pick(rng));
+  }
+  std::vector<size_t> planted;
+  for (size_t i = 0; i < clique_size; i++) planted.push_back(pick(rng));
+  for (size_t a = 0; a < planted.size(); a++) {
+    for (size_t b = a + 1; b < planted.size(); b++) {
+      adjacency.setEdge(planted[a], planted[b]);
+    }
+  }
+  double build_time = seconds(start);
+
+  // sequential row scan (what the degree pass of the heuristic does)
+  start = Clock::now();
+  std::vector<uint64_t> row;
+  size_t checksum = 0;
+  for (size_t i = 0; i < num_vertices; i++) {
+    adjacency.getRow(i, &row);
+    checksum += row[i / 64];
+  }
+  double scan_time = seconds(start);
+  const double scanned_gb =
+      num_vertices * adjacency.rowWords() * 8.0 / (1024.0 * 1024.0 * 1024.0);
+
+  // max clique
+  std::vector<int> clique;
+  MaxCliqueStats stats;
+  start = Clock::now();
+  findMaxCliqueHeu(adjacency, &clique, &stats);
+  double clique_time = seconds(start);
+  const double rows_read = stats.nodes_expanded + num_vertices;
+
+  const double dense_gb = static_cast<double>(num_vertices) * num_vertices *
+                          8.0 / (1024.0 * 1024.0 * 1024.0);
+  std::cout << "vertices: " << num_vertices << ", edges: " << stats.num_edges
+            << ", planted clique: " << clique_size
+            << ", found clique: " << stats.clique_size << std::endl;
+  std::cout << "backing file (GB): "
+            << adjacency.mappedBytes() / (1024.0 * 1024.0 * 1024.0)
+            << " (dense Eigen adjacency would need " << dense_gb << ")"
+            << std::endl;
+  std::cout << "build (s): " << build_time << std::endl;
+  std::cout << "row scan (s): " << scan_time
+            << ", throughput (GB/s): " << scanned_gb / scan_time << std::endl;
+  std::cout << "max clique (s): " << clique_time
+            << ", rows read: " << rows_read
+            << ", rows/s: " << rows_read / clique_time << std::endl;
+  if (checksum == 0) std::cout << "";
+  return 0;
+}
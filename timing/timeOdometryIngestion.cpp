@@ -0,0 +1,116 @@
+/*
+Timing of odometry ingestion through RobustSolver::update
+Two robots with a few inter robot loop closures, then odometry only updates.
+These append to the graph (see Pcm::appendOdometry), so the latency per
+update should stay flat as the graph grows
+Usage: ./timeOdometryIngestion <optional:poses-per-robot>
+       <optional:1 for multirobot frame alignment>
+*/
+
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/RobustSolver.h"
+#include "KimeraRPGO/SolverParams.h"
+#include "KimeraRPGO/utils/TypeUtils.h"
+
+using namespace KimeraRPGO;
+
+namespace {
+const gtsam::SharedNoiseModel& noise() {
+  static const gtsam::SharedNoiseModel noise =
+      gtsam::noiseModel::Isotropic::Variance(6, 0.01);
+  return noise;
+}
+
+// robot b starts 5 m to the side of robot a, both drive along x
+gtsam::Pose3 truePose(char robot, size_t i) {
+  return gtsam::Pose3(gtsam::Rot3(),
+                      gtsam::Point3(i, robot == 'a' ? 0.0 : 5.0, 0));
+}
+
+void addOdometry(RobustSolver* pgo, char robot, size_t i) {
+  gtsam::NonlinearFactorGraph factors;
+  gtsam::Values values;
+  factors.add(gtsam::BetweenFactor<gtsam::Pose3>(
+      gtsam::Symbol(robot, i),
+      gtsam::Symbol(robot, i + 1),
+      gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(1, 0, 0)),
+      noise()));
+  // robot b in its own frame (aligned by the solver if enabled)
+  values.insert(gtsam::Symbol(robot, i + 1),
+                gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(i + 1, 0, 0)));
+  pgo->update(factors, values);
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  size_t num_poses = 100000;
+  bool frame_align = false;
+  if (argc > 1) num_poses = atoi(argv[1]);
+  if (argc > 2) frame_align = atoi(argv[2]) == 1;
+
+  RobustSolverParams params;
+  params.setPcm3DParams(3.0, 3.0, Verbosity::QUIET);
+  if (frame_align) {
+    params.setMultiRobotAlignMethod(MultiRobotAlignMethod::GNC);
+  }
+  std::unique_ptr<RobustSolver> pgo =
+      KimeraRPGO::make_unique<RobustSolver>(params);
+
+  // prior on robot a, first odometry of both robots
+  gtsam::NonlinearFactorGraph init_factors;
+  gtsam::Values init_values;
+  init_factors.add(gtsam::PriorFactor<gtsam::Pose3>(
+      gtsam::Symbol('a', 0), truePose('a', 0), noise()));
+  init_values.insert(gtsam::Symbol('a', 0), truePose('a', 0));
+  init_values.insert(gtsam::Symbol('b', 0), gtsam::Pose3());
+  pgo->update(init_factors, init_values);
+  for (size_t i = 0; i < 10; i++) {
+    addOdometry(pgo.get(), 'a', i);
+    addOdometry(pgo.get(), 'b', i);
+  }
+  // inter robot loop closures (special factors and loop closures in the
+  // graph: appended odometry breaks its layout)
+  gtsam::NonlinearFactorGraph lc;
+  for (size_t i = 0; i <= 10; i += 5) {
+    lc.add(gtsam::BetweenFactor<gtsam::Pose3>(
+        gtsam::Symbol('a', i),
+        gtsam::Symbol('b', i),
+        truePose('a', i).between(truePose('b', i)),
+        noise()));
+  }
+  pgo->update(lc, gtsam::Values());
+
+  std::cout << "odometry updates, frame alignment "
+            << (frame_align ? "on" : "off") << std::endl;
+  std::cout << std::setw(12) << "poses" << std::setw(16) << "mean [us]"
+            << std::setw(16) << "max [us]" << std::endl;
+  const size_t window = 1000;
+  double window_total = 0, window_max = 0;
+  for (size_t i = 10; i < num_poses; i++) {
+    for (char robot : {'a', 'b'}) {
+      auto start = std::chrono::high_resolution_clock::now();
+      addOdometry(pgo.get(), robot, i);
+      auto stop = std::chrono::high_resolution_clock::now();
+      const double us =
+          std::chrono::duration<double, std::micro>(stop - start).count();
+      window_total += us;
+      window_max = std::max(window_max, us);
+    }
+    if ((i + 1) % window == 0) {
+      std::cout << std::setw(12) << 2 * (i + 1) << std::setw(16)
+                << window_total / (2 * window) << std::setw(16) << window_max
+                << std::endl;
+      window_total = 0;
+      window_max = 0;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,130 @@
+/*
+Timing of the Pcm registries (loop closure groups and landmarks)
+Compares std::unordered_map with the previous ObservationId hash against
+FlatHashMap with the canonical ObservationId
+Usage: ./timePcmRegistries <optional:num-robots> <optional:num-landmarks>
+*/
+
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <gtsam/inference/Symbol.h>
+
+#include "KimeraRPGO/utils/FlatHashMap.h"
+#include "KimeraRPGO/utils/TypeUtils.h"
+
+using namespace KimeraRPGO;
+
+// ObservationId and hash as they were before canonicalization
+struct LegacyObservationId {
+  char id1;
+  char id2;
+  LegacyObservationId(char first, char second) : id1(first), id2(second) {}
+  bool operator==(const LegacyObservationId& other) const {
+    if (id1 == other.id1 && id2 == other.id2) return true;
+    if (id2 == other.id1 && id1 == other.id2) return true;
+    return false;
+  }
+};
+
+struct LegacyObservationIdHash {
+  std::size_t operator()(const LegacyObservationId& id) const {
+    using std::hash;
+    return hash<char>()(id.id1) + hash<char>()(id.id2) +
+           hash<char>()(id.id1) * hash<char>()(id.id2);
+  }
+};
+
+template <class Map, class Id>
+double timeGroupLookups(const std::vector<Id>& queries, size_t repeats) {
+  Map map;
+  for (const auto& id : queries) map[id].adj_matrix.resize(1, 1);
+  size_t checksum = 0;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t r = 0; r < repeats; r++) {
+    for (const auto& id : queries) checksum += map[id].adj_matrix.rows();
+    for (const auto& entry : map) checksum += entry.second.factors.size();
+  }
+  auto stop = std::chrono::high_resolution_clock::now();
+  if (checksum == 0) std::cout << "";
+  return std::chrono::duration<double, std::micro>(stop - start).count() /
+         (repeats * queries.size());
+}
+
+template <class Map>
+double timeLandmarkLookups(const std::vector<gtsam::Key>& queries,
+                           size_t repeats) {
+  Map map;
+  for (const auto& key : queries) map[key].adj_matrix.resize(1, 1);
+  size_t checksum = 0;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t r = 0; r < repeats; r++) {
+    for (const auto& key : queries) {
+      checksum += map.find(key)->second.adj_matrix.rows();
+    }
+    for (const auto& entry : map) checksum += entry.second.factors.size();
+  }
+  auto stop = std::chrono::high_resolution_clock::now();
+  if (checksum == 0) std::cout << "";
+  return std::chrono::duration<double, std::micro>(stop - start).count() /
+         (repeats * queries.size());
+}
+
+int main(int argc, char* argv[]) {
+  size_t num_robots = 12;
+  size_t num_landmarks = 20000;
+  if (argc > 1) num_robots = atoi(argv[1]);
+  if (argc > 2) num_landmarks = atoi(argv[2]);
+
+  // all robot pairs, queried in both orders
+  std::vector<LegacyObservationId> legacy_ids;
+  std::vector<ObservationId> ids;
+  for (size_t i = 0; i < num_robots; i++) {
+    for (size_t j = 0; j < num_robots; j++) {
+      legacy_ids.push_back(LegacyObservationId('a' + i, 'a' + j));
+      ids.push_back(ObservationId('a' + i, 'a' + j));
+    }
+  }
+
+  std::vector<gtsam::Key> landmarks;
+  std::mt19937 rng(0);
+  for (size_t i = 0; i < num_landmarks; i++) {
+    landmarks.push_back(gtsam::Symbol('l', i));
+  }
+  std::shuffle(landmarks.begin(), landmarks.end(), rng);
+
+  const size_t repeats = 200;
+  double legacy_groups = timeGroupLookups<
+      std::unordered_map<LegacyObservationId,
+                         Measurements,
+                         LegacyObservationIdHash>>(legacy_ids, repeats * 50);
+  double flat_groups =
+      timeGroupLookups<FlatHashMap<ObservationId, Measurements>>(
+          ids, repeats * 50);
+  double legacy_landmarks =
+      timeLandmarkLookups<std::unordered_map<gtsam::Key, Measurements>>(
+          landmarks, repeats);
+  double flat_landmarks =
+      timeLandmarkLookups<FlatHashMap<gtsam::Key, Measurements>>(landmarks,
+                                                                 repeats);
+
+  std::cout << "robot pairs: " << ids.size()
+            << ", landmarks: " << num_landmarks << std::endl;
+  std::cout << "loop closure groups (ns per lookup + iteration share)"
+            << std::endl;
+  std::cout << "  unordered_map (legacy hash): " << legacy_groups * 1e3
+            << std::endl;
+  std::cout << "  FlatHashMap                : " << flat_groups * 1e3
+            << std::endl;
+  std::cout << "landmarks (ns per lookup + iteration share)" << std::endl;
+  std::cout << "  unordered_map              : " << legacy_landmarks * 1e3
+            << std::endl;
+  std::cout << "  FlatHashMap                : " << flat_landmarks * 1e3
+            << std::endl;
+  return 0;
+}